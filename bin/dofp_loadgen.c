@@ -0,0 +1,864 @@
+/*
+ * dofp_loadgen.c -- Simulate many DoFP+ viewers against one server.
+ *
+ * Each player is a libdofp session with its own buffer, ABR state and stall
+ * log.  Players are spread round-robin over the connections of a single
+ * engine and download one segment at a time, like http_client_dofp with
+ * -w 1.  When a player finishes, one row of QoE metrics is written.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#include <sys/types.h>
+
+#ifndef WIN32
+#include <unistd.h>
+#else
+#include "vc_compat.h"
+#include "getopt.h"
+#endif
+
+#include <event2/event.h>
+
+#include "lsquic.h"
+#include "test_common.h"
+#include "prog.h"
+
+#include "test_config.h"
+#if HAVE_GUROBI
+#include "abr_grb_ctx.h"
+#endif
+#include "abr_worker.h"
+#include "dofp.h"
+
+#include "../src/liblsquic/lsquic_logger.h"
+#include "../src/liblsquic/lsquic_int_types.h"
+#include "../src/liblsquic/lsquic_util.h"
+#include "lsxpack_header.h"
+
+static struct dofp_ladder  *s_ladder;
+static struct dofp_settings s_settings;
+
+static struct prog          s_prog;
+static struct abr_worker   *s_abr_worker;
+static struct event        *s_abr_event;
+static FILE                *s_qoe_fh;
+
+struct player;
+
+/* A segment waiting for a stream */
+struct lg_req
+{
+    TAILQ_ENTRY(lg_req)     next;
+    struct player          *player;
+    struct dofp_segment_req seg;
+    bool                    ret;    /* Re-download */
+};
+
+TAILQ_HEAD(lg_req_head, lg_req);
+
+struct lsquic_conn_ctx
+{
+    lsquic_conn_t          *conn;           /* NULL once closed */
+    unsigned                idx;
+    unsigned                n_players;      /* Players not done yet */
+    struct lg_req_head      reqs;
+};
+
+static struct lsquic_conn_ctx  *s_conns;
+static unsigned                 s_n_conns, s_n_new_conns, s_n_open_conns;
+
+enum player_state
+{
+    PL_WAIT,        /* Timer is armed */
+    PL_SOLVING,     /* ABR job is on the worker */
+    PL_DOWNLOADING,
+    PL_DONE,
+};
+
+struct player
+{
+    unsigned                pl_id;
+    enum player_state       pl_state;
+    bool                    pl_failed;
+    struct dofp_session    *pl_sess;
+    struct dofp_p1203      *pl_p1203;
+    struct lsquic_conn_ctx *pl_conn;
+    struct event           *pl_timer;
+    lsquic_time_t           pl_start;
+    /* Current decision: the new segment, then the re-downloads */
+    struct dofp_decision    pl_dec;
+    unsigned                pl_next_ret;
+    unsigned                pl_n_reqs;  /* Requests made for pl_dec */
+};
+
+static struct player   *s_players;
+static unsigned         s_n_players, s_n_active, s_n_failed;
+static lsquic_time_t    s_start_spread; /* Players start within this [us] */
+
+
+static void
+player_decide (struct player *);
+
+
+static void
+player_print_qoe (const struct player *pl)
+{
+    struct dofp_qoe qoe;
+
+    dofp_session_qoe(pl->pl_sess, &qoe);
+    fprintf(s_qoe_fh, "%u,%s,%u,%s,%u,%.3f,%.3f,%.3f,%u,%.3f,%.3f,%u,%.3f,"
+        "%u,%.3f,%u,%.3f\n", pl->pl_id, s_settings.dss_abr->dai_name,
+        pl->pl_conn->idx, pl->pl_failed ? "failed" : "ok", qoe.dq_n_seg,
+        qoe.dq_avg_bitrate, qoe.dq_std_bitrate, qoe.dq_avg_quality,
+        qoe.dq_switches, qoe.dq_instability, qoe.dq_startup, qoe.dq_n_stalls,
+        qoe.dq_stall_dur, qoe.dq_re_count, qoe.dq_re_data,
+        qoe.dq_re_unused_count, qoe.dq_re_unused_data);
+}
+
+
+static void
+player_finish (struct player *pl, bool failed)
+{
+    struct lsquic_conn_ctx *const conn_ctx = pl->pl_conn;
+
+    if (pl->pl_state == PL_DONE)
+        return;
+    pl->pl_state = PL_DONE;
+    pl->pl_failed = failed;
+    s_n_failed += failed;
+    dofp_session_update(pl->pl_sess, lsquic_time_now());
+    player_print_qoe(pl);
+    LSQ_INFO("player %u done%s", pl->pl_id, failed ? " (failed)" : "");
+
+    --s_n_active;
+    if (0 == --conn_ctx->n_players && conn_ctx->conn)
+    {
+        LSQ_INFO("all players of connection %u are done", conn_ctx->idx);
+        lsquic_conn_close(conn_ctx->conn);
+    }
+}
+
+
+static void
+player_arm_timer (struct player *pl, lsquic_time_t delay)
+{
+    struct timeval tv;
+
+    tv.tv_sec = delay / 1000000;
+    tv.tv_usec = delay % 1000000;
+    pl->pl_state = PL_WAIT;
+    if (0 != event_add(pl->pl_timer, &tv))
+    {
+        LSQ_ERROR("player %u: cannot add timer", pl->pl_id);
+        player_finish(pl, true);
+    }
+}
+
+
+static void
+player_request (struct player *pl, const struct dofp_segment_req *seg,
+                                                                    bool ret)
+{
+    struct lsquic_conn_ctx *const conn_ctx = pl->pl_conn;
+    struct lg_req *req;
+
+    if (!conn_ctx->conn || !(req = malloc(sizeof(*req))))
+    {
+        player_finish(pl, true);
+        return;
+    }
+    req->player = pl;
+    req->seg = *seg;
+    req->ret = ret;
+    TAILQ_INSERT_TAIL(&conn_ctx->reqs, req, next);
+    pl->pl_state = PL_DOWNLOADING;
+    ++pl->pl_n_reqs;
+    lsquic_conn_make_stream(conn_ctx->conn);
+}
+
+
+/* Issue the next request of the current decision, or decide again */
+static void
+player_continue (struct player *pl)
+{
+    struct dofp_session *const sess = pl->pl_sess;
+    struct dofp_decision *const dec = &pl->pl_dec;
+    const struct dofp_segment_req *seg;
+    lsquic_time_t delay;
+    long double throughput;
+
+    if (dec->dd_next)
+    {
+        /* Wait if the ABR asked for it (SARA) or the buffer is full */
+        delay = dofp_session_request_delay(sess, dec->dd_delay);
+        dec->dd_delay = 0;
+        if (delay)
+        {
+            player_arm_timer(pl, delay);
+            return;
+        }
+        dec->dd_next = false;
+        player_request(pl, &dec->dd_next_seg, false);
+        return;
+    }
+
+    /* Skip the re-downloads that cannot make it before their playout */
+    throughput = dofp_session_throughput(sess);
+    while (pl->pl_next_ret < dec->dd_n_ret)
+    {
+        seg = &dec->dd_ret[pl->pl_next_ret++];
+        if (dofp_session_retrans_acceptable(sess, seg->dsr_seg_ind)
+            && throughput > 0 && dofp_session_available_time(sess,
+                seg->dsr_seg_ind) >= s_ladder->dl_bitrates[seg->dsr_q]
+                                        * s_ladder->dl_seg_len / throughput)
+        {
+            player_request(pl, seg, true);
+            return;
+        }
+    }
+
+    if (pl->pl_n_reqs)
+        player_decide(pl);
+    else
+        /* Nothing to do now: let one segment play out */
+        player_arm_timer(pl, (lsquic_time_t) s_ladder->dl_seg_len * 1000000);
+}
+
+
+static void
+player_apply (struct player *pl, const struct dofp_decision *dec)
+{
+    pl->pl_dec = *dec;
+    pl->pl_next_ret = 0;
+    pl->pl_n_reqs = 0;
+    player_continue(pl);
+}
+
+
+static void
+player_decide (struct player *pl)
+{
+    struct dofp_decision dec;
+    struct abr_job *job;
+
+    dofp_session_update(pl->pl_sess, lsquic_time_now());
+    switch (dofp_session_decide(pl->pl_sess, &dec, &job))
+    {
+    case DOFP_DONE:
+        player_apply(pl, &dec);
+        break;
+    case DOFP_PENDING:
+        if (0 != abr_worker_submit(s_abr_worker, job))
+        {
+            LSQ_ERROR("player %u: cannot submit ABR job", pl->pl_id);
+            dofp_job_destroy(job);
+            player_finish(pl, true);
+            break;
+        }
+        pl->pl_state = PL_SOLVING;
+        break;
+    case DOFP_END:
+        player_finish(pl, false);
+        break;
+    default:
+        LSQ_ERROR("player %u: ABR decision failed", pl->pl_id);
+        player_finish(pl, true);
+        break;
+    }
+}
+
+
+static void
+player_on_timer (evutil_socket_t fd, short what, void *arg)
+{
+    struct player *const pl = arg;
+
+    if (pl->pl_state != PL_WAIT)
+        return;
+    dofp_session_update(pl->pl_sess, lsquic_time_now());
+    if (pl->pl_n_reqs || pl->pl_dec.dd_next)
+        player_continue(pl);
+    else
+        player_decide(pl);
+    prog_process_conns(&s_prog);
+}
+
+
+/* The ABR worker pipe is readable: apply the decisions */
+static void
+lg_abr_on_done (evutil_socket_t fd, short what, void *arg)
+{
+    struct dofp_decision dec;
+    struct abr_job *job;
+    struct player *pl;
+
+    while ((job = abr_worker_next_done(s_abr_worker)))
+    {
+        pl = dofp_session_get_ctx(dofp_job_session(job));
+        if (pl->pl_state != PL_SOLVING)
+        {
+            dofp_job_destroy(job);
+            continue;
+        }
+        dofp_session_update(pl->pl_sess, lsquic_time_now());
+        if (DOFP_DONE == dofp_session_complete(pl->pl_sess, job, &dec))
+            player_apply(pl, &dec);
+        else
+        {
+            LSQ_ERROR("player %u: ABR model could not be solved", pl->pl_id);
+            player_finish(pl, true);
+        }
+    }
+    prog_process_conns(&s_prog);
+}
+
+
+static lsquic_conn_ctx_t *
+lg_on_new_conn (void *stream_if_ctx, lsquic_conn_t *conn)
+{
+    struct lsquic_conn_ctx *conn_ctx;
+
+    assert(s_n_new_conns < s_n_conns);
+    conn_ctx = &s_conns[s_n_new_conns++];
+    conn_ctx->conn = conn;
+    ++s_n_open_conns;
+    return conn_ctx;
+}
+
+
+static void
+lg_on_hsk_done (lsquic_conn_t *conn, enum lsquic_hsk_status status)
+{
+    struct lsquic_conn_ctx *const conn_ctx = lsquic_conn_get_ctx(conn);
+
+    if (status == LSQ_HSK_OK || status == LSQ_HSK_RESUMED_OK)
+        LSQ_INFO("connection %u: handshake success", conn_ctx->idx);
+    else
+        LSQ_WARN("connection %u: handshake failed", conn_ctx->idx);
+}
+
+
+static void
+lg_on_conn_closed (lsquic_conn_t *conn)
+{
+    struct lsquic_conn_ctx *const conn_ctx = lsquic_conn_get_ctx(conn);
+    struct lg_req *req;
+    unsigned i;
+
+    LSQ_INFO("connection %u closed", conn_ctx->idx);
+    conn_ctx->conn = NULL;
+    lsquic_conn_set_ctx(conn, NULL);
+    while ((req = TAILQ_FIRST(&conn_ctx->reqs)))
+    {
+        TAILQ_REMOVE(&conn_ctx->reqs, req, next);
+        free(req);
+    }
+
+    for (i = conn_ctx->idx; i < s_n_players; i += s_n_conns)
+        player_finish(&s_players[i], true);
+
+    if (0 == --s_n_open_conns)
+    {
+        LSQ_NOTICE("all connections are closed: stop engine");
+        prog_stop(&s_prog);
+    }
+}
+
+
+struct lsquic_stream_ctx
+{
+    struct lg_req          *req;
+    lsquic_time_t           created;
+    size_t                  nread;
+    bool                    fin;
+};
+
+
+static lsquic_stream_ctx_t *
+lg_on_new_stream (void *stream_if_ctx, lsquic_stream_t *stream)
+{
+    struct lsquic_conn_ctx *conn_ctx;
+    struct lsquic_stream_ctx *st_h;
+    struct lg_req *req;
+
+    if (!stream)
+    {
+        LSQ_NOTICE("%s: got null stream: no more streams possible", __func__);
+        return NULL;
+    }
+
+    if (lsquic_stream_is_pushed(stream))
+    {
+        lsquic_stream_refuse_push(stream);
+        return NULL;
+    }
+
+    conn_ctx = lsquic_conn_get_ctx(lsquic_stream_conn(stream));
+    req = TAILQ_FIRST(&conn_ctx->reqs);
+    if (!req)
+    {
+        LSQ_WARN("%s: no request for the stream", __func__);
+        lsquic_stream_close(stream);
+        return NULL;
+    }
+    TAILQ_REMOVE(&conn_ctx->reqs, req, next);
+
+    st_h = calloc(1, sizeof(*st_h));
+    if (!st_h)
+    {
+        player_finish(req->player, true);
+        free(req);
+        lsquic_stream_close(stream);
+        return NULL;
+    }
+    st_h->req = req;
+    st_h->created = lsquic_time_now();
+    lsquic_stream_wantwrite(stream, 1);
+    return st_h;
+}
+
+
+static int
+lg_send_headers (lsquic_stream_t *stream, const struct lsquic_stream_ctx *st_h)
+{
+    static struct header_buf hbuf;
+    const char *hostname = s_prog.prog_hostname;
+    struct lsxpack_header headers_arr[5];
+    char path[0x400];
+    unsigned h_idx = 0;
+
+    if (!hostname)
+        hostname = TAILQ_FIRST(s_prog.prog_sports)->host;
+    /* Every media path was checked at startup */
+    (void) dofp_ladder_seg_path(s_ladder, st_h->req->seg.dsr_q,
+                        st_h->req->seg.dsr_seg_ind, path, sizeof(path));
+    hbuf.off = 0;
+#define V(v) (v), strlen(v)
+    header_set_ptr(&headers_arr[h_idx++], &hbuf, V(":method"), V("GET"));
+    header_set_ptr(&headers_arr[h_idx++], &hbuf, V(":scheme"), V("https"));
+    header_set_ptr(&headers_arr[h_idx++], &hbuf, V(":path"), V(path));
+    header_set_ptr(&headers_arr[h_idx++], &hbuf, V(":authority"), V(hostname));
+    header_set_ptr(&headers_arr[h_idx++], &hbuf, V("user-agent"), V(s_prog.prog_settings.es_ua));
+#undef V
+    lsquic_http_headers_t headers = {
+        .count = h_idx,
+        .headers = headers_arr,
+    };
+    if (0 != lsquic_stream_send_headers(stream, &headers, 1))
+    {
+        LSQ_ERROR("cannot send headers: %s", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+
+static void
+lg_on_write (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+    if (0 == lg_send_headers(stream, st_h))
+    {
+        lsquic_stream_shutdown(stream, 1);
+        lsquic_stream_wantread(stream, 1);
+    }
+    else
+        lsquic_stream_close(stream);
+}
+
+
+static size_t
+lg_discard (void *ctx, const unsigned char *buf, size_t sz, int fin)
+{
+    return sz;
+}
+
+
+static void
+lg_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+    ssize_t nread;
+
+    nread = lsquic_stream_readf(stream, lg_discard, NULL);
+    if (nread > 0)
+        st_h->nread += (size_t) nread;
+    else if (nread == 0)
+    {
+        st_h->fin = true;
+        lsquic_stream_shutdown(stream, 0);
+    }
+    else
+    {
+        LSQ_WARN("error reading from stream: %s", strerror(errno));
+        lsquic_stream_close(stream);
+    }
+}
+
+
+static void
+lg_on_close (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+    struct lg_req *req;
+    struct player *pl;
+    const lsquic_time_t now = lsquic_time_now();
+
+    if (!st_h)
+        return;
+    req = st_h->req;
+    pl = req->player;
+    if (pl->pl_state != PL_DOWNLOADING)
+        goto end;
+
+    if (!st_h->fin)
+    {
+        LSQ_WARN("player %u: download of segment %u did not complete",
+                                        pl->pl_id, req->seg.dsr_seg_ind);
+        player_finish(pl, true);
+        goto end;
+    }
+
+    dofp_session_on_download(pl->pl_sess, st_h->nread, now - st_h->created);
+    if (req->ret)
+        (void) dofp_session_retrans_received(pl->pl_sess,
+                    req->seg.dsr_seg_ind, req->seg.dsr_q, st_h->nread, false,
+                    now);
+    else if (!dofp_session_segment_received(pl->pl_sess, req->seg.dsr_q, now))
+    {
+        player_finish(pl, false);   /* End of segments */
+        goto end;
+    }
+    player_continue(pl);
+
+  end:
+    free(req);
+    free(st_h);
+}
+
+
+static const struct lsquic_stream_if lg_stream_if = {
+    .on_new_conn            = lg_on_new_conn,
+    .on_hsk_done            = lg_on_hsk_done,
+    .on_conn_closed         = lg_on_conn_closed,
+    .on_new_stream          = lg_on_new_stream,
+    .on_read                = lg_on_read,
+    .on_write               = lg_on_write,
+    .on_close               = lg_on_close,
+};
+
+
+static void
+usage (const char *prog)
+{
+    const char *const slash = strrchr(prog, '/');
+    if (slash)
+        prog = slash + 1;
+    printf(
+"Usage: %s [opts]\n"
+"\n"
+"Options:\n"
+"   -n CONNS    Number of connections.  Defaults to 1.\n"
+"   -N PLAYERS  Number of players, spread over the connections.  Defaults\n"
+"                 to 1.\n"
+"   -J ABR      ABR algorithm, same numbers as http_client_dofp.  Defaults\n"
+"                 to 1.\n"
+"   -O SOLVER   Solver for the ABR models 0-3: `native' or `gurobi'.\n"
+#if HAVE_GUROBI
+"                 Defaults to `gurobi'.\n"
+#else
+"                 Only `native' is available in this build.\n"
+#endif
+"   -Z 1        Enable H2BR.\n"
+"   -A NAME=VAL Set an ABR tunable, see http_client_dofp -h.  May be\n"
+"                 specified several times.\n"
+"   -d MSEC     Start the players evenly within MSEC milliseconds.\n"
+"                 Defaults to 0.\n"
+"   -V FILE     Representation ladder.  Defaults to\n"
+"                 bin/ladder_apple_tos.txt.\n"
+"   -P PREFIX   Path prefix of the segments.  Defaults to the base of the\n"
+"                 ladder.\n"
+"   -w FILE     Segment sizes, used by SARA and BOLA.  Defaults to\n"
+"                 bin/weights_apple_tos.txt.\n"
+"   -F FILE     Write the QoE of every player to FILE.  Defaults to stdout.\n"
+"   -I DIR      Write the P.1203 input of every player to\n"
+"                 DIR/p1203_<player>.json as it plays.\n"
+            , prog);
+}
+
+
+int
+main (int argc, char **argv)
+{
+    int opt, s, abr_id = 1;
+    unsigned i;
+#if HAVE_GUROBI
+    bool native_solver = false;
+#endif
+    const char *ladder_file = "bin/ladder_apple_tos.txt";
+    const char *sizes_file = "bin/weights_apple_tos.txt";
+    const char *path_prefix = NULL;
+    char path[0x400];
+    const char *qoe_file = NULL;
+    const char *p1203_dir = NULL;
+    struct sport_head sports;
+    struct player *pl;
+    struct timeval tv;
+#if HAVE_GUROBI
+    struct abr_grb_ctx *grb_ctx = NULL;
+#endif
+
+    s_n_conns = 1;
+    s_n_players = 1;
+    dofp_settings_init(&s_settings);
+
+    TAILQ_INIT(&sports);
+    prog_init(&s_prog, LSENG_HTTP, &sports, &lg_stream_if, NULL);
+    s_prog.prog_settings.es_ua = "dofp_loadgen";
+
+    while (-1 != (opt = getopt(argc, argv, PROG_OPTS "hn:N:J:O:Z:A:d:V:P:w:F:I:")))
+    {
+        switch (opt) {
+        case 'n':
+            s_n_conns = atoi(optarg);
+            break;
+        case 'N':
+            s_n_players = atoi(optarg);
+            break;
+        case 'J':
+            abr_id = atoi(optarg);
+            break;
+        case 'O':
+#if HAVE_GUROBI
+            if (0 == strcmp(optarg, "native"))
+                native_solver = true;
+            else if (0 == strcmp(optarg, "gurobi"))
+                native_solver = false;
+#else
+            if (0 == strcmp(optarg, "native"))
+                ;
+#endif
+            else
+            {
+                fprintf(stderr, "unknown ABR solver `%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'Z':
+            s_settings.dss_h2br = atoi(optarg) == 1;
+            break;
+        case 'A':
+            if (0 != dofp_settings_parse(&s_settings, optarg))
+            {
+                fprintf(stderr, "invalid ABR setting `%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'd':
+            s_start_spread = strtoull(optarg, NULL, 10) * 1000;
+            break;
+        case 'V':
+            ladder_file = optarg;
+            break;
+        case 'P':
+            path_prefix = optarg;
+            break;
+        case 'w':
+            sizes_file = optarg;
+            break;
+        case 'F':
+            qoe_file = optarg;
+            break;
+        case 'I':
+            p1203_dir = optarg;
+            break;
+        case 'h':
+            usage(argv[0]);
+            prog_print_common_options(&s_prog, stdout);
+            exit(0);
+        default:
+            if (0 != prog_set_opt(&s_prog, opt, optarg))
+                exit(1);
+        }
+    }
+
+    if (s_n_conns == 0 || s_n_players == 0)
+    {
+        fprintf(stderr, "the number of connections and players must be "
+                                                                "positive\n");
+        exit(EXIT_FAILURE);
+    }
+    if (s_n_conns > s_n_players)
+        s_n_conns = s_n_players;
+
+    s_settings.dss_abr = dofp_abr_by_id(abr_id);
+    if (!s_settings.dss_abr)
+    {
+        fprintf(stderr, "unknown ABR algorithm %d\n", abr_id);
+        exit(EXIT_FAILURE);
+    }
+
+    s_ladder = dofp_ladder_load(ladder_file);
+    if (!s_ladder)
+        exit(EXIT_FAILURE);
+    if (path_prefix && 0 != dofp_ladder_set_base(s_ladder, path_prefix))
+        exit(EXIT_FAILURE);
+    for (i = 0; i < s_ladder->dl_n_rep; ++i)
+        if (dofp_ladder_seg_path(s_ladder, i, 1, path, sizeof(path)) < 0)
+        {
+            fprintf(stderr, "%s: representation %u has no media path\n",
+                                                            ladder_file, i);
+            exit(EXIT_FAILURE);
+        }
+    if (s_ladder->dl_n_seg && 0 != dofp_ladder_load_sizes(s_ladder, sizes_file))
+        LSQ_WARN("segment sizes not loaded: using the nominal bitrates");
+    s_settings.dss_ladder = s_ladder;
+
+    if (qoe_file)
+    {
+        s_qoe_fh = fopen(qoe_file, "w");
+        if (!s_qoe_fh)
+        {
+            fprintf(stderr, "cannot open %s for writing: %s\n", qoe_file,
+                                                            strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+    else
+        s_qoe_fh = stdout;
+    fprintf(s_qoe_fh, "SESSION,ABR,CONN,STATUS,SEGMENTS,AVGBITRATE,"
+        "STDBITRATE,AVGQUALITY,SWITCHES,INSTABILITY,STARTUP,STALLS,STALLD,"
+        "RECOUNT,REDATA,REUNUSEDCOUNT,REUNUSED\n");
+
+    if (0 != prog_prep(&s_prog))
+    {
+        LSQ_ERROR("could not prep");
+        exit(EXIT_FAILURE);
+    }
+
+    if (s_settings.dss_abr->dai_flags & DOFP_ABR_ASYNC)
+    {
+#if HAVE_GUROBI
+        /* One worker: the Gurobi context is not thread-safe */
+        if (!native_solver)
+        {
+            grb_ctx = abr_grb_ctx_new();
+            if (!grb_ctx)
+            {
+                LSQ_ERROR("could not start Gurobi environment");
+                exit(EXIT_FAILURE);
+            }
+            s_settings.dss_grb_ctx = grb_ctx;
+        }
+#endif
+        s_abr_worker = abr_worker_new();
+        if (!s_abr_worker)
+        {
+            LSQ_ERROR("could not start ABR worker");
+            exit(EXIT_FAILURE);
+        }
+        s_abr_event = event_new(prog_eb(&s_prog), abr_worker_fd(s_abr_worker),
+                                    EV_READ|EV_PERSIST, lg_abr_on_done, NULL);
+        if (!s_abr_event || 0 != event_add(s_abr_event, NULL))
+        {
+            LSQ_ERROR("cannot add ABR worker event");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    s_conns = calloc(s_n_conns, sizeof(s_conns[0]));
+    s_players = calloc(s_n_players, sizeof(s_players[0]));
+    if (!s_conns || !s_players)
+    {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < s_n_conns; ++i)
+    {
+        s_conns[i].idx = i;
+        TAILQ_INIT(&s_conns[i].reqs);
+    }
+
+    for (i = 0; i < s_n_players; ++i)
+    {
+        pl = &s_players[i];
+        pl->pl_id = i;
+        pl->pl_conn = &s_conns[i % s_n_conns];
+        pl->pl_start = s_start_spread * i / s_n_players;
+        pl->pl_sess = dofp_session_new(&s_settings, pl,
+                                            lsquic_time_now() + pl->pl_start);
+        pl->pl_timer = event_new(prog_eb(&s_prog), -1, 0, player_on_timer,
+                                                                        pl);
+        if (!pl->pl_sess || !pl->pl_timer)
+        {
+            LSQ_ERROR("cannot create player %u", i);
+            exit(EXIT_FAILURE);
+        }
+        if (p1203_dir)
+        {
+            snprintf(path, sizeof(path), "%s/p1203_%u.json", p1203_dir, i);
+            pl->pl_p1203 = dofp_p1203_open(path, 16);
+            if (!pl->pl_p1203)
+                exit(EXIT_FAILURE);
+            dofp_session_set_p1203(pl->pl_sess, pl->pl_p1203);
+        }
+        ++pl->pl_conn->n_players;
+        ++s_n_active;
+    }
+
+    for (i = 0; i < s_n_conns; ++i)
+        if (0 != prog_connect(&s_prog, NULL, 0))
+        {
+            LSQ_ERROR("connection failed");
+            exit(EXIT_FAILURE);
+        }
+
+    /* The first decision of every player is made when its timer fires */
+    for (i = 0; i < s_n_players; ++i)
+    {
+        pl = &s_players[i];
+        tv.tv_sec = pl->pl_start / 1000000;
+        tv.tv_usec = pl->pl_start % 1000000;
+        pl->pl_state = PL_WAIT;
+        if (0 != event_add(pl->pl_timer, &tv))
+        {
+            LSQ_ERROR("cannot add timer of player %u", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    LSQ_DEBUG("entering event loop");
+
+    s = prog_run(&s_prog);
+
+    LSQ_NOTICE("%u players, %u failed, %u did not finish", s_n_players,
+                                                    s_n_failed, s_n_active);
+    for (i = 0; i < s_n_players; ++i)
+    {
+        event_free(s_players[i].pl_timer);
+        if (s_players[i].pl_p1203)
+            (void) dofp_p1203_close(s_players[i].pl_p1203,
+                                                    s_players[i].pl_sess);
+        dofp_session_destroy(s_players[i].pl_sess);
+    }
+    free(s_players);
+    free(s_conns);
+    dofp_ladder_destroy(s_ladder);
+    if (s_abr_event)
+        event_free(s_abr_event);
+    if (s_abr_worker)
+        abr_worker_destroy(s_abr_worker);
+#if HAVE_GUROBI
+    if (grb_ctx)
+        abr_grb_ctx_destroy(grb_ctx);
+#endif
+    prog_cleanup(&s_prog);
+    if (s_qoe_fh != stdout)
+        (void) fclose(s_qoe_fh);
+
+    exit(0 == s && 0 == s_n_failed ? EXIT_SUCCESS : EXIT_FAILURE);
+}
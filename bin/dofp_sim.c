@@ -0,0 +1,661 @@
+/*
+ * dofp_sim.c -- Replay bandwidth traces against the DoFP+ ABR algorithms.
+ *
+ * Every combination of trace, algorithm and setting values is one libdofp
+ * session played by dofp_sim_run(): no network and no wall clock are
+ * involved, so a run that takes minutes live completes in milliseconds.
+ * The runs are spread over a pool of threads that steal work from each
+ * other.  For every run, one row of QoE metrics is written and, optionally,
+ * the per-segment CSV of http_client_dofp.
+ *
+ * Settings given more than one value (-A NAME=V1,V2,...) are swept: every
+ * point of the grid they span is played.  The Pareto front of the grid, that
+ * is the configurations that no other one beats on quality, stalls and
+ * wasted re-downloads at once, can be written with -P.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dofp.h"
+
+#define MAX_AXES 16
+
+/* A setting and the values it takes */
+struct sim_axis
+{
+    char                       *sa_name;
+    unsigned                    sa_n_values;
+    double                     *sa_values;
+};
+
+struct sim_run
+{
+    const struct dofp_trace    *sr_trace;
+    unsigned                    sr_abr_id;
+    unsigned                    sr_point;   /* Point of the grid */
+    int                         sr_status;
+    struct dofp_qoe             sr_qoe;
+};
+
+/* Runs [sw_lo, sw_hi) are left to this worker.  The owner takes from the
+ * front; thieves take the back half.
+ */
+struct sim_worker
+{
+    pthread_t                   sw_thread;
+    pthread_mutex_t             sw_mutex;
+    unsigned                    sw_idx;
+    unsigned                    sw_lo, sw_hi;
+};
+
+static struct dofp_ladder      *s_ladder;
+static struct dofp_settings     s_settings;
+static struct dofp_sim_params   s_params;
+static const char              *s_out_dir;
+
+static struct sim_axis          s_axes[MAX_AXES];
+static unsigned                 s_n_axes, s_n_points = 1;
+
+static struct sim_run          *s_runs;
+static unsigned                 s_n_runs;
+static struct sim_worker       *s_workers;
+static unsigned                 s_n_workers;
+
+
+/* Settings of a point of the grid */
+static void
+point_settings (unsigned point, struct dofp_settings *settings)
+{
+    unsigned i;
+
+    *settings = s_settings;
+    for (i = 0; i < s_n_axes; ++i)
+    {
+        (void) dofp_settings_set(settings, s_axes[i].sa_name,
+                        s_axes[i].sa_values[point % s_axes[i].sa_n_values]);
+        point /= s_axes[i].sa_n_values;
+    }
+}
+
+
+static void
+print_point (FILE *out, unsigned point)
+{
+    unsigned i;
+
+    for (i = 0; i < s_n_axes; ++i)
+    {
+        fprintf(out, ",%g", s_axes[i].sa_values[point % s_axes[i].sa_n_values]);
+        point /= s_axes[i].sa_n_values;
+    }
+}
+
+
+static void
+print_axes (FILE *out)
+{
+    unsigned i;
+
+    for (i = 0; i < s_n_axes; ++i)
+        fprintf(out, ",%s", s_axes[i].sa_name);
+}
+
+
+/* Per-segment metrics, same file as METRICS_FILENAME of http_client_dofp */
+static int
+write_metrics (const struct sim_run *run, const struct dofp_session *sess)
+{
+    char path[4096];
+    FILE *fp;
+    int s;
+
+    if (s_n_points > 1)
+        snprintf(path, sizeof(path), "%s/metrics_abr_%u_%s_%u.csv", s_out_dir,
+                run->sr_abr_id, run->sr_trace->dt_name, run->sr_point);
+    else
+        snprintf(path, sizeof(path), "%s/metrics_abr_%u_%s.csv", s_out_dir,
+                                    run->sr_abr_id, run->sr_trace->dt_name);
+    fp = fopen(path, "w");
+    if (!fp)
+    {
+        fprintf(stderr, "cannot open %s for writing: %s\n", path,
+                                                            strerror(errno));
+        return -1;
+    }
+    s = dofp_session_write_csv(sess, fp);
+    if (0 != fclose(fp))
+        s = -1;
+    return s;
+}
+
+
+static void
+play (struct sim_run *run)
+{
+    struct dofp_settings settings;
+    struct dofp_session *sess;
+
+    point_settings(run->sr_point, &settings);
+    settings.dss_abr = dofp_abr_by_id(run->sr_abr_id);
+    sess = dofp_session_new(&settings, run, 0);
+    if (!sess)
+    {
+        run->sr_status = -1;
+        return;
+    }
+    run->sr_status = dofp_sim_run(sess, run->sr_trace, &s_params);
+    dofp_session_qoe(sess, &run->sr_qoe);
+    if (s_out_dir && 0 != write_metrics(run, sess))
+        run->sr_status = -1;
+    dofp_session_destroy(sess);
+}
+
+
+/* Take the first run left to `self', or steal the back half of the runs of
+ * another worker.  Returns false when no run is left.
+ */
+static bool
+next_run (struct sim_worker *self, unsigned *idx)
+{
+    struct sim_worker *victim;
+    unsigned i, lo = 0, hi = 0;
+
+    pthread_mutex_lock(&self->sw_mutex);
+    if (self->sw_lo < self->sw_hi)
+    {
+        *idx = self->sw_lo++;
+        pthread_mutex_unlock(&self->sw_mutex);
+        return true;
+    }
+    pthread_mutex_unlock(&self->sw_mutex);
+
+    for (i = 1; i < s_n_workers && lo == hi; ++i)
+    {
+        victim = &s_workers[(self->sw_idx + i) % s_n_workers];
+        pthread_mutex_lock(&victim->sw_mutex);
+        if (victim->sw_lo < victim->sw_hi)
+        {
+            hi = victim->sw_hi;
+            lo = victim->sw_hi - (victim->sw_hi - victim->sw_lo + 1) / 2;
+            victim->sw_hi = lo;
+        }
+        pthread_mutex_unlock(&victim->sw_mutex);
+    }
+    if (lo == hi)
+        return false;
+
+    pthread_mutex_lock(&self->sw_mutex);
+    self->sw_lo = lo + 1;
+    self->sw_hi = hi;
+    pthread_mutex_unlock(&self->sw_mutex);
+    *idx = lo;
+    return true;
+}
+
+
+static void *
+sim_thread (void *arg)
+{
+    struct sim_worker *const self = arg;
+    unsigned idx;
+
+    while (next_run(self, &idx))
+        play(&s_runs[idx]);
+
+    return NULL;
+}
+
+
+static int
+run_all (unsigned n_threads)
+{
+    unsigned i;
+
+    s_n_workers = n_threads;
+    s_workers = calloc(s_n_workers, sizeof(s_workers[0]));
+    if (!s_workers)
+        return -1;
+    for (i = 0; i < s_n_workers; ++i)
+    {
+        pthread_mutex_init(&s_workers[i].sw_mutex, NULL);
+        s_workers[i].sw_idx = i;
+        s_workers[i].sw_lo = s_n_runs * i / s_n_workers;
+        s_workers[i].sw_hi = s_n_runs * (i + 1) / s_n_workers;
+    }
+    for (i = 0; i < s_n_workers; ++i)
+        if (0 != pthread_create(&s_workers[i].sw_thread, NULL, sim_thread,
+                                                            &s_workers[i]))
+        {
+            fprintf(stderr, "cannot create thread: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    for (i = 0; i < s_n_workers; ++i)
+    {
+        pthread_join(s_workers[i].sw_thread, NULL);
+        pthread_mutex_destroy(&s_workers[i].sw_mutex);
+    }
+    free(s_workers);
+    s_workers = NULL;
+    return 0;
+}
+
+
+static void
+print_qoe (FILE *out, const struct sim_run *run)
+{
+    const struct dofp_qoe *const qoe = &run->sr_qoe;
+
+    fprintf(out, "%s,%s", run->sr_trace->dt_name,
+                                dofp_abr_by_id(run->sr_abr_id)->dai_name);
+    print_point(out, run->sr_point);
+    fprintf(out, ",%s,%u,%.3f,%.3f,%.3f,%u,%.3f,%.3f,%u,%.3f,"
+        "%u,%.3f,%u,%.3f\n", run->sr_status ? "failed" : "ok",
+        qoe->dq_n_seg, qoe->dq_avg_bitrate, qoe->dq_std_bitrate,
+        qoe->dq_avg_quality, qoe->dq_switches, qoe->dq_instability,
+        qoe->dq_startup, qoe->dq_n_stalls, qoe->dq_stall_dur,
+        qoe->dq_re_count, qoe->dq_re_data, qoe->dq_re_unused_count,
+        qoe->dq_re_unused_data);
+}
+
+
+/* Mean over the traces of one algorithm at one point of the grid */
+struct sim_config
+{
+    unsigned                    sc_abr_id;
+    unsigned                    sc_point;
+    unsigned                    sc_n_runs;
+    bool                        sc_failed;
+    double                      sc_quality;     /* Higher is better */
+    double                      sc_stall_dur;   /* Lower is better... */
+    double                      sc_unused;
+};
+
+
+static bool
+dominates (const struct sim_config *a, const struct sim_config *b)
+{
+    return a->sc_quality >= b->sc_quality
+        && a->sc_stall_dur <= b->sc_stall_dur
+        && a->sc_unused <= b->sc_unused
+        && (a->sc_quality > b->sc_quality
+            || a->sc_stall_dur < b->sc_stall_dur
+            || a->sc_unused < b->sc_unused);
+}
+
+
+static int
+compare_quality (const void *ap, const void *bp)
+{
+    const struct sim_config *const a = ap, *const b = bp;
+
+    return (a->sc_quality < b->sc_quality) - (a->sc_quality > b->sc_quality);
+}
+
+
+static int
+write_pareto (FILE *out, unsigned n_abrs, const unsigned *abr_ids)
+{
+    struct sim_config *configs, *config;
+    const struct sim_run *run;
+    unsigned n_configs, i, j, a;
+
+    n_configs = n_abrs * s_n_points;
+    configs = calloc(n_configs, sizeof(configs[0]));
+    if (!configs)
+        return -1;
+    for (a = 0; a < n_abrs; ++a)
+        for (i = 0; i < s_n_points; ++i)
+        {
+            configs[a * s_n_points + i].sc_abr_id = abr_ids[a];
+            configs[a * s_n_points + i].sc_point = i;
+        }
+
+    /* Runs are ordered by trace, then algorithm, then point */
+    for (i = 0; i < s_n_runs; ++i)
+    {
+        run = &s_runs[i];
+        config = &configs[(i % n_configs)];
+        ++config->sc_n_runs;
+        config->sc_failed |= run->sr_status != 0;
+        config->sc_quality += run->sr_qoe.dq_avg_quality;
+        config->sc_stall_dur += run->sr_qoe.dq_stall_dur;
+        config->sc_unused += run->sr_qoe.dq_re_unused_data;
+    }
+    for (i = 0; i < n_configs; ++i)
+    {
+        configs[i].sc_quality /= configs[i].sc_n_runs;
+        configs[i].sc_stall_dur /= configs[i].sc_n_runs;
+        configs[i].sc_unused /= configs[i].sc_n_runs;
+    }
+
+    /* Keep the configurations that nothing dominates */
+    for (i = j = 0; i < n_configs; ++i)
+    {
+        if (configs[i].sc_failed)
+            continue;
+        for (a = 0; a < n_configs; ++a)
+            if (!configs[a].sc_failed && dominates(&configs[a], &configs[i]))
+                break;
+        if (a == n_configs)
+            configs[j++] = configs[i];
+    }
+    qsort(configs, j, sizeof(configs[0]), compare_quality);
+
+    fprintf(out, "ABR");
+    print_axes(out);
+    fprintf(out, ",AVGQUALITY,STALLD,REUNUSED\n");
+    for (i = 0; i < j; ++i)
+    {
+        fprintf(out, "%s", dofp_abr_by_id(configs[i].sc_abr_id)->dai_name);
+        print_point(out, configs[i].sc_point);
+        fprintf(out, ",%.3f,%.3f,%.3f\n", configs[i].sc_quality,
+                                configs[i].sc_stall_dur, configs[i].sc_unused);
+    }
+
+    free(configs);
+    return ferror(out) ? -1 : 0;
+}
+
+
+/* Parse a comma-separated list of ABR ids into a bit mask */
+static int
+parse_abr_ids (const char *s, unsigned *mask)
+{
+    unsigned long id;
+    char *end;
+
+    *mask = 0;
+    do
+    {
+        id = strtoul(s, &end, 10);
+        if (end == s || !dofp_abr_by_id(id))
+            return -1;
+        *mask |= 1u << id;
+        s = end + 1;
+    }
+    while (*end == ',');
+
+    return *end == '\0' ? 0 : -1;
+}
+
+
+/* NAME=V1[,V2...]: a single value is a plain setting, more values make an
+ * axis of the grid.
+ */
+static int
+parse_axis (const char *s)
+{
+    struct dofp_settings scratch;
+    struct sim_axis *axis;
+    const char *eq;
+    char *end;
+    double *values;
+
+    eq = strchr(s, '=');
+    if (!eq || s_n_axes >= MAX_AXES)
+        return -1;
+    axis = &s_axes[s_n_axes];
+    axis->sa_name = strndup(s, eq - s);
+    if (!axis->sa_name)
+        return -1;
+    dofp_settings_init(&scratch);
+    s = eq + 1;
+    do
+    {
+        values = realloc(axis->sa_values,
+                        (axis->sa_n_values + 1) * sizeof(axis->sa_values[0]));
+        if (!values)
+            return -1;
+        axis->sa_values = values;
+        values[axis->sa_n_values] = strtod(s, &end);
+        if (end == s || 0 != dofp_settings_set(&scratch, axis->sa_name,
+                                                values[axis->sa_n_values]))
+            return -1;
+        ++axis->sa_n_values;
+        s = end + 1;
+    }
+    while (*end == ',');
+    if (*end != '\0')
+        return -1;
+
+    if (axis->sa_n_values == 1)
+    {
+        (void) dofp_settings_set(&s_settings, axis->sa_name, values[0]);
+        free(axis->sa_name);
+        free(axis->sa_values);
+        memset(axis, 0, sizeof(*axis));
+    }
+    else
+    {
+        s_n_points *= axis->sa_n_values;
+        ++s_n_axes;
+    }
+    return 0;
+}
+
+
+static void
+usage (const char *prog)
+{
+    const char *const slash = strrchr(prog, '/');
+    if (slash)
+        prog = slash + 1;
+    printf(
+"Usage: %s [opts] TRACE...\n"
+"\n"
+"TRACE is a shell script that shapes the link with `tc qdisc', such as\n"
+"bin/A_2018_01_26_11_26_26_good_4M.sh.  Traces loop if the session outlasts\n"
+"them.\n"
+"\n"
+"Options:\n"
+"   -J ABR,...  ABR algorithms, same numbers as http_client_dofp.  Defaults\n"
+"                 to all of them.  The models 0-3 use the native solver.\n"
+"   -Z 1        Enable H2BR.\n"
+"   -A NAME=V[,V...]\n"
+"               Set an ABR tunable, see http_client_dofp -h.  With several\n"
+"                 values, every value is tried: the grid of all such\n"
+"                 settings is swept.  May be specified several times.\n"
+"   -r MSEC     Round-trip time added to every download.  Defaults to 40.\n"
+"   -V FILE     Representation ladder.  Defaults to\n"
+"                 bin/ladder_apple_tos.txt.\n"
+"   -w FILE     Segment sizes.  Defaults to bin/weights_apple_tos.txt.\n"
+"   -o DIR      Write the per-segment metrics of every run to\n"
+"                 DIR/metrics_abr_<ABR>_<TRACE>[_<POINT>].csv.\n"
+"   -F FILE     Write the QoE of every run to FILE.  Defaults to stdout.\n"
+"   -P FILE     Write the Pareto front of average quality, stall duration\n"
+"                 and unused re-downloaded data to FILE.  Every algorithm\n"
+"                 and point of the grid is averaged over the traces.\n"
+"   -t THREADS  Number of threads.  Defaults to the number of CPUs.\n"
+"   -h          Print this help screen and exit.\n"
+            , prog);
+}
+
+
+static FILE *
+open_output (const char *filename)
+{
+    FILE *fh;
+
+    fh = fopen(filename, "w");
+    if (!fh)
+    {
+        fprintf(stderr, "cannot open %s for writing: %s\n", filename,
+                                                            strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    return fh;
+}
+
+
+int
+main (int argc, char **argv)
+{
+    int opt, s = 0;
+    unsigned abr_mask = 0, abr_ids[32], n_abrs = 0, n_traces;
+    unsigned n_threads = 0, n_failed = 0, i, j, p;
+    const char *ladder_file = "bin/ladder_apple_tos.txt";
+    const char *sizes_file = "bin/weights_apple_tos.txt";
+    const char *qoe_file = NULL, *pareto_file = NULL;
+    struct dofp_trace **traces;
+    FILE *qoe_fh, *pareto_fh;
+    long n_cpus;
+
+    dofp_settings_init(&s_settings);
+    s_params.dsp_rtt = 40000;
+
+    while (-1 != (opt = getopt(argc, argv, "hJ:Z:A:r:V:w:o:F:P:t:")))
+    {
+        switch (opt) {
+        case 'J':
+            if (0 != parse_abr_ids(optarg, &abr_mask))
+            {
+                fprintf(stderr, "invalid ABR algorithms `%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'Z':
+            s_settings.dss_h2br = atoi(optarg) == 1;
+            break;
+        case 'A':
+            if (0 != parse_axis(optarg))
+            {
+                fprintf(stderr, "invalid ABR setting `%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'r':
+            s_params.dsp_rtt = strtoull(optarg, NULL, 10) * 1000;
+            break;
+        case 'V':
+            ladder_file = optarg;
+            break;
+        case 'w':
+            sizes_file = optarg;
+            break;
+        case 'o':
+            s_out_dir = optarg;
+            break;
+        case 'F':
+            qoe_file = optarg;
+            break;
+        case 'P':
+            pareto_file = optarg;
+            break;
+        case 't':
+            n_threads = atoi(optarg);
+            break;
+        case 'h':
+            usage(argv[0]);
+            exit(EXIT_SUCCESS);
+        default:
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (optind >= argc)
+    {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (!abr_mask)
+        abr_mask = ~0u;
+    for (i = 0; dofp_abr_by_id(i); ++i)
+        if (abr_mask & (1u << i))
+            abr_ids[n_abrs++] = i;
+
+    s_ladder = dofp_ladder_load(ladder_file);
+    if (!s_ladder)
+        exit(EXIT_FAILURE);
+    if (s_ladder->dl_n_seg == 0)
+    {
+        fprintf(stderr, "%s: live content cannot be simulated\n",
+                                                                ladder_file);
+        exit(EXIT_FAILURE);
+    }
+    if (0 != dofp_ladder_load_sizes(s_ladder, sizes_file))
+        fprintf(stderr, "segment sizes not loaded: using the nominal "
+                                                            "bitrates\n");
+    s_settings.dss_ladder = s_ladder;
+
+    n_traces = argc - optind;
+    traces = calloc(n_traces, sizeof(traces[0]));
+    s_runs = calloc((size_t) n_traces * n_abrs * s_n_points,
+                                                        sizeof(s_runs[0]));
+    if (!traces || !s_runs)
+    {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < n_traces; ++i)
+    {
+        traces[i] = dofp_trace_load(argv[optind + i]);
+        if (!traces[i])
+            exit(EXIT_FAILURE);
+        for (j = 0; j < n_abrs; ++j)
+            for (p = 0; p < s_n_points; ++p)
+            {
+                s_runs[s_n_runs].sr_trace = traces[i];
+                s_runs[s_n_runs].sr_abr_id = abr_ids[j];
+                s_runs[s_n_runs].sr_point = p;
+                ++s_n_runs;
+            }
+    }
+
+    if (n_threads == 0)
+    {
+        n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = n_cpus > 0 ? (unsigned) n_cpus : 1;
+    }
+    if (n_threads > s_n_runs)
+        n_threads = s_n_runs;
+    if (0 != run_all(n_threads))
+    {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    qoe_fh = qoe_file ? open_output(qoe_file) : stdout;
+    fprintf(qoe_fh, "TRACE,ABR");
+    print_axes(qoe_fh);
+    fprintf(qoe_fh, ",STATUS,SEGMENTS,AVGBITRATE,STDBITRATE,AVGQUALITY,"
+        "SWITCHES,INSTABILITY,STARTUP,STALLS,STALLD,RECOUNT,REDATA,"
+        "REUNUSEDCOUNT,REUNUSED\n");
+    for (i = 0; i < s_n_runs; ++i)
+    {
+        print_qoe(qoe_fh, &s_runs[i]);
+        n_failed += s_runs[i].sr_status != 0;
+    }
+    if (qoe_fh != stdout && 0 != fclose(qoe_fh))
+        s = -1;
+
+    if (pareto_file)
+    {
+        pareto_fh = open_output(pareto_file);
+        if (0 != write_pareto(pareto_fh, n_abrs, abr_ids))
+            s = -1;
+        if (0 != fclose(pareto_fh))
+            s = -1;
+    }
+
+    if (n_failed)
+        fprintf(stderr, "%u of %u runs failed\n", n_failed, s_n_runs);
+    for (i = 0; i < n_traces; ++i)
+        dofp_trace_destroy(traces[i]);
+    for (i = 0; i < s_n_axes; ++i)
+    {
+        free(s_axes[i].sa_name);
+        free(s_axes[i].sa_values);
+    }
+    free(traces);
+    free(s_runs);
+    dofp_ladder_destroy(s_ladder);
+
+    exit(0 == s && 0 == n_failed ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -0,0 +1,74 @@
+/*
+ * dofp_sizes.c -- Convert segment sizes to a segment-size index.
+ *
+ * The text file of segment sizes, such as bin/weights_apple_tos.txt, is
+ * parsed value by value.  The index it is converted to is mapped by
+ * dofp_ladder_load_sizes() as it is: loading it takes constant time and
+ * the processes that play the same content share its pages.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dofp.h"
+
+
+static void
+usage (const char *prog)
+{
+    const char *const slash = strrchr(prog, '/');
+    if (slash)
+        prog = slash + 1;
+    printf(
+"Usage: %s [opts] SIZES INDEX\n"
+"\n"
+"Write the segment sizes of SIZES, a text file or an index, to INDEX.\n"
+"\n"
+"Options:\n"
+"   -V FILE     Representation ladder.  Defaults to\n"
+"                 bin/ladder_apple_tos.txt.\n"
+"   -h          Print this help screen and exit.\n"
+            , prog);
+}
+
+
+int
+main (int argc, char **argv)
+{
+    const char *ladder_file = "bin/ladder_apple_tos.txt";
+    struct dofp_ladder *ladder;
+    int opt, s;
+
+    while (-1 != (opt = getopt(argc, argv, "hV:")))
+    {
+        switch (opt) {
+        case 'V':
+            ladder_file = optarg;
+            break;
+        case 'h':
+            usage(argv[0]);
+            exit(EXIT_SUCCESS);
+        default:
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (optind + 2 != argc)
+    {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    ladder = dofp_ladder_load(ladder_file);
+    if (!ladder)
+        exit(EXIT_FAILURE);
+    s = dofp_ladder_load_sizes(ladder, argv[optind]);
+    if (s == 0)
+        s = dofp_ladder_write_sizes(ladder, argv[optind + 1]);
+    dofp_ladder_destroy(ladder);
+
+    exit(s == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -45,10 +45,12 @@
 #include "test_common.h"
 #include "prog.h"
 
-#include "abr_max_j.h"
-#include "abr_max_min_j.h"
-#include "abr_max_min_j_norm.h"
-#include "abr_quality_instability.h"
+#include "test_config.h"
+#if HAVE_GUROBI
+#include "abr_grb_ctx.h"
+#endif
+#include "abr_worker.h"
+#include "dofp.h"
 
 #include "../src/liblsquic/lsquic_logger.h"
 #include "../src/liblsquic/lsquic_int_types.h"
@@ -63,10 +65,7 @@
 #include "../src/liblsquic/lsquic_conn.h"
 #include "lsxpack_header.h"
 
-#define N_REP 11 /* Number of available media representations (quality levels) Apple: 11, Ghent: 6 */
 #define K_MAX 10 /* Quality  values for average quality computation */
-#define N_MAX_SEG 184 /* Max number of segments to be downloaded */
-#define AVG_COUNT 5 /* Moving average count */
 
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
@@ -108,362 +107,18 @@ static struct sample_stats  s_stat_to_conn,     /* Time to connect */
 static unsigned s_stat_conns_ok, s_stat_conns_failed;
 static unsigned long s_stat_downloaded_bytes;
 
-struct throughput_stats
-{
-    long double         throughput;
-    long double         tot_throughput;
-    long double         s_throughput;
-    long double         e_temp_throughput;
-    long double         e_throughput[N_MAX_SEG];
-    long double         comp_throughput[N_MAX_SEG];
-    double              b_level[N_MAX_SEG];
-};
-
-struct h2br_stats
-{
-    long double         T_e;
-};
-
-struct wlb_stats
-{
-    unsigned            re_count;
-    unsigned            re_unused_count;
-    long double         re_data; // [kB]
-    long double         re_unused_data; // [kB]
-};
-
-// Minh - Add BOLA ABR - ADD - S
-struct bola_m_stats
-{
-    double        Sm [N_REP];    // segment size
-    double        Vm [N_REP];    // utilities
-    double        value [N_REP]; // the values of optimization problem
-    double        max_value;     // the value of equation (9) in the paper
-    double        V;             // the control parameter for overflow case
-    double        gma;           // control parameter for rebuffering case
-    double        SM;            // minimum segment size
-    unsigned      m_star;        // selected quality
-};
-// Minh - Add BOLA ABR - ADD - E
-
-// Minh - Add BBA ABR - ADD - S
-/* BBA selects the bitrate based on a function f = a*buffer_level + b
-* 
-*/
+static unsigned          seg_length; /* Lenght of the segments to be downloaded, from the ladder */
+static lsquic_time_t    start_t; /* Start time */
 
-struct bba_stats
-{
-    double        rS;
-    double        cuS;
-    double        a;
-    double        b;
-    unsigned      selected_bitrate;
-};
-// Minh - Add BBA ABR - ADD - E
-
-struct sara_stats
-{
-    double        I;
-    double        B_alpha;
-    double        B_beta;
-    double        B_max;
-    long double   W [N_REP][N_MAX_SEG];    // KB
-    long double   weights [N_MAX_SEG];     // In KB
-    long double   down_rate [N_MAX_SEG];   // In KB/s
-    double        H;                       // Weighted Harmonic mean of first n segments
-    double        delta;
-};
+static struct dofp_ladder *s_ladder; /* Representations and media paths */
 
-static struct           throughput_stats t_stats;
-static struct           h2br_stats h_stats;
-// Minh - Add BOLA ABR - ADD - S
-static struct           bola_m_stats b_m_stats;
-// Minh - Add BOLA ABR - ADD - E
-static struct           bba_stats b_b_stats;
-static struct           sara_stats s_stats;
-static struct           wlb_stats w_stats;
-static double const     buffer_size = 20.0; // Maximum buffer size
-static double           buffer_level = 0.0; /* Updated buffer level of the downloaded segment */
-static unsigned         seg_length = 4U; /* Lenght of the segments to be downloaded */
-static unsigned         playout = 0U; /* States whether the playout is running [1] or is paused (stall or buffering) [0] */
-static unsigned         min_init_bs = 4U; /* Minimum initial[/stall] buffer size (sec) to [re]start playout */
-static lsquic_time_t    start_t; /* Start time */
-static lsquic_time_t    playout_t; /* Start playout time */
-static double           stalls_t[N_MAX_SEG] = {0.0}; /* Stalls media time */
-static double           stalls_d[N_MAX_SEG] = {0.0}; /* Stalls duration */
-static unsigned         stall_ind = 0U; // First stall is the initial buffering
-static lsquic_time_t    stall_t; /* Start stall time */
-static const char       FP_PATH[] = "apple/"; // "ghent", "apple"
-static const char       SP_PATH[] = "/segment_";
-static const char       EXT[] = ".m4s";
-static unsigned         seg_ind = 1U;
-
-/* APPle*/
-static char             *seg_paths[N_REP] = {"apple/145/segment_1.m4s", 
-                                             "apple/300/segment_1.m4s", 
-                                             "apple/600/segment_1.m4s", 
-                                             "apple/900/segment_1.m4s", 
-                                             "apple/1600/segment_1.m4s", 
-                                             "apple/2400/segment_1.m4s", 
-                                             "apple/3400/segment_1.m4s", 
-                                             "apple/4500/segment_1.m4s", 
-                                             "apple/5800/segment_1.m4s", 
-                                             "apple/8100/segment_1.m4s", 
-                                             "apple/11600/segment_1.m4s"}; /* To be actually parsed from an MPD file but done without loss of generality (Not considering the initialization segment) */
-static const int        seg_bitrates[N_REP] = {145, 300, 600, 900, 1600, 2400, 3400, 4500, 5800, 8100, 11600}; /* [kbps] To be actually parsed from an MPD file but done without loss of generality */
-static char             *seg_res[N_REP] = {"640x360", "768x432", "960x540", "960x540", "960x540", "1280x720", "1280x720", "1920x1080", "1920x1080", "2560x1440", "3840x2160"};
-
-/* Ghent */
-// static char             *seg_paths[N_REP] = {"ghent/150/segment_1.m4s", 
-//                                              "ghent/150/segment_1.m4s",
-//                                              "ghent/150/segment_1.m4s",
-//                                              "ghent/150/segment_1.m4s",
-//                                              "ghent/150/segment_1.m4s",
-//                                              "ghent/150/segment_1.m4s"}; /* To be actually parsed from an MPD file but done without loss of generality (Not considering the initialization segment) */
-// static const int        seg_bitrates[N_REP] = {150, 500, 1150, 2600, 5450, 10700}; /* [kbps] To be actually parsed from an MPD file but done without loss of generality */
-// static char             *seg_res[N_REP] = {"640x360", "854x480", "1280x720", "1920x1080", "2560x1440", "3840x2160"};
-
-
-static int              seg_chosen_q[N_MAX_SEG]; /* Chosen representation quality for each downloaded segment. If -1, the segment has not been yet downloaded */
-// static int              re_seg_chosen_q[N_MAX_SEG]; /* Chosen representation quality for each re-transmitted segment. If -1, the segment has not been re-transmitted */
-static int              qualities_ind = -1; /* Index for values substitution */
-static const double     alpha = .5, beta = .5;
-static unsigned         rep_seg_ind = 1U;
-static double           rep_seg_time = 4.0; /* Left time for the segment to be fully reproduced (4s -> ... -> 0s) */
+static const char       LADDER_FILENAME[] = "bin/ladder_apple_tos.txt";
 static const char       WEIGHTS_FILENAME[] = "bin/weights_apple_tos.txt";
 static char             METRICS_FILENAME[] = "DoFP_extensions/apple_tos/metrics_abr_00.csv";
 static char             METRICS_OUT_FILENAME[] = "DoFP_extensions/apple_tos/metrics_abr_00_out.csv";
 static char             JSON_FILENAME[] = "DoFP_extensions/apple_tos/itu-p1203_abr_00.json";
-static char             JSON_OUT_FILENAME[] = "DoFP_extensions/apple_tos/itu-p1203_abr_00_out.txt";
-static const float      FPS = 24.0;
-static const char       DEVICE[] = "pc";
-static const char       DISPLAYSIZE[] = "3840x2160";
-static const unsigned   VIEWINGDISTANCE = 150U;
-static bool             isMultiStream = false; // Set to true automatically if multiplexing feature is enabled (-w parameter > 1)
 static bool             request_cancellation = true; // True if request cancellation, or stream termination or stream cancellation, is enabled
 
-/* Update the buffer size when required */
-static void update_buff(bool sr){
-    if(playout){ /* If player is not paused */
-        double elapsed_time = (double) (lsquic_time_now() - playout_t) / 1000000;
-        playout_t = lsquic_time_now();
-        if (elapsed_time > buffer_level) {
-            rep_seg_ind = seg_ind - 1;
-            rep_seg_time = 0.0;
-            playout = 0;
-            stalls_t[stall_ind] = (rep_seg_ind + 1) * seg_length;
-            stall_t = lsquic_time_now() - ((lsquic_time_t) elapsed_time - buffer_level) * 1000000;
-            buffer_level = 0.0;
-        } else {
-            buffer_level -= elapsed_time;
-            if (elapsed_time > rep_seg_time) {
-                // printf("Elapsed time: %.3f \n", elapsed_time);
-                // printf("Check rep_seg_ind update: += %.1f\n", floor(1 + (elapsed_time - rep_seg_time) / seg_length));
-                rep_seg_ind += floor(1 + (elapsed_time - rep_seg_time) / seg_length);
-                rep_seg_time = seg_length - (elapsed_time - rep_seg_time - floor((elapsed_time - rep_seg_time) / seg_length) * seg_length);
-            } else
-                rep_seg_time -= elapsed_time;
-        }
-    }
-    if (sr){ /* Segment received */
-        buffer_level += seg_length;
-        if (!playout){ /* If player is paused */
-            if (buffer_level > min_init_bs) {
-                playout = 1;
-                playout_t = lsquic_time_now();
-                stalls_d[stall_ind] = (double) (playout_t - stall_t) / 1000000;
-                printf("Stall n. %u: Media start stall time -> %.3f, Time to stall -> %.3f s\n", stall_ind + 1, stalls_t[stall_ind], stalls_d[stall_ind]);
-                ++stall_ind;
-                if(rep_seg_time <= 0){
-                    if (rep_seg_ind < seg_ind){
-                        ++rep_seg_ind;
-                        rep_seg_time = seg_length;
-                    }
-                }
-                return;
-            }
-        }
-    }
-}
-
-static int
-getWords(char *base, char target[N_MAX_SEG][40])
-{
-    int n=0,i,j=0;
-    
-    while(base[i]!='\0')
-    {
-        if(base[i]!=' '){
-            target[n][j++]=base[i];
-        }
-        else{
-            target[n][j++]='\0';//insert NULL
-            n++;
-            j=0;
-        }
-        i++;
-    }
-    return n;
-    
-}
-
-/*
-function : getBitrateFromPath
-argument list:
-1) source - path source string
-Return type - int : bitrate on success, 0 on failure
-*/
-
-static int
-getBitrateFromPath(const char* source)
-{
-    int length, i, j, bitrate;
-    int target_length = 5;
-    char target[target_length]; // 4 ciphers + '/0'
-    // get string length
-    for (length = 0; source[length] != '\0'; length++)
-        ;
-    
-    // printf("\nLength is %i!\n", length);
-    
-    // reach end of bitrate string (name of directory of the segments)
-    for (i = length - 2; source[i + 1] != '/'; i--)
-        ;
-    
-    // printf("\n/ is at position %i!\n", i);
-    
-    target[target_length - 1] = '\0'; // assign null at last
-    j = target_length - 2;
-    
-    while (source[i] != '/') {
-        // printf("%c", source[i]);
-        target[j] = source[i];
-        j--;
-        i--;
-    }
-    j++;
-    
-    // check if the bitrate ciphers are less than target_length - 1
-    if (j > 0)
-        for (int d = j; d < target_length; d++)
-            target[d - j] = target[d]; // shift the ciphers by j
-        
-    // printf("\n");
-    for (j = 0; j < target_length; j++)
-        ;
-        // printf("%c", target[j]); // shift the ciphers by j
-        
-    bitrate = atoi(target);
-    
-    // printf("\nBitrate gathered -> %i!\n", bitrate);
-    
-    return bitrate;
-}
-
-/*
-function : getSegIndFromPath
-argument list:
-1) source - path source string
-Return type - unsigned : segment index on success, 0 on failure
-*/
-
-static unsigned
-getSegIndFromPath(const char* source)
-{
-	// Minh - MOD - S
-	#if 0
-    int length, i, j;
-    int target_length = 3;
-    unsigned seg_ind;
-    char target[target_length]; // 2 ciphers + '/0'
-    // get string length
-    for (length = 0; source[length] != '\0'; length++)
-        ;
-    
-    // reach end of segment index string (e.g. 'segment_75.m4s')
-    for (i = length - 2; source[i + 1] != '.'; i--)
-        ;
-    
-    target[target_length - 1] = '\0'; // assign null at last
-    j = target_length - 2;
-    
-    while (source[i] != '_') {
-        target[j] = source[i];
-        j--;
-        i--;
-    }
-    j++;
-    
-    // check if the segment index ciphers are less than target_length - 1
-    if (j > 0)
-        for (int d = j; d < target_length; d++)
-            target[d - j] = target[d]; // shift the ciphers by j
-        
-    seg_ind = (unsigned) atoi(target);
-    #else
-    // example of source: ghent/5450/segment_100.m4s
-    unsigned seg_ind = 0;
-
-	char str[strlen(source) + 1]; // do not forget +1 for the null character!
-	strcpy(str, source);    
-
-    char *pChr = strtok (str, "_.");
-    int i = 0;
-    while (pChr != NULL) {
-        if (i == 1) {	// the seg_id is in the 2nd element
-        	// printf("----------- seg_id found: %s\n", pChr);
-        	seg_ind = (unsigned) atoi(pChr);
-        }
-        pChr = strtok (NULL, "_.");
-        i++;
-    }
-
-    #endif
-    // Minh - MOD - E
-    // printf("============> Minh --- seg_ind: %u\n", seg_ind);
-    return seg_ind;
-}
-
-
-static void
-weights_init (long double W[N_REP][N_MAX_SEG], char const* filename) {
-    FILE * fp;
-    char * line = NULL;
-    size_t len = 0;
-    ssize_t read;
-    unsigned r_ind = 0; // representation index
-    int n = 0;
-    char target[N_MAX_SEG][40];
-
-    fp = fopen(filename, "r");
-    if (fp == NULL) {
-        printf("NO WEIGHT FILE FOUND at %s!\n", filename);
-        return;
-    }
-    
-    while ((read = getline(&line, &len, fp)) != -1) {
-        //printf("Retrieved line of length %zu:\n", read);
-        //printf("%s", line);
-        n = getWords(line, target);
-        // printf("N = %d\n", n);
-        if (n != N_MAX_SEG) {
-            printf("ERROR: Quality Idx %d: number of returned words from getWords() is %i instead of %i\n", r_ind, n, N_MAX_SEG);
-            return;
-        }
-        for (ssize_t i = 0; i < n; i++) {
-            W[r_ind][i] = strtold(target[i], NULL)*8/1000.0;
-            // printf("W[%d][%ld] = %Lf ", r_ind, i, W[r_ind][i]);
-        }
-        printf("\n");
-        r_ind++;
-    }
-
-    fclose(fp);
-    if (line)
-        free(line);
-    printf("=========== 2 ==================\n");
-}
-
 static void
 update_sample_stats (struct sample_stats *stats, unsigned long val)
 {
@@ -535,7 +190,7 @@ struct lsquic_conn_ctx;
 
 struct path_elem {
     TAILQ_ENTRY(path_elem)      next_pe;
-    const char                 *path;
+    const char                 *path;   /* Given with -p; NULL if built from the ladder */
     unsigned                    seg_ind;
     unsigned                    seg_q;
 };
@@ -563,6 +218,29 @@ struct http_client_ctx {
     
     unsigned                     chosen_abr; // {0 -> Normalized_Quality_Instability; 1 -> MaxJ; 2 -> MaxMinJ (MaxJ*); 3 -> MaxMinJ_Buff_Norm; 4 -> MaxR select; 5 -> BOLA; 6 -> SARA; 7 -> BBA}
     bool                         h2br; // If H2BR module is implemented
+    bool                         native_solver; // Solve ABR models 0-3 with abr_native.c instead of Gurobi
+#if HAVE_GUROBI
+    struct abr_grb_ctx          *grb_ctx; // Gurobi environment and model skeletons, kept for the whole session
+#endif
+    struct dofp_session         *hcc_sess;       // Player: buffer, stalls and ABR state
+    struct dofp_manifest        *hcc_manifest;   // Manifest being fetched, if any: the session starts once the ladder is known
+    const char                  *hcc_manifest_path; // Its document to request next
+    struct dofp_settings        *hcc_settings;   // Settings of the session
+    lsquic_time_t                hcc_stall_t;    // Start of the initial stall
+    struct abr_worker           *hcc_abr_worker; // Solves the optimization models off the event loop
+    struct event                *hcc_abr_event;  // Fires when the worker has completed decisions
+    struct event                *hcc_playout_ev; // Fires at the next segment end or stall
+    struct dofp_pool            *hcc_pool;       // Media of the buffered segments
+    struct dofp_p1203           *hcc_p1203;      // P.1203 input, written as played
+    struct abr_job              *hcc_abr_job;    // Decision in progress, if any
+    lsquic_conn_ctx_t           *hcc_abr_conn;   // Its connection; NULL if it closed
+    lsquic_time_t                hcc_req_at;     // The next new segment is requested at this time; 0 if it is not held back
+    unsigned                     hcc_prefetch;   // Segments the server is asked to push after each new one (-F)
+    unsigned                     hcc_push_ind, hcc_push_end; // Segments expected to be pushed next, end excluded
+    unsigned                     hcc_push_q;     // Their representation
+    TAILQ_HEAD(, lsquic_stream_ctx) hcc_pushed;  // Pushed segments the ABR has not picked yet, in order
+    struct lsquic_stream_ctx    *hcc_taken;      // Picked pushed segment, held back until hcc_push_ev fires
+    struct event                *hcc_push_ev;
     unsigned                     hcc_total_n_reqs;
     unsigned                     hcc_reqs_per_conn;
     unsigned                     hcc_concurrency;
@@ -578,6 +256,7 @@ struct http_client_ctx {
         HCC_SKIP_SESS_RESUME    = (1 << 0),
         HCC_SEEN_FIN            = (1 << 1),
         HCC_ABORT_ON_INCOMPLETE = (1 << 2),
+        HCC_WALL_CLOCK_TPUT     = (1 << 3),  /* Throughput from the stream time, not the transport */
     }                            hcc_flags;
     struct prog                 *prog;
     const char                  *qif_file;
@@ -599,9 +278,12 @@ struct lsquic_conn_ctx {
     enum {
         CH_SESSION_RESUME_SAVED   = 1 << 0,
     }                    ch_flags;
+    struct event        *ch_req_ev;     /* Opens the stream of a held-back request */
 };
 
 
+enum abr_status { ABR_DONE, ABR_PENDING, ABR_STOP, };
+
 struct hset_elem
 {
     STAILQ_ENTRY(hset_elem)     next;
@@ -618,6 +300,8 @@ static void
 hset_destroy (void *hset);
 static void
 display_cert_chain (lsquic_conn_t *);
+static void
+push_drop_conn (struct http_client_ctx *, lsquic_conn_ctx_t *);
 
 
 static void
@@ -657,12 +341,42 @@ create_connections (struct http_client_ctx *client_ctx)
 }
 
 
+/* The new segment is requested when the buffer has room for it or when
+ * the ABR asked (SARA): its stream is opened from a timer, the other
+ * streams are opened now.
+ */
 static void
 create_streams (struct http_client_ctx *client_ctx, lsquic_conn_ctx_t *conn_h)
 {
-    t_stats.tot_throughput /= (client_ctx->hcc_still_ret_segments + client_ctx->hcc_still_segments); // Throughput subdivision for number of streams to be opened
+    lsquic_time_t now, delay;
+    struct timeval tv;
+    unsigned n_held = 0;
+
+    if (client_ctx->hcc_req_at)
+    {
+        now = lsquic_time_now();
+        if (client_ctx->hcc_req_at > now)
+        {
+            delay = client_ctx->hcc_req_at - now;
+            tv.tv_sec = delay / 1000000;
+            tv.tv_usec = delay % 1000000;
+            if (0 != event_add(conn_h->ch_req_ev, &tv))
+            {
+                LSQ_ERROR("cannot add request timer");
+                exit(1);
+            }
+            /* With one stream, the segments are requested in order */
+            if (client_ctx->hcc_cc_reqs_per_conn == 1)
+                return;
+            n_held = 1;
+        }
+        else
+            client_ctx->hcc_req_at = 0;
+    }
+
+    dofp_session_share_throughput(client_ctx->hcc_sess, client_ctx->hcc_still_ret_segments + client_ctx->hcc_still_segments); // Throughput subdivision for number of streams to be opened
     while (conn_h->ch_n_reqs - conn_h->ch_n_cc_streams &&
-            conn_h->ch_n_cc_streams < client_ctx->hcc_cc_reqs_per_conn && client_ctx->hcc_open_streams < (client_ctx->hcc_still_ret_segments + client_ctx->hcc_still_segments))
+            conn_h->ch_n_cc_streams < client_ctx->hcc_cc_reqs_per_conn && client_ctx->hcc_open_streams + n_held < (client_ctx->hcc_still_ret_segments + client_ctx->hcc_still_segments))
     {
         lsquic_conn_make_stream(conn_h->conn);
         conn_h->ch_n_cc_streams++;
@@ -671,6 +385,20 @@ create_streams (struct http_client_ctx *client_ctx, lsquic_conn_ctx_t *conn_h)
 }
 
 
+/* The buffer has room for the next segment */
+static void
+http_client_on_req_timer (evutil_socket_t fd, short what, void *arg)
+{
+    lsquic_conn_ctx_t *const conn_h = arg;
+    struct http_client_ctx *const client_ctx = conn_h->client_ctx;
+
+    client_ctx->hcc_req_at = 0;
+    dofp_session_update(client_ctx->hcc_sess, lsquic_time_now());
+    create_streams(client_ctx, conn_h);
+    prog_process_conns(client_ctx->prog);
+}
+
+
 static lsquic_conn_ctx_t *
 http_client_on_new_conn (void *stream_if_ctx, lsquic_conn_t *conn)
 {
@@ -678,11 +406,20 @@ http_client_on_new_conn (void *stream_if_ctx, lsquic_conn_t *conn)
     lsquic_conn_ctx_t *conn_h = calloc(1, sizeof(*conn_h));
     conn_h->conn = conn;
     conn_h->client_ctx = client_ctx;
+    conn_h->ch_req_ev = event_new(prog_eb(client_ctx->prog), -1, 0,
+                                        http_client_on_req_timer, conn_h);
+    if (!conn_h->ch_req_ev)
+    {
+        LSQ_ERROR("cannot allocate request timer");
+        exit(1);
+    }
     conn_h->ch_n_reqs = MIN(client_ctx->hcc_total_n_reqs,
                                                 client_ctx->hcc_reqs_per_conn);
     client_ctx->hcc_total_n_reqs -= conn_h->ch_n_reqs;
     ++conn_h->client_ctx->hcc_n_open_conns;
-    if (!TAILQ_EMPTY(&client_ctx->hcc_path_elems))
+    if (client_ctx->hcc_manifest)
+        lsquic_conn_make_stream(conn);  /* The manifest comes first */
+    else if (!TAILQ_EMPTY(&client_ctx->hcc_path_elems))
         create_streams(client_ctx, conn_h);
     conn_h->ch_created = lsquic_time_now();
     return conn_h;
@@ -733,6 +470,9 @@ http_client_on_conn_closed (lsquic_conn_t *conn)
             abort();
     }
     --conn_h->client_ctx->hcc_n_open_conns;
+    if (conn_h->client_ctx->hcc_abr_conn == conn_h)
+        conn_h->client_ctx->hcc_abr_conn = NULL;
+    push_drop_conn(conn_h->client_ctx, conn_h);
 
     cacos = calloc(1, sizeof(*cacos));
     if (!cacos)
@@ -755,6 +495,7 @@ http_client_on_conn_closed (lsquic_conn_t *conn)
     }
     event_active(cacos->event, 0, 0);
 
+    event_free(conn_h->ch_req_ev);
     free(conn_h);
 }
 
@@ -863,52 +604,371 @@ struct lsquic_stream_ctx {
         ABANDON = 1 << 2,   /* Abandon reading from stream after sh_stop bytes
                              * have been read.
                              */
+        MANIFEST = 1 << 3,  /* The stream fetches the manifest */
+        SKIPPED_HEADERS = 1 << 4,   /* The headers are not put in sh_slab */
+        PUSHED  = 1 << 5,   /* The segment was pushed by the server */
+        TAKEN   = 1 << 6,   /* The ABR picked the pushed segment */
+        DROPPED = 1 << 7,   /* The pushed segment is of no use */
+        READ_ALL = 1 << 8,  /* The whole response was read */
     }                    sh_flags;
     lsquic_time_t        sh_created;
+    lsquic_time_t        sh_closed;
     lsquic_time_t        sh_ttfb;
+    lsquic_time_t        sh_deadline;   /* When the player needs the segment, 0 if unknown */
     size_t               sh_stop;   /* Stop after reading this many bytes if ABANDON is set */
     size_t               sh_nread;  /* Number of bytes read from stream using one of
                                      * lsquic_stream_read* functions.
                                      */
     bool                 isTerminated;
-    long double          sh_throughput;
     bool                 isRet;
     unsigned             seg_ind;
     unsigned             seg_q;
     unsigned             count;
     FILE                *download_fh;
+    struct dofp_slab    *sh_slab;   /* Segment being received */
+    /* Pushed segments only: */
+    TAILQ_ENTRY(lsquic_stream_ctx)
+                         sh_next_push;
+    lsquic_conn_ctx_t   *sh_conn_h;
+    lsquic_time_t        sh_due;    /* Not delivered before this time */
     struct lsquic_reader reader;
+    char                 sh_path_buf[0x400];    /* Segment path, from the ladder */
 };
 
-static bool
-isRetSegAcceptable(struct lsquic_stream_ctx *st_h)
+static void
+http_client_arm_playout (struct http_client_ctx *);
+
+
+/* A segment ended or the buffer ran out */
+static void
+http_client_on_playout (evutil_socket_t fd, short what, void *arg)
 {
-    //printf("SEG_IND: %i, SEG_REP: %i", client_ctx->hcc_ret_pe->seg_ind, rep_seg_ind);
-    // Check if re-transmitted index (real array index [starting from 0]) + 1 > rep_seg_ind (path index starting from 1 [not 0])
-    if (st_h->seg_ind > rep_seg_ind)
-        return true;
+    struct http_client_ctx *const client_ctx = arg;
+    struct dofp_session *const sess = client_ctx->hcc_sess;
+
+    dofp_session_update(sess, lsquic_time_now());
+    if (dofp_session_next_event(sess))
+        LSQ_DEBUG("playing segment %u, buffer: %.3f s",
+            dofp_session_rep_seg_ind(sess), dofp_session_buffer_level(sess));
     else
-        return false;
+        LSQ_NOTICE("stall before segment %u", dofp_session_rep_seg_ind(sess) + 1);
+    http_client_arm_playout(client_ctx);
 }
 
 
+/* The session is updated when the playout changes by itself and when it
+ * is read, not as data arrives.  Call this after a segment is received.
+ * The played segments leave the pool.
+ */
+static void
+http_client_arm_playout (struct http_client_ctx *client_ctx)
+{
+    lsquic_time_t at, now, delay;
+    struct timeval tv;
+
+    if (!client_ctx->hcc_playout_ev)
+    {
+        client_ctx->hcc_playout_ev = event_new(prog_eb(client_ctx->prog), -1,
+                                    0, http_client_on_playout, client_ctx);
+        if (!client_ctx->hcc_playout_ev)
+        {
+            LSQ_ERROR("cannot allocate playout timer");
+            exit(1);
+        }
+    }
+
+    if (client_ctx->hcc_pool)
+        dofp_pool_release(client_ctx->hcc_pool,
+                                dofp_session_rep_seg_ind(client_ctx->hcc_sess));
+
+    at = dofp_session_next_event(client_ctx->hcc_sess);
+    if (!at)
+    {
+        event_del(client_ctx->hcc_playout_ev);
+        return;
+    }
+    now = lsquic_time_now();
+    delay = at > now ? at - now : 0;
+    tv.tv_sec = delay / 1000000;
+    tv.tv_usec = delay % 1000000;
+    if (0 != event_add(client_ctx->hcc_playout_ev, &tv))
+    {
+        LSQ_ERROR("cannot add playout timer");
+        exit(1);
+    }
+}
+
+
+static void
+http_client_stream_done (struct http_client_ctx *, lsquic_conn_ctx_t *,
+                                                        lsquic_stream_ctx_t *);
+
+
+/* A pushed segment that is not delivered */
+static void
+push_free (struct http_client_ctx *client_ctx, lsquic_stream_ctx_t *st_h)
+{
+    if (st_h->sh_slab)
+        dofp_pool_put(client_ctx->hcc_pool, st_h->sh_slab);
+    if (st_h->download_fh)
+        fclose(st_h->download_fh);
+    free(st_h);
+}
+
+
+/* If its stream is still open, it is closed, and on_close frees it */
+static void
+push_drop (struct http_client_ctx *client_ctx, lsquic_stream_ctx_t *st_h)
+{
+    LSQ_INFO("drop pushed segment %u of representation %u", st_h->seg_ind,
+                                                                st_h->seg_q);
+    TAILQ_REMOVE(&client_ctx->hcc_pushed, st_h, sh_next_push);
+    if (st_h->stream)
+    {
+        st_h->sh_flags |= DROPPED;
+        lsquic_stream_close(st_h->stream);
+    }
+    else
+        push_free(client_ctx, st_h);
+}
+
+
+/* The connection is closed: its pushed segments go.  The segment the ABR
+ * picked is still needed: it is requested again, at the time it was due,
+ * on the next connection.
+ */
+static void
+push_drop_conn (struct http_client_ctx *client_ctx, lsquic_conn_ctx_t *conn_h)
+{
+    lsquic_stream_ctx_t *st_h, *next;
+    struct path_elem *pe;
+
+    for (st_h = TAILQ_FIRST(&client_ctx->hcc_pushed); st_h; st_h = next)
+    {
+        next = TAILQ_NEXT(st_h, sh_next_push);
+        if (st_h->sh_conn_h == conn_h)
+            push_drop(client_ctx, st_h);
+    }
+    if (client_ctx->hcc_taken && client_ctx->hcc_taken->sh_conn_h == conn_h)
+    {
+        st_h = client_ctx->hcc_taken;
+        event_del(client_ctx->hcc_push_ev);
+        client_ctx->hcc_taken = NULL;
+        pe = calloc(1, sizeof(*pe));
+        if (!pe)
+        {
+            LSQ_ERROR("cannot allocate path element");
+            exit(1);
+        }
+        pe->seg_ind = st_h->seg_ind;
+        pe->seg_q = st_h->seg_q;
+        printf("Downloading seg. %u, rep. %u\n", pe->seg_ind, pe->seg_q);
+        TAILQ_INSERT_TAIL(&client_ctx->hcc_path_elems, pe, next_pe);
+        if (st_h->sh_due > lsquic_time_now())
+            client_ctx->hcc_req_at = st_h->sh_due;
+        push_free(client_ctx, st_h);
+        --client_ctx->hcc_open_streams;
+        ++client_ctx->hcc_total_n_reqs;     /* The request goes to the next connection */
+    }
+}
+
+
+/* The picked pushed segment is due: it is received now */
+static void
+http_client_on_push_due (evutil_socket_t fd, short what, void *arg)
+{
+    struct http_client_ctx *const client_ctx = arg;
+    lsquic_stream_ctx_t *const st_h = client_ctx->hcc_taken;
+
+    client_ctx->hcc_taken = NULL;
+    dofp_session_update(client_ctx->hcc_sess, lsquic_time_now());
+    http_client_stream_done(client_ctx, st_h->sh_conn_h, st_h);
+    prog_process_conns(client_ctx->prog);
+}
+
+
+/* The picked pushed segment arrived before it is due */
+static void
+push_deliver_later (struct http_client_ctx *client_ctx,
+                                                    lsquic_stream_ctx_t *st_h)
+{
+    lsquic_time_t now, delay;
+    struct timeval tv;
+
+    if (!client_ctx->hcc_push_ev)
+    {
+        client_ctx->hcc_push_ev = event_new(prog_eb(client_ctx->prog), -1,
+                                    0, http_client_on_push_due, client_ctx);
+        if (!client_ctx->hcc_push_ev)
+        {
+            LSQ_ERROR("cannot allocate push timer");
+            exit(1);
+        }
+    }
+
+    now = lsquic_time_now();
+    delay = st_h->sh_due > now ? st_h->sh_due - now : 0;
+    tv.tv_sec = delay / 1000000;
+    tv.tv_usec = delay % 1000000;
+    client_ctx->hcc_taken = st_h;
+    if (0 != event_add(client_ctx->hcc_push_ev, &tv))
+    {
+        LSQ_ERROR("cannot add push timer");
+        exit(1);
+    }
+}
+
+
+/* True if the promised path is `path' */
+static bool
+hset_has_path (const struct hset *hset, const char *path)
+{
+    const struct hset_elem *el;
+    const size_t len = strlen(path);
+
+    STAILQ_FOREACH(el, hset, next)
+        if (el->xhdr.name_len == 5
+                && 0 == memcmp(lsxpack_header_get_name(&el->xhdr), ":path", 5))
+            return el->xhdr.val_len == len
+                && 0 == memcmp(lsxpack_header_get_value(&el->xhdr), path, len);
+    return false;
+}
+
+
+/* A segment the server pushes after the one requested with dofp-prefetch.
+ * The segments of the horizon are promised in order.  The segment is kept
+ * until the ABR picks the next segment, see http_client_take_push().
+ */
 static lsquic_stream_ctx_t *
-http_client_on_new_stream (void *stream_if_ctx, lsquic_stream_t *stream)
+push_on_new_stream (struct http_client_ctx *client_ctx,
+                                                    lsquic_stream_t *stream)
 {
-    
-    /* Buffer update */
-    update_buff(false); // [false] is "normal Time Update"
-    // printf("Buffer size: %.3f sec\n", buffer_level);
-    
-    const int pushed = lsquic_stream_is_pushed(stream);
+    lsquic_stream_ctx_t *st_h;
+    lsquic_stream_id_t ref_stream_id;
+    void *hset;
+
+    if (client_ctx->hcc_push_ind >= client_ctx->hcc_push_end
+            || !dofp_ladder_has_seg(s_ladder, client_ctx->hcc_push_ind))
+        goto refuse;
+
+    st_h = calloc(1, sizeof(*st_h));
+    if (!st_h)
+    {
+        LSQ_ERROR("cannot allocate stream context");
+        exit(1);
+    }
+    st_h->stream = stream;
+    st_h->client_ctx = client_ctx;
+    st_h->sh_created = lsquic_time_now();
+    st_h->sh_flags = PUSHED;
+    st_h->sh_conn_h = lsquic_conn_get_ctx(lsquic_stream_conn(stream));
+    st_h->seg_ind = client_ctx->hcc_push_ind;
+    st_h->seg_q = client_ctx->hcc_push_q;
+    st_h->path = st_h->sh_path_buf;
+    if (dofp_ladder_seg_path(s_ladder, st_h->seg_q, st_h->seg_ind,
+                        st_h->sh_path_buf, sizeof(st_h->sh_path_buf)) < 0
+        /* The header set is only ours with header bypass */
+        || (g_header_bypass
+            && 0 == lsquic_stream_push_info(stream, &ref_stream_id, &hset)
+            && !hset_has_path(hset, st_h->path)))
+    {
+        free(st_h);
+        goto refuse;
+    }
+
+    ++client_ctx->hcc_push_ind;
+    TAILQ_INSERT_TAIL(&client_ctx->hcc_pushed, st_h, sh_next_push);
+    LSQ_INFO("accepted push of %s", st_h->path);
+    lsquic_stream_wantread(stream, 1);
+    return st_h;
+
+  refuse:
+    LSQ_INFO("not accepting server push");
+    lsquic_stream_refuse_push(stream);
+    return NULL;
+}
+
 
-    if (pushed)
+/* Stream that fetches the current document of the manifest */
+static lsquic_stream_ctx_t *
+manifest_on_new_stream (struct http_client_ctx *client_ctx,
+                                                    lsquic_stream_t *stream)
+{
+    lsquic_stream_ctx_t *st_h;
+
+    if (lsquic_stream_is_pushed(stream))
     {
         LSQ_INFO("not accepting server push");
         lsquic_stream_refuse_push(stream);
         return NULL;
     }
 
+    st_h = calloc(1, sizeof(*st_h));
+    if (!st_h)
+    {
+        LSQ_ERROR("cannot allocate stream context");
+        exit(1);
+    }
+    st_h->stream = stream;
+    st_h->client_ctx = client_ctx;
+    st_h->sh_created = lsquic_time_now();
+    st_h->sh_flags = MANIFEST;
+    st_h->path = client_ctx->hcc_manifest_path;
+    LSQ_INFO("created new stream, manifest path: %s", st_h->path);
+    lsquic_stream_wantwrite(stream, 1);
+    return st_h;
+}
+
+
+/* Path of the segment of `pe': given with -p, or built in place from the
+ * ladder.
+ */
+static bool
+stream_set_path (lsquic_stream_ctx_t *st_h, const struct path_elem *pe)
+{
+    if (pe->path)
+        st_h->path = pe->path;
+    else if (dofp_ladder_seg_path(s_ladder, pe->seg_q, pe->seg_ind,
+                        st_h->sh_path_buf, sizeof(st_h->sh_path_buf)) >= 0)
+        st_h->path = st_h->sh_path_buf;
+    else
+    {
+        LSQ_ERROR("no media path for segment %u of representation %u",
+                                                    pe->seg_ind, pe->seg_q);
+        return false;
+    }
+    return true;
+}
+
+
+/* Expected size of segment `seg_ind' of representation `q' [bytes] */
+static uint64_t
+seg_nbytes (unsigned q, unsigned seg_ind)
+{
+    unsigned i = seg_ind - 1;
+
+    if (!s_ladder->dl_sizes)
+        return (uint64_t) s_ladder->dl_bitrates[q] * s_ladder->dl_seg_len * 125;
+    if (i >= s_ladder->dl_n_seg)
+        i = s_ladder->dl_n_seg - 1;
+    return s_ladder->dl_sizes[q * s_ladder->dl_n_seg + i];
+}
+
+
+static lsquic_stream_ctx_t *
+http_client_on_new_stream (void *stream_if_ctx, lsquic_stream_t *stream)
+{
+    struct http_client_ctx *const client_ctx = stream_if_ctx;
+
+    if (client_ctx->hcc_manifest)
+        return manifest_on_new_stream(client_ctx, stream);
+
+    /* Buffer update */
+    dofp_session_update(client_ctx->hcc_sess, lsquic_time_now());
+
+    if (lsquic_stream_is_pushed(stream))
+        return push_on_new_stream(client_ctx, stream);
+
     lsquic_stream_ctx_t *st_h = calloc(1, sizeof(*st_h));
     st_h->stream = stream;
     st_h->client_ctx = stream_if_ctx;
@@ -916,21 +976,16 @@ http_client_on_new_stream (void *stream_if_ctx, lsquic_stream_t *stream)
     st_h->isTerminated = false;
     
     struct path_elem *temp_pe;
-    temp_pe = calloc(1, sizeof(*temp_pe));
     
     transmission:
         printf("\nTransmission:\n");
+        if (client_ctx->hcc_req_at) // The new segment is requested later, from create_streams()
+            goto retransmission;
         if (!st_h->client_ctx->hcc_cur_pe) {
             printf("====> INIT QUEUE !\n");
             st_h->client_ctx->hcc_cur_pe = TAILQ_FIRST(
                                                 &st_h->client_ctx->hcc_path_elems);
         } else if (st_h->client_ctx->hcc_still_segments) {
-            // If we don't have space in the buffer, wait sometime before sending request for new segment
-            if (buffer_level > buffer_size){
-                printf("==> MAIN2 FULL BUFFER! Sleep for %d s\n", (unsigned int) seg_length);
-                sleep((unsigned int) seg_length); // Sleep for x seconds until the buffer level allow new segments download
-                st_h->sh_created = lsquic_time_now();
-            }
             temp_pe = TAILQ_NEXT(st_h->client_ctx->hcc_cur_pe, next_pe);
             if (!temp_pe){ // If there are no more available new segments to be downloaded throw an error
                 if (st_h->client_ctx->hcc_still_ret_segments) { // If we still have segments to be retransmitted let's try that
@@ -946,11 +1001,18 @@ http_client_on_new_stream (void *stream_if_ctx, lsquic_stream_t *stream)
         else if (st_h->client_ctx->hcc_still_ret_segments) {
             goto retransmission;
         }
-        st_h->path = st_h->client_ctx->hcc_cur_pe->path;
+        if (!stream_set_path(st_h, st_h->client_ctx->hcc_cur_pe))
+        {
+            lsquic_stream_close(stream);
+            return st_h;
+        }
         printf("=================MINH 913 path: %s\n", st_h->path);
         st_h->isRet = false;
         st_h->seg_ind = st_h->client_ctx->hcc_cur_pe->seg_ind;
         st_h->seg_q = st_h->client_ctx->hcc_cur_pe->seg_q;
+        /* The player stalls when the buffer runs out */
+        st_h->sh_deadline = st_h->sh_created + (lsquic_time_t)
+                    (dofp_session_buffer_level(client_ctx->hcc_sess) * 1000000);
         goto process_path;
     
     retransmission:
@@ -962,7 +1024,7 @@ http_client_on_new_stream (void *stream_if_ctx, lsquic_stream_t *stream)
                 if (st_h->client_ctx->hcc_ret_pe){
                     temp_pe = TAILQ_NEXT(st_h->client_ctx->hcc_ret_pe, next_pe);
                     if (!temp_pe) { // If it's the last element of the queue
-                        if (st_h->client_ctx->hcc_still_segments) { // If we still have segments to be retransmitted let's try that
+                        if (st_h->client_ctx->hcc_still_segments && !client_ctx->hcc_req_at) { // If we still have segments to be retransmitted let's try that
                             goto transmission;
                         } else {
                             LSQ_ERROR("NO SEGMENTS IN ANY QUEUE.");
@@ -976,9 +1038,7 @@ http_client_on_new_stream (void *stream_if_ctx, lsquic_stream_t *stream)
             if (!st_h->client_ctx->hcc_ret_pe)
                 st_h->client_ctx->hcc_ret_pe = TAILQ_FIRST(&st_h->client_ctx->hcc_ret_path_elems);
             /* Path has been set. Check whether the throughput is enough to re-download the segment in time before the playout of its low-quality version */
-            double available_time = 0.0;
-            if (st_h->client_ctx->hcc_ret_pe->seg_ind > rep_seg_ind)
-                available_time = rep_seg_time + (st_h->client_ctx->hcc_ret_pe->seg_ind - rep_seg_ind - 1) * seg_length; // .. (st_h->client_ctx->hcc_ret_pe->seg_ind (+1) - rep_seg_ind (-1)) * ..
+            double available_time = dofp_session_available_time(client_ctx->hcc_sess, st_h->client_ctx->hcc_ret_pe->seg_ind);
             // printf("Available time: %.3f\n", available_time);
             // printf("Bitrate: %d\n", seg_bitrates[st_h->client_ctx->hcc_ret_pe->seg_q]);
             // printf("Estimated throughput: %.3Lf\n", t_stats.e_temp_throughput);
@@ -1000,25 +1060,37 @@ http_client_on_new_stream (void *stream_if_ctx, lsquic_stream_t *stream)
                     // }
                 // }
             // }
-            ///////////////////// MINH - Temporal fix - S
-            char *m_temp = st_h->client_ctx->hcc_ret_pe->path;
-            int m_temp_length = strlen(m_temp);
-            printf("=================MINH 966-1 path: %s. last character: %c, length: %ld\n",
-                m_temp, m_temp[m_temp_length-1], m_temp_length);
-
-            if (m_temp[m_temp_length-1] != 's') {
-                strcat(m_temp,"s");
-                printf("\t***** fixed path: %s. length: %ld\n", m_temp, strlen(m_temp));
-            }           
-            #if 0
-            st_h->path = st_h->client_ctx->hcc_ret_pe->path; // Set the segment path
-            #endif
-            st_h->path = m_temp;
-            printf("=================MINH 966-2 path: %s\n", st_h->path);
-            ///////////////////// MINH - Temporal fix - E
+            if (!stream_set_path(st_h, st_h->client_ctx->hcc_ret_pe))
+            {
+                lsquic_stream_close(stream);
+                return st_h;
+            }
             st_h->isRet = true; // It's a re-transmission
             st_h->seg_ind = st_h->client_ctx->hcc_ret_pe->seg_ind;
             st_h->seg_q = st_h->client_ctx->hcc_ret_pe->seg_q;
+            /* The low-quality version is played 100 ms after the deadline */
+            if (available_time > 0.1)
+                st_h->sh_deadline = st_h->sh_created
+                        + (lsquic_time_t) ((available_time - 0.1) * 1000000);
+            if (request_cancellation && st_h->seg_q > 0
+                && (dofp_session_settings(client_ctx->hcc_sess)->dss_abr->dai_flags & DOFP_ABR_CANCEL))
+            {
+                /* The stream calls on_deadline when the segment cannot
+                 * arrive before the playout of its low-quality version.
+                 */
+                if (st_h->sh_deadline)
+                    lsquic_stream_set_deadline(stream,
+                        st_h->sh_deadline - st_h->sh_created,
+                        seg_nbytes(st_h->seg_q, st_h->seg_ind));
+                else
+                {
+                    LSQ_NOTICE("no time left to re-download segment %u",
+                                                            st_h->seg_ind);
+                    st_h->isTerminated = true;
+                    lsquic_stream_close(stream);
+                    return st_h;
+                }
+            }
             //++st_h->client_ctx->hcc_open_ret_streams; // This stream belongs to the re-transmission ones
             goto process_path; // Process the request
         } else {
@@ -1098,10 +1170,12 @@ send_headers (lsquic_stream_ctx_t *st_h)
     const char *hostname = st_h->client_ctx->hostname;
     struct header_buf hbuf;
     unsigned h_idx = 0;
+    lsquic_time_t now;
+    char deadline[24], prefetch[12];
     if (!hostname)
         hostname = st_h->client_ctx->prog->prog_hostname;
     hbuf.off = 0;
-    struct lsxpack_header headers_arr[10];
+    struct lsxpack_header headers_arr[11];
 #define V(v) (v), strlen(v)
     header_set_ptr(&headers_arr[h_idx++], &hbuf, V(":method"), V(st_h->client_ctx->method));
     header_set_ptr(&headers_arr[h_idx++], &hbuf, V(":scheme"), V("https"));
@@ -1120,6 +1194,25 @@ send_headers (lsquic_stream_ctx_t *st_h)
             sprintf(pfv, "i=?0");
         header_set_ptr(&headers_arr[h_idx++], &hbuf, V("priority"), V(pfv));
     }
+    if (st_h->sh_deadline)
+    {
+        /* Lets a server with deadline scheduling order the segments */
+        now = lsquic_time_now();
+        sprintf(deadline, "%"PRIu64, st_h->sh_deadline > now
+                                    ? (st_h->sh_deadline - now) / 1000 : 1);
+        header_set_ptr(&headers_arr[h_idx++], &hbuf, V("dofp-deadline"), V(deadline));
+    }
+    if (st_h->client_ctx->hcc_prefetch && !st_h->isRet
+                                        && !(st_h->sh_flags & MANIFEST))
+    {
+        /* The server pushes the next segments at the same quality */
+        sprintf(prefetch, "%u", st_h->client_ctx->hcc_prefetch);
+        header_set_ptr(&headers_arr[h_idx++], &hbuf, V("dofp-prefetch"), V(prefetch));
+        st_h->client_ctx->hcc_push_ind = st_h->seg_ind + 1;
+        st_h->client_ctx->hcc_push_end = st_h->seg_ind + 1
+                                            + st_h->client_ctx->hcc_prefetch;
+        st_h->client_ctx->hcc_push_q = st_h->seg_q;
+    }
     if (st_h->client_ctx->payload)
     {
         header_set_ptr(&headers_arr[h_idx++], &hbuf, V("content-type"), V("application/octet-stream"));
@@ -1222,6 +1315,44 @@ discard (void *ctx, const unsigned char *buf, size_t sz, int fin)
 }
 
 
+/* Segment data goes straight from the stream frames into the slab */
+static size_t
+segment_readf (void *ctx, const unsigned char *buf, size_t sz, int fin)
+{
+    lsquic_stream_ctx_t *const st_h = ctx;
+
+    /* Without header bypass, the headers are read first, in one piece */
+    if (!g_header_bypass && !(st_h->sh_flags & SKIPPED_HEADERS))
+    {
+        st_h->sh_flags |= SKIPPED_HEADERS;
+        return sz;
+    }
+
+    if (st_h->sh_flags & ABANDON)
+    {
+        if (sz > st_h->sh_stop - st_h->sh_nread)
+            sz = st_h->sh_stop - st_h->sh_nread;
+    }
+
+    if (!st_h->sh_slab)
+    {
+        st_h->sh_slab = dofp_pool_get(st_h->client_ctx->hcc_pool,
+                                                st_h->seg_q, st_h->seg_ind);
+        if (!st_h->sh_slab)
+        {
+            LSQ_ERROR("cannot get a slab for segment %u", st_h->seg_ind);
+            exit(1);
+        }
+    }
+    if (0 != dofp_slab_append(st_h->sh_slab, buf, sz))
+    {
+        LSQ_ERROR("cannot grow the slab of segment %u", st_h->seg_ind);
+        exit(1);
+    }
+    return sz;
+}
+
+
 static void
 maybe_perform_priority_actions (struct lsquic_stream *stream,
                                                 lsquic_stream_ctx_t *st_h)
@@ -1256,6 +1387,62 @@ maybe_perform_priority_actions (struct lsquic_stream *stream,
 }
 
 
+static size_t
+manifest_readf (void *ctx, const unsigned char *buf, size_t sz, int fin)
+{
+    lsquic_stream_ctx_t *const st_h = ctx;
+    const unsigned char *eol;
+
+    /* Without header bypass, the headers are read first, in one piece */
+    if (!(st_h->sh_flags & PROCESSED_HEADERS))
+    {
+        st_h->sh_flags |= PROCESSED_HEADERS;
+        if (sz < 12 || 0 != memcmp(buf, "HTTP/1.1 200", 12))
+        {
+            eol = memchr(buf, '\r', sz);
+            LSQ_ERROR("cannot fetch manifest %s: %.*s", st_h->path,
+                                (int) (eol ? (size_t) (eol - buf) : sz), buf);
+            exit(EXIT_FAILURE);
+        }
+        return sz;
+    }
+
+    /* Errors are reported by dofp_manifest_end() */
+    (void) dofp_manifest_feed(st_h->client_ctx->hcc_manifest, buf, sz);
+    st_h->sh_nread += sz;
+    return sz;
+}
+
+
+static void
+manifest_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+    struct hset *hset;
+    ssize_t nread;
+
+    if (g_header_bypass && !(st_h->sh_flags & PROCESSED_HEADERS))
+    {
+        hset = lsquic_stream_get_hset(stream);
+        if (!hset)
+        {
+            LSQ_ERROR("could not get header set from stream");
+            exit(2);
+        }
+        hset_destroy(hset);
+        st_h->sh_flags |= PROCESSED_HEADERS;
+    }
+
+    nread = lsquic_stream_readf(stream, manifest_readf, st_h);
+    if (nread == 0)
+        lsquic_stream_shutdown(stream, 0);
+    else if (nread < 0 && errno != EWOULDBLOCK)
+    {
+        LSQ_ERROR("could not read manifest: %s", strerror(errno));
+        exit(2);
+    }
+}
+
+
 static void
 http_client_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
 {
@@ -1263,18 +1450,18 @@ http_client_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
     struct hset *hset;
     ssize_t nread;
     unsigned old_prio, new_prio;
-    unsigned char buf[0x200];
     unsigned nreads = 0;
-    /* Throughput computation */
-    // lsquic_time_t init;
-    lsquic_time_t end;
     // Segment bitrate and index
-    int bitrate = 0;
-    unsigned seg_ind = 0;
-    // Gather bitrate from path
-    // printf("Gather bitrate...\n");
-    bitrate = getBitrateFromPath(st_h->path);
-    seg_ind = getSegIndFromPath(st_h->path);
+    int bitrate;
+    unsigned seg_ind;
+
+    if (st_h->sh_flags & MANIFEST)
+    {
+        manifest_on_read(stream, st_h);
+        return;
+    }
+    bitrate = s_ladder->dl_bitrates[st_h->seg_q];
+    seg_ind = st_h->seg_ind;
     
     // init = lsquic_time_now();
     
@@ -1311,53 +1498,12 @@ http_client_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
             hset_destroy(hset);
             st_h->sh_flags |= PROCESSED_HEADERS;
         }
-        else if (nread = (s_discard_response
-                            ? lsquic_stream_readf(stream, discard, st_h)
-                            : lsquic_stream_read(stream, buf,
-                                    st_h->sh_flags & ABANDON
-                                  ? MIN(sizeof(buf), st_h->sh_nread - st_h->sh_stop)
-                                  : sizeof(buf))),
+        else if (nread = lsquic_stream_readf(stream, s_discard_response
+                                    ? discard : segment_readf, st_h),
                     nread > 0)
         {
             st_h->sh_nread += (size_t) nread;
             s_stat_downloaded_bytes += nread;
-            end = lsquic_time_now();
-            // printf("Init: %ld; End: %ld\n", st_h->sh_created, end);
-            // printf("Difference: %ld\n", end - st_h->sh_created);
-            update_buff(false);
-            if (st_h->seg_q > 0 && (client_ctx->chosen_abr == 0 || client_ctx->chosen_abr == 2 || client_ctx->chosen_abr == 3)              && st_h->isRet) {
-                /* ADD Throughput computation and CANCEL FEATURE */
-                st_h->sh_throughput = (long double) st_h->sh_nread * 8 / ((long double) 1000 * (end - st_h->sh_created) / 1000000); // [kbps]
-                // printf("Passed seconds: %Lf\n", (long double) (end - st_h->sh_created) / 1000000);
-                /* Compute deadline and download time for segment */
-                double available_time = 0.0;
-                if (st_h->isRet) {
-                    if (seg_ind > rep_seg_ind)
-                        available_time = rep_seg_time + (seg_ind - rep_seg_ind - 1) * seg_length;
-                } else
-                    available_time = rep_seg_time + (seg_ind - rep_seg_ind - 1) * seg_length;
-                /* CANCEL_PUSH if available_time is not enough */
-                if (request_cancellation) {
-                    printf("\n==! TRANSMISSION STATUS CHECK !==\n");
-                    printf("Number of read bytes from stream: %zu\n", st_h->sh_nread);
-                    printf("Available time: %.3f\n", available_time);
-                    printf("Estimated throughput: %.3Lf\n", st_h->sh_throughput);
-                    printf("Re-transmission time: %.3Lf\n", (bitrate * seg_length - (st_h->sh_nread * 8 / 1000)) / st_h->sh_throughput);
-                    // if (available_time < 0.9 * ((bitrate * seg_length - (st_h->sh_nread * 8 / 1000)) / st_h->sh_throughput)) {
-                    if (available_time < 0.1) {
-                        printf("\n==! TRANSMISSION STATUS CHECK !==\n");
-                        printf("Number of read bytes from stream: %zu\n", st_h->sh_nread);
-                        printf("Available time: %.3f\n", available_time);
-                        printf("Estimated throughput: %.3Lf\n", st_h->sh_throughput);
-                        printf("Re-transmission time: %.3Lf\n", (bitrate * seg_length - (st_h->sh_nread * 8 / 1000)) / st_h->sh_throughput);
-                        printf("==== NOT ENOUGH THROUGHPUT FOR FULLFILLING REQUEST -> CLOSING STREAM for segment %u ====\n", seg_ind);
-                        /* Send CANCEL_PUSH -> If next segment, need to re-download it with different quality */
-                        st_h->isTerminated = true;
-                        lsquic_stream_close(stream);
-                        break;
-                    }
-                }
-            }
             /* test stream_reset after some number of read bytes */
             if (client_ctx->hcc_reset_after_nbytes &&
                 s_stat_downloaded_bytes > client_ctx->hcc_reset_after_nbytes)
@@ -1381,9 +1527,6 @@ http_client_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
                                     st_h->sh_ttfb - st_h->sh_created);
                 st_h->sh_flags |= PROCESSED_HEADERS;
             }
-            if (!s_discard_response)
-                fwrite(buf, 1, nread, st_h->download_fh
-                                    ? st_h->download_fh : stdout);
             if (randomly_reprioritize_streams && (st_h->count++ & 0x3F) == 0)
             {
                 if ((1 << lsquic_conn_quic_version(lsquic_stream_conn(stream)))
@@ -1428,6 +1571,7 @@ http_client_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
         {
             update_sample_stats(&s_stat_req, lsquic_time_now() - st_h->sh_ttfb);
             client_ctx->hcc_flags |= HCC_SEEN_FIN;
+            st_h->sh_flags |= READ_ALL;
             lsquic_stream_shutdown(stream, 0);
             break;
         }
@@ -1438,137 +1582,532 @@ http_client_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
         }
         else if (lsquic_stream_is_rejected(stream))
         {
-            LSQ_NOTICE("stream was rejected");
-            lsquic_stream_close(stream);
-            break;
+            LSQ_NOTICE("stream was rejected");
+            lsquic_stream_close(stream);
+            break;
+        }
+        else
+        {
+            LSQ_ERROR("could not read: %s", strerror(errno));
+            exit(2);
+        }
+    }
+    while (client_ctx->prog->prog_settings.es_rw_once
+            && nreads++ < 3 /* Emulate just a few reads */);
+}
+
+
+/* Take the pushed segment if the ABR picked it as the next one: it needs no
+ * request.  Like a request, it is delivered `delay' from now at the
+ * earliest.  The other pushed segments up to it are of no use any more; if
+ * the prediction was wrong, none of them is.
+ */
+static bool
+http_client_take_push (struct http_client_ctx *client_ctx,
+            lsquic_conn_ctx_t *conn_h, const struct dofp_segment_req *next,
+            lsquic_time_t delay)
+{
+    lsquic_stream_ctx_t *st_h, *tmp, *taken;
+    char path[PATH_MAX];
+
+    taken = NULL;
+    TAILQ_FOREACH(st_h, &client_ctx->hcc_pushed, sh_next_push)
+        if (st_h->sh_conn_h == conn_h && st_h->seg_ind == next->dsr_seg_ind
+                                            && st_h->seg_q == next->dsr_q)
+        {
+            taken = st_h;
+            break;
+        }
+    for (st_h = TAILQ_FIRST(&client_ctx->hcc_pushed); st_h; st_h = tmp)
+    {
+        tmp = TAILQ_NEXT(st_h, sh_next_push);
+        if (st_h != taken
+                    && (!taken || st_h->seg_ind <= next->dsr_seg_ind))
+            push_drop(client_ctx, st_h);
+    }
+    if (!taken)
+    {
+        /* Late promises of the horizon are refused */
+        client_ctx->hcc_push_ind = client_ctx->hcc_push_end;
+        return false;
+    }
+
+    TAILQ_REMOVE(&client_ctx->hcc_pushed, taken, sh_next_push);
+    taken->sh_flags |= TAKEN;
+    taken->sh_due = lsquic_time_now() + delay;
+    ++conn_h->ch_n_cc_streams;
+    ++client_ctx->hcc_open_streams;
+    if (client_ctx->hcc_download_dir)
+    {
+        snprintf(path, sizeof(path), "%s/%s", client_ctx->hcc_download_dir,
+                                                                taken->path);
+        taken->download_fh = fopen(path, "wb");
+        if (taken->download_fh)
+            LSQ_NOTICE("downloading %s to %s", taken->path, path);
+        else
+            LSQ_ERROR("cannot open %s for writing: %s", path, strerror(errno));
+    }
+    if (!taken->stream)     /* Received already */
+        push_deliver_later(client_ctx, taken);
+    return true;
+}
+
+
+/* Queue the segments picked by the ABR */
+static void
+http_client_queue_decision (struct http_client_ctx *client_ctx,
+                lsquic_conn_ctx_t *conn_h, const struct dofp_decision *dec)
+{
+    struct path_elem *pe;
+    lsquic_time_t delay;
+    unsigned i;
+
+    if (dec->dd_next)
+    {
+        /* Wait if the ABR asked for it (SARA) or the buffer is full */
+        delay = dofp_session_request_delay(client_ctx->hcc_sess, dec->dd_delay);
+        ++client_ctx->hcc_still_segments;
+        if (http_client_take_push(client_ctx, conn_h, &dec->dd_next_seg,
+                                                                    delay))
+            printf("Pushed seg. %u, rep. %u\n", dec->dd_next_seg.dsr_seg_ind,
+                                                    dec->dd_next_seg.dsr_q);
+        else
+        {
+            if (delay)
+            {
+                printf("MAIN Delay next request by %.3f s\n", (double) delay / 1000000);
+                client_ctx->hcc_req_at = lsquic_time_now() + delay;
+            }
+            pe = calloc(1, sizeof(*pe));
+            pe->seg_ind = dec->dd_next_seg.dsr_seg_ind;
+            pe->seg_q = dec->dd_next_seg.dsr_q;
+            printf("Downloading seg. %u, rep. %u\n", pe->seg_ind, pe->seg_q);
+            TAILQ_INSERT_TAIL(&client_ctx->hcc_path_elems, pe, next_pe);
+        }
+        conn_h->ch_n_reqs = MIN(client_ctx->hcc_total_n_reqs,
+                                                client_ctx->hcc_reqs_per_conn);
+        client_ctx->hcc_total_n_reqs -= conn_h->ch_n_reqs;
+    }
+
+    // Segments re-transmission for the buffered segments
+    for (i = 0; i < dec->dd_n_ret; ++i)
+    {
+        ++client_ctx->hcc_still_ret_segments;
+        pe = calloc(1, sizeof(*pe));
+        pe->seg_ind = dec->dd_ret[i].dsr_seg_ind;
+        pe->seg_q = dec->dd_ret[i].dsr_q;
+        printf("Added to the queue: segment index %u, representation %u\n", pe->seg_ind, pe->seg_q);
+        TAILQ_INSERT_TAIL(&client_ctx->hcc_ret_path_elems, pe, next_pe);
+        conn_h->ch_n_reqs += MIN(client_ctx->hcc_total_n_reqs,
+                                        client_ctx->hcc_reqs_per_conn);
+        client_ctx->hcc_total_n_reqs -= conn_h->ch_n_reqs;
+    }
+}
+
+
+/* Picks the next segment and the segments to re-transmit once all streams
+ * of the previous round are closed.  The optimization models are solved by
+ * the ABR worker: in that case, ABR_PENDING is returned and the decision is
+ * applied when the worker is done.
+ */
+static enum abr_status
+http_client_abr (struct http_client_ctx *client_ctx, lsquic_conn_ctx_t *conn_h)
+{
+    struct dofp_decision dec;
+    struct abr_job *job;
+
+    if (client_ctx->hcc_still_ret_segments || client_ctx->hcc_still_segments)
+        return ABR_DONE;    /* Wait for the segments in flight */
+
+    printf("Total throughput: %.3Lf kbps\n", dofp_session_throughput(client_ctx->hcc_sess));
+    switch (dofp_session_decide(client_ctx->hcc_sess, &dec, &job))
+    {
+    case DOFP_DONE:
+        http_client_queue_decision(client_ctx, conn_h, &dec);
+        return ABR_DONE;
+    case DOFP_PENDING:
+        /* The model is solved by the ABR worker; the decision is applied
+         * in dofp_abr_on_done().
+         */
+        if (0 != abr_worker_submit(client_ctx->hcc_abr_worker, job))
+        {
+            LSQ_ERROR("cannot submit ABR job");
+            dofp_job_destroy(job);
+            return ABR_STOP;
+        }
+        client_ctx->hcc_abr_job = job;
+        client_ctx->hcc_abr_conn = conn_h;
+        return ABR_PENDING;
+    case DOFP_END:  /* CLOSE CONN IF THERE IS NO PLACE FOR IMPROVEMENT */
+        printf("Closing connection!\n");
+        client_ctx->hcc_total_n_reqs = 0;
+        lsquic_conn_close(conn_h->conn);
+        return ABR_STOP;
+    default:
+        LSQ_ERROR("ABR decision failed");
+        return ABR_STOP;
+    }
+}
+
+
+/* Runs the ABR step, if needed, and opens the streams for the queued
+ * segments.
+ */
+static void
+http_client_continue (struct http_client_ctx *client_ctx,
+                                    lsquic_conn_ctx_t *conn_h, bool run_abr)
+{
+  again:
+    if (run_abr)
+        switch (http_client_abr(client_ctx, conn_h))
+        {
+        case ABR_DONE:
+            break;
+        case ABR_PENDING:
+        case ABR_STOP:
+            return;
+        }
+    run_abr = true;
+    
+    /* End new request for segment */
+    if (0 == conn_h->ch_n_reqs)
+    {
+        // printf("all requests completed, closing connection");
+        LSQ_INFO("all requests completed, closing connection");
+        lsquic_conn_close(conn_h->conn);
+    }
+    else
+    {
+        LSQ_INFO("%u active stream, %u request remain, creating %u new stream",
+            conn_h->ch_n_cc_streams,
+            conn_h->ch_n_reqs - conn_h->ch_n_cc_streams,
+            MIN((conn_h->ch_n_reqs - conn_h->ch_n_cc_streams),
+                (client_ctx->hcc_cc_reqs_per_conn - conn_h->ch_n_cc_streams)));
+        /* CHECK ON TRANSMISSION AND RE-TRANSMISSION QUEUES */
+        printf("SRS: %u, SS: %u\n", client_ctx->hcc_still_ret_segments, client_ctx->hcc_still_segments);
+        if (client_ctx->hcc_cc_reqs_per_conn > 1) {
+            if (!client_ctx->hcc_open_streams) {
+                printf("\n==> Transmission Time <==\n");
+                create_streams(client_ctx, conn_h); // Open the transmission stream
+            }
+        } else {
+            if (client_ctx->hcc_still_segments) {           // Check if next stream is re-transmission and - if so - whether it is possible or not
+                printf("Transmission\n");
+                create_streams(client_ctx, conn_h); // Open the transmission stream
+            } else if (client_ctx->hcc_still_ret_segments) {
+                printf("\nRe-transmission path update\n");
+                struct path_elem *temp_pe;
+                if (client_ctx->hcc_ret_pe)
+                    temp_pe = TAILQ_NEXT(client_ctx->hcc_ret_pe, next_pe);
+                else
+                    temp_pe = TAILQ_FIRST(&client_ctx->hcc_ret_path_elems);
+                if (!temp_pe) { // If it's the last element of the queue
+                    printf("\nGoing through ABR again\n");
+                    goto again; // Re-execute ABR strategy
+                }
+                client_ctx->hcc_ret_pe = temp_pe;
+                double available_time = dofp_session_available_time(client_ctx->hcc_sess, client_ctx->hcc_ret_pe->seg_ind);
+                while(available_time < (s_ladder->dl_bitrates[client_ctx->hcc_ret_pe->seg_q] * seg_length / dofp_session_throughput(client_ctx->hcc_sess))){
+                    --client_ctx->hcc_still_ret_segments;
+                    if ((temp_pe = TAILQ_NEXT(client_ctx->hcc_ret_pe, next_pe))){
+                        client_ctx->hcc_ret_pe = temp_pe;
+                        available_time = dofp_session_available_time(client_ctx->hcc_sess, client_ctx->hcc_ret_pe->seg_ind + 1);
+                    } else {
+                        printf("\nGoing through ABR again\n");
+                        goto again;
+                    }
+                }
+                create_streams(client_ctx, conn_h); // Open the re-transmission stream
+            }
+        }
+        /* END CHECK */
+    }
+}
+
+
+static void
+dofp_abr_complete (struct http_client_ctx *client_ctx, struct abr_job *job)
+{
+    lsquic_conn_ctx_t *conn_h = NULL;
+    struct dofp_decision dec;
+
+    if (client_ctx->hcc_abr_job == job)
+    {
+        conn_h = client_ctx->hcc_abr_conn;
+        client_ctx->hcc_abr_job = NULL;
+        client_ctx->hcc_abr_conn = NULL;
+    }
+
+    if (!conn_h)
+    {
+        LSQ_INFO("connection closed while the ABR decision was pending");
+        dofp_job_destroy(job);
+        return;
+    }
+
+    if (DOFP_DONE != dofp_session_complete(client_ctx->hcc_sess, job, &dec))
+    {
+        printf("ERROR: OPTIMIZATION ALGORITHM RETURNED -1!\n");
+        return;
+    }
+    printf("Optimization model running time: %.3Lf\n", (long double) dec.dd_solve_time / 1000000);
+    http_client_queue_decision(client_ctx, conn_h, &dec);
+    http_client_continue(client_ctx, conn_h, false);
+}
+
+
+/* The ABR worker pipe is readable: apply the decisions */
+static void
+dofp_abr_on_done (evutil_socket_t fd, short what, void *arg)
+{
+    struct http_client_ctx *const client_ctx = arg;
+    struct abr_job *aj;
+
+    while ((aj = abr_worker_next_done(client_ctx->hcc_abr_worker)))
+        dofp_abr_complete(client_ctx, aj);
+    prog_process_conns(client_ctx->prog);
+}
+
+
+
+/* The QoE metrics are updated every time a segment is received */
+static void
+dofp_on_qoe (struct dofp_session *sess, const struct dofp_qoe *qoe)
+{
+    printf("QoE: avg. bitrate %.3f kbps (std %.3f), avg. quality %.3f, "
+        "%u switches, instability %.3f, start-up %.3f s, %u stalls (%.3f s)\n",
+        qoe->dq_avg_bitrate, qoe->dq_std_bitrate, qoe->dq_avg_quality,
+        qoe->dq_switches, qoe->dq_instability, qoe->dq_startup,
+        qoe->dq_n_stalls, qoe->dq_stall_dur);
+}
+
+
+static void
+print_chosen_qualities (const struct dofp_session *sess)
+{
+    printf("Chosen segments qualities [");
+    for (unsigned i = 1; i < dofp_session_seg_ind(sess); ++i)
+        printf(" %i ", dofp_session_seg_quality(sess, i));
+    printf("]\n");
+}
+
+
+/* Start the player once the ladder is known: from the ladder file at
+ * startup, or from the manifest.
+ */
+static void
+http_client_start_session (struct http_client_ctx *client_ctx)
+{
+    struct path_elem *pe;
+    char path[0x400];
+    unsigned q;
+
+    for (q = 0; q < s_ladder->dl_n_rep; ++q)
+        if (dofp_ladder_seg_path(s_ladder, q, 1, path, sizeof(path)) < 0)
+        {
+            LSQ_ERROR("representation %u has no valid media path", q);
+            exit(EXIT_FAILURE);
+        }
+    seg_length = s_ladder->dl_seg_len;
+    client_ctx->hcc_settings->dss_ladder = s_ladder;
+
+    client_ctx->hcc_sess = dofp_session_new(client_ctx->hcc_settings,
+                                        client_ctx, client_ctx->hcc_stall_t);
+    if (!client_ctx->hcc_sess)
+    {
+        LSQ_ERROR("could not create DoFP+ session");
+        exit(EXIT_FAILURE);
+    }
+    /* Every record is flushed: a segment plays for seconds */
+    client_ctx->hcc_p1203 = dofp_p1203_open(JSON_FILENAME, 1);
+    if (client_ctx->hcc_p1203)
+        dofp_session_set_p1203(client_ctx->hcc_sess, client_ctx->hcc_p1203);
+    else
+        printf("Error opening JSON file %s!\n", JSON_FILENAME);
+    if (!s_discard_response)
+    {
+        client_ctx->hcc_pool = dofp_pool_new(s_ladder, 2);
+        if (!client_ctx->hcc_pool)
+            exit(EXIT_FAILURE);
+    }
+
+    if (TAILQ_EMPTY(&client_ctx->hcc_path_elems))
+    {
+        /* Start with the first segment at the lowest quality */
+        pe = calloc(1, sizeof(*pe));
+        if (!pe)
+        {
+            LSQ_ERROR("cannot allocate path element");
+            exit(EXIT_FAILURE);
         }
-        else
+        pe->seg_ind = 1;
+        TAILQ_INSERT_TAIL(&client_ctx->hcc_path_elems, pe, next_pe);
+    }
+}
+
+
+/* A document of the manifest is complete: fetch the next one or start the
+ * player.
+ */
+static void
+manifest_on_close (lsquic_stream_ctx_t *st_h, lsquic_conn_ctx_t *conn_h)
+{
+    struct http_client_ctx *const client_ctx = st_h->client_ctx;
+    const char *next;
+
+    switch (dofp_manifest_end(client_ctx->hcc_manifest, &next))
+    {
+    case 1:
+        client_ctx->hcc_manifest_path = next;
+        lsquic_conn_make_stream(conn_h->conn);
+        return;
+    case 0:
+        break;
+    default:
+        LSQ_ERROR("cannot build the ladder from %s", st_h->path);
+        exit(EXIT_FAILURE);
+    }
+
+    s_ladder = dofp_manifest_ladder(client_ctx->hcc_manifest);
+    dofp_manifest_destroy(client_ctx->hcc_manifest);
+    client_ctx->hcc_manifest = NULL;
+    LSQ_NOTICE("ladder: %u representations, %u segments of %u s",
+            s_ladder->dl_n_rep, s_ladder->dl_n_seg, s_ladder->dl_seg_len);
+    http_client_start_session(client_ctx);
+    create_streams(client_ctx, conn_h);
+}
+
+
+/* The received media is written out once, then buffered if `keep' is set */
+static void
+http_client_keep_segment (struct http_client_ctx *client_ctx,
+                                        lsquic_stream_ctx_t *st_h, bool keep)
+{
+    struct dofp_slab *const slab = st_h->sh_slab;
+
+    if (!slab)
+        return;
+    st_h->sh_slab = NULL;
+    fwrite(slab->dsl_buf, 1, slab->dsl_len,
+                            st_h->download_fh ? st_h->download_fh : stdout);
+    if (!keep)
+        dofp_pool_put(client_ctx->hcc_pool, slab);
+    else if (0 != dofp_pool_commit(client_ctx->hcc_pool, slab))
+    {
+        LSQ_ERROR("cannot buffer segment %u", st_h->seg_ind);
+        exit(1);
+    }
+}
+
+
+/* The pushed segment is received.  Returns true if the segment is to be
+ * delivered now; otherwise, it is kept or freed.
+ */
+static bool
+push_on_close (lsquic_stream_ctx_t *st_h)
+{
+    struct http_client_ctx *const client_ctx = st_h->client_ctx;
+
+    st_h->stream = NULL;
+    st_h->sh_closed = lsquic_time_now();
+    if (st_h->sh_flags & TAKEN)
+    {
+        if (!(st_h->sh_flags & READ_ALL))
         {
-            LSQ_ERROR("could not read: %s", strerror(errno));
-            exit(2);
+            /* Given up: the ABR picks the segment again */
+            st_h->isTerminated = true;
+            return true;
         }
+        if (st_h->sh_due <= st_h->sh_closed)
+            return true;
+        push_deliver_later(client_ctx, st_h);
     }
-    while (client_ctx->prog->prog_settings.es_rw_once
-            && nreads++ < 3 /* Emulate just a few reads */);
+    else if (st_h->sh_flags & DROPPED)
+        push_free(client_ctx, st_h);
+    else if (!(st_h->sh_flags & READ_ALL))
+    {
+        TAILQ_REMOVE(&client_ctx->hcc_pushed, st_h, sh_next_push);
+        push_free(client_ctx, st_h);
+    }
+    return false;
 }
 
 
 static void
 http_client_on_close (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
 {
-    const int pushed = lsquic_stream_is_pushed(stream);
-    if (pushed)
+    if (lsquic_stream_is_pushed(stream))
     {
-        assert(NULL == st_h);
-        return;
+        /* Refused, or kept until the ABR picks it */
+        if (!st_h || !push_on_close(st_h))
+            return;
     }
+    else
+        st_h->sh_closed = lsquic_time_now();
     
-    struct http_client_ctx *const client_ctx = st_h->client_ctx;
-    lsquic_conn_t *const conn = lsquic_stream_conn(stream);
-    lsquic_conn_ctx_t *const conn_h = lsquic_conn_get_ctx(conn);
+    if (st_h->sh_flags & MANIFEST)
+    {
+        manifest_on_close(st_h, lsquic_conn_get_ctx(lsquic_stream_conn(stream)));
+        free(st_h);
+        return;
+    }
+    http_client_stream_done(st_h->client_ctx,
+                    lsquic_conn_get_ctx(lsquic_stream_conn(stream)), st_h);
+}
+
+
+/* The segment of a stream, or a pushed segment, is received or given up */
+static void
+http_client_stream_done (struct http_client_ctx *client_ctx,
+                    lsquic_conn_ctx_t *conn_h, lsquic_stream_ctx_t *st_h)
+{
     --conn_h->ch_n_reqs;
     --conn_h->ch_n_cc_streams;
     
     printf("SRS: %i, SS: %i", client_ctx->hcc_still_ret_segments, client_ctx->hcc_still_segments);
     
     if (client_ctx->hcc_still_ret_segments || client_ctx->hcc_still_segments) {
-    
-        printf("Read bytes: %.0ld, time_now(): %.0ld, st_h->sh_created: %.0ld, download time: %.0lds\n", st_h->sh_nread, lsquic_time_now(), st_h->sh_created, (lsquic_time_now() - st_h->sh_created) / 1000000);
-        
-        long double new_throughput = (long double) st_h->sh_nread * 8 / ((long double) 1000 * (lsquic_time_now() - st_h->sh_created) / 1000000); // [kbps]
-        /* Smoothed throughput computation */
-
-        if (t_stats.s_throughput == 0)
-            t_stats.s_throughput = new_throughput;
+        struct dofp_session *const sess = client_ctx->hcc_sess;
+        const lsquic_time_t now = lsquic_time_now();
+        struct lsquic_conn_info info;
+
+        printf("Read bytes: %.0ld, time_now(): %.0ld, st_h->sh_created: %.0ld, download time: %.0lds\n", st_h->sh_nread, now, st_h->sh_created, (st_h->sh_closed - st_h->sh_created) / 1000000);
+
+        /* The delivery rate of the connection leaves out the request RTT,
+         * the delay before the request and the other streams.  It is only
+         * known once the peer has sent for one RTT.
+         */
+        if (!(client_ctx->hcc_flags & HCC_WALL_CLOCK_TPUT)
+                && 0 == lsquic_conn_get_info(conn_h->conn, &info)
+                && info.lci_recv_rate > 0)
+        {
+            LSQ_INFO("delivery rate: %"PRIu64" kbps (max %"PRIu64" kbps), "
+                "srtt: %"PRIu64" us", info.lci_recv_rate * 8 / 1000,
+                info.lci_recv_rate_max * 8 / 1000, info.lci_srtt);
+            dofp_session_on_rate(sess, (long double) info.lci_recv_rate * 8
+                                                                    / 1000);
+        }
         else
-            t_stats.s_throughput = .875 * t_stats.s_throughput + .125 * new_throughput; // (1-1/8) and 1/8 as described in the WISH paper
-        /* Throughput computation */
-		
-		// Minh - Fix 0kbps throughput - S - reason: sh_nread = 0.
-		#if 0          
-        t_stats.throughput = new_throughput;
-        #else
-        t_stats.throughput = (new_throughput == 0) ? t_stats.s_throughput : new_throughput;
-        #endif
-        // Minh - Fix 0kbps throughput - E
-
-        // Estimated Throughput is the MIN(Smoothed and Normal)
-        printf("==> Throughput: %.3Lf kbps\n", t_stats.throughput);
-        printf("==> Smoothed throughput: %Lf kbps\n", t_stats.s_throughput);
-        //t_stats.e_temp_throughput = MIN(t_stats.throughput, t_stats.s_throughput);
-        t_stats.e_temp_throughput = 0.9 * t_stats.throughput;
-        t_stats.tot_throughput += t_stats.e_temp_throughput; // Useful for computing the total throughput in multistreams scenarios
-        printf("==> Estimated throughput: %Lf kbps\n", t_stats.e_temp_throughput);
-        printf("==> Total throughput: %Lf kbps\n", t_stats.tot_throughput);
+            dofp_session_on_download(sess, st_h->sh_nread,
+                                        st_h->sh_closed - st_h->sh_created);
+        printf("==> Total throughput: %Lf kbps\n", dofp_session_throughput(sess));
         LSQ_INFO("%s called", __func__);
-        // struct http_client_ctx *const client_ctx = st_h->client_ctx;
-        // lsquic_conn_t *const conn = lsquic_stream_conn(stream);
-        // lsquic_conn_ctx_t *const conn_h = lsquic_conn_get_ctx(conn);
-        // --conn_h->ch_n_reqs;
-        // --conn_h->ch_n_cc_streams;
-        double download_time = (double) (lsquic_time_now() - st_h->sh_created) / 1000000;
-        printf("Stream init: %.3f; Stream close: %.3f; Download time: %.3f.\n", (double) st_h->sh_created / 1000000, (double) lsquic_time_now() / 1000000, download_time);
+        double download_time = (double) (st_h->sh_closed - st_h->sh_created) / 1000000;
+        printf("Stream init: %.3f; Stream close: %.3f; Download time: %.3f.\n", (double) st_h->sh_created / 1000000, (double) st_h->sh_closed / 1000000, download_time);
         if (!st_h->isRet){
             if (!st_h->isTerminated) {
-                seg_chosen_q[++qualities_ind] = st_h->seg_q;
-                t_stats.e_throughput[qualities_ind] = t_stats.e_temp_throughput;
-                t_stats.comp_throughput[qualities_ind] = t_stats.throughput;
-                // SARA parameters computation
-                if (st_h->client_ctx->chosen_abr == 6) {
-                    s_stats.weights[seg_ind - 1] = s_stats.W[seg_chosen_q[qualities_ind]][seg_ind - 1];
-                    s_stats.down_rate[seg_ind - 1] = t_stats.e_throughput[qualities_ind];
-                    long double num = 0.0;
-                    long double den = 0.0;
-                    unsigned start_ind = 0;
-                    if (seg_ind > AVG_COUNT)
-                        start_ind = seg_ind - AVG_COUNT;
-                    for (size_t i = start_ind; i < seg_ind; i++) {
-                        printf("i: %zu, count: %u, seg_ind: %u\n", i, AVG_COUNT, seg_ind);
-                        num += s_stats.weights[i];
-                        den += s_stats.weights[i]*1.0 / s_stats.down_rate[i];
-                        printf("i: %zu -> s_stats.weights: %.3Lf, s_stats.down_rate: %.3Lf\n", i, s_stats.weights[i], s_stats.down_rate[i]);
-                    }           
-                    s_stats.H = (double) num / den;
-                }
                 printf("Transmitted segment from path: %s\n", st_h->path);
                 /* Buffer update */
-                update_buff(true); // [true] is "Segment Received"
-                t_stats.b_level[qualities_ind] = buffer_level;
-                printf("Buffer size: %.3f sec\n", buffer_level);
-                printf("Segment reproduced: %u\n", rep_seg_ind);
-                printf("Time left for reproduced segment: %.3f sec\n", rep_seg_time);
+                const bool more = dofp_session_segment_received(sess, st_h->seg_q, now);
+                http_client_keep_segment(client_ctx, st_h, true);
+                http_client_arm_playout(client_ctx);
+                printf("Buffer size: %.3f sec\n", dofp_session_buffer_level(sess));
+                printf("Segment reproduced: %u\n", dofp_session_rep_seg_ind(sess));
                 --client_ctx->hcc_still_segments;
                 --client_ctx->hcc_open_streams;
                 /* QUALITY PRINT */
-                printf("Chosen segments qualities [");
-                for (unsigned i = 0; i < sizeof(seg_chosen_q) / sizeof(seg_chosen_q[0]); ++i){
-                    printf(" %i ", seg_chosen_q[i]);
-                }
-                printf("]\n");
-                /* Update seg_paths */
-                ++seg_ind;
-                // Check seg_chosen_q size
-                // if(seg_ind > (sizeof(seg_chosen_q)/sizeof(seg_chosen_q[0]))){ // If quality array is full and needs to be expanded
-                    // printf("Try to realloc seg_chosen_q!\n");
-                    // int *seg_chosen_p = seg_chosen_q;
-                    // seg_chosen_p = realloc(seg_chosen_p, 2 * seg_ind * sizeof(int)); // Reallocate memory
-                // }
-                if (seg_ind <= N_MAX_SEG) {
-                    for (size_t i = 0; i < N_REP; i++){
-                        // Update paths
-                        int up_len = strlen(FP_PATH) + 6 + strlen(SP_PATH) + strlen(EXT) + 6; // 6 is the max. number of bitrate ciphers, 6 is the max. segment index (1,..,999999)"
-                        char* temp_pp = (char*)malloc((up_len+1)*sizeof(char));
-                        snprintf(temp_pp, (up_len+1)*sizeof(char), "%s%d%s%d%s", FP_PATH, seg_bitrates[i], SP_PATH, seg_ind, EXT);
-                        printf("Updated path %d: %s\n", (int) i, temp_pp);
-                        seg_paths[i] = temp_pp;
-                        temp_pp = NULL;
-                    }
-                } else {
-                    update_buff(false);
-                    for (int k = 0; k < 10; k++){
-                        printf("\a\n");
-                        sleep(0.5);
-                    }
+                print_chosen_qualities(sess);
+                if (!more) {
                     printf("===! END OF SEGMENTS !===\n");
                     printf("!! Closing connection !!\n");
                     client_ctx->hcc_total_n_reqs = 0;
@@ -1576,46 +2115,34 @@ http_client_on_close (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
                     return;
                 }
             } else {
+                http_client_keep_segment(client_ctx, st_h, false);
                 --client_ctx->hcc_still_segments;
                 --client_ctx->hcc_open_streams;
             }
         } else {
-            /* Buffer update */
-            update_buff(false); // [false] is "Normal Update" (the re-transmission of a segment doesn't add seconds to the buffer time)
-            printf("Buffer size: %.3f sec\n", buffer_level);
-            printf("Segment reproduced: %u\n", rep_seg_ind);
-            printf("Time left for reproduced segment: %.3f sec\n", rep_seg_time);
             //--client_ctx->hcc_open_ret_streams;
             --client_ctx->hcc_open_streams;
             --client_ctx->hcc_still_ret_segments;
-            w_stats.re_count++;
-            w_stats.re_data += st_h->sh_nread / 1000;
-            if (!st_h->isTerminated) {
-                printf("Re-Transmitted segment from path: %s\n", st_h->path);
-                if(isRetSegAcceptable(st_h)){
-                    printf("Segment acceptable!\n");
-                    printf("Quality changed from q = %i", seg_chosen_q[st_h->seg_ind - 1]);
-                    seg_chosen_q[st_h->seg_ind - 1] = (int) st_h->seg_q;
-                    printf(" to q = %i\n", seg_chosen_q[st_h->seg_ind - 1]);
-                } else { // Segment not acceptable
-                    w_stats.re_unused_count++;
-                    w_stats.re_unused_data += st_h->sh_nread / 1000;
-                    printf("Segment NOT acceptable!\n");
-                }
-            } else { // Stream terminated
-                w_stats.re_unused_count++;
-                w_stats.re_unused_data += st_h->sh_nread / 1000;
-            }
+            const int old_q = dofp_session_seg_quality(sess, st_h->seg_ind);
+            /* The re-transmission of a segment doesn't add seconds to the buffer time */
+            const bool accepted = dofp_session_retrans_received(sess,
+                st_h->seg_ind, st_h->seg_q, st_h->sh_nread, st_h->isTerminated, now);
+            /* An accepted upgrade replaces the buffered segment in place */
+            http_client_keep_segment(client_ctx, st_h, accepted);
+            http_client_arm_playout(client_ctx);
+            if (accepted)
+                printf("Re-Transmitted segment from path: %s\nSegment acceptable!\nQuality changed from q = %i to q = %u\n", st_h->path, old_q, st_h->seg_q);
+            else if (!st_h->isTerminated)
+                printf("Re-Transmitted segment from path: %s\nSegment NOT acceptable!\n", st_h->path);
+            printf("Buffer size: %.3f sec\n", dofp_session_buffer_level(sess));
+            printf("Segment reproduced: %u\n", dofp_session_rep_seg_ind(sess));
             /* QUALITY PRINT */
-            printf("Chosen segments qualities [");
-            for (unsigned i = 0; i < sizeof(seg_chosen_q) / sizeof(seg_chosen_q[0]); ++i){
-                printf(" %i ", seg_chosen_q[i]);
-            }
-
+            print_chosen_qualities(sess);
         }
         
     } else {
-        update_buff(false);
+        http_client_keep_segment(client_ctx, st_h, false);
+        dofp_session_update(client_ctx->hcc_sess, lsquic_time_now());
         printf("No segment has been trasmitted through this stream!!\n");
         printf("Closing connection!!\n");
         client_ctx->hcc_total_n_reqs = 0;
@@ -1623,653 +2150,8 @@ http_client_on_close (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
         return;
     }
     
-    abr:
-    /* ABR Algorithm */
-    if (client_ctx->hcc_still_ret_segments == 0 && client_ctx->hcc_still_segments == 0) { // if new segment and re-transmitted segments are received
-        printf("Total throughput: %.3Lf kbps\n", t_stats.tot_throughput);
-        if (rep_seg_ind < seg_ind) { // If there is still playout of reproduction
-            if (buffer_level >= min_init_bs && playout){
-                unsigned next_quality = 0;
-                if (client_ctx->chosen_abr < 4) {
-                    printf("ABR starting... \n"); 
-                    
-                    unsigned start_seg_ind = rep_seg_ind;
-                    // if (rep_seg_time <= available_time_off)
-                        // start_seg_ind++; // Start from the second segment after the one being played out (the deadline is too short for the first one after it to be re-downloaded)
-                    
-                    if (buffer_level < 0.5 * buffer_size && seg_ind < N_MAX_SEG)
-                        start_seg_ind = seg_ind - 1; // Only download the next segment
-                    
-                    unsigned group_n = seg_ind - start_seg_ind;  // Number of segments in the group to be checked for [re-]transmission -> |T|
-                    if (seg_ind > N_MAX_SEG)
-                        group_n--;
-                    
-                    unsigned min_q[group_n];
-                    for (size_t i = 0; i < group_n; i++){
-                        min_q[i] = seg_chosen_q[i + start_seg_ind];
-                        if (i < group_n - 1)
-                            printf("min_q[%zu]: %d \n", i, min_q[i]);
-                    }
-                    if (seg_ind > N_MAX_SEG)
-                        min_q[group_n - 1] = seg_chosen_q[start_seg_ind + group_n - 1];
-                    else
-                        min_q[group_n - 1] = 0;
-                    printf("min_q[%u]: %d \n", group_n - 1, min_q[group_n - 1]);
-                    
-                    unsigned n_par = group_n; // Throughputs 
-                    for (size_t i = 0; i < group_n; i++){
-                        n_par += N_REP - min_q[i];
-                    }
-                    if (client_ctx->chosen_abr != 1)
-                        n_par++; // j*
-                    
-                    double available_times[group_n];
-                    
-                    if (buffer_level < 0.5 * buffer_size){
-                        available_times[0] = seg_length * 0.9;
-                        printf("available_times[%zu]: %.3f \n", 0, available_times[0]);
-                    }
-                    else {
-                        double buffer_threshold = (double) min_init_bs;
-                        if (buffer_level >= 0.75 * buffer_size)
-                            buffer_threshold = 0.5 * buffer_size;
-                        for (size_t i = 0; i < group_n; i++){
-                            if (i < group_n - 1)
-                                available_times[i] = (rep_seg_time + (i + start_seg_ind - rep_seg_ind) * seg_length) * 0.9;
-                                // available_times[i] = (rep_seg_time + (i + start_seg_ind - rep_seg_ind) * seg_length);
-                            else // If last segment (next segment to be downloaded)
-                                // available_times[i] = (rep_seg_time + (i + start_seg_ind - rep_seg_ind) * seg_length) * 0.9;
-                                if (seg_ind < N_MAX_SEG)
-                                    available_times[i] = seg_length * 0.9; // EPIQ paper: rep_seg_time - buffer_threshold + (i + start_seg_ind - rep_seg_ind) * seg_length;
-                                else
-                                    available_times[i] = seg_length * 0.9;; // EPIQ paper: (rep_seg_time + (i + start_seg_ind - rep_seg_ind) * seg_length) * 0.9;
-                            printf("available_times[%zu]: %.3f \n", i, available_times[i]);
-                        }
-                    }
-                    
-                    
-                    double sol[n_par];
-                    
-                    int error;
-                    
-                    lsquic_time_t init_opt_model = lsquic_time_now();
-                    
-                    if (client_ctx->hcc_cc_reqs_per_conn > 1)
-                        isMultiStream = true;
-                    
-                    // ABR SELECTION
-                    if (client_ctx->chosen_abr == 0)
-                        error = getMaxQINormCoefficients(N_REP, group_n, n_par, seg_length, (double) t_stats.tot_throughput, seg_bitrates, available_times, min_q, sol, isMultiStream, alpha, beta);
-                    else if (client_ctx->chosen_abr == 1)
-                        error = getMaxJCoefficients(N_REP, group_n, n_par, seg_length, (double) t_stats.tot_throughput, seg_bitrates, available_times, min_q, sol);
-                    else if (client_ctx->chosen_abr == 2)
-                        error = getMaxMinJCoefficients(N_REP, group_n, n_par, seg_length, (double) t_stats.tot_throughput, seg_bitrates, available_times, min_q, sol, isMultiStream);
-                    else if (client_ctx->chosen_abr == 3)
-                        error = getMaxMinJNormCoefficients(N_REP, group_n, n_par, seg_length, (double) t_stats.tot_throughput, seg_bitrates, available_times, min_q, sol, isMultiStream, alpha, beta, buffer_level, buffer_size);
-                    else {
-                        printf("ERROR: CHOSEN_ABR HAS NO VALID VALUE!\n");
-                        return;
-                    }
-                    
-                    printf("Optimization model running time: %.3Lf\n", (long double) (lsquic_time_now() - init_opt_model) / 1000000);
-                    
-                    if (error == -1){
-                        printf("ERROR: OPTIMIZATION ALGORITHM RETURNED -1!\n");
-                        return;
-                    }
-                    
-                    unsigned chosen_q[group_n];
-                    for (size_t i = 0; i < group_n; i++)
-                        chosen_q[i] = min_q[i];
-                    
-                    double chosen_T[group_n];
-                    
-                    printf("\nSOLUTIONS:\n");
-                    unsigned temp_ind = 0;
-                    for (size_t i = 0; i < group_n; i++){
-                        for (size_t j = min_q[i]; j < N_REP; j++){
-                            if ((unsigned) (sol[temp_ind]) == 1)
-                                chosen_q[i] = (int) j;
-                            temp_ind++;
-                        }
-                        if (client_ctx->chosen_abr != 1)
-                            chosen_T[i] = sol[n_par - group_n - 1 + i];
-                        else
-                            chosen_T[i] = sol[n_par - group_n + i];
-                    //printf("\n\n");
-                    }
-                    
-                    for (size_t i = 0; i < group_n; i++)
-                        printf("Segment %lu: Quality -> %i; Throughput -> %.0f\n", i + start_seg_ind + 1, chosen_q[i], chosen_T[i]);
-                    // Print J* [and Q*]
-                    if (client_ctx->chosen_abr != 1)
-                        printf("J* -> %.0f\n", sol[n_par - 1]);
-                    
-                    if (seg_ind <= N_MAX_SEG) { // NEW SEGMENTS TO DOWNLOAD
-                        // Only send the next segment, don't retransmit
-                        ++client_ctx->hcc_still_segments;
-                        struct path_elem *pe;
-                        pe = calloc(1, sizeof(*pe));
-                        next_quality = chosen_q[sizeof(chosen_q)/sizeof(chosen_q[0]) - 1]; // Gather segment chosen quality
-                        pe->path = seg_paths[next_quality]; /* Path of the next requested segment */
-                        pe->seg_ind = seg_ind;
-                        pe->seg_q = next_quality;
-                        printf("Downloading seg. %d, rep. %d, path: '%s'\n", seg_ind, next_quality, pe->path);
-                        TAILQ_INSERT_TAIL(&client_ctx->hcc_path_elems, pe, next_pe);
-                        conn_h->ch_n_reqs = MIN(client_ctx->hcc_total_n_reqs,
-                                                                client_ctx->hcc_reqs_per_conn);
-                        client_ctx->hcc_total_n_reqs -= conn_h->ch_n_reqs;
-                    }
-                    
-                    /* Quality check for the chosen re-trans. segments */
-                    // if (group_n > 1) {
-                        // for (unsigned i = group_n - 2; i > 0; i--) {
-                            // if (chosen_q[i] != min_q[i]) {
-                                // if (chosen_q[i] > chosen_q[i + 1]) {
-                                    // chosen_q[i] = chosen_q[i + 1];
-                                // }
-                            // }
-                        // }
-                    // }
-                    
-                    /* Output of the quality check */
-                    // for (size_t i = 0; i < group_n; i++)
-                        // printf("Segment %lu: Quality -> %i; Throughput -> %.0f\n", i + start_seg_ind + 1, chosen_q[i], chosen_T[i]);
-                    
-                    // Segments re-transmission for the buffered segments
-                    
-                    for (unsigned i = 0; i < group_n - 1; ++i) {
-                        if (chosen_q[i] != min_q[i]) { // If the chosen quality is higher than the buffered one (&& at least equal to the subsequent one)
-                            //Retransmit
-                            ++client_ctx->hcc_still_ret_segments;
-                            /* Create path for to-be-re-transmitted segment */
-                            int up_len = strlen(FP_PATH) + 4 + strlen(SP_PATH) + strlen(EXT) + 3; // ciphers as index (1,..,999)"
-                            char* temp_pp = (char*)malloc((up_len+1)*sizeof(char));
-                            snprintf(temp_pp, (up_len+1)*sizeof(char), "%s%d%s%d%s", FP_PATH, seg_bitrates[chosen_q[i]], SP_PATH, i + start_seg_ind + 1, EXT);
-                            /* Insert path element in TAILQ */
-                            struct path_elem *pe;
-                            pe = calloc(1, sizeof(*pe));
-                            pe->path = temp_pp; /* Path of the next requested segment */
-                            pe->seg_ind = i + start_seg_ind + 1;
-                            pe->seg_q = chosen_q[i];
-                            printf("Added to the queue: segment index %u, representation %u, segment path '%s'\n", i + start_seg_ind + 1, chosen_q[i], pe->path);
-                            TAILQ_INSERT_TAIL(&client_ctx->hcc_ret_path_elems, pe, next_pe);
-                            conn_h->ch_n_reqs += MIN(client_ctx->hcc_total_n_reqs,
-                                                            client_ctx->hcc_reqs_per_conn);
-                            client_ctx->hcc_total_n_reqs -= conn_h->ch_n_reqs;
-                        }
-                    }
-                } else if (client_ctx->chosen_abr == 4) { // MaxR select
-                    unsigned chosen_q = 0;
-                    
-                    for (ssize_t i = N_REP - 1; i >= 0; i--) {
-                        if ((1 - 0.1) * (double) t_stats.tot_throughput > seg_bitrates[i]) { // 0.1 parameter
-                            chosen_q = i;
-                            break;
-                        }
-                    }
-                    
-                    // If we don't have space in the buffer, wait sometime before sending request for new segment
-                    // if (buffer_level > buffer_size){
-                        // printf("==> FULL BUFFER! Sleep for %d s\n", (unsigned int) ceil((double) seg_length - (buffer_size - buffer_level)));
-                        // sleep((unsigned int) seg_length); // Sleep for x seconds until the buffer level allow new segments download
-                    // }
-                    
-                    ++client_ctx->hcc_still_segments;
-                    struct path_elem *pe;
-                    pe = calloc(1, sizeof(*pe));
-                    next_quality = chosen_q; // Gather segment chosen quality
-                    pe->path = seg_paths[next_quality]; /* Path of the next requested segment */
-                    pe->seg_ind = seg_ind;
-                    pe->seg_q = next_quality;
-                    printf("Downloading seg. %d, rep. %d, path: '%s'\n", seg_ind, next_quality, pe->path);
-                    TAILQ_INSERT_TAIL(&client_ctx->hcc_path_elems, pe, next_pe);
-                    conn_h->ch_n_reqs = MIN(client_ctx->hcc_total_n_reqs,
-                                                            client_ctx->hcc_reqs_per_conn);
-                    client_ctx->hcc_total_n_reqs -= conn_h->ch_n_reqs;
-                } else if (client_ctx->chosen_abr == 5) { // BOLA - Minh
-                    
-                    b_m_stats.max_value = 0;
-                    b_m_stats.gma = 5.0/seg_length;
-                    b_m_stats.SM = DBL_MAX;
-
-                    // get segment size
-                    for (int i = 0; i < N_REP; i++) {
-                        b_m_stats.Sm[i] = s_stats.W[i][seg_ind];
-                    }
-                    #if 0
-                    b_m_stats.SM = b_m_stats.Sm[N_REP-1]; // get the min segment size    /* DANIELE - Why min segment size is N_REP - 1? */
-                    #else
-                    b_m_stats.SM = b_m_stats.Sm[0];
-                    #endif
-
-                    b_m_stats.V = ((buffer_size*1.0/seg_length)-1.0)/(b_m_stats.Vm[N_REP-1]+(b_m_stats.gma*seg_length));
-
-                    // equation 9
-                    for (int i = 0; i < N_REP; i++) {
-                        b_m_stats.value[i] = (b_m_stats.V*(b_m_stats.Vm[i] + b_m_stats.gma*seg_length) - (buffer_level*1.0)/seg_length)/b_m_stats.Sm[i];
-                    }
-
-                    //choose next_quality_idx that maximize vaWe still need a minimum buffer size 3p for the aWe still need a minimum buffer size 3p for the algorithm to work effectivelylgorithm to work effectivelylue
-                    for(int i = 0; i < N_REP; i++) {
-                        // skip representations whose objective < 0
-                        if (b_m_stats.value[i] < 0) {
-                            continue;
-                        }
-
-                        if (b_m_stats.value[i] > b_m_stats.max_value)
-                        {
-                            b_m_stats.max_value = b_m_stats.value[i];
-                            b_m_stats.m_star = i;
-                        }
-                    }
-                    // pause for max[p · (Q − Q_d_max + 1), 0]
-                    // If we don't have space in the buffer, wait sometime before sending request for new segment
-                    // if (buffer_level > buffer_size){
-                        // printf("==> FULL BUFFER! Sleep for %d s\n", (unsigned int) ceil((double) seg_length - (buffer_size - buffer_level)));
-                        // sleep((unsigned int) seg_length); // Sleep for x seconds until the buffer level allow new segments download
-                    // }
-                    
-                    ++client_ctx->hcc_still_segments;
-                    struct path_elem *pe;
-                    pe = calloc(1, sizeof(*pe));
-                    next_quality = b_m_stats.m_star; // Gather segment chosen quality
-                    pe->path = seg_paths[next_quality]; /* Path of the next requested segment */
-                    pe->seg_ind = seg_ind;
-                    pe->seg_q = next_quality;
-                    printf("Downloading seg. %d, rep. %d, path: '%s'\n", seg_ind, next_quality, pe->path);
-                    TAILQ_INSERT_TAIL(&client_ctx->hcc_path_elems, pe, next_pe);
-                    conn_h->ch_n_reqs = MIN(client_ctx->hcc_total_n_reqs,
-                                                            client_ctx->hcc_reqs_per_conn);
-                    client_ctx->hcc_total_n_reqs -= conn_h->ch_n_reqs;
-    // Minh - Add BOLA ABR - ADD - E                
-                } else if (client_ctx->chosen_abr == 6) { // SARA select
-                    
-                    unsigned l = 0;
-                    s_stats.delta = 0.0;
-
-                    // Minh - ADD - S
-                    printf("MInh: H = %.2f\t Buffer level = %.2f\n", s_stats.H, buffer_level);
-                    // Minh - ADD - E
-
-                    if (buffer_level > s_stats.I){
-                        if (s_stats.W[seg_chosen_q[qualities_ind]][seg_ind] / s_stats.H > buffer_level - s_stats.I) {
-
-                            printf("MInh: W/H = %.2Lf\n", s_stats.W[seg_chosen_q[qualities_ind]][seg_ind] / s_stats.H);
-                            
-                            for (int i = seg_chosen_q[qualities_ind]; i >= 0; i--) {
-                                if (s_stats.W[i][seg_ind] / s_stats.H <= buffer_level - s_stats.I) {
-                                    l = (unsigned) i;
-                                    break;
-                                }
-                            }
-                        } else if (buffer_level <= s_stats.B_alpha) { // Additive increase
-                            printf("Additive Increase!\n");
-                            // Minh - MOD - S
-                            unsigned qualities_ind_increased = seg_chosen_q[qualities_ind] + 1;
-                            
-                            if (s_stats.W[qualities_ind_increased][seg_ind] / s_stats.H < buffer_level - s_stats.I)
-                                l = qualities_ind_increased;
-                            // Minh - MOD - E
-                            else
-                                l = seg_chosen_q[qualities_ind];
-                        } else if (buffer_level <= s_stats.B_beta) { // Aggressive switching
-                            printf("Aggressive Switching!\n");
-                            l = seg_chosen_q[qualities_ind];
-                            for (int i = N_REP - 1; i >= (int) seg_chosen_q[qualities_ind]; i--) {
-                                if (s_stats.W[i][seg_ind] / s_stats.H <= buffer_level - s_stats.I) {
-                                    printf("W[][] -> %.1Lf, H -> %.3f, W/H -> %.3Lf, buff.lev - I -> %.3f\n", s_stats.W[i][seg_ind], s_stats.H, s_stats.W[i][seg_ind] / s_stats.H, buffer_level - s_stats.I);
-                                    l = (unsigned) i;
-                                    break;
-                                }
-                            }
-                        } else if (buffer_level > s_stats.B_beta) { // Delayed Download
-                            printf("Delayed Download!\n");
-                            // Minh - MOD - S
-                            l = seg_chosen_q[qualities_ind];
-                            // Minh - MOD - E
-                            for (int i = N_REP - 1; i >= (int) seg_chosen_q[qualities_ind]; i--) {
-                                if (s_stats.W[i][seg_ind] / s_stats.H <= buffer_level - s_stats.B_alpha) {
-                                    l = (unsigned) i;
-                                    break;
-                                }
-                            }
-                            s_stats.delta = buffer_level - s_stats.B_beta;
-                        } else
-                            l = seg_chosen_q[qualities_ind];
-                    }
-                    else {
-                        l = 0;
-                    }
-                    
-                    if (l >= N_REP)
-                        l = N_REP - 1;
-                    
-                    printf("l is %u\n", l);
-                    
-                    printf("MAIN Sleep for %d s\n", (unsigned int) s_stats.delta);
-                    sleep((unsigned int) s_stats.delta); // Sleep for x seconds until the buffer level allow new segments download
-                    
-                    ++client_ctx->hcc_still_segments;
-                    struct path_elem *pe;
-                    pe = calloc(1, sizeof(*pe));
-                    next_quality = l; // Gather segment chosen quality
-                    pe->path = seg_paths[next_quality]; /* Path of the next requested segment */
-                    pe->seg_ind = seg_ind;
-                    pe->seg_q = next_quality;
-                    printf("Downloading seg. %d, rep. %d, path: '%s'\n", seg_ind, next_quality, pe->path);
-                    TAILQ_INSERT_TAIL(&client_ctx->hcc_path_elems, pe, next_pe);
-                    conn_h->ch_n_reqs = MIN(client_ctx->hcc_total_n_reqs,
-                                                            client_ctx->hcc_reqs_per_conn);
-                    client_ctx->hcc_total_n_reqs -= conn_h->ch_n_reqs;
-                }
-                else if (client_ctx->chosen_abr == 7) { // BBA-0 ABR
-                    b_b_stats.rS = 0.2 * buffer_size;
-                    b_b_stats.cuS = 0.7 * buffer_size;
-                    b_b_stats.a = 1.0 * (seg_bitrates[N_REP-1] - seg_bitrates[0])/b_b_stats.cuS;
-                    b_b_stats.b = seg_bitrates[0] - b_b_stats.rS * b_b_stats.a;
-
-                    double       f_buff_value = b_b_stats.a * buffer_level + b_b_stats.b; // (kbps)  
-                    unsigned     m_selectedQualityIndex = 0;
-                    unsigned     m_quality_plus = 0;
-                    unsigned     m_quality_subtract = 0;
-
-                    // determine plus quality
-                    if (seg_chosen_q[qualities_ind] == N_REP-1)   // if the last selected segment's quality == the highest one
-                      m_quality_plus = N_REP-1;
-                    else
-                      m_quality_plus = seg_chosen_q[qualities_ind]+1;   // the plus quality is the next higher level
-                    
-                    // determine subtract quality
-                    if (seg_chosen_q[qualities_ind] == 0)
-                      m_quality_subtract = 0;
-                    else
-                      m_quality_subtract = seg_chosen_q[qualities_ind]-1; // the subtract quality is the previous lower level
-                    
-                    // determine the next segment's bittrate
-                    if (buffer_level <= b_b_stats.rS){
-                      m_selectedQualityIndex = 0;
-                    }
-                    else if (buffer_level >= (b_b_stats.rS + b_b_stats.cuS)){
-                      m_selectedQualityIndex = N_REP-1;
-                    }
-                    else if (f_buff_value >= seg_bitrates[m_quality_plus]){
-                      for (int i = N_REP-1; i >= 0; i--){
-                        if (seg_bitrates[i] < f_buff_value){
-                          m_selectedQualityIndex = i;
-                          break;
-                        }
-                      }
-                    }
-                    else if (f_buff_value <= seg_bitrates[m_quality_subtract]){
-                      for (int i = 0; i < N_REP; i++){
-                        if (seg_bitrates[i] > f_buff_value){
-                          m_selectedQualityIndex = i;
-                          break;
-                        }
-                      }
-                    }
-                    else {
-                      m_selectedQualityIndex = seg_chosen_q[qualities_ind];
-                    }
-
-                    printf("===================== BBA-0 ==================");
-                    printf(" Selected bitrate: %u\n", m_selectedQualityIndex);
-                    
-                    // printf("Sleep for %d s\n", (unsigned int) s_stats.delta);
-                    // sleep((unsigned int) s_stats.delta); // Sleep for x seconds until the buffer level allow new segments download
-                    
-                    ++client_ctx->hcc_still_segments;
-                    struct path_elem *pe;
-                    pe = calloc(1, sizeof(*pe));
-                    next_quality = m_selectedQualityIndex; // Gather segment chosen quality
-                    pe->path = seg_paths[next_quality]; /* Path of the next requested segment */
-                    pe->seg_ind = seg_ind;
-                    pe->seg_q = next_quality;
-                    printf("Downloading seg. %d, rep. %d, path: '%s'\n", seg_ind, next_quality, pe->path);
-                    TAILQ_INSERT_TAIL(&client_ctx->hcc_path_elems, pe, next_pe);
-                    conn_h->ch_n_reqs = MIN(client_ctx->hcc_total_n_reqs,
-                                                            client_ctx->hcc_reqs_per_conn);
-                    client_ctx->hcc_total_n_reqs -= conn_h->ch_n_reqs;
-                }
-                // H2BR RETRANSMISSION
-                if (client_ctx->h2br) {
-                    // Throughput T^e from PAPER
-                    // ...
-                    h_stats.T_e = t_stats.tot_throughput;
-                    // seg_ind is the next segment index
-                    // seg_bitrates[next_quality] is the chosen bitrate for next segment
-                    //if (buffer_level >= min_init_bs) has already been checked
-                    if (h_stats.T_e > seg_bitrates[next_quality]) {
-                        printf("===================== H2BR STRATEGY ==================");
-                        double buffer_estim = 0.0;
-                        int start_group = -1;
-                        int end_group = -1;
-                        bool retransmit = true;
-                        unsigned first_quality = 0U;
-                        unsigned second_quality = 0U;
-                        unsigned ret_segments = 0U;
-                        unsigned group_quality = 0U;
-                        unsigned quality_levels[seg_ind - rep_seg_ind - 1];
-                        printf("\nQuality level: [ ");
-                        for (unsigned i = 0; i < seg_ind - rep_seg_ind - 1; i++) {
-                            quality_levels[i] = seg_chosen_q[rep_seg_ind + i];
-                            printf("%i ", quality_levels[i]);
-                        }
-                        printf("]\n");
-                        // Check beginning quality value
-                        first_quality = seg_chosen_q[rep_seg_ind - 1];
-                        if (quality_levels[0] < seg_chosen_q[rep_seg_ind - 1]) {
-                            start_group = 0;
-                        }
-                        // } else if (quality_levels[0] == seg_chosen_q[rep_seg_ind - 1] && seg_chosen_q[rep_seg_ind - 1] + 1 < N_REP) {
-                            // first_quality = seg_chosen_q[rep_seg_ind - 1] + 1;
-                            // start_group = 0;
-                        // }
-                        
-                        unsigned start_search = 0U;
-                        find_groups:
-                        // Check groups and conditions
-                        for (unsigned i = start_search; i < seg_ind - rep_seg_ind - 2; i++) {
-                            printf("\n q[i]: %u - q[i+1]: %u", quality_levels[i], quality_levels[i+1]);
-                            if (start_group != -1 && end_group != -1)
-                                break;
-                            if (quality_levels[i] > quality_levels[i + 1]) {
-                                // if (start_group == 0) {
-                                    // end_group = i;
-                                    // second_quality = quality_levels[i] + 1;
-                                // } else if (start_group == -1) {
-                                    // start_group = i + 1;
-                                    // first_quality = quality_levels[i];
-                                // } else {
-                                    // end_group = i;
-                                    // second_quality = quality_levels[i] + 1;
-                                // }
-                                start_group = i + 1;
-                                first_quality = quality_levels[i];
-                            } else if (quality_levels[i] < quality_levels[i + 1]) {
-                                if (start_group != -1) {
-                                    end_group = i;
-                                    second_quality = quality_levels[i + 1];
-                                }
-                            }
-                        }
-                        // Check the group indexes
-                        if (start_group == -1) {
-                            retransmit = false;
-                        } else if (end_group == -1) {
-                            if (quality_levels[seg_ind - rep_seg_ind - 2] < next_quality) {
-                                end_group = seg_ind - rep_seg_ind - 2;
-                                second_quality = next_quality;
-                            } else
-                                retransmit = false;
-                        }
-                        // } else if (start_group > end_group) {
-                            // end_group = start_group;
-                        // }
-                        
-                        // Indexes are set
-                        if (retransmit) {
-                            // If the right extrem quality value is lower than the group quality we set it to the group quality + 1
-                            if (second_quality <= quality_levels[start_group]) {
-                                second_quality = quality_levels[start_group] + 1;
-                            }
-                            printf("\nStart group: %i, End group: %i, retransmit: %d, first quality: %u, second quality: %u!\n", start_group, end_group, retransmit, first_quality, second_quality);
-                            //printf("\nTEST SEG. FALT 1\n");
-                            unsigned n_segments = end_group - start_group + 1;
-                            // Try first with minimum of adjacent quality values
-                            group_quality = MIN(first_quality, second_quality);
-                            double available_times[n_segments];
-                            for (size_t i = 0; i < n_segments; i++)
-                                available_times[i] = (rep_seg_time + (i + start_group) * seg_length);
-                            //printf("\nTEST SEG. FALT 2\n");
-                            long double T_r[n_segments];
-                            bool break_loop = false;
-                            //printf("\nTEST SEG. FALT 3\n");
-                            for (unsigned k = MIN(first_quality, second_quality); k <= MAX(first_quality, second_quality); k++) {
-                                for (unsigned i = 0; i < n_segments; i++) {
-                                    long double split_throughput = h_stats.T_e/(i + 1 + 1); // i + 1 ret. segments + 1 next segment
-                                    buffer_estim = buffer_level + seg_length - (seg_length * seg_bitrates[next_quality] + (i + 1) * seg_length * seg_bitrates[k])/h_stats.T_e;
-                                    if (buffer_estim < min_init_bs){
-                                        break_loop = true;
-                                    }
-                                    for (unsigned j = 0; j < i + 1; j++) {
-                                        T_r[j] = seg_bitrates[k] * seg_length / available_times[j];
-                                        if (T_r[j] > split_throughput) { // Not enough throughput for retransmission
-                                            break_loop = true;
-                                        }
-                                    }
-                                    if (break_loop) {
-                                        break_loop = false;
-                                        break;
-                                    }
-                                    else {
-                                        if (ret_segments <= i + 1) { // If actual ret_segments is lower or equal than the new number of segments to be pushed at quality k, go for it
-                                            ret_segments = i + 1;
-                                            group_quality = k;
-                                            printf("Conditions satisfied for %u ret_segments -> buffer_estim: %.3f, split_throughput: %.3Lf", ret_segments, buffer_estim, split_throughput);
-                                            for (unsigned j = 0; j < i + 1; j++)
-                                                printf(", T_r[%u]: %.3Lf", j, T_r[j]);
-                                            printf("\n");
-                                        }
-                                    }
-                                }
-                            }
-                            
-                            // Check next group if ret_segments is 0 and other groups are available
-                            if (ret_segments == 0 && end_group < seg_ind - rep_seg_ind - 2) {
-                                first_quality = quality_levels[end_group];
-                                start_search = end_group + 1;
-                                start_group = -1;
-                                end_group = -1;
-                                goto find_groups;
-                            }
-                            //printf("\nTEST SEG. FALT 4\n");
-                            
-                            if (ret_segments == 0 && group_quality == 0)
-                                printf("!!Problems in assessing the group quality and number of segments to be pushed!!\n");
-                            // Add push segments to the queue
-                            // Retransmit
-                            for (unsigned int s = 0; s < ret_segments; s++) {
-                                ++client_ctx->hcc_still_ret_segments;
-                                /* Create path for to-be-re-transmitted segment */
-                                int up_len = strlen(FP_PATH) + 4 + strlen(SP_PATH) + strlen(EXT) + 3; // ciphers as index (1,..,999)"
-                                char* temp_pp = (char*)malloc((up_len+1)*sizeof(char));
-                                snprintf(temp_pp, (up_len+1)*sizeof(char), "%s%d%s%d%s", FP_PATH, seg_bitrates[group_quality], SP_PATH, rep_seg_ind + start_group + s + 1, EXT);
-                                /* Insert path element in TAILQ */
-                                struct path_elem *pe;
-                                pe = calloc(1, sizeof(*pe));
-                                pe->path = temp_pp; /* Path of the next requested segment */
-                                pe->seg_ind = rep_seg_ind + start_group + s + 1;
-                                pe->seg_q = group_quality;
-                                printf("Added to the queue: segment index %u, representation %u, segment path '%s'\n", rep_seg_ind + start_group + s + 1, group_quality, pe->path);
-                                TAILQ_INSERT_TAIL(&client_ctx->hcc_ret_path_elems, pe, next_pe);
-                                conn_h->ch_n_reqs += MIN(client_ctx->hcc_total_n_reqs,
-                                                                client_ctx->hcc_reqs_per_conn);
-                                client_ctx->hcc_total_n_reqs -= conn_h->ch_n_reqs;
-                            }
-                        }
-                    }
-                }
-            } else { // Transmit only new segment with lowest resolution
-                ++client_ctx->hcc_still_segments;
-                struct path_elem *pe;
-                pe = calloc(1, sizeof(*pe));
-                pe->path = seg_paths[0]; /* Path of the next requested segment */
-                pe->seg_ind = seg_ind;
-                pe->seg_q = 0;
-                printf("Lowest representation, segment path: '%s'\n", pe->path);
-                TAILQ_INSERT_TAIL(&client_ctx->hcc_path_elems, pe, next_pe);
-                conn_h->ch_n_reqs = MIN(client_ctx->hcc_total_n_reqs,
-                                                        client_ctx->hcc_reqs_per_conn);
-                client_ctx->hcc_total_n_reqs -= conn_h->ch_n_reqs;
-            }
-        } else { /* CLOSE CONN IF THERE IS NO PLACE FOR IMPROVEMENT */
-            printf("Closing connection!\n");
-            client_ctx->hcc_total_n_reqs = 0;
-            lsquic_conn_close(conn_h->conn);
-            printf("After closing connection!\n");
-            return;
-        }
-        t_stats.tot_throughput = 0.0; // re-initialization total throughput;
-    }
+    http_client_continue(client_ctx, conn_h, true);
     
-    /* End new request for segment */
-    if (0 == conn_h->ch_n_reqs)
-    {
-        // printf("all requests completed, closing connection");
-        LSQ_INFO("all requests completed, closing connection");
-        lsquic_conn_close(conn_h->conn);
-    }
-    else
-    {
-        LSQ_INFO("%u active stream, %u request remain, creating %u new stream",
-            conn_h->ch_n_cc_streams,
-            conn_h->ch_n_reqs - conn_h->ch_n_cc_streams,
-            MIN((conn_h->ch_n_reqs - conn_h->ch_n_cc_streams),
-                (client_ctx->hcc_cc_reqs_per_conn - conn_h->ch_n_cc_streams)));
-        /* CHECK ON TRANSMISSION AND RE-TRANSMISSION QUEUES */
-        printf("SRS: %u, SS: %u\n", client_ctx->hcc_still_ret_segments, client_ctx->hcc_still_segments);
-        if (client_ctx->hcc_cc_reqs_per_conn > 1) {
-            if (!client_ctx->hcc_open_streams) {
-                printf("\n==> Transmission Time <==\n");
-                create_streams(client_ctx, conn_h); // Open the transmission stream
-            }
-        } else {
-            if (client_ctx->hcc_still_segments) {           // Check if next stream is re-transmission and - if so - whether it is possible or not
-                printf("Transmission\n");
-                create_streams(client_ctx, conn_h); // Open the transmission stream
-            } else if (client_ctx->hcc_still_ret_segments) {
-                printf("\nRe-transmission path update\n");
-                struct path_elem *temp_pe;
-                temp_pe = calloc(1, sizeof(*temp_pe));
-                if (client_ctx->hcc_ret_pe)
-                    temp_pe = TAILQ_NEXT(client_ctx->hcc_ret_pe, next_pe);
-                else
-                    temp_pe = TAILQ_FIRST(&client_ctx->hcc_ret_path_elems);
-                if (!temp_pe) { // If it's the last element of the queue
-                    printf("\nGoing through ABR again\n");
-                    goto abr; // Re-execute ABR strategy
-                }
-                client_ctx->hcc_ret_pe = temp_pe;
-                double available_time = 0.0;
-                if (client_ctx->hcc_ret_pe->seg_ind > rep_seg_ind)
-                    available_time = rep_seg_time + (client_ctx->hcc_ret_pe->seg_ind - rep_seg_ind - 1) * seg_length;
-                while(available_time < (seg_bitrates[client_ctx->hcc_ret_pe->seg_q] * seg_length / t_stats.tot_throughput)){
-                    --client_ctx->hcc_still_ret_segments;
-                    if ((temp_pe = TAILQ_NEXT(client_ctx->hcc_ret_pe, next_pe))){
-                        client_ctx->hcc_ret_pe = temp_pe;
-                        available_time = rep_seg_time + (client_ctx->hcc_ret_pe->seg_ind - rep_seg_ind) * seg_length;
-                    } else {
-                        printf("\nGoing through ABR again\n");
-                        goto abr;
-                    }
-                }
-                create_streams(client_ctx, conn_h); // Open the re-transmission stream
-            }
-        }
-        /* END CHECK */
-    }
     if (st_h->reader.lsqr_ctx)
         destroy_lsquic_reader_ctx(st_h->reader.lsqr_ctx);
     if (st_h->download_fh)
@@ -2278,6 +2160,22 @@ http_client_on_close (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
 }
 
 
+/* The re-download cannot complete before the playout of the segment */
+static void
+http_client_on_deadline (struct lsquic_stream *stream, lsquic_stream_ctx_t *st_h)
+{
+    struct lsquic_stream_progress prog;
+
+    if (0 == lsquic_stream_get_progress(stream, &prog))
+        LSQ_NOTICE("segment %u: %"PRIu64" bytes received at %"PRIu64" B/s, "
+            "%"PRIu64" us left: cancel the re-download", st_h->seg_ind,
+            prog.lsp_bytes_received, prog.lsp_rate, prog.lsp_eta);
+    printf("==== NOT ENOUGH THROUGHPUT FOR FULLFILLING REQUEST -> CLOSING STREAM for segment %u ====\n", st_h->seg_ind);
+    st_h->isTerminated = true;
+    lsquic_stream_close(stream);
+}
+
+
 static struct lsquic_stream_if http_client_if = {
     .on_new_conn            = http_client_on_new_conn,
     .on_conn_closed         = http_client_on_conn_closed,
@@ -2286,6 +2184,7 @@ static struct lsquic_stream_if http_client_if = {
     .on_write               = http_client_on_write,
     .on_close               = http_client_on_close,
     .on_hsk_done            = http_client_on_hsk_done,
+    .on_deadline            = http_client_on_deadline,
 };
 
 
@@ -2351,6 +2250,7 @@ static struct lsquic_stream_if hq_client_if = {
 static void
 usage (const char *prog)
 {
+    struct dofp_settings settings;
     const char *const slash = strrchr(prog, '/');
     if (slash)
         prog = slash + 1;
@@ -2358,9 +2258,20 @@ usage (const char *prog)
 "Usage: %s [opts]\n"
 "\n"
 "Options:\n"
-"   -p PATH     Path to request.  May be specified more than once.  If no\n"
-"                 path is specified, the connection is closed as soon as\n"
-"                 handshake succeeds.\n"
+"   -p PATH     Path of the first segment.  Defaults to the first segment\n"
+"                 of the lowest representation of the ladder.\n"
+"   -V FILE     Representation ladder.  Defaults to\n"
+"                 bin/ladder_apple_tos.txt.\n"
+"   -U PATH     Path of a DASH MPD or HLS master playlist on the server.\n"
+"                 The ladder is built from it instead of the ladder file.\n"
+"   -f FILE     Segment sizes, used by SARA and BOLA.  Defaults to\n"
+"                 bin/weights_apple_tos.txt.  Not used with -U.\n"
+"   -x          Estimate the throughput from the duration of each stream\n"
+"                 instead of the delivery rate measured by the transport.\n"
+"   -F HORIZON  Ask the server to push the next HORIZON segments (at most\n"
+"                 8) at the quality of each new segment.  A pushed segment\n"
+"                 needs no request if the ABR picks it.  Push needs gQUIC:\n"
+"                 select the versions with -o version=Q050 (or Q043, Q046).\n"
 "   -n CONNS    Number of concurrent connections.  Defaults to 1.\n"
 "   -r NREQS    Total number of requests to send.  Defaults to 1.\n"
 "   -R MAXREQS  Maximum number of requests per single connection.  Some\n"
@@ -2394,7 +2305,17 @@ usage (const char *prog)
 "                 urgency and I is incremental.  Matched \\d+:\\d+:[0-7][01]\n"
 "   -7 DIR      Save fetched resources into this directory.\n"
 "   -Q ALPN     Use hq ALPN.  Specify, for example, \"h3-29\".\n"
+"   -O SOLVER   Solver for the ABR models 0-3: `native' or `gurobi'.\n"
+#if HAVE_GUROBI
+"                 Defaults to `gurobi'.\n"
+#else
+"                 Only `native' is available in this build.\n"
+#endif
+"   -A NAME=VAL Set an ABR tunable.  May be specified several times.\n"
+"                 The tunables and their defaults are:\n"
             , prog);
+    dofp_settings_init(&settings);
+    dofp_settings_print(&settings, stdout);
 }
 
 
@@ -2962,51 +2883,23 @@ main (int argc, char **argv)
     struct prog prog;
     const char *token = NULL;
     struct priority_spec *priority_specs = NULL;
-    stall_t = lsquic_time_now();
-    // seg_chosen_q[0] = 0; // The quality of the first downloaded segment
-    // SARA stats
-    s_stats.I = seg_length;
-    s_stats.B_alpha = 2 * seg_length;
-    s_stats.B_beta = 5 * seg_length;
-    // BOLA stats
-    b_m_stats.gma = 5.0/seg_length;
-    b_m_stats.SM = DBL_MAX;
-    b_m_stats.max_value = 0;
-    w_stats.re_data = 0.0;
-    w_stats.re_count = 0U;
+    const lsquic_time_t stall_t = lsquic_time_now();
+    const struct dofp_abr_if *abr;
+    struct dofp_settings settings;
+
+    const char *ladder_file = LADDER_FILENAME;
+    const char *sizes_file = WEIGHTS_FILENAME;
+    const char *manifest_path = NULL;
 
     int experiment_id = 0;
-    
-    // Initialization of segments qualities
-    for (unsigned i = 0; i < sizeof(seg_chosen_q) / sizeof(seg_chosen_q[0]); ++i){
-        seg_chosen_q[i] = -1;
-    }
-    // Initialization of re-transmitted segments qualities
-    // for (unsigned i = 1; i < sizeof(re_seg_chosen_q) / sizeof(re_seg_chosen_q[0]); ++i){
-        // re_seg_chosen_q[i] = -1;
-    // }
-
-// Minh - Add BOLA ABR - ADD - S
-    // Initialization of v_m values for BOLA
-    printf("====> Get BOLA v_m\n");
-    for (unsigned i = 0; i < N_REP; ++i){
-        b_m_stats.Vm[i] = log((double) seg_bitrates[i] / seg_bitrates[0]);
-    }
-// Minh - Add BOLA ABR - ADD - E    
-    // Initialization of W values for SARA
-    weights_init(s_stats.W, WEIGHTS_FILENAME);
-    
-    // for (ssize_t i = 0; i < N_REP; i++) {
-        // for (ssize_t j = 0; j < N_MAX_SEG; j++) {
-            // printf("%Lf ", s_stats.W[i][j]);
-        // }
-        // printf("\n");
-    // }
+
+    dofp_settings_init(&settings);
 
     TAILQ_INIT(&sports);
     memset(&client_ctx, 0, sizeof(client_ctx));
     TAILQ_INIT(&client_ctx.hcc_path_elems);
     TAILQ_INIT(&client_ctx.hcc_ret_path_elems);
+    TAILQ_INIT(&client_ctx.hcc_pushed);
     client_ctx.method = "GET";
     client_ctx.hcc_concurrency = 1;
     client_ctx.hcc_cc_reqs_per_conn = 1;
@@ -3020,13 +2913,18 @@ main (int argc, char **argv)
     client_ctx.prog = &prog;
     client_ctx.h2br = false;
     client_ctx.chosen_abr = 1;
+#if HAVE_GUROBI
+    client_ctx.native_solver = false;
+#else
+    client_ctx.native_solver = true;
+#endif
 
     printf("====> 1\n");
 
     prog_init(&prog, LSENG_HTTP, &sports, &http_client_if, &client_ctx);
 
     while (-1 != (opt = getopt(argc, argv, PROG_OPTS
-                                    ":J:Z:46Br:R:IKu:EP:M:n:w:H:p:0:q:e:hatT:b:d"
+                                    ":A:J:Z:O:46Br:R:IKu:EP:M:n:w:H:p:0:q:e:hatT:b:dV:f:U:xF:"
                             "3:"    /* 3 is 133+ for "e" ("e" for "early") */
                             "9:"    /* 9 sort of looks like P... */
                             "7:"    /* Download directory */
@@ -3040,9 +2938,29 @@ main (int argc, char **argv)
         case 'a':
             ++s_display_cert_chain;
             break;
+        case 'A':
+            if (0 != dofp_settings_parse(&settings, optarg))
+            {
+                fprintf(stderr, "invalid ABR setting `%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
         case 'J':
             client_ctx.chosen_abr = atoi(optarg);
             break;
+        case 'O':
+            if (0 == strcmp(optarg, "native"))
+                client_ctx.native_solver = true;
+#if HAVE_GUROBI
+            else if (0 == strcmp(optarg, "gurobi"))
+                client_ctx.native_solver = false;
+#endif
+            else
+            {
+                fprintf(stderr, "unknown ABR solver `%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
         case 'Z':
                 if (atoi(optarg) == 1){
                 	client_ctx.h2br = true;
@@ -3073,6 +2991,15 @@ main (int argc, char **argv)
             }
             prog.prog_settings.es_support_push = 1;     /* Pokes into prog */
             break;
+        case 'F':
+            client_ctx.hcc_prefetch = atoi(optarg);
+            if (client_ctx.hcc_prefetch > 8)
+            {
+                fprintf(stderr, "prefetch horizon must be at most 8\n");
+                exit(EXIT_FAILURE);
+            }
+            prog.prog_settings.es_support_push = 1;     /* Pokes into prog */
+            break;
         case 'E':   /* E: randomly reprioritize str<E>ams.  Now, that's
                      * pretty random. :)
                      */
@@ -3107,9 +3034,22 @@ main (int argc, char **argv)
             client_ctx.hostname = optarg;
             prog.prog_hostname = optarg;            /* Pokes into prog */
             break;
+        case 'V':
+            ladder_file = optarg;
+            break;
+        case 'f':
+            sizes_file = optarg;
+            break;
+        case 'U':
+            manifest_path = optarg;
+            break;
+        case 'x':
+            client_ctx.hcc_flags |= HCC_WALL_CLOCK_TPUT;
+            break;
         case 'p':
             pe = calloc(1, sizeof(*pe));
             pe->path = optarg;
+            pe->seg_ind = 1;    /* The first segment at the lowest quality */
             TAILQ_INSERT_TAIL(&client_ctx.hcc_path_elems, pe, next_pe);
             break;
         case 'h':
@@ -3220,6 +3160,17 @@ main (int argc, char **argv)
         }
     }
 
+    /* The HTTP/3 client does not accept push: the prefetched segments
+     * would never arrive.
+     */
+    if (client_ctx.hcc_prefetch
+                && (prog.prog_settings.es_versions & LSQUIC_IETF_VERSIONS))
+    {
+        fprintf(stderr, "-F needs gQUIC: use -o version=Q050 (or Q043, "
+                                                                "Q046)\n");
+        exit(EXIT_FAILURE);
+    }
+
     printf("====> 2\n");
     // Set file path for metrics
     snprintf(METRICS_FILENAME, sizeof(METRICS_FILENAME)*2, "%s%i%i%s", "DoFP_extensions/apple_tos/metrics_abr_", client_ctx.chosen_abr, experiment_id, ".csv");
@@ -3229,12 +3180,37 @@ main (int argc, char **argv)
     
     // Set file path for json metrics
     snprintf(JSON_FILENAME, sizeof(JSON_FILENAME)*2, "%s%i%i%s", "DoFP_extensions/apple_tos/itu-p1203_abr_", client_ctx.chosen_abr, experiment_id, ".json");
+
     
-    // Set file path for json qoe metrics
-    snprintf(JSON_OUT_FILENAME, sizeof(JSON_OUT_FILENAME)*2, "%s%i%i%s", "DoFP_extensions/apple_tos/itu-p1203_abr_", client_ctx.chosen_abr, experiment_id, "_out.txt");
-    
-    if (client_ctx.chosen_abr == 6) // SARA
-        min_init_bs = s_stats.I;
+    if (manifest_path)
+    {
+        /* The ladder is read from the manifest over the first connection */
+        client_ctx.hcc_manifest = dofp_manifest_new(manifest_path);
+        if (!client_ctx.hcc_manifest)
+            exit(EXIT_FAILURE);
+        client_ctx.hcc_manifest_path = manifest_path;
+    }
+    else
+    {
+        s_ladder = dofp_ladder_load(ladder_file);
+        if (!s_ladder)
+            exit(EXIT_FAILURE);
+        // Segment sizes, used by SARA and BOLA
+        if (s_ladder->dl_n_seg
+                        && 0 != dofp_ladder_load_sizes(s_ladder, sizes_file))
+            LSQ_WARN("segment sizes not loaded: using the nominal bitrates");
+    }
+
+    abr = dofp_abr_by_id(client_ctx.chosen_abr);
+    if (!abr)
+    {
+        fprintf(stderr, "unknown ABR algorithm %d\n", client_ctx.chosen_abr);
+        exit(EXIT_FAILURE);
+    }
+    settings.dss_abr = abr;
+    settings.dss_h2br = client_ctx.h2br;
+    settings.dss_multistream = client_ctx.hcc_cc_reqs_per_conn > 1;
+    settings.dss_on_qoe = dofp_on_qoe;
 
 #if LSQUIC_CONN_STATS
     prog.prog_api.ea_stats_fh = stats_fh;
@@ -3256,11 +3232,25 @@ main (int argc, char **argv)
         prog.prog_api.ea_hsi_if = &header_bypass_api;
         prog.prog_api.ea_hsi_ctx = NULL;
     }
-    else if (TAILQ_EMPTY(&client_ctx.hcc_path_elems))
+
+#if HAVE_GUROBI
+    /* Start the Gurobi environment once, not for every decision */
+    if (!client_ctx.native_solver && (abr->dai_flags & DOFP_ABR_ASYNC))
     {
-        fprintf(stderr, "Specify at least one path using -p option\n");
-        exit(1);
+        client_ctx.grb_ctx = abr_grb_ctx_new();
+        if (!client_ctx.grb_ctx)
+        {
+            LSQ_ERROR("could not start Gurobi environment");
+            exit(EXIT_FAILURE);
+        }
     }
+    settings.dss_grb_ctx = client_ctx.grb_ctx;
+#endif
+
+    client_ctx.hcc_settings = &settings;
+    client_ctx.hcc_stall_t = stall_t;
+    if (!client_ctx.hcc_manifest)
+        http_client_start_session(&client_ctx);
 
     start_time = lsquic_time_now();
     start_t = lsquic_time_now();
@@ -3279,6 +3269,25 @@ main (int argc, char **argv)
     if (was_empty && token)
         sport_set_token(TAILQ_LAST(&sports, sport_head), token);
 
+    if (abr->dai_flags & DOFP_ABR_ASYNC)
+    {
+        client_ctx.hcc_abr_worker = abr_worker_new();
+        if (!client_ctx.hcc_abr_worker)
+        {
+            LSQ_ERROR("could not start ABR worker");
+            exit(EXIT_FAILURE);
+        }
+        client_ctx.hcc_abr_event = event_new(prog_eb(&prog),
+                    abr_worker_fd(client_ctx.hcc_abr_worker),
+                    EV_READ|EV_PERSIST, dofp_abr_on_done, &client_ctx);
+        if (!client_ctx.hcc_abr_event
+                        || 0 != event_add(client_ctx.hcc_abr_event, NULL))
+        {
+            LSQ_ERROR("cannot add ABR worker event");
+            exit(EXIT_FAILURE);
+        }
+    }
+
     if (client_ctx.qif_file)
     {
         if (0 != prog_connect(&prog, NULL, 0))
@@ -3298,6 +3307,12 @@ main (int argc, char **argv)
     
     s = prog_run(&prog);
 
+    if (!client_ctx.hcc_sess)
+    {
+        LSQ_ERROR("the manifest could not be fetched");
+        exit(EXIT_FAILURE);
+    }
+
     if (stats_fh)
     {
         elapsed = (long double) (lsquic_time_now() - start_time) / 1000000;
@@ -3317,66 +3332,43 @@ main (int argc, char **argv)
     FILE *fp = fopen(METRICS_FILENAME,"wa");
     if (!fp)
         printf("Error opening JSON file %s!\n", METRICS_FILENAME);
-    fprintf(fp, "THROUGHPUT,BITRATE,BUFFER,QUALITY,STALLT,STALLD");
-    // Minh - Add metrics when H2BR is enable - MOD - S
-    #if 0
-    if (client_ctx.chosen_abr < 4)
-    #else
-    if (client_ctx.chosen_abr < 4 || client_ctx.h2br)
-    #endif
-    // Minh - Add metrics when H2BR is enable - MOD - E
-        fprintf(fp, ",REDATA,RECOUNT,REUNUSED,REUNUSEDCOUNT");
-    fprintf(fp, "\n");
-    for (size_t i = 0; i < N_MAX_SEG; i++) {
-        fprintf(fp, "%.2Lf,%i,%.3f,%i,%.3f,%.3f", t_stats.e_throughput[i], seg_bitrates[seg_chosen_q[i]], t_stats.b_level[i], seg_chosen_q[i], stalls_t[i], stalls_d[i]);
-        // Minh - Add metrics when H2BR is enable - MOD - S
-        #if 0
-        if (i == 0 && client_ctx.chosen_abr < 4)
-        #else
-        if (i == 0 && (client_ctx.chosen_abr < 4 || client_ctx.h2br))
-        #endif
-        // Minh - Add metrics when H2BR is enable - MOD - E
-            fprintf(fp, ",%.3Lf,%u,%.3Lf,%u", w_stats.re_data, w_stats.re_count, w_stats.re_unused_data, w_stats.re_unused_count);
-        fprintf(fp, "\n");
-    }
-    fclose(fp);
-    
-    /* CREATE INPUT JSON FILE */
-    FILE *jfp = fopen(JSON_FILENAME,"wa");
-    if (!jfp)
-        printf("Error opening JSON file %s!\n", JSON_FILENAME);
-    fprintf(jfp, "{\n\t\"I11\":{\n\t\t\"segments\":[],\n\t\t\"streamId\":42},\n\t\"I13\":{\n\t\t\"segments\":[");
-    unsigned int start = 0U;
-    fprintf(jfp, "\n\t\t{\n\t\t\t\"bitrate\":%i,\n\t\t\t\"codec\":\"hevc\",\n\t\t\t\"duration\":%u,\n\t\t\t\"fps\":%.1f,\n\t\t\t\"resolution\":\"%s\",\n\t\t\t\"start\":%u\n\t\t\t}", 
-            seg_bitrates[seg_chosen_q[0]], seg_length, FPS, seg_res[seg_chosen_q[0]], start);
-    start += seg_length;
-    for (size_t i = 1; i < N_MAX_SEG; i++) {
-        fprintf(jfp, ",\n\t\t{\n\t\t\t\"bitrate\": %i,\n\t\t\t\"codec\":\"hevc\",\n\t\t\t\"duration\":%u,\n\t\t\t\"fps\":%.1f,\n\t\t\t\"resolution\":\"%s\",\n\t\t\t\"start\":%u\n\t\t\t}", 
-            seg_bitrates[seg_chosen_q[i]], seg_length, FPS, seg_res[seg_chosen_q[i]], start);
-    start += seg_length;
-    }
-    fprintf(jfp, "],\n\t\t\"streamId\":42\n},\n\t\"I23\":{\n\t\"stalling\":[");
-    fprintf(jfp, "[%.3f,%.3f]", stalls_t[0], stalls_d[0]);
-    for (size_t j = 1; j < stall_ind; j++)
-        fprintf(jfp, ",[%.3f,%.3f]", stalls_t[j], stalls_d[j]);
-    fprintf(jfp, "],\n\t\t\"streamId\": 42},\n\t\"IGen\":{\n\t\t\"device\":\"%s\",\n\t\t\"displaySize\":\"%s\",\n\t\t\"viewingDistance\":\"%u%s\"}}\n", DEVICE, DISPLAYSIZE, VIEWINGDISTANCE, "cm");
-    fclose(jfp);
+    else
+    {
+        (void) dofp_session_write_csv(client_ctx.hcc_sess, fp);
+        fclose(fp);
+    }
     
-    /* CREATE OUTPUT JSON FILE */
-    int max_command_length = 250;
-    char command[max_command_length];
-    snprintf(command, max_command_length, "python3 /home/minh/qoe_model_source/itu-p1203-codecextension/calculate.py -m 0 %s > %s\n", JSON_FILENAME, JSON_OUT_FILENAME);
-    int error = system(command);
-    if (error == -1)
-        printf("Error executing the command \'%s\'", command);
+    /* COMPLETE INPUT JSON FILE */
+    if (client_ctx.hcc_p1203)
+        (void) dofp_p1203_close(client_ctx.hcc_p1203, client_ctx.hcc_sess);
     
-    /* CREATE OUTPUT METRICS FILE */
-    snprintf(command, max_command_length, "python3 compute-metrics.py %s %s > %s\n", METRICS_FILENAME, JSON_OUT_FILENAME, METRICS_OUT_FILENAME);
-    error = system(command);
-    if (error == -1)
-        printf("Error executing the command \'%s\'", command);
+    /* CREATE OUTPUT METRICS FILE: same as compute-metrics.py */
+    FILE *mfp = fopen(METRICS_OUT_FILENAME,"w");
+    if (!mfp)
+        printf("Error opening metrics file %s!\n", METRICS_OUT_FILENAME);
+    else
+    {
+        (void) dofp_session_write_qoe(client_ctx.hcc_sess, mfp);
+        fclose(mfp);
+    }
     
+    if (client_ctx.hcc_abr_event)
+        event_free(client_ctx.hcc_abr_event);
+    if (client_ctx.hcc_playout_ev)
+        event_free(client_ctx.hcc_playout_ev);
+    if (client_ctx.hcc_push_ev)
+        event_free(client_ctx.hcc_push_ev);
+    if (client_ctx.hcc_abr_worker)
+        abr_worker_destroy(client_ctx.hcc_abr_worker);
+    dofp_session_destroy(client_ctx.hcc_sess);
+    if (client_ctx.hcc_pool)
+        dofp_pool_destroy(client_ctx.hcc_pool);
+    dofp_ladder_destroy(s_ladder);
     prog_cleanup(&prog);
+#if HAVE_GUROBI
+    if (client_ctx.grb_ctx)
+        abr_grb_ctx_destroy(client_ctx.grb_ctx);
+#endif
     if (promise_fd >= 0)
         (void) close(promise_fd);
 
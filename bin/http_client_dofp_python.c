@@ -3,7 +3,6 @@
  * http_client.c -- A simple HTTP/QUIC client
  */
 
-#include <Python.h>
 #ifndef WIN32
 #include <arpa/inet.h>
 #include <netinet/in.h>
@@ -50,6 +49,7 @@
 #include "abr_max_min_j.h"
 #include "abr_max_min_j_norm.h"
 #include "abr_quality_instability.h"
+#include "dofp.h"
 
 #include "../src/liblsquic/lsquic_logger.h"
 #include "../src/liblsquic/lsquic_int_types.h"
@@ -306,17 +306,6 @@ static const char       EXT[] = ".m4s";
 static const char       WEIGHTS_FILENAME[] = "tos_5min_end_4s/weights.txt";
 */
 
-/* Python Helper Functions */
-void  Initialize ()
-{ 
-    Py_Initialize();
-}
-
-void Finalize ()
-{
-    Py_Finalize();
-}
-
 /* Update the buffer size when required */
 static void update_buff(bool sr){
 	if(playout){ /* If player is not paused */
@@ -1734,7 +1723,8 @@ http_client_on_close (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
 					}
 					
 					double sol[n_par];
-					unsigned *retransmission_queue = NULL;
+					unsigned plan_q[group_n + 1];
+					unsigned retransmission_queue[DOFP_MAX_RET];
 					unsigned rq_size = 0;
 					
 					int error;
@@ -1746,285 +1736,27 @@ http_client_on_close (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
 					
 					// ABR SELECTION
 					if (client_ctx->chosen_abr == 0) {
+						// DoFP+ gap planning (libdofp, formerly milp.py): the window is the playing segment and the buffered ones
+						unsigned window[group_n];
+						struct dofp_gap_params gap_params = {
+							.dgp_bitrates = seg_bitrates,
+							.dgp_n_rep = N_REP,
+							.dgp_seg_len = seg_length,
+							.dgp_throughput = (double) t_stats.tot_throughput,
+							.dgp_buffer = buffer_level,
+							.dgp_buffer_size = buffer_size,
+							.dgp_play_left = rep_seg_time,
+							.dgp_one_gap = true,
+						};
 						
-						// We also have L[0] -> The composite sum of all the instability values (quality[i+1] - quality[i])
-						// n_par++;
-						
-						int cmd_argc = 2;
-						char* cmd_argv[] = {"milp", "initialize_run_dofp"};
-						
-						wchar_t** _argv = PyMem_Malloc(sizeof(wchar_t*)*cmd_argc);
-						for (int i=0; i<cmd_argc; i++) {
-						  wchar_t* arg = Py_DecodeLocale(cmd_argv[i], NULL);
-						  _argv[i] = arg;
-						}
-
-						/* Setup */
-						Py_SetProgramName(_argv[0]);
-						Initialize();
-						PySys_SetArgv(cmd_argc, _argv);
-						
-						/* Add local path */
-						PyObject *sys = PyImport_ImportModule("sys");
-						PyObject *path = PyObject_GetAttrString(sys, "path");
-						
-						/* Run the 'main' module */
-						// int rtn = Py_Main(cmd_argc, _argv); // <-- Notice the command line arguments.
-						// char filename[] = "milp.py";
-						// FILE* fp;
-
-						// fp = _Py_fopen(filename, "r");
-						// PyRun_SimpleFile(fp, filename);
-						
-						PyObject* myModuleString = PyUnicode_FromString(cmd_argv[0]);
-						PyObject* myModule = PyImport_Import(myModuleString);
-						Py_DECREF(myModuleString);
-						
-						PyObject* myFunction;
-						PyObject* args;
-						PyObject* pValue;
-
-						bool error = false;
-						
-						if (myModule != NULL) {
-							myFunction = PyObject_GetAttrString(myModule,cmd_argv[1]);
-							/* pFunc is a new reference */
-
-							if (myFunction && PyCallable_Check(myFunction)) {
-								/*
-								seg_bitrates,
-								min_q,
-								available_times --> computed in the Python script,
-								sol --> This will be returned by Python, 
-								isMultiStream --> For now not useful, 
-								t_stats.tot_throughput, 
-								current_buffer,
-								save_buffer_threshold,
-								seg_length,
-								remaining_time_current_segment,
-								retrans_strategy
-								*/
-								int arg_index = 0;
-								args = PyTuple_New(9);
-								/** Total number of elements in the bitrate ladder */
-								// pValue = PyLong_FromUnsignedLong((unsigned long) N_REP);
-								// PyTuple_SetItem(args, arg_index, pValue);
-								// arg_index++;
-								// if (!pValue) {
-									// error = true;
-									// goto error_check;
-								// }
-								/** Bitrate ladder */
-								pValue = PyTuple_New(sizeof(seg_bitrates)/sizeof(seg_bitrates[0]) + 1);
-								PyObject* loop_value;
-								loop_value = PyLong_FromLong((unsigned long) 0);
-									PyTuple_SetItem(pValue, 0, loop_value);
-									if (!loop_value) {
-										error = true;
-										goto error_check;
-									}
-								for (int i = 0; i < N_REP; i++) {
-									loop_value = PyLong_FromLong((unsigned long) seg_bitrates[i]);
-									PyTuple_SetItem(pValue, i+1, loop_value);
-									if (!loop_value) {
-										error = true;
-										goto error_check;
-									}
-								}
-								PyTuple_SetItem(args, arg_index, pValue);
-								arg_index++;
-								/** Minimum quality value for each segment in the group + playing segment */
-								pValue = PyTuple_New(sizeof(min_q)/sizeof(min_q[0]) + 1); // + 1 --> playing segment
-								// Add segment currently played out
-								loop_value = PyLong_FromLong((unsigned long) seg_chosen_q[rep_seg_ind - 1]);
-									PyTuple_SetItem(pValue, 0, loop_value);
-									if (!loop_value) {
-										error = true;
-										goto error_check;
-									}
-								for (int i = 0; i < sizeof(min_q)/sizeof(min_q[0]); i++) {
-									loop_value = PyLong_FromLong((unsigned long) min_q[i]);
-									PyTuple_SetItem(pValue, i+1, loop_value);
-									if (!loop_value) {
-										error = true;
-										goto error_check;
-									}
-								}
-								PyTuple_SetItem(args, arg_index, pValue);
-								arg_index++;
-								/** Available times - deadlines */
-								// pValue = PyTuple_New(sizeof(available_times)/sizeof(available_times[0]));
-								// for (int i = 0; i < sizeof(available_times)/sizeof(available_times[0]); i++) {
-									// loop_value = PyFloat_FromDouble((double) available_times[i]);
-									// PyTuple_SetItem(pValue, i, loop_value);
-									// if (!loop_value) {
-										// error = true;
-										// goto error_check;
-									// }
-								// }
-								// PyTuple_SetItem(args, arg_index, pValue);
-								// arg_index++;
-								/** Total throughput */
-								pValue = PyFloat_FromDouble((double) t_stats.tot_throughput);
-								PyTuple_SetItem(args, arg_index, pValue);
-								arg_index++;
-								if (!pValue) {
-									error = true;
-									goto error_check;
-								}
-								/** Number of total segments in the buffer + next segment */
-								// pValue = PyLong_FromUnsignedLong((unsigned long) group_n);
-								// PyTuple_SetItem(args, arg_index, pValue);
-								// arg_index++;
-								// if (!pValue) {
-									// error = true;
-									// goto error_check;
-								// }
-								/** Number of total parameters */
-								// pValue = PyLong_FromUnsignedLong((unsigned long) n_par);
-								// PyTuple_SetItem(args, arg_index, pValue);
-								// arg_index++;
-								// if (!pValue) {
-									// error = true;
-									// goto error_check;
-								// }
-								/** Buffer */
-								pValue = PyFloat_FromDouble((double) buffer_level);
-								PyTuple_SetItem(args, arg_index, pValue);
-								arg_index++;
-								if (!pValue) {
-									error = true;
-									goto error_check;
-								}
-								/** Save_buffer_threshold */
-								pValue = PyFloat_FromDouble((double) buffer_size/2);
-								PyTuple_SetItem(args, arg_index, pValue);
-								arg_index++;
-								if (!pValue) {
-									error = true;
-									goto error_check;
-								}
-								/** Segment length */
-								pValue = PyLong_FromUnsignedLong((unsigned long) seg_length);
-								PyTuple_SetItem(args, arg_index, pValue);
-								arg_index++;
-								if (!pValue) {
-									error = true;
-									goto error_check;
-								}
-								/** Remaining_time_current_segment */
-								pValue = PyFloat_FromDouble((double) rep_seg_time);
-								PyTuple_SetItem(args, arg_index, pValue);
-								arg_index++;
-								if (!pValue) {
-									error = true;
-									goto error_check;
-								}
-								/** Available time next segment */
-								pValue = PyFloat_FromDouble((double) available_times[sizeof(available_times)/sizeof(available_times[0])-1]);
-								PyTuple_SetItem(args, arg_index, pValue);
-								arg_index++;
-								if (!pValue) {
-									error = true;
-									goto error_check;
-								}
-								/** DoFP Strategy */
-								pValue = PyLong_FromUnsignedLong((unsigned long) 1);
-								PyTuple_SetItem(args, arg_index, pValue);
-								arg_index++;
-								if (!pValue) {
-									error = true;
-									goto error_check;
-								}
-								/** Is Multistream / Multiplexing being used */
-								// if (isMultiStream)
-									// pValue = Py_True;
-								// else
-									// pValue = Py_False;
-								// PyTuple_SetItem(args, arg_index, pValue);
-								// arg_index++;
-								// if (!pValue) {
-									// error = true;
-									// goto error_check;
-								// }
-								/** Alpha */
-								// pValue = PyFloat_FromDouble((double) alpha);
-								// PyTuple_SetItem(args, arg_index, pValue);
-								// arg_index++;
-								// if (!pValue) {
-									// error = true;
-									// goto error_check;
-								// }
-								/** Beta */
-								// pValue = PyFloat_FromDouble((double) beta);
-								// PyTuple_SetItem(args, arg_index, pValue);
-								// arg_index++;
-								// if (!pValue) {
-									// error = true;
-									// goto error_check;
-								// }
-								/* pValue reference stolen here: */
-								printf("Calling Python function!\n");
-								pValue = PyObject_CallObject(myFunction, args);
-								printf("End Python function!\n");
-								Py_DECREF(args);
-								if (pValue != NULL) {
-									// printf("PyList_Check: %d\n", PyList_Check(pValue));
-									if (PyList_Check(pValue)) {
-										printf("PyList_Size: %d\n", PyList_Size(pValue));
-										// printf("Result of call: %.1f\n", PyFloat_AsDouble(PyList_GetItem(pValue, 0)));
-										// sol[n_par-1] = PyFloat_AsDouble(PyList_GetItem(pValue, 0));
-										// Skip 2nd element which is L[0]
-										for (int i = 0; i < n_par; i++) {
-											printf("Result of call: %.1f\n", PyFloat_AsDouble(PyList_GetItem(pValue, i)));
-											sol[i] = PyFloat_AsDouble(PyList_GetItem(pValue, i));
-											printf("Sol[%d]: %.1f\n", i, sol[i]);
-										}
-										if (PyList_Size(pValue) > n_par) { // If there are segments to be retransmitted
-											rq_size = PyList_Size(pValue) - n_par;
-											retransmission_queue = malloc(rq_size * sizeof(unsigned));
-											for (int i = n_par; i < PyList_Size(pValue); i++) {
-												retransmission_queue[i-n_par] = (unsigned) PyFloat_AsDouble(PyList_GetItem(pValue, i)) - 1; // - 1 because Python algorithm considers also in-play segment
-												printf("Retransmission_queue index %d: %d\n", i-n_par, retransmission_queue[i-n_par]);
-											}
-										}
-									}
-									Py_DECREF(pValue);
-								}
-								else {
-									Py_DECREF(myFunction);
-									Py_DECREF(myModule);
-									PyErr_Print();
-									fprintf(stderr,"Call failed\n");
-									//return 1;
-								}
-							}
-							else {
-								if (PyErr_Occurred())
-									PyErr_Print();
-								fprintf(stderr, "Cannot find function \"%s\"\n", cmd_argv[1]);
-							}
-							Py_XDECREF(myFunction);
-							Py_DECREF(myModule);
-						}
-						else {
-							PyErr_Print();
-							fprintf(stderr, "Failed to load \"%s\"\n", cmd_argv[0]);
-							//return 1;
-						}
-						// if (Py_FinalizeEx() < 0) {
-							// printf("Errors reported by Python Finalize()\n");
-						// }
-						// Finalize Python Module
-						if (atexit(Finalize) != 0) { // Numpy module does not like to be initialized twice --> needs to be managed with "atexit"
-							printf("Errors reported by atexit in terminating 'Finalize()'\n");
+						window[0] = seg_chosen_q[rep_seg_ind - 1];
+						for (size_t i = 1; i < group_n; i++)
+							window[i] = min_q[i - 1];
+						error = dofp_gaps_plan(&gap_params, window, group_n, plan_q, retransmission_queue, &rq_size);
+						for (unsigned i = 0; i < rq_size; i++) {
+							retransmission_queue[i]--; // Window index -> min_q index
+							printf("Retransmission_queue index %u: %u\n", i, retransmission_queue[i]);
 						}
-						
-						error_check:
-						if (error)
-							printf("Error setting input of Python script!\n");
-						
-						// error = getMaxQINormCoefficients(N_REP, group_n, n_par, seg_length, (double) t_stats.tot_throughput, seg_bitrates, available_times, min_q, sol, isMultiStream, alpha, beta);					
 					} else if (client_ctx->chosen_abr == 1)
 						error = getMaxJCoefficients(N_REP, group_n, n_par, seg_length, (double) t_stats.tot_throughput, seg_bitrates, available_times, min_q, sol);
 					else if (client_ctx->chosen_abr == 2)
@@ -2050,7 +1782,7 @@ http_client_on_close (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
 					if (client_ctx->chosen_abr == 0) {
 						printf("\nSOLUTIONS:\n");
 						for (size_t i = 0; i < group_n; i++){
-							chosen_q[i] = (unsigned) sol[i+1] - 1; // Python script works with {quality + 1}
+							chosen_q[i] = plan_q[i + 1]; // plan_q[0] is the playing segment
 							printf("Segment %lu: Old Quality -> %i; New Quality -> %i\n", i + start_seg_ind + 1, min_q[i], chosen_q[i]);
 						}
 					} else {
@@ -2113,7 +1845,7 @@ http_client_on_close (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
 						// printf("Segment %lu: Quality -> %i; Throughput -> %.0f\n", i + start_seg_ind + 1, chosen_q[i], chosen_T[i]);
 					
 					// Segments re-transmission for the buffered segments
-					if (client_ctx->chosen_abr == 0 && retransmission_queue) {
+					if (client_ctx->chosen_abr == 0 && rq_size > 0) {
 						printf("In the retransmission selection...\n");
 						for (unsigned i = 0; i < rq_size; ++i) {
 							if (chosen_q[retransmission_queue[i]] != min_q[retransmission_queue[i]]) { // If the chosen quality is higher than the buffered one (&& at least equal to the subsequent one)
@@ -2136,8 +1868,6 @@ http_client_on_close (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
 								client_ctx->hcc_total_n_reqs -= conn_h->ch_n_reqs;
 							}
 						}
-						// Free pointer
-						free(retransmission_queue);
 					} else {
 						for (unsigned i = 0; i < group_n - 1; ++i) {
 							if (chosen_q[i] != min_q[i]) { // If the chosen quality is higher than the buffered one (&& at least equal to the subsequent one)
@@ -19,6 +19,11 @@
 #include <netinet/in.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#if __linux__
+#include <linux/filter.h>
+#endif
 #else
 #include "vc_compat.h"
 #include "getopt.h"
@@ -27,6 +32,7 @@
 #include <event2/event.h>
 
 #include <openssl/md5.h>
+#include <openssl/rand.h>
 
 #include "lsquic.h"
 #include "../src/liblsquic/lsquic_hash.h"
@@ -35,6 +41,7 @@
 #include "test_common.h"
 #include "test_cert.h"
 #include "prog.h"
+#include "dofp.h"
 
 #if HAVE_REGEX
 #ifndef WIN32
@@ -287,9 +294,21 @@ static int s_immediate_write;
  */
 static ssize_t s_pwritev;
 
+#ifndef WIN32
+/* Worker mode: the server forks this many processes, each with its own
+ * engine and its own SO_REUSEPORT socket per service port.
+ */
+static unsigned s_n_workers = 1;
+static unsigned s_worker;           /* Index of this worker */
+static int s_worker_ready_fd = -1;  /* Tells the parent the sockets are bound */
+#endif
+
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #define V(v) (v), strlen(v)
 
+/* Most segments a client may ask to be pushed after each request */
+#define MAX_PREFETCH 8
+
 struct lsquic_conn_ctx;
 
 static void interop_server_hset_destroy (void *);
@@ -306,6 +325,7 @@ struct server_ctx {
     unsigned                     n_conn;
     unsigned                     n_current_conns;
     unsigned                     delay_resp_sec;
+    struct dofp_cache           *seg_cache;     /* Interop mode media */
 };
 
 struct lsquic_conn_ctx {
@@ -427,6 +447,12 @@ struct req
     char        *authority_str;
     char        *qif_str;
     size_t       qif_sz;
+    /* Time left until the client plays the segment [ms], 0 if not given */
+    unsigned long deadline;
+    /* Segments to push once this one is sent (dofp-prefetch), 0 if none */
+    unsigned     prefetch;
+    /* Place of a pushed segment after the requested one, 0 if requested */
+    unsigned     push_rank;
     struct lsxpack_header
                  xhdr;
     size_t       decode_off;
@@ -444,9 +470,9 @@ struct media_ctx
 {
     char        *seg_path;
 	STAILQ_HEAD(, interop_push_path)    push_paths;
-	long        file_size;
+    const struct dofp_cached_seg       *seg;
     size_t      remain;
-    unsigned    file_off;
+    size_t      seg_off;
 };
 
 struct gen_file_ctx
@@ -1061,6 +1087,8 @@ http_server_on_read (struct lsquic_stream *stream, lsquic_stream_ctx_t *st_h)
 static void
 http_server_on_close (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
 {
+    struct interop_push_path *push_path;
+
     free(st_h->req_filename);
     free(st_h->req_path);
     if (st_h->reader.lsqr_ctx)
@@ -1071,6 +1099,17 @@ http_server_on_close (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
 #endif
     if (st_h->req)
         interop_server_hset_destroy(st_h->req);
+    if (st_h->interop_handler == IOH_MEDIA)
+    {
+        if (st_h->interop_u.mc.seg)
+            dofp_cache_put(st_h->server_ctx->seg_cache, st_h->interop_u.mc.seg);
+        /* Not pushed if the stream was reset */
+        while ((push_path = STAILQ_FIRST(&st_h->interop_u.mc.push_paths)))
+        {
+            STAILQ_REMOVE_HEAD(&st_h->interop_u.mc.push_paths, next);
+            free(push_path);
+        }
+    }
     free(st_h);
     LSQ_INFO("%s called, has unacked data: %d", __func__,
                                 lsquic_stream_has_unacked_data(stream));
@@ -1338,6 +1377,41 @@ read_md5 (void *ctx, const unsigned char *buf, size_t sz, int fin)
 }
 
 
+/* The client asks for the next segments of the representation to be pushed
+ * after this one (dofp-prefetch).  They are loaded into the segment cache
+ * now, up to the end of the content, and pushed once this segment is sent.
+ * Where the connection cannot push, the client finds them in the cache.
+ */
+static void
+media_prefetch (lsquic_stream_ctx_t *st_h)
+{
+    const struct dofp_cached_seg *seg;
+    struct interop_push_path *push_path;
+    char path[0x400];
+    unsigned i;
+    int len;
+
+    for (i = 1; i <= st_h->req->prefetch; ++i)
+    {
+        len = dofp_seg_path_next(st_h->req->path, i, path, sizeof(path));
+        if (len < 0)
+            break;
+        seg = dofp_cache_get(st_h->server_ctx->seg_cache, path);
+        if (!seg)
+        {
+            LSQ_DEBUG("not prefetching %s: %s", path, strerror(errno));
+            break;
+        }
+        dofp_cache_put(st_h->server_ctx->seg_cache, seg);
+        push_path = malloc(sizeof(*push_path) + len + 1);
+        if (!push_path)
+            break;
+        memcpy(push_path->path, path, len + 1);
+        STAILQ_INSERT_TAIL(&st_h->interop_u.mc.push_paths, push_path, next);
+    }
+}
+
+
 static void
 http_server_interop_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
 {
@@ -1363,8 +1437,6 @@ http_server_interop_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
     unsigned char md5sum[MD5_DIGEST_LENGTH];
     char md5str[ sizeof(md5sum) * 2 + 1 ];
     char byte[1];
-	int fd = 0;
-	struct stat st;
 
     if (!(st_h->flags & SH_HEADERS_READ))
     {
@@ -1392,23 +1464,24 @@ http_server_interop_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
                 st_h->interop_u.ihc.resp = (struct resp) { INDEX_HTML, sizeof(INDEX_HTML) - 1, 0, };
                 break;
 			case IOH_MEDIA:
-				// IMPLEMENT STAIL_Q push_paths for re-transmissions
 				STAILQ_INIT(&st_h->interop_u.mc.push_paths);
 				st_h->interop_u.mc.seg_path = st_h->req->path;
-				fd = open(st_h->req->path, O_RDONLY);
-				fstat(fd, &st);
-				st_h->interop_u.mc.remain = st.st_size;
-				st_h->interop_u.mc.file_size = st.st_size;
-				st_h->interop_u.mc.file_off = 0;
-				/*
-				len = matches[i].rm_eo - matches[i].rm_so;
-                        push_path = malloc(sizeof(*push_path) + len + 1);
-                        memcpy(push_path->path, st_h->req->path
-                            + matches[i].rm_so, len);
-                        push_path->path[len] ='\0';
-                        STAILQ_INSERT_TAIL(&st_h->interop_u.gfc.push_paths,
-                                                                push_path, next);
-				*/
+				st_h->interop_u.mc.seg = dofp_cache_get(
+					st_h->server_ctx->seg_cache, st_h->req->path);
+				if (!st_h->interop_u.mc.seg)
+					ERROR_RESP(404, "cannot read %s: %s", st_h->req->path,
+						strerror(errno));
+				st_h->interop_u.mc.remain = st_h->interop_u.mc.seg->dcs_len;
+				st_h->interop_u.mc.seg_off = 0;
+				if (st_h->req->deadline)
+					lsquic_stream_set_deadline(stream,
+						(uint64_t) st_h->req->deadline * 1000,
+						st_h->interop_u.mc.remain);
+                if (st_h->req->push_rank)
+                    /* Pushed segments go out in order, after the requests */
+                    (void) lsquic_stream_set_priority(stream,
+                        lsquic_stream_priority(stream) + st_h->req->push_rank);
+                media_prefetch(st_h);
                 break;
             case IOH_VER_HEAD:
                 st_h->interop_u.vhc.resp = (struct resp) {
@@ -1608,30 +1681,19 @@ idle_read (void *lsqr_ctx, void *buf, size_t count)
     return p - (unsigned char *) buf;
 }
 
+/* Copy straight from the cached segment */
 static size_t
 media_read (void *lsqr_ctx, void *buf, size_t count)
 {
     struct media_ctx *const mc = lsqr_ctx;
-    unsigned char *p = buf;
-    unsigned char *const end = p + count;
     size_t towrite;
-	FILE *media;
-	media = fopen(mc->seg_path,"rb");  // media = fopen("test.bin","rb"); r for read, b for binary
-    while (p < end && mc->remain > 0)
-    {
-        towrite = MIN((unsigned) (end - p), mc->file_size - mc->file_off);
-        if (towrite > mc->remain)
-            towrite = mc->remain;
-        fread(p, towrite, 1, media); // memcpy(p, on_being_idle + mc->file_off, towrite);
-        mc->file_off += towrite;
-        if (mc->file_off == mc->file_size)
-            mc->file_off = 0;
-        p += towrite;
-        mc->remain -= towrite;
-    }
-	fclose(media);
 
-    return p - (unsigned char *) buf;
+    towrite = MIN(count, mc->remain);
+    memcpy(buf, mc->seg->dcs_buf + mc->seg_off, towrite);
+    mc->seg_off += towrite;
+    mc->remain -= towrite;
+
+    return towrite;
 }
 
 
@@ -1695,6 +1757,21 @@ my_interop_preadv (void *user_data, const struct iovec *iov, int iovcnt)
 }
 
 
+static ssize_t
+media_preadv (void *user_data, const struct iovec *iov, int iovcnt)
+{
+    struct media_ctx *const mc = user_data;
+    size_t nread;
+    int i;
+
+    nread = 0;
+    for (i = 0; i < iovcnt; ++i)
+        nread += media_read(mc, iov[i].iov_base, iov[i].iov_len);
+
+    return (ssize_t) nread;
+}
+
+
 static void
 idle_on_write (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
 {
@@ -1770,23 +1847,71 @@ idle_on_write (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
     }
 }
 
+/* Push the segments of the prefetch horizon: the client gets the next
+ * segments without asking for them, one after the other.
+ */
 static void
-media_on_write (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+media_push (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
 {
     struct media_ctx *const mc = &st_h->interop_u.mc;
-	struct interop_push_path *push_path;
+    struct interop_push_path *push_path;
     struct lsxpack_header header_arr[4];
     struct lsquic_http_headers headers;
+    struct header_buf hbuf;
     struct req *req;
+    unsigned rank;
+    int s;
+
+    rank = 0;
+    while ((push_path = STAILQ_FIRST(&mc->push_paths)))
+    {
+        STAILQ_REMOVE_HEAD(&mc->push_paths, next);
+        if (!st_h->req->authority_str)
+        {
+            free(push_path);
+            continue;
+        }
+        LSQ_DEBUG("pushing promise for %s", push_path->path);
+        hbuf.off = 0;
+        header_set_ptr(&header_arr[0], &hbuf, V(":method"), V("GET"));
+        header_set_ptr(&header_arr[1], &hbuf, V(":path"), V(push_path->path));
+        header_set_ptr(&header_arr[2], &hbuf, V(":authority"), V(st_h->req->authority_str));
+        header_set_ptr(&header_arr[3], &hbuf, V(":scheme"), V("https"));
+        headers.headers = header_arr;
+        headers.count = sizeof(header_arr) / sizeof(header_arr[0]);
+        req = new_req(GET, push_path->path, st_h->req->authority_str);
+        if (req)
+        {
+            req->push_rank = ++rank;
+            s = lsquic_conn_push_stream(lsquic_stream_conn(stream), req,
+                                                            stream, &headers);
+            if (s != 0)
+            {
+                /* Without push, as over HTTP/3, the segment is only cached */
+                if (s < 0)
+                    LSQ_WARN("stream push failed");
+                interop_server_hset_destroy(req);
+            }
+        }
+        else
+            LSQ_WARN("cannot allocate req for push");
+        free(push_path);
+    }
+}
+
+
+static void
+media_on_write (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+    struct media_ctx *const mc = &st_h->interop_u.mc;
     ssize_t nw;
-    struct header_buf hbuf;
     struct lsquic_reader reader;
 
     if (st_h->flags & SH_HEADERS_SENT)
     {
         if (s_pwritev)
         {
-            nw = lsquic_stream_pwritev(stream, my_interop_preadv, mc,
+            nw = lsquic_stream_pwritev(stream, media_preadv, mc,
                                                             mc->remain);
             if (nw == 0)
                 goto with_reader;
@@ -1805,36 +1930,14 @@ media_on_write (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
             exit(1);
         }
         if (mc->remain == 0)
+        {
+            /* The promises must precede the end of the stream */
+            media_push(stream, st_h);
             lsquic_stream_shutdown(stream, 1);
+        }
     }
     else
     {
-        if (st_h->req->authority_str)
-            while ((push_path = STAILQ_FIRST(&mc->push_paths)))
-            {
-                STAILQ_REMOVE_HEAD(&mc->push_paths, next);
-                LSQ_DEBUG("pushing promise for %s", push_path->path);
-                hbuf.off = 0;
-                header_set_ptr(&header_arr[0], &hbuf, V(":method"), V("GET"));
-                header_set_ptr(&header_arr[1], &hbuf, V(":path"), V(push_path->path));
-                header_set_ptr(&header_arr[2], &hbuf, V(":authority"), V(st_h->req->authority_str));
-                header_set_ptr(&header_arr[3], &hbuf, V(":scheme"), V("https"));
-                headers.headers = header_arr;
-                headers.count = sizeof(header_arr) / sizeof(header_arr[0]);
-                req = new_req(GET, push_path->path, st_h->req->authority_str);
-                if (req)
-                {
-                    if (0 != lsquic_conn_push_stream(lsquic_stream_conn(stream),
-                                                            req, stream, &headers))
-                    {
-                        LSQ_WARN("stream push failed");
-                        interop_server_hset_destroy(req);
-                    }
-                }
-                else
-                    LSQ_WARN("cannot allocate req for push");
-                free(push_path);
-            }
         if (0 == send_headers2(stream, st_h, mc->remain))
             st_h->flags |= SH_HEADERS_SENT;
         else
@@ -1911,6 +2014,208 @@ const struct lsquic_stream_if interop_http_server_if = {
 };
 #endif /* HAVE_REGEX */
 
+#ifndef WIN32
+/* Connection steering
+ *
+ * The first byte of the connection IDs a worker issues is its index modulo
+ * the number of workers, and the sockets of the workers join the
+ * SO_REUSEPORT group in the order of their index.  The packets of a
+ * connection thus reach the worker that owns it whatever the address they
+ * come from, after a migration as well as before.  The Initial packets of
+ * the client, whose DCID the client chose, all go to the same worker, as the
+ * choice depends only on that DCID.
+ */
+static void
+worker_generate_scid (void *ctx, lsquic_conn_t *conn, lsquic_cid_t *scid,
+                                                                unsigned len)
+{
+    RAND_bytes(scid->idbuf, len);
+    scid->idbuf[0] = s_worker
+                    + s_n_workers * (scid->idbuf[0] % (256 / s_n_workers));
+    scid->len = len;
+}
+
+
+#if __linux__ && defined(SO_ATTACH_REUSEPORT_CBPF)
+/* The program returns the first byte of the DCID modulo the number of
+ * workers: the byte after the first one in a short header packet and the
+ * byte after the version and the DCID length in a long header packet.
+ */
+static int
+worker_attach_steering (int fd)
+{
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 0),
+        BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x80, 0, 2),
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 6),
+        BPF_STMT(BPF_JMP | BPF_JA, 1),
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 1),
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, s_n_workers),
+        BPF_STMT(BPF_RET | BPF_A, 0),
+    };
+    struct sock_fprog prog = {
+        .len    = sizeof(code) / sizeof(code[0]),
+        .filter = code,
+    };
+
+    return setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog,
+                                                                sizeof(prog));
+}
+#endif
+
+
+static pid_t *s_worker_pids;
+
+
+static void
+workers_signal (int signo)
+{
+    unsigned n;
+
+    for (n = 0; n < s_n_workers; ++n)
+        if (s_worker_pids[n] > 0)
+            kill(s_worker_pids[n], signo);
+}
+
+
+/* Fork the workers one after the other, each once the previous one has
+ * bound its sockets, so that the order of the sockets in the SO_REUSEPORT
+ * group is that of the worker indexes.  Only the workers return: the parent
+ * forwards the signals it gets to the workers, stops them all once one
+ * exits -- its socket leaving the group breaks the steering -- and exits
+ * when they are all gone.
+ */
+static void
+workers_start (void)
+{
+    struct sigaction sa;
+    unsigned n, n_left;
+    int fds[2], status, rc, stopping;
+    pid_t pid;
+    char c;
+
+    s_worker_pids = calloc(s_n_workers, sizeof(s_worker_pids[0]));
+    if (!s_worker_pids)
+    {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    rc = EXIT_SUCCESS;
+    for (n = 0; n < s_n_workers; ++n)
+    {
+        if (0 != pipe(fds))
+        {
+            perror("pipe");
+            rc = EXIT_FAILURE;
+            break;
+        }
+        pid = fork();
+        if (pid == 0)
+        {
+            close(fds[0]);
+            free(s_worker_pids);
+            s_worker_pids = NULL;
+            s_worker = n;
+            s_worker_ready_fd = fds[1];
+            return;
+        }
+        close(fds[1]);
+        if (pid < 0)
+        {
+            perror("fork");
+            close(fds[0]);
+            rc = EXIT_FAILURE;
+            break;
+        }
+        if (1 != read(fds[0], &c, 1))
+        {
+            LSQ_ERROR("worker %u failed to start", n);
+            close(fds[0]);
+            waitpid(pid, NULL, 0);
+            rc = EXIT_FAILURE;
+            break;
+        }
+        close(fds[0]);
+        s_worker_pids[n] = pid;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = workers_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGUSR1, &sa, NULL);
+    sigaction(SIGUSR2, &sa, NULL);
+    stopping = rc != EXIT_SUCCESS;
+    if (stopping)
+        workers_signal(SIGUSR1);
+
+    for (n_left = n; n_left > 0; )
+    {
+        pid = wait(&status);
+        if (pid < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("wait");
+            rc = EXIT_FAILURE;
+            break;
+        }
+        for (n = 0; n < s_n_workers; ++n)
+            if (s_worker_pids[n] == pid)
+            {
+                s_worker_pids[n] = 0;
+                --n_left;
+                LSQ_NOTICE("worker %u exited", n);
+                break;
+            }
+        if (!(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS))
+            rc = EXIT_FAILURE;
+        if (!stopping)
+        {
+            stopping = 1;
+            workers_signal(SIGUSR1);
+        }
+    }
+
+    free(s_worker_pids);
+    exit(rc);
+}
+
+
+/* Called by a worker once its sockets are bound */
+static void
+worker_ready (struct server_ctx *server_ctx)
+{
+#if __linux__ && defined(SO_ATTACH_REUSEPORT_CBPF)
+    struct service_port *sport;
+
+    if (s_worker == 0)
+        TAILQ_FOREACH(sport, &server_ctx->sports, next_sport)
+            if (0 != worker_attach_steering(sport->fd))
+            {
+                LSQ_ERROR("cannot attach steering program: %s",
+                                                            strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+#else
+    if (s_worker == 0)
+        LSQ_WARN("no connection steering on this platform: packets of a "
+            "connection reach its worker only as long as its address stays "
+            "the same");
+#endif
+    if (1 != write(s_worker_ready_fd, "", 1))
+    {
+        perror("write");
+        exit(EXIT_FAILURE);
+    }
+    close(s_worker_ready_fd);
+    s_worker_ready_fd = -1;
+    LSQ_NOTICE("worker %u ready", s_worker);
+}
+#endif
+
 
 static void
 usage (const char *prog)
@@ -1933,6 +2238,12 @@ usage (const char *prog)
 "                 Incompatible with -w.\n"
 #endif
 "   -y DELAY    Delay response for this many seconds -- use for debugging\n"
+"   -C MB       Size of the segment cache in interop mode.  The default is\n"
+"                 256 MB.  Each worker has its own.\n"
+#ifndef WIN32
+"   -N WORKERS  Run this many worker processes, each with its own engine\n"
+"                 and SO_REUSEPORT sockets.  The default is 1.\n"
+#endif
 "   -Q ALPN     Use hq mode; ALPN could be \"hq-29\", for example.\n"
             , prog);
 }
@@ -1987,7 +2298,7 @@ interop_server_hset_add_header (void *hset_p, struct lsxpack_header *xhdr)
 {
     struct req *req = hset_p;
     const char *name, *value;
-    unsigned name_len, value_len;
+    unsigned name_len, value_len, i;
 
     if (!xhdr)
     {
@@ -2056,6 +2367,25 @@ interop_server_hset_add_header (void *hset_p, struct lsxpack_header *xhdr)
         return 0;
     }
 
+    if (13 == name_len && 0 == strncmp(name, "dofp-deadline", 13))
+    {
+        /* The value is not NUL-terminated */
+        req->deadline = 0;
+        for (i = 0; i < value_len && value[i] >= '0' && value[i] <= '9'; ++i)
+            req->deadline = req->deadline * 10 + value[i] - '0';
+        return 0;
+    }
+
+    if (13 == name_len && 0 == strncmp(name, "dofp-prefetch", 13))
+    {
+        req->prefetch = 0;
+        for (i = 0; i < value_len && value[i] >= '0' && value[i] <= '9'
+                                    && req->prefetch <= MAX_PREFETCH; ++i)
+            req->prefetch = req->prefetch * 10 + value[i] - '0';
+        req->prefetch = MIN(req->prefetch, MAX_PREFETCH);
+        return 0;
+    }
+
     return 0;
 }
 
@@ -2089,6 +2419,10 @@ main (int argc, char **argv)
     struct server_ctx server_ctx;
     struct prog prog;
     const char *const *alpn;
+    size_t cache_budget = 256;
+#ifndef WIN32
+    struct service_port *sport;
+#endif
 
 #if !(HAVE_OPEN_MEMSTREAM || HAVE_REGEX)
     fprintf(stderr, "cannot run server without regex or open_memstream\n");
@@ -2102,7 +2436,10 @@ main (int argc, char **argv)
     prog_init(&prog, LSENG_SERVER|LSENG_HTTP, &server_ctx.sports,
                                             &http_server_if, &server_ctx);
 
-    while (-1 != (opt = getopt(argc, argv, PROG_OPTS "y:Y:n:p:r:w:P:h"
+    while (-1 != (opt = getopt(argc, argv, PROG_OPTS "y:Y:n:p:r:w:P:C:h"
+#ifndef WIN32
+                                                    "N:"
+#endif
 #if HAVE_OPEN_MEMSTREAM
                                                     "Q:"
 #endif
@@ -2145,6 +2482,19 @@ main (int argc, char **argv)
         case 'y':
             server_ctx.delay_resp_sec = atoi(optarg);
             break;
+        case 'C':
+            cache_budget = strtoull(optarg, NULL, 10);
+            break;
+#ifndef WIN32
+        case 'N':
+            s_n_workers = atoi(optarg);
+            if (s_n_workers == 0 || s_n_workers > 256)
+            {
+                fprintf(stderr, "number of workers must be 1 to 256\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+#endif
         case 'h':
             usage(argv[0]);
             prog_print_common_options(&prog, stdout);
@@ -2168,6 +2518,12 @@ main (int argc, char **argv)
 #if HAVE_REGEX
         LSQ_NOTICE("Document root is not set: start in Interop Mode");
         init_map_regexes();
+        server_ctx.seg_cache = dofp_cache_new(cache_budget << 20);
+        if (!server_ctx.seg_cache)
+        {
+            LSQ_ERROR("cannot create the segment cache");
+            exit(EXIT_FAILURE);
+        }
         prog.prog_api.ea_stream_if = &interop_http_server_if;
         prog.prog_api.ea_hsi_if = &header_bypass_api;
         prog.prog_api.ea_hsi_ctx = NULL;
@@ -2195,12 +2551,33 @@ main (int argc, char **argv)
         }
     }
 
+#ifndef WIN32
+    if (s_n_workers > 1)
+    {
+        if (prog.prog_settings.es_scid_len == 0)
+        {
+            LSQ_ERROR("workers need non-empty connection IDs");
+            exit(EXIT_FAILURE);
+        }
+        prog.prog_api.ea_generate_scid = worker_generate_scid;
+        prog.prog_dummy_sport.sp_flags |= SPORT_REUSEPORT;
+        TAILQ_FOREACH(sport, &server_ctx.sports, next_sport)
+            sport->sp_flags |= SPORT_REUSEPORT;
+        workers_start();
+    }
+#endif
+
     if (0 != prog_prep(&prog))
     {
         LSQ_ERROR("could not prep");
         exit(EXIT_FAILURE);
     }
 
+#ifndef WIN32
+    if (s_n_workers > 1)
+        worker_ready(&server_ctx);
+#endif
+
     LSQ_DEBUG("entering event loop");
 
     s = prog_run(&prog);
@@ -2208,7 +2585,10 @@ main (int argc, char **argv)
 
 #if HAVE_REGEX
     if (!server_ctx.document_root)
+    {
         free_map_regexes();
+        dofp_cache_destroy(server_ctx.seg_cache);
+    }
 #endif
 
     exit(0 == s ? EXIT_SUCCESS : EXIT_FAILURE);
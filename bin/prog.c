@@ -170,6 +170,14 @@ prog_print_common_options (const struct prog *prog, FILE *out)
 "   -S opt=val  Socket options.  Supported options:\n"
 "                   sndbuf=12345    # Sets SO_SNDBUF\n"
 "                   rcvbuf=12345    # Sets SO_RCVBUF\n"
+    );
+#if HAVE_GRO
+    fprintf(out,
+"                   gro=1           # Sets UDP_GRO: receive coalesced\n"
+"                                   #   datagrams with recvmmsg()\n"
+    );
+#endif
+    fprintf(out,
 "   -W          Use stock PMI (malloc & free)\n"
     );
 
@@ -183,6 +191,13 @@ prog_print_common_options (const struct prog *prog, FILE *out)
 "   -j          Use recvmmsg() to receive packets.\n"
     );
 #endif
+#if HAVE_GSO
+    fprintf(out,
+"   -X          Use sendmmsg() and UDP GSO to send packets: consecutive\n"
+"                 packets to the same destination go in one datagram\n"
+"                 that the kernel splits.\n"
+    );
+#endif
 
     if (prog->prog_engine_flags & LSENG_SERVER)
         fprintf(out,
@@ -256,6 +271,11 @@ prog_set_opt (struct prog *prog, int opt, const char *arg)
     case 'j':
         prog->prog_use_recvmmsg = 1;
         return 0;
+#endif
+#if HAVE_GSO
+    case 'X':
+        prog->prog_use_gso = 1;
+        return 0;
 #endif
     case 'm':
         prog->prog_packout_max = atoi(arg);
@@ -326,6 +346,17 @@ prog_set_opt (struct prog *prog, int opt, const char *arg)
                 free(name);
                 return 0;
             }
+#if HAVE_GRO
+            else if (0 == strcasecmp(name, "gro"))
+            {
+                if (atoi(val))
+                    sport->sp_flags |= SPORT_GRO;
+                else
+                    sport->sp_flags &= ~SPORT_GRO;
+                free(name);
+                return 0;
+            }
+#endif
             else
             {
                 free(name);
@@ -609,6 +640,9 @@ prog_run (struct prog *prog)
 void
 prog_cleanup (struct prog *prog)
 {
+    if (prog->prog_send_calls)
+        LSQ_NOTICE("sent %lu packets in %lu system calls",
+                            prog->prog_packets_sent, prog->prog_send_calls);
     lsquic_engine_destroy(prog->prog_engine);
     event_base_free(prog->prog_eb);
     if (!prog->prog_use_stock_pmi)
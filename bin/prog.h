@@ -31,6 +31,11 @@ struct prog
 #if HAVE_RECVMMSG
     int                             prog_use_recvmmsg;
 #endif
+#if HAVE_GSO
+    int                             prog_use_gso;
+#endif
+    unsigned long                   prog_packets_sent;
+    unsigned long                   prog_send_calls;
     int                             prog_use_stock_pmi;
     struct event_base              *prog_eb;
     struct event                   *prog_timer,
@@ -68,6 +73,12 @@ prog_init (struct prog *, unsigned lsquic_engine_flags, struct sport_head *,
 #   define RECVMMSG_FLAG ""
 #endif
 
+#if HAVE_GSO
+#   define GSO_FLAG "X"
+#else
+#   define GSO_FLAG ""
+#endif
+
 #if LSQUIC_DONTFRAG_SUPPORTED
 #   define IP_DONTFRAG_FLAG "D"
 #else
@@ -75,7 +86,7 @@ prog_init (struct prog *, unsigned lsquic_engine_flags, struct sport_head *,
 #endif
 
 #define PROG_OPTS "i:km:c:y:L:l:o:H:s:S:Y:z:G:W" RECVMMSG_FLAG SENDMMSG_FLAG \
-                                                            IP_DONTFRAG_FLAG
+                                                GSO_FLAG IP_DONTFRAG_FLAG
 
 /* Returns:
  *  0   Applied
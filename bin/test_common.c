@@ -30,6 +30,9 @@
 #include <fcntl.h>
 
 #include "test_config.h"
+#if HAVE_GSO || HAVE_GRO
+#include <netinet/udp.h>
+#endif
 
 #if HAVE_REGEX
 #ifndef WIN32
@@ -77,10 +80,24 @@
 #define ECN_SZ 0
 #endif
 
+#if HAVE_GRO
+#define GRO_SZ CMSG_SPACE(sizeof(int))
+#else
+#define GRO_SZ 0
+#endif
+
 #define MAX_PACKET_SZ 0xffff
 
 #define CTL_SZ (CMSG_SPACE(MAX(DST_MSG_SZ, \
-                        sizeof(struct in6_pktinfo))) + NDROPPED_SZ + ECN_SZ)
+                sizeof(struct in6_pktinfo))) + NDROPPED_SZ + ECN_SZ + GRO_SZ)
+
+#if HAVE_GRO
+/* The kernel coalesces at most this many packets into one datagram */
+#define GRO_MAX_SEGS 64
+
+/* Number of datagrams read at once with GRO */
+#define GRO_MAX_MSGS 32
+#endif
 
 /* There are `n_alloc' elements in `vecs', `local_addresses', and
  * `peer_addresses' arrays.  `ctlmsg_data' is n_alloc * CTL_SZ.  Each packets
@@ -88,6 +105,9 @@
  *
  * `n_alloc' is calculated at run-time based on the socket's receive buffer
  * size.
+ *
+ * `specs' are the packets handed to the engine.  With UDP GRO, each of the
+ * n_alloc datagrams may be split into several packets, which point into it.
  */
 struct packets_in
 {
@@ -103,7 +123,9 @@ struct packets_in
 #endif
     struct sockaddr_storage *local_addresses,
                             *peer_addresses;
+    struct lsquic_in_spec   *specs;
     unsigned                 n_alloc;
+    unsigned                 n_specs;
     unsigned                 data_sz;
 };
 
@@ -161,7 +183,7 @@ static void getExtensionPtrs()
 
 
 static struct packets_in *
-allocate_packets_in (SOCKET_TYPE fd)
+allocate_packets_in (SOCKET_TYPE fd, int gro)
 {
     struct packets_in *packs_in;
     unsigned n_alloc;
@@ -181,6 +203,15 @@ allocate_packets_in (SOCKET_TYPE fd)
     recvsz += MAX_PACKET_SZ;
 
     packs_in = malloc(sizeof(*packs_in));
+    packs_in->n_specs = n_alloc;
+#if HAVE_GRO
+    if (gro)
+    {
+        n_alloc = GRO_MAX_MSGS;
+        recvsz = GRO_MAX_MSGS * MAX_PACKET_SZ;
+        packs_in->n_specs = GRO_MAX_MSGS * GRO_MAX_SEGS;
+    }
+#endif
     packs_in->data_sz = recvsz;
     packs_in->n_alloc = n_alloc;
     packs_in->packet_data = malloc(recvsz);
@@ -188,6 +219,7 @@ allocate_packets_in (SOCKET_TYPE fd)
     packs_in->vecs = malloc(n_alloc * sizeof(packs_in->vecs[0]));
     packs_in->local_addresses = malloc(n_alloc * sizeof(packs_in->local_addresses[0]));
     packs_in->peer_addresses = malloc(n_alloc * sizeof(packs_in->peer_addresses[0]));
+    packs_in->specs = malloc(packs_in->n_specs * sizeof(packs_in->specs[0]));
 #if ECN_SUPPORTED
     packs_in->ecn = malloc(n_alloc * sizeof(packs_in->ecn[0]));
 #endif
@@ -202,6 +234,7 @@ free_packets_in (struct packets_in *packs_in)
 #if ECN_SUPPORTED
     free(packs_in->ecn);
 #endif
+    free(packs_in->specs);
     free(packs_in->peer_addresses);
     free(packs_in->local_addresses);
     free(packs_in->ctlmsg_data);
@@ -698,6 +731,128 @@ read_using_recvmmsg (struct read_iter *iter)
 }
 
 
+#endif
+
+#if HAVE_GRO
+/* Size of the packets coalesced into the datagram, 0 if it is one packet */
+static int
+gro_size (struct msghdr *msg)
+{
+    struct cmsghdr *cmsg;
+    int size;
+
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg))
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+        {
+            memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+            return size;
+        }
+    return 0;
+}
+
+
+/* Like read_using_recvmmsg(), but a datagram may be several packets the
+ * kernel coalesced: all of the same size but the last one, which may be
+ * shorter.  The packets are split into `specs', which point into the
+ * datagram; `ri_idx' is the number of packets.
+ */
+static enum rop
+read_using_gro (struct read_iter *iter)
+{
+#if __linux__
+    uint32_t n_dropped;
+#endif
+    int s, seg_size;
+    unsigned n, n_specs, off, len;
+    struct sockaddr_storage *local_addr;
+    struct lsquic_in_spec *spec;
+    struct service_port *const sport = iter->ri_sport;
+    struct packets_in *const packs_in = sport->packs_in;
+    struct mmsghdr mmsghdrs[ GRO_MAX_MSGS ];
+
+    assert(iter->ri_off == 0 && iter->ri_idx == 0);
+    assert(packs_in->n_alloc == GRO_MAX_MSGS);
+
+    for (n = 0; n < GRO_MAX_MSGS; ++n)
+    {
+        packs_in->vecs[n].iov_base = packs_in->packet_data + MAX_PACKET_SZ * n;
+        packs_in->vecs[n].iov_len  = MAX_PACKET_SZ;
+        mmsghdrs[n].msg_hdr = (struct msghdr) {
+            .msg_name       = &packs_in->peer_addresses[n],
+            .msg_namelen    = sizeof(packs_in->peer_addresses[n]),
+            .msg_iov        = &packs_in->vecs[n],
+            .msg_iovlen     = 1,
+            .msg_control    = packs_in->ctlmsg_data + CTL_SZ * n,
+            .msg_controllen = CTL_SZ,
+        };
+    }
+
+    s = recvmmsg(sport->fd, mmsghdrs, GRO_MAX_MSGS, 0, NULL);
+    if (s < 0)
+    {
+        if (!(EAGAIN == errno || EWOULDBLOCK == errno))
+            LSQ_ERROR("recvmmsg: %s", strerror(errno));
+        return ROP_ERROR;
+    }
+
+    n_specs = 0;
+    for (n = 0; n < (unsigned) s; ++n)
+    {
+        local_addr = &packs_in->local_addresses[n];
+        memcpy(local_addr, &sport->sp_local_addr, sizeof(*local_addr));
+#if __linux__
+        n_dropped = 0;
+#endif
+#if ECN_SUPPORTED
+        packs_in->ecn[n] = 0;
+#endif
+        proc_ancillary(&mmsghdrs[n].msg_hdr, local_addr
+#if __linux__
+            , &n_dropped
+#endif
+#if ECN_SUPPORTED
+            , &packs_in->ecn[n]
+#endif
+        );
+#if __linux__
+        if (sport->drop_init)
+        {
+            if (sport->n_dropped < n_dropped)
+                LSQ_INFO("dropped %u packets", n_dropped - sport->n_dropped);
+        }
+        else
+            sport->drop_init = 1;
+        sport->n_dropped = n_dropped;
+#endif
+        len = mmsghdrs[n].msg_len;
+        seg_size = gro_size(&mmsghdrs[n].msg_hdr);
+        if (seg_size <= 0)
+            seg_size = len;
+        off = 0;
+        do
+        {
+            spec = &packs_in->specs[n_specs++];
+            spec->data      = (unsigned char *) packs_in->vecs[n].iov_base
+                                                                        + off;
+            spec->sz        = MIN((unsigned) seg_size, len - off);
+            spec->local_sa  = (struct sockaddr *) local_addr;
+            spec->peer_sa   = (struct sockaddr *) &packs_in->peer_addresses[n];
+#if ECN_SUPPORTED
+            spec->ecn       = packs_in->ecn[n];
+#else
+            spec->ecn       = 0;
+#endif
+            off += spec->sz;
+        }
+        while (off < len && n_specs < packs_in->n_specs);
+    }
+
+    iter->ri_idx = n_specs;
+
+    return n == GRO_MAX_MSGS ? ROP_NOROOM : ROP_OK;
+}
+
+
 #endif
 
 
@@ -717,7 +872,7 @@ read_handler (evutil_socket_t fd, short flags, void *ctx)
     struct read_iter iter;
     unsigned n, n_batches;
     /* Save the value in case program is stopped packs_in is freed: */
-    const unsigned n_alloc = packs_in->n_alloc;
+    const unsigned n_alloc = packs_in->n_specs;
     enum rop rop;
 
     n_batches = 0;
@@ -729,6 +884,11 @@ read_handler (evutil_socket_t fd, short flags, void *ctx)
         iter.ri_off = 0;
         iter.ri_idx = 0;
 
+#if HAVE_GRO
+        if (sport->sp_flags & SPORT_GRO)
+            rop = read_using_gro(&iter);
+        else
+#endif
 #if HAVE_RECVMMSG
         if (sport->sp_prog->prog_use_recvmmsg)
             rop = read_using_recvmmsg(&iter);
@@ -748,25 +908,35 @@ read_handler (evutil_socket_t fd, short flags, void *ctx)
 
         n_batches += iter.ri_idx > 0;
 
-        for (n = 0; n < iter.ri_idx; ++n)
-            if (0 > lsquic_engine_packet_in(engine,
+#if HAVE_GRO
+        if (!(sport->sp_flags & SPORT_GRO))
+#endif
+            for (n = 0; n < iter.ri_idx; ++n)
+            {
 #ifndef WIN32
-                        packs_in->vecs[n].iov_base,
-                        packs_in->vecs[n].iov_len,
+                packs_in->specs[n].data = packs_in->vecs[n].iov_base;
+                packs_in->specs[n].sz   = packs_in->vecs[n].iov_len;
 #else
-                        (const unsigned char *) packs_in->vecs[n].buf,
-                        packs_in->vecs[n].len,
-#endif
-                        (struct sockaddr *) &packs_in->local_addresses[n],
-                        (struct sockaddr *) &packs_in->peer_addresses[n],
-                        sport,
+                packs_in->specs[n].data =
+                                (const unsigned char *) packs_in->vecs[n].buf;
+                packs_in->specs[n].sz   = packs_in->vecs[n].len;
+#endif
+                packs_in->specs[n].local_sa =
+                            (struct sockaddr *) &packs_in->local_addresses[n];
+                packs_in->specs[n].peer_sa =
+                            (struct sockaddr *) &packs_in->peer_addresses[n];
 #if ECN_SUPPORTED
-                        packs_in->ecn[n]
+                packs_in->specs[n].ecn  = packs_in->ecn[n];
 #else
-                        0
+                packs_in->specs[n].ecn  = 0;
 #endif
-                        ))
-                break;
+            }
+
+        /* One batch: the engine looks up the connection once for packets
+         * in a row, and the connections are processed once.
+         */
+        n = lsquic_engine_packets_in(engine, packs_in->specs, iter.ri_idx,
+                                                                    sport);
 
         if (n > 0)
             prog_process_conns(sport->sp_prog);
@@ -795,6 +965,49 @@ add_to_event_loop (struct service_port *sport, struct event_base *eb)
 }
 
 
+#if HAVE_GRO
+/* Without UDP GRO support, datagrams are read one packet each */
+static void
+set_gro (struct service_port *sport, int fd)
+{
+    int on = 1;
+
+    if ((sport->sp_flags & SPORT_GRO)
+        && 0 != setsockopt(fd, SOL_UDP, UDP_GRO, &on, sizeof(on)))
+    {
+        LSQ_WARN("UDP GRO is not supported (%s): receiving without it",
+                                                            strerror(errno));
+        sport->sp_flags &= ~SPORT_GRO;
+    }
+}
+
+
+#endif
+
+
+#if HAVE_GSO
+/* Kernels before 4.18 ignore the UDP_SEGMENT control message and would send
+ * the whole batch as one datagram: check that the socket knows about it.
+ */
+static void
+check_gso (struct service_port *sport, int fd)
+{
+    int gso_size;
+    socklen_t len = sizeof(gso_size);
+
+    if (sport->sp_prog->prog_use_gso
+        && 0 != getsockopt(fd, SOL_UDP, UDP_SEGMENT, &gso_size, &len))
+    {
+        LSQ_WARN("UDP GSO is not supported (%s): sending without it",
+                                                            strerror(errno));
+        sport->sp_prog->prog_use_gso = 0;
+    }
+}
+
+
+#endif
+
+
 int
 sport_init_server (struct service_port *sport, struct lsquic_engine *engine,
                    struct event_base *eb)
@@ -828,6 +1041,21 @@ sport_init_server (struct service_port *sport, struct lsquic_engine *engine,
     if (-1 == sockfd)
         return -1;
 
+#ifdef SO_REUSEPORT
+    if (sport->sp_flags & SPORT_REUSEPORT)
+    {
+        on = 1;
+        s = setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+        if (0 != s)
+        {
+            saved_errno = errno;
+            close(sockfd);
+            errno = saved_errno;
+            return -1;
+        }
+    }
+#endif
+
     if (0 != bind(sockfd, sa_local, socklen)) {
         saved_errno = errno;
         LSQ_WARN("bind failed: %s", strerror(errno));
@@ -1016,7 +1244,12 @@ sport_init_server (struct service_port *sport, struct lsquic_engine *engine,
         return -1;
     }
 
-    sport->packs_in = allocate_packets_in(sockfd);
+#if HAVE_GRO
+    set_gro(sport, sockfd);
+    sport->packs_in = allocate_packets_in(sockfd, sport->sp_flags & SPORT_GRO);
+#else
+    sport->packs_in = allocate_packets_in(sockfd, 0);
+#endif
     if (!sport->packs_in)
     {
         saved_errno = errno;
@@ -1037,6 +1270,10 @@ sport_init_server (struct service_port *sport, struct lsquic_engine *engine,
         break;
     }
 
+#if HAVE_GSO
+    check_gso(sport, sockfd);
+#endif
+
     sport->engine = engine;
     sport->fd = sockfd;
     sport->sp_flags |= SPORT_SERVER;
@@ -1212,7 +1449,12 @@ sport_init_client (struct service_port *sport, struct lsquic_engine *engine,
         return -1;
     }
 
-    sport->packs_in = allocate_packets_in(sockfd);
+#if HAVE_GRO
+    set_gro(sport, sockfd);
+    sport->packs_in = allocate_packets_in(sockfd, sport->sp_flags & SPORT_GRO);
+#else
+    sport->packs_in = allocate_packets_in(sockfd, 0);
+#endif
     if (!sport->packs_in)
     {
         saved_errno = errno;
@@ -1232,6 +1474,10 @@ sport_init_client (struct service_port *sport, struct lsquic_engine *engine,
         break;
     }
 
+#if HAVE_GSO
+    check_gso(sport, sockfd);
+#endif
+
     sport->engine = engine;
     sport->fd = sockfd;
 
@@ -1488,6 +1734,9 @@ send_packets_using_sendmmsg (const struct lsquic_out_spec *specs,
     }
 
     s = sendmmsg(fd, mmsgs, count, 0);
+    ++sport->sp_prog->prog_send_calls;
+    if (s > 0)
+        sport->sp_prog->prog_packets_sent += s;
     if (s < (int) count)
     {
         saved_errno = errno;
@@ -1510,6 +1759,205 @@ send_packets_using_sendmmsg (const struct lsquic_out_spec *specs,
 #endif
 
 
+#if HAVE_GSO
+/* The kernel splits a datagram into at most this many segments */
+#define GSO_MAX_SEGS 64
+
+/* The datagram must fit into an IPv6 packet: 40-byte IPv6 header and 8-byte
+ * UDP header.
+ */
+#define GSO_MAX_BYTES (0xFFFF - 40 - 8)
+
+#define GSO_MAX_MSGS 1024
+#define GSO_MAX_IOVS (GSO_MAX_MSGS * 2)
+
+
+static size_t
+spec_size (const struct lsquic_out_spec *spec)
+{
+    size_t size;
+    unsigned i;
+
+    size = 0;
+    for (i = 0; i < spec->iovlen; ++i)
+        size += spec->iov[i].iov_len;
+    return size;
+}
+
+
+static int
+same_sockaddr (const struct sockaddr *a, const struct sockaddr *b)
+{
+    if (a == b)
+        return 1;
+    if (a->sa_family != b->sa_family)
+        return 0;
+    switch (a->sa_family)
+    {
+    case AF_INET:
+        return 0 == memcmp(a, b, sizeof(struct sockaddr_in));
+    case AF_INET6:
+        return 0 == memcmp(a, b, sizeof(struct sockaddr_in6));
+    default:
+        return 1;
+    }
+}
+
+
+/* Packets go in the same datagram if the kernel sends them the same way */
+static int
+same_path (const struct lsquic_out_spec *a, const struct lsquic_out_spec *b)
+{
+    return a->ecn == b->ecn
+        && same_sockaddr(a->dest_sa, b->dest_sa)
+        && same_sockaddr(a->local_sa, b->local_sa);
+}
+
+
+/* Append the UDP_SEGMENT message to the control messages set up by
+ * setup_control_msg().
+ */
+static void
+add_gso_control_msg (struct msghdr *msg, uint16_t gso_size)
+{
+    struct cmsghdr *const cmsg = (struct cmsghdr *)
+                ((unsigned char *) msg->msg_control + msg->msg_controllen);
+
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type  = UDP_SEGMENT;
+    cmsg->cmsg_len   = CMSG_LEN(sizeof(gso_size));
+    memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+    msg->msg_controllen += CMSG_SPACE(sizeof(gso_size));
+}
+
+
+/* Like send_packets_using_sendmmsg(), but consecutive packets to the same
+ * destination with the same ECN go in one datagram with a UDP_SEGMENT
+ * control message: the kernel splits it into packets the size of the first
+ * one.  All but the last packet of a datagram are of that size, the last
+ * may be shorter.  The packets are not copied: the datagram is gathered
+ * from their buffers.
+ *
+ * If the kernel rejects a datagram, GSO is turned off and the packets are
+ * sent one per message.
+ */
+static int
+send_packets_using_gso (const struct lsquic_out_spec *specs, unsigned count)
+{
+    const struct service_port *const sport = specs[0].peer_ctx;
+    struct prog *const prog = sport->sp_prog;
+    const int fd = sport->fd;
+    enum ctl_what cw;
+    unsigned i, first, n_msgs, n_iovs, iov_first, n_sent;
+    int s, saved_errno;
+    size_t gso_size, size, msg_size;
+    struct mmsghdr mmsgs[GSO_MAX_MSGS];
+    unsigned n_specs[GSO_MAX_MSGS];     /* Packets in each datagram */
+    struct iovec iovs[GSO_MAX_IOVS];
+    union {
+        /* cmsg(3) recommends union for proper alignment */
+        unsigned char buf[ CMSG_SPACE(sizeof(struct in6_pktinfo))
+#if ECN_SUPPORTED
+            + CMSG_SPACE(sizeof(int))
+#endif
+            + CMSG_SPACE(sizeof(uint16_t))
+                                                                    ];
+        struct cmsghdr cmsg;
+    } ancil [ GSO_MAX_MSGS ];
+
+    n_msgs = 0;
+    n_iovs = 0;
+    for (i = 0; i < count && n_msgs < GSO_MAX_MSGS; ++n_msgs)
+    {
+        first = i;
+        iov_first = n_iovs;
+        gso_size = size = spec_size(&specs[i]);
+        if (n_iovs + specs[i].iovlen > GSO_MAX_IOVS)
+            break;
+        msg_size = 0;
+        for (;;)
+        {
+            memcpy(&iovs[n_iovs], specs[i].iov,
+                                        specs[i].iovlen * sizeof(iovs[0]));
+            n_iovs += specs[i].iovlen;
+            msg_size += size;
+            ++i;
+            if (i == count || size < gso_size || i - first == GSO_MAX_SEGS
+                                        || !same_path(&specs[first], &specs[i]))
+                break;
+            size = spec_size(&specs[i]);
+            if (size > gso_size || msg_size + size > GSO_MAX_BYTES
+                                || n_iovs + specs[i].iovlen > GSO_MAX_IOVS)
+                break;
+        }
+        n_specs[n_msgs] = i - first;
+
+        mmsgs[n_msgs].msg_hdr.msg_name       = (void *) specs[first].dest_sa;
+        mmsgs[n_msgs].msg_hdr.msg_namelen    =
+                                (AF_INET == specs[first].dest_sa->sa_family ?
+                                            sizeof(struct sockaddr_in) :
+                                            sizeof(struct sockaddr_in6));
+        mmsgs[n_msgs].msg_hdr.msg_iov        = &iovs[iov_first];
+        mmsgs[n_msgs].msg_hdr.msg_iovlen     = n_iovs - iov_first;
+        mmsgs[n_msgs].msg_hdr.msg_flags      = 0;
+        if ((sport->sp_flags & SPORT_SERVER) && specs[first].local_sa->sa_family)
+            cw = CW_SENDADDR;
+        else
+            cw = 0;
+#if ECN_SUPPORTED
+        if (prog->prog_api.ea_settings->es_ecn && specs[first].ecn)
+            cw |= CW_ECN;
+#endif
+        setup_control_msg(&mmsgs[n_msgs].msg_hdr, cw, &specs[first],
+                            ancil[n_msgs].buf, sizeof(ancil[n_msgs].buf));
+        if (n_specs[n_msgs] > 1)
+            add_gso_control_msg(&mmsgs[n_msgs].msg_hdr, gso_size);
+        else if (!cw)
+            mmsgs[n_msgs].msg_hdr.msg_control = NULL;
+    }
+
+    s = sendmmsg(fd, mmsgs, n_msgs, 0);
+    ++prog->prog_send_calls;
+    if (s < 0 && n_specs[0] > 1
+            && (errno == EIO || errno == EINVAL || errno == EMSGSIZE))
+    {
+        /* EIO: no checksum offload; EINVAL and EMSGSIZE: segments too
+         * large for the path or too many of them.
+         */
+        LSQ_WARN("sendmmsg with GSO failed: %s; sending without GSO",
+                                                            strerror(errno));
+        prog->prog_use_gso = 0;
+        return send_packets_using_sendmmsg(specs, count);
+    }
+
+    n_sent = 0;
+    for (i = 0; s > 0 && i < (unsigned) s; ++i)
+        n_sent += n_specs[i];
+    prog->prog_packets_sent += n_sent;
+
+    if (n_sent < count)
+    {
+        saved_errno = errno;
+        prog_sport_cant_send(prog, fd);
+        if (s < 0)
+        {
+            LSQ_WARN("sendmmsg failed: %s", strerror(saved_errno));
+            errno = saved_errno;
+            return -1;
+        }
+        else if (s > 0)
+            errno = EAGAIN;
+        else
+            errno = saved_errno;
+    }
+
+    return n_sent;
+}
+
+
+#endif
+
+
 #if LSQUIC_PREFERRED_ADDR
 static const struct service_port *
 find_sport (struct prog *prog, const struct sockaddr *local_sa)
@@ -1687,6 +2135,8 @@ send_packets_one_by_one (const struct lsquic_out_spec *specs, unsigned count)
 #endif
             break;
         }
+        ++sport->sp_prog->prog_send_calls;
+        ++sport->sp_prog->prog_packets_sent;
         ++n;
     }
     while (n < count);
@@ -1724,6 +2174,10 @@ sport_packets_out (void *ctx, const struct lsquic_out_spec *specs,
 {
 #if HAVE_SENDMMSG
     const struct prog *prog = ctx;
+#if HAVE_GSO
+    if (prog->prog_use_gso)
+        return send_packets_using_gso(specs, count);
+#endif
     if (prog->prog_use_sendmmsg)
         return send_packets_using_sendmmsg(specs, count);
     else
@@ -1978,6 +2432,11 @@ set_engine_option (struct lsquic_engine_settings *settings,
             settings->es_max_batch_size = atoi(val);
             return 0;
         }
+        if (0 == strncmp(name, "deadline_sched", 14))
+        {
+            settings->es_deadline_sched = atoi(val);
+            return 0;
+        }
         break;
     case 15:
         if (0 == strncmp(name, "allow_migration", 15))
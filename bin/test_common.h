@@ -47,6 +47,8 @@ enum sport_flags
     SPORT_SET_RCVBUF        = (1 << 2), /* SO_RCVBUF */
     SPORT_SERVER            = (1 << 3),
     SPORT_CONNECT           = (1 << 4),
+    SPORT_REUSEPORT         = (1 << 5), /* SO_REUSEPORT */
+    SPORT_GRO               = (1 << 6), /* UDP_GRO */
 };
 
 struct service_port {
@@ -0,0 +1,36 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "gurobi_c.h"
+#include <stdbool.h>
+#include <math.h>
+
+/* Long-lived Gurobi context for the DoFP+ ABR models.  The environment is
+ * started once and one model skeleton is kept per (model, n_seg, multistream)
+ * combination.  Each decision only updates bounds, coefficients and the
+ * right-hand side of the bandwidth constraint, then warm-starts from the
+ * previous solution.
+ */
+
+/* Same numbering as the client's chosen_abr */
+enum abr_grb_model
+{
+    ABR_GRB_QI_NORM         = 0,
+    ABR_GRB_MAX_J           = 1,
+    ABR_GRB_MAX_MIN_J       = 2,
+    ABR_GRB_MAX_MIN_J_NORM  = 3,
+};
+
+struct abr_grb_ctx;
+
+struct abr_grb_ctx *
+abr_grb_ctx_new (void);
+
+void
+abr_grb_ctx_destroy (struct abr_grb_ctx *);
+
+/* Takes the arguments of the getMax*Coefficients() functions and fills `sol'
+ * with the same layout.  alpha and beta are ignored by the models that do not
+ * use them.  Returns 0 on success and -1 on error.
+ */
+int
+abr_grb_solve (struct abr_grb_ctx *, enum abr_grb_model, unsigned n_rep, unsigned n_seg, unsigned n_par, unsigned seg_dur, double bandwidth, const int* bitrates, double* available_times, unsigned* min_q, double* sol, bool isMultiStream, double alpha, double beta);
@@ -0,0 +1,22 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <math.h>
+
+/* Native (no Gurobi) solvers for the DoFP+ ABR models.  Every function takes
+ * the same arguments as its Gurobi counterpart and fills `sol' with the same
+ * variable layout: a_{ij} for every segment i and j in [min_q[i], n_rep),
+ * then T_i for every segment, then j* (all but MaxJ).
+ */
+
+int
+getMaxJCoefficientsNative(unsigned n_rep, unsigned n_seg, unsigned n_par, unsigned seg_dur, double bandwidth, const int* bitrates, double* available_times, unsigned* min_q, double* sol);
+
+int
+getMaxMinJCoefficientsNative(unsigned n_rep, unsigned n_seg, unsigned n_par, unsigned seg_dur, double throughput, const int* bitrates, double* available_times, unsigned* min_q, double* sol, bool isMultiStream);
+
+int
+getMaxMinJNormCoefficientsNative(unsigned n_rep, unsigned n_seg, unsigned n_par, unsigned seg_dur, double bandwidth, const int* bitrates, double* available_times, unsigned* min_q, double* sol, bool isMultiStream, double alpha, double beta, double buffer_level, double buffer_size);
+
+int
+getMaxQINormCoefficientsNative(unsigned n_rep, unsigned n_seg, unsigned n_par, unsigned seg_dur, double bandwidth, const int* bitrates, double* available_times, unsigned* min_q, double* sol, bool isMultiStream, double alpha, double beta);
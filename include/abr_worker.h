@@ -0,0 +1,40 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/queue.h>
+
+/* ABR decision worker: runs the optimization models on a separate thread so
+ * that the event loop keeps processing packets while a decision is computed.
+ *
+ * Jobs are submitted from the event loop thread.  The worker calls aj_solve()
+ * and moves the job to the completion queue; the read end of a pipe, given
+ * by abr_worker_fd(), becomes readable when completed jobs are available.
+ * Register it with the event loop and call abr_worker_next_done() until it
+ * returns NULL.
+ */
+
+struct abr_job
+{
+    TAILQ_ENTRY(abr_job)    aj_next;
+    /* Called on the worker thread.  Must not touch event loop state. */
+    int                   (*aj_solve)(struct abr_job *);
+    int                     aj_status;  /* Return value of aj_solve() */
+};
+
+struct abr_worker;
+
+struct abr_worker *
+abr_worker_new (void);
+
+/* Jobs that did not complete are freed with free() */
+void
+abr_worker_destroy (struct abr_worker *);
+
+int
+abr_worker_fd (const struct abr_worker *);
+
+int
+abr_worker_submit (struct abr_worker *, struct abr_job *);
+
+struct abr_job *
+abr_worker_next_done (struct abr_worker *);
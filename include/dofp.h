@@ -0,0 +1,767 @@
+#ifndef DOFP_H
+#define DOFP_H
+
+/**
+ * @file
+ * libdofp: the DoFP+ player model.
+ *
+ * A session holds everything one simulated viewer needs: the playout buffer,
+ * the stall log, the throughput estimates, the qualities of the downloaded
+ * segments and the state of its ABR algorithm.  Sessions do not read the
+ * clock and do no I/O: every call that depends on time takes the current
+ * time as an argument, so the same code runs inside an lsquic event loop or
+ * from a simulator.  Many sessions can share one process, one ladder and one
+ * ABR worker.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Time in microseconds, same unit as lsquic_time_t */
+typedef uint64_t dofp_time_t;
+
+/** Maximum number of re-downloads in one decision */
+#define DOFP_MAX_RET 64
+
+/**
+ * Representation ladder of the content.  It is read-only once sessions
+ * use it and can be shared by any number of them.  Create it with
+ * dofp_ladder_new() or dofp_ladder_load().
+ */
+struct dofp_ladder
+{
+    unsigned            dl_n_rep;       /* Number of representations */
+    unsigned            dl_n_seg;       /* Number of segments, 0 if live */
+    unsigned            dl_seg_len;     /* Segment duration [s] */
+    unsigned            dl_start_number; /* Number of segment 1 in media paths */
+    int                *dl_bitrates;    /* [kbps], ascending */
+    char              **dl_res;         /* E.g. "1920x1080" */
+    /* Media path of every representation, relative to dl_base.  "$Number$"
+     * or "$Number%05d$" stands for the segment number, as in DASH templates.
+     */
+    char              **dl_media;
+    char               *dl_base;
+    /* Size of every segment [bytes], used by SARA and BOLA: dl_n_seg sizes
+     * per representation.  NULL until dofp_ladder_load_sizes() is called;
+     * segments are then assumed to have the nominal bitrate.  When loaded
+     * from a segment-size index, this is a read-only mapping of the file.
+     */
+    const uint32_t     *dl_sizes;
+    size_t              dl_sizes_map_len;   /* 0 if dl_sizes is allocated */
+};
+
+/**
+ * Create a ladder without representations.  Returns NULL on error.
+ */
+struct dofp_ladder *
+dofp_ladder_new (unsigned n_rep, unsigned n_seg, unsigned seg_len);
+
+/**
+ * Set representation `q'.  The strings are copied; `res' and `media' may
+ * be NULL.  Returns 0 on success and -1 on error.
+ */
+int
+dofp_ladder_set_rep (struct dofp_ladder *, unsigned q, int bitrate,
+                                        const char *res, const char *media);
+
+/** Set the path prefix of the media paths.  Returns 0 or -1. */
+int
+dofp_ladder_set_base (struct dofp_ladder *, const char *base);
+
+/**
+ * Load a ladder file:
+ *
+ *   segment_duration 4
+ *   segments 184
+ *   start_number 1
+ *   base apple/
+ *   rep 145 640x360 145/segment_$Number$.m4s
+ *
+ * with one `rep' line per representation, by ascending bitrate [kbps].
+ * `segments' is omitted for live content; `start_number' defaults to 1.
+ * Returns NULL on error.
+ */
+struct dofp_ladder *
+dofp_ladder_load (const char *filename);
+
+void
+dofp_ladder_destroy (struct dofp_ladder *);
+
+/**
+ * Load the segment sizes from a segment-size index, which is mapped in
+ * memory as it is, or from a text file: one line per representation,
+ * dl_n_seg sizes in bytes per line.  Returns 0 on success and -1 on error.
+ */
+int
+dofp_ladder_load_sizes (struct dofp_ladder *, const char *filename);
+
+/**
+ * Write the segment sizes as a segment-size index: the 8 bytes
+ * DOFP_SIZES_MAGIC, then the 32-bit words 0x01020304 (byte order),
+ * dl_n_rep, dl_n_seg and 0, then the sizes, representation after
+ * representation, as 32-bit words, all in the byte order of the host.
+ * Returns 0 on success and -1 on error.
+ */
+int
+dofp_ladder_write_sizes (const struct dofp_ladder *, const char *filename);
+
+#define DOFP_SIZES_MAGIC "DOFPSZ01"
+
+/**
+ * Write the path of segment `seg_ind' (1-based) of representation `q' to
+ * `buf'.  Returns the length of the path, or -1 if it does not fit or the
+ * media path is invalid.
+ */
+int
+dofp_ladder_seg_path (const struct dofp_ladder *, unsigned q,
+                                unsigned seg_ind, char *buf, size_t bufsz);
+
+/** True if the content has segment `seg_ind' (1-based) */
+static inline bool
+dofp_ladder_has_seg (const struct dofp_ladder *ladder, unsigned seg_ind)
+{
+    return ladder->dl_n_seg == 0 || seg_ind <= ladder->dl_n_seg;
+}
+
+/**
+ * Manifest parser.  DASH MPDs (SegmentTemplate, with or without a
+ * SegmentTimeline) and HLS playlists are parsed as they arrive, in chunks
+ * of any size, into a ladder whose media paths are relative to the server
+ * root or to the directory of the manifest.  The HLS media playlists are
+ * documents of their own, fetched one after the other once the master
+ * playlist ends.  Live content is played from its first listed segment.
+ */
+struct dofp_manifest;
+
+/** `path' is the path of the manifest on the server */
+struct dofp_manifest *
+dofp_manifest_new (const char *path);
+
+/** Parse the next bytes of the current document.  Returns 0 or -1. */
+int
+dofp_manifest_feed (struct dofp_manifest *, const void *buf, size_t len);
+
+/**
+ * The current document is complete.  Returns 1 and sets `*next_path' if
+ * another document must be fetched and fed, 0 when the ladder is ready and
+ * -1 on error.  `*next_path' lives as long as the parser.
+ */
+int
+dofp_manifest_end (struct dofp_manifest *, const char **next_path);
+
+/**
+ * Take the ladder out of the parser.  Segment sizes are set when the
+ * playlists carry them (EXT-X-BITRATE).
+ */
+struct dofp_ladder *
+dofp_manifest_ladder (struct dofp_manifest *);
+
+void
+dofp_manifest_destroy (struct dofp_manifest *);
+
+struct dofp_session;
+struct dofp_decision;
+struct dofp_qoe;
+struct abr_job;
+
+enum dofp_status
+{
+    DOFP_DONE,      /* The decision is ready */
+    DOFP_PENDING,   /* A solver job must be run first */
+    DOFP_END,       /* Nothing left to improve: stop downloading */
+    DOFP_ERROR,
+};
+
+/** ABR algorithm flags */
+enum dofp_abr_flags
+{
+    /* Decisions are computed by a solver job, see dofp_session_decide() */
+    DOFP_ABR_ASYNC      = 1 << 0,
+    /* The algorithm re-downloads buffered segments at a higher quality */
+    DOFP_ABR_RETRANS    = 1 << 1,
+    /* Re-downloads that cannot make their deadline may be cancelled */
+    DOFP_ABR_CANCEL     = 1 << 2,
+};
+
+/**
+ * ABR algorithm.  Algorithms are stateless objects; per-session state is
+ * created by dai_new().
+ */
+struct dofp_abr_if
+{
+    const char         *dai_name;
+    enum dofp_abr_flags dai_flags;
+
+    /* Optional: returns per-session state passed to the other callbacks */
+    void *            (*dai_new)(struct dofp_session *);
+    void              (*dai_destroy)(void *abr_ctx);
+
+    /* Optional: a new segment was received at quality `q' */
+    void              (*dai_on_segment)(void *abr_ctx, struct dofp_session *,
+                                                unsigned seg_ind, unsigned q);
+
+    /* Fill the decision and return DOFP_DONE, or, for DOFP_ABR_ASYNC
+     * algorithms, set the job and return DOFP_PENDING.
+     */
+    enum dofp_status  (*dai_decide)(void *abr_ctx, struct dofp_session *,
+                            struct dofp_decision *, struct abr_job **);
+
+    /* DOFP_ABR_ASYNC only: turn the result of a solved job into a decision */
+    enum dofp_status  (*dai_complete)(void *abr_ctx, struct dofp_session *,
+                            struct abr_job *, struct dofp_decision *);
+};
+
+/* Built-in algorithms.  The MILP models are DoFP+; see abr_native.h */
+extern const struct dofp_abr_if dofp_abr_qi_norm;       /* 0 */
+extern const struct dofp_abr_if dofp_abr_max_j;         /* 1 */
+extern const struct dofp_abr_if dofp_abr_max_min_j;     /* 2 */
+extern const struct dofp_abr_if dofp_abr_max_min_j_norm;/* 3 */
+extern const struct dofp_abr_if dofp_abr_maxr;          /* 4 */
+extern const struct dofp_abr_if dofp_abr_bola;          /* 5 */
+extern const struct dofp_abr_if dofp_abr_sara;          /* 6 */
+extern const struct dofp_abr_if dofp_abr_bba;           /* 7 */
+
+/**
+ * Look up a built-in algorithm by the number used by the -J option of
+ * http_client_dofp.  Returns NULL if there is no such algorithm.
+ */
+const struct dofp_abr_if *
+dofp_abr_by_id (unsigned id);
+
+struct dofp_settings
+{
+    const struct dofp_abr_if   *dss_abr;
+    const struct dofp_ladder   *dss_ladder;
+    double                      dss_buffer_size;    /* Maximum buffer [s] */
+    double                      dss_min_init_bs;    /* Buffer needed to
+                                                     * [re]start playout [s]
+                                                     */
+    double                      dss_alpha, dss_beta;/* Normalized models */
+    bool                        dss_h2br;           /* H2BR re-downloads */
+    bool                        dss_multistream;    /* Segments share the
+                                                     * connection concurrently
+                                                     */
+    /* If set, the MILP models are solved by Gurobi instead of the native
+     * solver.  The context is not thread-safe: use a single ABR worker.
+     */
+    struct abr_grb_ctx         *dss_grb_ctx;
+
+    /* Optional: called with the updated metrics whenever a segment or a
+     * re-download is received.
+     */
+    void                      (*dss_on_qoe)(struct dofp_session *,
+                                                    const struct dofp_qoe *);
+
+    /* Tunables.  Each one can also be set by name, see dofp_settings_set(). */
+    double                      dss_tput_safety;    /* Share of the measured
+                                                     * throughput the ABR
+                                                     * relies on
+                                                     */
+    double                      dss_deadline_safety;/* Share of the time left
+                                                     * before playout that a
+                                                     * MILP re-download may use
+                                                     */
+    double                      dss_milp_window;    /* Below this share of
+                                                     * dss_buffer_size, the
+                                                     * MILP models only pick
+                                                     * the next segment
+                                                     */
+    double                      dss_bba_reservoir;  /* BBA-0, shares of */
+    double                      dss_bba_cushion;    /* dss_buffer_size */
+    unsigned                    dss_sara_avg_count; /* SARA: segments in the
+                                                     * harmonic mean
+                                                     */
+    unsigned                    dss_log_window;     /* Played segments kept
+                                                     * in the session log.
+                                                     * 0 keeps all of them,
+                                                     * or the last 256 of
+                                                     * live content
+                                                     */
+};
+
+/** Fill settings with the defaults of http_client_dofp */
+void
+dofp_settings_init (struct dofp_settings *);
+
+/**
+ * Set a numeric setting by name: "buffer_size", "min_init_bs", "alpha",
+ * "beta", or the name of a tunable without the dss_ prefix, such as
+ * "tput_safety".  Returns 0 on success and -1 if there is no such setting.
+ * Values are checked by dofp_session_new().
+ */
+int
+dofp_settings_set (struct dofp_settings *, const char *name, double value);
+
+/**
+ * Parse "NAME=VALUE" and set it.  Returns 0 on success and -1 on error.
+ */
+int
+dofp_settings_parse (struct dofp_settings *, const char *name_value);
+
+/** Print the names accepted by dofp_settings_set() and their values */
+void
+dofp_settings_print (const struct dofp_settings *, FILE *);
+
+/** One segment to download */
+struct dofp_segment_req
+{
+    unsigned            dsr_seg_ind;    /* 1-based */
+    unsigned            dsr_q;
+};
+
+struct dofp_decision
+{
+    bool                    dd_next;    /* Download the next segment */
+    struct dofp_segment_req dd_next_seg;
+    dofp_time_t             dd_delay;   /* Wait before requesting it */
+    dofp_time_t             dd_solve_time;  /* DOFP_ABR_ASYNC only */
+    unsigned                dd_n_ret;   /* Re-downloads, in order */
+    struct dofp_segment_req dd_ret[DOFP_MAX_RET];
+};
+
+/**
+ * Create a session.  `ctx' is returned by dofp_session_get_ctx().  The
+ * settings are copied.  Returns NULL on error.
+ */
+struct dofp_session *
+dofp_session_new (const struct dofp_settings *, void *ctx, dofp_time_t now);
+
+void
+dofp_session_destroy (struct dofp_session *);
+
+void *
+dofp_session_get_ctx (const struct dofp_session *);
+
+const struct dofp_settings *
+dofp_session_settings (const struct dofp_session *);
+
+/**
+ * Advance the playout to `now'.  Stalls are detected here.  The playout
+ * state only depends on the time of the last update and on the segments
+ * received, so the session does not need to be updated as data arrives:
+ * only before reading the playout state and at the time given by
+ * dofp_session_next_event().
+ */
+void
+dofp_session_update (struct dofp_session *, dofp_time_t now);
+
+/**
+ * Time at which the playout state next changes by itself: the end of the
+ * segment being played or the start of a stall, whichever comes first.
+ * Zero if the playout is paused: it only restarts when a segment arrives.
+ */
+dofp_time_t
+dofp_session_next_event (const struct dofp_session *);
+
+/**
+ * A download finished: `nbytes' were read in `download_time'.  Updates the
+ * throughput estimates used by the next decision.
+ */
+void
+dofp_session_on_download (struct dofp_session *, size_t nbytes,
+                                                dofp_time_t download_time);
+
+/**
+ * A download finished and the transport measured the delivery rate of the
+ * connection: `rate' [kbps].  Use instead of dofp_session_on_download():
+ * the rate leaves out the request RTT and the idle time, and already covers
+ * the concurrent downloads.
+ */
+void
+dofp_session_on_rate (struct dofp_session *, long double rate);
+
+/** Throughput available to the next decision [kbps] */
+long double
+dofp_session_throughput (const struct dofp_session *);
+
+/**
+ * Split the estimated throughput among `n' concurrent downloads.
+ */
+void
+dofp_session_share_throughput (struct dofp_session *, unsigned n);
+
+/**
+ * The next segment was received at quality `q'.  Returns true if the
+ * content has more segments.
+ */
+bool
+dofp_session_segment_received (struct dofp_session *, unsigned q,
+                                                        dofp_time_t now);
+
+/**
+ * A re-download of `seg_ind' finished.  `nbytes' were read; `cancelled' is
+ * set if the stream was closed early.  Returns true if the new quality
+ * replaces the buffered one, i.e. the segment is not being played yet.
+ */
+bool
+dofp_session_retrans_received (struct dofp_session *, unsigned seg_ind,
+            unsigned q, size_t nbytes, bool cancelled, dofp_time_t now);
+
+/** True if a re-download of `seg_ind' would still be played */
+bool
+dofp_session_retrans_acceptable (const struct dofp_session *,
+                                                        unsigned seg_ind);
+
+/**
+ * Playout time left before segment `seg_ind' starts [s]; 0 if it is
+ * already being played.
+ */
+double
+dofp_session_available_time (const struct dofp_session *, unsigned seg_ind);
+
+/**
+ * Time to wait before requesting the next new segment [us]: `delay', as
+ * asked for by the ABR, or longer if the buffer is above dss_buffer_size.
+ * The buffer drains at playout speed, so the wait ends exactly when it
+ * falls to dss_buffer_size.
+ */
+dofp_time_t
+dofp_session_request_delay (const struct dofp_session *, dofp_time_t delay);
+
+/**
+ * Pick what to download next.  Call it once the previous downloads are
+ * complete.
+ *
+ * If DOFP_PENDING is returned, `*job' must be solved, either in place by
+ * calling its aj_solve() or by an ABR worker, and then be passed to
+ * dofp_session_complete().  To drop it instead, use dofp_job_destroy().
+ */
+enum dofp_status
+dofp_session_decide (struct dofp_session *, struct dofp_decision *,
+                                                    struct abr_job **job);
+
+/** Consumes the job */
+enum dofp_status
+dofp_session_complete (struct dofp_session *, struct abr_job *,
+                                                    struct dofp_decision *);
+
+struct dofp_session *
+dofp_job_session (const struct abr_job *);
+
+void
+dofp_job_destroy (struct abr_job *);
+
+double
+dofp_session_buffer_level (const struct dofp_session *);
+
+/** Index of the next segment to download, starting from 1 */
+unsigned
+dofp_session_seg_ind (const struct dofp_session *);
+
+/** Index of the segment being played, starting from 1 */
+unsigned
+dofp_session_rep_seg_ind (const struct dofp_session *);
+
+/**
+ * Quality of segment `seg_ind' (1-based), -1 if it has not been downloaded
+ * or has left the session log.
+ */
+int
+dofp_session_seg_quality (const struct dofp_session *, unsigned seg_ind);
+
+/**
+ * Session summary, same metrics as compute-metrics.py.  They are kept up to
+ * date as segments arrive, so getting them is cheap at any time.
+ */
+struct dofp_qoe
+{
+    unsigned            dq_n_seg;           /* Segments downloaded */
+    double              dq_avg_bitrate;     /* [kbps] */
+    double              dq_std_bitrate;     /* [kbps] */
+    double              dq_avg_quality;     /* Starting from 1 */
+    unsigned            dq_switches;        /* Downward switches */
+    double              dq_instability;
+    double              dq_startup;         /* Initial buffering [s] */
+    unsigned            dq_n_stalls;        /* Not counting start-up */
+    double              dq_stall_dur;       /* [s] */
+    unsigned            dq_re_count;        /* Re-downloads */
+    unsigned            dq_re_unused_count; /* ... arrived too late */
+    double              dq_re_data;         /* [kB] */
+    double              dq_re_unused_data;  /* [kB] */
+};
+
+void
+dofp_session_qoe (const struct dofp_session *, struct dofp_qoe *);
+
+/**
+ * Per-segment metrics in the CSV format read by compute-metrics.py:
+ * throughput, bitrate, buffer level, quality and stalls.  Only the segments
+ * and stalls still in the session log are written.
+ */
+int
+dofp_session_write_csv (const struct dofp_session *, FILE *);
+
+/**
+ * Session summary in the CSV format printed by compute-metrics.py.
+ */
+int
+dofp_session_write_qoe (const struct dofp_session *, FILE *);
+
+/** Input file of the ITU-T P.1203 model */
+int
+dofp_session_write_p1203 (const struct dofp_session *, FILE *);
+
+/**
+ * Streaming writer of the same P.1203 input.  A segment is appended to
+ * `path' once its quality is final, when it starts playing, and a stall to
+ * `path'.stalls once it ends, so that long sessions need not keep their
+ * log (see dss_log_window) and a crash leaves what was played on disk.
+ * The files are flushed every `flush_every' records, or left to stdio if
+ * `flush_every' is 0.  Returns NULL on error.
+ */
+struct dofp_p1203;
+
+struct dofp_p1203 *
+dofp_p1203_open (const char *path, unsigned flush_every);
+
+/** The session writes to `w' from now on; NULL stops it */
+void
+dofp_session_set_p1203 (struct dofp_session *, struct dofp_p1203 *w);
+
+/**
+ * Write the segments still in the buffer, merge the stalls into the
+ * document and remove `path'.stalls.  The session stops writing to `w',
+ * which is freed.  Returns 0 on success and -1 on error.
+ */
+int
+dofp_p1203_close (struct dofp_p1203 *w, struct dofp_session *);
+
+/**
+ * Segment buffer pool: the media of the buffered segments, in slabs that
+ * are sized from the ladder and recycled per representation, so that a
+ * segment is received without allocations or intermediate copies.  A slab
+ * is taken when the download starts, filled as data arrives and committed
+ * when the session accepts the segment; an upgrade replaces the buffered
+ * slab of its segment in place.  Played segments are released.
+ */
+struct dofp_slab
+{
+    unsigned            dsl_q;
+    unsigned            dsl_seg_ind;    /* 1-based */
+    size_t              dsl_len;        /* Bytes received */
+    size_t              dsl_size;       /* Capacity of dsl_buf */
+    unsigned char      *dsl_buf;
+    struct dofp_slab   *dsl_next;       /* Free list of the representation */
+};
+
+struct dofp_pool;
+
+/**
+ * Create a pool with `n_slabs' slabs per representation allocated up
+ * front; more are allocated if needed.  Returns NULL on error.
+ */
+struct dofp_pool *
+dofp_pool_new (const struct dofp_ladder *, unsigned n_slabs);
+
+void
+dofp_pool_destroy (struct dofp_pool *);
+
+/** Take an empty slab for segment `seg_ind' of representation `q' */
+struct dofp_slab *
+dofp_pool_get (struct dofp_pool *, unsigned q, unsigned seg_ind);
+
+/**
+ * Append received data.  The slab grows if the segment is larger than
+ * its representation suggested.  Returns 0 or -1.
+ */
+int
+dofp_slab_append (struct dofp_slab *, const void *buf, size_t len);
+
+/** Give back a slab that is not committed, e.g. a cancelled download */
+void
+dofp_pool_put (struct dofp_pool *, struct dofp_slab *);
+
+/**
+ * The slab becomes the buffered media of its segment.  A slab already
+ * buffered for the segment, of a lower quality, goes back to the pool.
+ * Returns 0 or -1.
+ */
+int
+dofp_pool_commit (struct dofp_pool *, struct dofp_slab *);
+
+/** Buffered media of segment `seg_ind', NULL if there is none */
+const struct dofp_slab *
+dofp_pool_segment (const struct dofp_pool *, unsigned seg_ind);
+
+/** Release the buffered segments before `seg_ind' */
+void
+dofp_pool_release (struct dofp_pool *, unsigned seg_ind);
+
+/** Bytes of media in the buffer */
+size_t
+dofp_pool_buffered (const struct dofp_pool *);
+
+/**
+ * DoFP+ gap planning, formerly milp.py.  The window is the segment being
+ * played, q[0], followed by the n - 1 buffered segments; the next segment
+ * comes after them.  A gap is a run of buffered segments at the same
+ * quality, lower than the segment before it, that may be re-downloaded up
+ * to a target quality.
+ */
+struct dofp_gap
+{
+    unsigned            dg_first;   /* Index in the window */
+    unsigned            dg_n;
+    unsigned            dg_q;
+    unsigned            dg_target;
+};
+
+/**
+ * Find the gaps of the window, in the order of the window, with `n_rep'
+ * representations.  `gaps' must have room for n entries.  Returns the
+ * number of gaps.
+ */
+unsigned
+dofp_gaps_find (const unsigned *q, unsigned n, unsigned n_rep,
+                                                        struct dofp_gap *gaps);
+
+/** Order gaps by quality, lowest first; equal gaps stay in window order */
+void
+dofp_gaps_order (struct dofp_gap *gaps, unsigned n_gaps);
+
+struct dofp_gap_params
+{
+    const int          *dgp_bitrates;   /* [kbps] */
+    unsigned            dgp_n_rep;
+    unsigned            dgp_seg_len;    /* [s] */
+    double              dgp_throughput; /* [kbps] */
+    double              dgp_buffer;     /* Buffer level [s] */
+    double              dgp_buffer_size;/* [s] */
+    double              dgp_play_left;  /* Until q[0] is played out [s] */
+    /* Upgrade at most one gap per decision */
+    bool                dgp_one_gap;
+};
+
+/**
+ * Pick the quality of the next segment and the re-downloads of the window.
+ * `new_q' receives n + 1 qualities: the window, upgraded, and the next
+ * segment last.  `ret' receives the indexes of the upgraded segments in
+ * download order: gaps from the lowest, each from its last segment.  The
+ * window is at most DOFP_MAX_RET + 1 segments.  Returns 0 or -1.
+ */
+int
+dofp_gaps_plan (const struct dofp_gap_params *, const unsigned *q,
+            unsigned n, unsigned *new_q, unsigned *ret, unsigned *n_ret);
+
+/**
+ * Segment cache of a server: segment files mapped in memory, or read into
+ * it if they cannot be mapped, and shared by all the streams that send
+ * them.  Entries are reference counted.  When the cache holds more than its
+ * budget, the least recently used entries that no stream holds are dropped.
+ * The files must not change while they are cached.
+ */
+struct dofp_cached_seg
+{
+    const unsigned char    *dcs_buf;
+    size_t                  dcs_len;
+};
+
+struct dofp_cache;
+
+/** `budget' is in bytes.  Returns NULL on error. */
+struct dofp_cache *
+dofp_cache_new (size_t budget);
+
+/** All the segments must have been put back */
+void
+dofp_cache_destroy (struct dofp_cache *);
+
+/**
+ * Take a reference to the segment in file `path', which is loaded if it is
+ * not cached.  Returns NULL with errno set if the file cannot be read.
+ */
+const struct dofp_cached_seg *
+dofp_cache_get (struct dofp_cache *, const char *path);
+
+/** Drop a reference taken by dofp_cache_get() */
+void
+dofp_cache_put (struct dofp_cache *, const struct dofp_cached_seg *);
+
+/** Bytes of the cached segments */
+size_t
+dofp_cache_size (const struct dofp_cache *);
+
+/**
+ * Write the path of the segment `delta' segments after the one in `path' to
+ * `buf': the last number of the file name before the extension is the
+ * segment index, as in tos1_h264/2426/segment_12.m4s.  Returns the length
+ * of the path, or -1 if the file name has no number or the path does not
+ * fit.
+ */
+int
+dofp_seg_path_next (const char *path, unsigned delta, char *buf,
+                                                                size_t bufsz);
+
+/**
+ * Bandwidth trace: a sequence of constant rates.  Traces loop: a transfer
+ * that outlasts the trace continues from its first step.
+ */
+struct dofp_trace_step
+{
+    dofp_time_t         dts_start;  /* Offset from the start of the trace */
+    dofp_time_t         dts_dur;
+    double              dts_rate;   /* [kbps] */
+};
+
+struct dofp_trace
+{
+    char               *dt_name;    /* File name without the directories */
+    unsigned            dt_n_steps;
+    dofp_time_t         dt_len;     /* Sum of the step durations */
+    struct dofp_trace_step *dt_steps;
+};
+
+/**
+ * Load a trace from a shell script in the format of
+ * bin/A_2018_01_26_11_26_26_good_4M.sh: every `tc qdisc add|change ... rate
+ * R' line sets a rate that holds for the `sleep' lines that follow it.
+ * Returns NULL on error.
+ */
+struct dofp_trace *
+dofp_trace_load (const char *filename);
+
+void
+dofp_trace_destroy (struct dofp_trace *);
+
+/**
+ * Time needed to transfer `kbit' starting at `start' [us].  Returns
+ * (dofp_time_t) -1 if the trace carries no data at all.
+ */
+dofp_time_t
+dofp_trace_transfer_time (const struct dofp_trace *, dofp_time_t start,
+                                                                double kbit);
+
+/** Data transferred within `dur' starting at `start' [kbit] */
+double
+dofp_trace_volume (const struct dofp_trace *, dofp_time_t start,
+                                                            dofp_time_t dur);
+
+struct dofp_sim_params
+{
+    dofp_time_t         dsp_rtt;    /* Added to every download */
+};
+
+/**
+ * Play the whole content of a new session over the trace, without a
+ * network: downloads are sequential, like http_client_dofp -w 1, and take
+ * the time the trace needs to carry the segment plus one round trip.  The
+ * session must have been created at time 0, which is the start of the trace.
+ * Solver jobs are run in place.  On return, the session has the same
+ * metrics as after a run over the network.  Live content has no end and
+ * cannot be played.  Returns 0 on success and -1 on error.
+ */
+int
+dofp_sim_run (struct dofp_session *, const struct dofp_trace *,
+                                            const struct dofp_sim_params *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
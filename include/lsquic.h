@@ -218,6 +218,17 @@ struct lsquic_stream_if {
     void (*on_conncloseframe_received)(lsquic_conn_t *c,
                                        int app_error, uint64_t error_code,
                                        const char *reason, int reason_len);
+    /**
+     * Optional callback is called once when the stream misses the deadline
+     * set by @ref lsquic_stream_set_deadline(): the deadline has passed or,
+     * at the current delivery rate, the remaining data will arrive after
+     * it.  The deadline is checked as data arrives on the stream and by
+     * a connection alarm, so a stalled stream misses it too.  The
+     * callback is called from the read event dispatch, before on_read(),
+     * so the stream must want to read.  Typically, the stream is closed or
+     * reset here.
+     */
+    void (*on_deadline) (lsquic_stream_t *s, lsquic_stream_ctx_t *h);
 };
 
 struct ssl_ctx_st;
@@ -432,6 +443,9 @@ typedef struct ssl_ctx_st * (*lsquic_lookup_cert_f)(
 /** Transport parameter sanity checks are performed by default. */
 #define LSQUIC_DF_CHECK_TP_SANITY 1
 
+/** By default, streams with a deadline are scheduled like other streams. */
+#define LSQUIC_DF_DEADLINE_SCHED 0
+
 struct lsquic_engine_settings {
     /**
      * This is a bit mask wherein each bit corresponds to a value in
@@ -1054,6 +1068,17 @@ struct lsquic_engine_settings {
      * Default value is @ref LSQUIC_DF_CHECK_TP_SANITY
      */
     int             es_check_tp_sanity;
+
+    /**
+     * If set to true, IETF QUIC connections give bandwidth to the streams
+     * that have a deadline (see @ref lsquic_stream_set_deadline()) before
+     * the other non-critical streams, the stream closest to missing its
+     * deadline first.  The time a stream needs is the rest of its expected
+     * size at the send bandwidth estimate.
+     *
+     * Default value is @ref LSQUIC_DF_DEADLINE_SCHED
+     */
+    int             es_deadline_sched;
 };
 
 /* Initialize `settings' to default values */
@@ -1400,6 +1425,34 @@ lsquic_engine_packet_in (lsquic_engine_t *,
         const struct sockaddr *sa_local, const struct sockaddr *sa_peer,
         void *peer_ctx, int ecn);
 
+/**
+ * Incoming packet passed to @ref lsquic_engine_packets_in().
+ */
+struct lsquic_in_spec
+{
+    const unsigned char   *data;
+    size_t                 sz;
+    const struct sockaddr *local_sa;
+    const struct sockaddr *peer_sa;
+    int                    ecn;       /* Valid values are 0 - 3.  See RFC 3168 */
+};
+
+/**
+ * Pass several incoming packets received on the same socket to the QUIC
+ * engine.  This is the same as calling @ref lsquic_engine_packet_in() for
+ * each of them, except that the connection a packet belongs to is looked up
+ * once for consecutive packets with the same destination connection ID.
+ * Several packets split from one UDP GRO datagram, for example, are all
+ * for the same connection.
+ *
+ * @return  Number of packets passed to the engine.  If it is smaller than
+ *          `count', an error occurred on the packet that follows (see
+ *          @ref lsquic_engine_packet_in()).
+ */
+unsigned
+lsquic_engine_packets_in (lsquic_engine_t *,
+        const struct lsquic_in_spec *, unsigned count, void *peer_ctx);
+
 /**
  * Process tickable connections.  This function must be called often enough so
  * that packets and connections do not expire.
@@ -1737,6 +1790,61 @@ unsigned lsquic_stream_priority (const lsquic_stream_t *s);
  */
 int lsquic_stream_set_priority (lsquic_stream_t *s, unsigned priority);
 
+/**
+ * Progress of a stream, see @ref lsquic_stream_get_progress().  Sizes are
+ * in stream bytes, HTTP/3 framing included.
+ */
+struct lsquic_stream_progress
+{
+    /** Highest offset received and offset read by the user */
+    uint64_t    lsp_bytes_received, lsp_bytes_read;
+    /** Bytes packetized so far */
+    uint64_t    lsp_bytes_sent;
+    /**
+     * Bytes of STREAM frames, frame headers included, acknowledged by the
+     * peer and still in flight.
+     */
+    uint64_t    lsp_bytes_acked, lsp_bytes_in_flight;
+    /**
+     * Rate at which the stream receives data [bytes per second], measured
+     * over intervals of one smoothed RTT since the first call to
+     * @ref lsquic_stream_get_progress() or @ref lsquic_stream_set_deadline().
+     * Zero if not known yet.
+     */
+    uint64_t    lsp_rate;
+    /**
+     * Time until the rest of the data arrives at that rate [microseconds].
+     * Zero if the expected size or the rate is not known.
+     */
+    uint64_t    lsp_eta;
+};
+
+/**
+ * Get the progress of the stream.  The first call starts measuring the
+ * delivery rate.
+ *
+ * @retval   0  Success.
+ * @retval  -1  Out of memory.
+ */
+int
+lsquic_stream_get_progress (lsquic_stream_t *,
+                                        struct lsquic_stream_progress *);
+
+/**
+ * Expect `size' bytes on the stream within `usec' microseconds from now.
+ * If `size' is zero, the final size of the stream is used once known.
+ * When the deadline is missed, @ref lsquic_stream_if.on_deadline is called.
+ * A `usec' of zero removes the deadline.
+ *
+ * On the sending side, `size' is the number of bytes to write and the
+ * deadline is used to schedule the stream if @ref es_deadline_sched is set.
+ *
+ * @retval   0  Success.
+ * @retval  -1  Out of memory.
+ */
+int
+lsquic_stream_set_deadline (lsquic_stream_t *, uint64_t usec, uint64_t size);
+
 /*
  * Definitions for Extensible HTTP Priorities:
  * https://tools.ietf.org/html/draft-ietf-httpbis-priority-01
@@ -1805,6 +1913,43 @@ lsquic_conn_get_min_datagram_size (lsquic_conn_t *);
 int
 lsquic_conn_set_min_datagram_size (lsquic_conn_t *, size_t sz);
 
+/**
+ * Transport's view of the connection, see @ref lsquic_conn_get_info().
+ * Times are in microseconds and rates in bytes per second.  Zero means
+ * that there is no estimate yet.
+ */
+struct lsquic_conn_info
+{
+    /** Smoothed RTT, its variation and the minimum RTT */
+    uint64_t            lci_srtt, lci_rttvar, lci_min_rtt;
+    /** Congestion window and bytes in flight */
+    uint64_t            lci_cwnd, lci_bytes_in_flight;
+    /** Pacing rate */
+    uint64_t            lci_pacing_rate;
+    /**
+     * Bandwidth estimate of the congestion controller, for the sending
+     * direction: the maximum-filtered delivery rate with BBR, congestion
+     * window over smoothed RTT with Cubic.
+     */
+    uint64_t            lci_send_bw;
+    /** Bytes received on the connection, in UDP payloads */
+    uint64_t            lci_bytes_in;
+    /**
+     * Receive-side delivery rate, measured as packets arrive over intervals
+     * of one smoothed RTT while the peer is sending: the last interval and
+     * the maximum over the last ten.  Idle time does not count.
+     */
+    uint64_t            lci_recv_rate, lci_recv_rate_max;
+};
+
+/**
+ * Get RTT, congestion control and delivery rate estimates of the
+ * connection.  Returns 0 on success and -1 if the connection does not
+ * provide them: only full IETF QUIC connections do.
+ */
+int
+lsquic_conn_get_info (lsquic_conn_t *, struct lsquic_conn_info *);
+
 struct lsquic_logger_if {
     int     (*log_buf)(void *logger_ctx, const char *buf, size_t len);
 };
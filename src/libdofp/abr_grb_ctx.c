@@ -0,0 +1,526 @@
+/* Persistent Gurobi context for the DoFP+ ABR models
+ *
+ * getMaxJCoefficients() and its siblings start a new Gurobi environment and
+ * build a new model for every decision.  Here the environment is started once
+ * and a model skeleton is cached for every (model, n_seg, multistream)
+ * combination.  The skeleton covers the full ladder of every segment, so that
+ * its structure does not depend on the decision inputs:
+ *
+ *  - a_{ij} for j < min_q[i] are disabled through their upper bound;
+ *  - the indicator "a_{i,min_q[i]} == 1" is a binary s_i tied to a_{i,min_q[i]}
+ *    by a linking row whose coefficients move when min_q[i] changes;
+ *  - the indicator constraints become big-M rows, so that available_times,
+ *    bitrates and bandwidth are plain coefficient and right-hand side updates;
+ *  - j* <= j for the chosen j is linearized as j* + (N-1) a_{ij} <= j + N-1.
+ *
+ * The instability variables of the quality-instability model are left out:
+ * they have no constraints and a negative objective coefficient, so they are
+ * always zero.
+ *
+ * Every decision warm-starts from the previous solution of the same skeleton,
+ * shifted by one segment.
+ */
+
+#include <string.h>
+#include <sys/queue.h>
+
+#include "abr_grb_ctx.h"
+
+struct abr_grb_skel
+{
+    SLIST_ENTRY(abr_grb_skel)   next;
+    GRBmodel                   *model;
+    enum abr_grb_model          kind;
+    unsigned                    n_rep;
+    unsigned                    n_seg;
+    bool                        multistream;
+    bool                        has_jstar;
+    bool                        has_prev;
+    int                         n_vars;
+    int                         bw_row;
+    int                         zero_row0;  /* s_i == 1 -> T_i == 0 */
+    unsigned                    n_zero;
+    int                         ms_row0;    /* Multi-stream: T_i >= T_j */
+    unsigned                   *cur_min_q;  /* Current linking rows */
+    unsigned                   *prev_q;     /* Last solution */
+};
+
+struct abr_grb_ctx
+{
+    GRBenv                     *env;
+    SLIST_HEAD(, abr_grb_skel)  skels;
+};
+
+/* Variable indices in the skeleton */
+#define VAR_A(sk, i, j) ((int) ((i) * (sk)->n_rep + (j)))
+#define VAR_T(sk, i) ((int) ((sk)->n_seg * (sk)->n_rep + (i)))
+#define VAR_S(sk, i) ((int) ((sk)->n_seg * (sk)->n_rep + (sk)->n_seg + (i)))
+#define VAR_JSTAR(sk) ((int) ((sk)->n_seg * (sk)->n_rep + 2 * (sk)->n_seg))
+
+/* Row indices of the groups that do not depend on the model.  The first
+ * n_seg rows are the sum(a_{ij}) == 1 constraints.
+ */
+#define ROW_LINK(sk, i) ((int) ((sk)->n_seg + (i)))
+#define ROW_DEADLINE(sk, i) ((int) (2 * (sk)->n_seg + (i)))
+
+
+struct abr_grb_ctx *
+abr_grb_ctx_new (void)
+{
+    struct abr_grb_ctx *ctx;
+    int error;
+
+    ctx = calloc(1, sizeof(*ctx));
+    if (!ctx)
+        return NULL;
+
+    error = GRBemptyenv(&ctx->env);
+    if (error) goto QUIT;
+
+    error = GRBstartenv(ctx->env);
+    if (error) goto QUIT;
+
+    SLIST_INIT(&ctx->skels);
+    return ctx;
+
+  QUIT:
+    if (ctx->env)
+    {
+        printf("ERROR: %s\n", GRBgeterrormsg(ctx->env));
+        GRBfreeenv(ctx->env);
+    }
+    free(ctx);
+    return NULL;
+}
+
+
+static void
+skel_destroy (struct abr_grb_skel *sk)
+{
+    GRBfreemodel(sk->model);
+    free(sk->cur_min_q);
+    free(sk->prev_q);
+    free(sk);
+}
+
+
+void
+abr_grb_ctx_destroy (struct abr_grb_ctx *ctx)
+{
+    struct abr_grb_skel *sk;
+
+    while ((sk = SLIST_FIRST(&ctx->skels)))
+    {
+        SLIST_REMOVE_HEAD(&ctx->skels, next);
+        skel_destroy(sk);
+    }
+    GRBfreeenv(ctx->env);
+    free(ctx);
+}
+
+
+static struct abr_grb_skel *
+skel_new (struct abr_grb_ctx *ctx, enum abr_grb_model kind, unsigned n_rep,
+                                            unsigned n_seg, bool multistream)
+{
+    struct abr_grb_skel *sk;
+    unsigned i, j, k, n_val;
+    int error = 0;
+
+    sk = calloc(1, sizeof(*sk));
+    if (!sk)
+        return NULL;
+    sk->kind = kind;
+    sk->n_rep = n_rep;
+    sk->n_seg = n_seg;
+    sk->multistream = multistream;
+    sk->has_jstar = kind != ABR_GRB_MAX_J;
+    sk->n_vars = n_seg * n_rep + 2 * n_seg + sk->has_jstar;
+    sk->cur_min_q = calloc(n_seg, sizeof(sk->cur_min_q[0]));
+    sk->prev_q = calloc(n_seg, sizeof(sk->prev_q[0]));
+    if (!sk->cur_min_q || !sk->prev_q)
+    {
+        free(sk->cur_min_q);
+        free(sk->prev_q);
+        free(sk);
+        return NULL;
+    }
+
+    int ind[n_rep + n_seg + 2];
+    double val[n_rep + n_seg + 2];
+    char vtype[sk->n_vars];
+
+    error = GRBnewmodel(ctx->env, &sk->model, "dofpSkeleton", 0, NULL, NULL,
+                                                    NULL, NULL, NULL);
+    if (error) goto QUIT;
+
+    for (i = 0; i < n_seg * n_rep; i++)
+        vtype[i] = GRB_BINARY;                      /* a_{ij} */
+    for (i = 0; i < n_seg; i++)
+    {
+        vtype[VAR_T(sk, i)] = GRB_INTEGER;          /* Throughputs */
+        vtype[VAR_S(sk, i)] = GRB_BINARY;           /* a_{i,min_q[i]} */
+    }
+    if (sk->has_jstar)
+        vtype[VAR_JSTAR(sk)] = GRB_INTEGER;         /* j* */
+
+    /* Objective coefficients are set for every decision */
+    error = GRBaddvars(sk->model, sk->n_vars, 0, NULL, NULL, NULL, NULL,
+                                                    NULL, NULL, vtype, NULL);
+    if (error) goto QUIT;
+
+    error = GRBsetintattr(sk->model, GRB_INT_ATTR_MODELSENSE, GRB_MAXIMIZE);
+    if (error) goto QUIT;
+
+    /* For every i -> sum(a_{ij}) == 1 */
+    for (i = 0; i < n_seg; i++) {
+        for (j = 0; j < n_rep; j++) {
+            ind[j] = VAR_A(sk, i, j);
+            val[j] = 1.0;
+        }
+        error = GRBaddconstr(sk->model, n_rep, ind, val, GRB_EQUAL, 1.0, NULL);
+        if (error) goto QUIT;
+    }
+
+    /* For every i -> s_i - a_{i,min_q[i]} == 0, with min_q[i] = 0 for now */
+    for (i = 0; i < n_seg; i++) {
+        ind[0] = VAR_S(sk, i);
+        val[0] = 1.0;
+        ind[1] = VAR_A(sk, i, 0);
+        val[1] = -1.0;
+        error = GRBaddconstr(sk->model, 2, ind, val, GRB_EQUAL, 0.0, NULL);
+        if (error) goto QUIT;
+    }
+
+    /* For every i -> SD x ri - di * Ti - M * s_i <= 0, coefficients are set
+     * for every decision.
+     */
+    for (i = 0; i < n_seg; i++) {
+        n_val = 0;
+        for (j = 0; j < n_rep; j++) {
+            ind[n_val] = VAR_A(sk, i, j);
+            val[n_val] = 1.0;
+            n_val++;
+        }
+        ind[n_val] = VAR_T(sk, i);
+        val[n_val] = -1.0;
+        n_val++;
+        ind[n_val] = VAR_S(sk, i);
+        val[n_val] = -1.0;
+        n_val++;
+        error = GRBaddconstr(sk->model, n_val, ind, val, GRB_LESS_EQUAL, 0.0,
+                                                                        NULL);
+        if (error) goto QUIT;
+    }
+
+    /* sum(Ti) <= Bandwidth */
+    sk->bw_row = 3 * n_seg;
+    for (i = 0; i < n_seg; i++) {
+        ind[i] = VAR_T(sk, i);
+        val[i] = 1.0;
+    }
+    error = GRBaddconstr(sk->model, n_seg, ind, val, GRB_LESS_EQUAL, 0.0, NULL);
+    if (error) goto QUIT;
+
+    /* s_i == 1 -> Ti == 0 as Ti + B * s_i <= B.  The min-J models let the
+     * last segment be downloaded at quality 0.
+     */
+    sk->zero_row0 = sk->bw_row + 1;
+    sk->n_zero = sk->has_jstar ? n_seg - 1 : n_seg;
+    for (i = 0; i < sk->n_zero; i++) {
+        ind[0] = VAR_T(sk, i);
+        val[0] = 1.0;
+        ind[1] = VAR_S(sk, i);
+        val[1] = 1.0;
+        error = GRBaddconstr(sk->model, 2, ind, val, GRB_LESS_EQUAL, 0.0, NULL);
+        if (error) goto QUIT;
+    }
+
+    /* Multi-stream: s_i == 0 -> Ti >= Tj as Ti - Tj + B * s_i >= 0 for every
+     * i except the last one, and T_last >= Tj always.
+     */
+    sk->ms_row0 = sk->zero_row0 + sk->n_zero;
+    if (multistream) {
+        for (i = 0; i < n_seg - 1; i++) {
+            for (j = 0; j < n_seg; j++) {
+                if (i == j)
+                    continue;
+                ind[0] = VAR_T(sk, i);
+                val[0] = 1.0;
+                ind[1] = VAR_T(sk, j);
+                val[1] = -1.0;
+                ind[2] = VAR_S(sk, i);
+                val[2] = 1.0;
+                error = GRBaddconstr(sk->model, 3, ind, val, GRB_GREATER_EQUAL,
+                                                                    0.0, NULL);
+                if (error) goto QUIT;
+            }
+        }
+        for (j = 0; j < n_seg - 1; j++) {
+            ind[0] = VAR_T(sk, n_seg - 1);
+            val[0] = 1.0;
+            ind[1] = VAR_T(sk, j);
+            val[1] = -1.0;
+            error = GRBaddconstr(sk->model, 2, ind, val, GRB_GREATER_EQUAL, 0.0,
+                                                                        NULL);
+            if (error) goto QUIT;
+        }
+    }
+
+    /* For every i and j -> j* + (N-1) a_{ij} <= j + N-1 */
+    if (sk->has_jstar)
+        for (i = 0; i < n_seg; i++)
+            for (k = 0; k < n_rep; k++) {
+                ind[0] = VAR_JSTAR(sk);
+                val[0] = 1.0;
+                ind[1] = VAR_A(sk, i, k);
+                val[1] = (double) (n_rep - 1);
+                error = GRBaddconstr(sk->model, 2, ind, val, GRB_LESS_EQUAL,
+                                            (double) (k + n_rep - 1), NULL);
+                if (error) goto QUIT;
+            }
+
+    if (kind == ABR_GRB_QI_NORM) {
+        error = GRBsetintparam(GRBgetenv(sk->model), "DualReductions", 0);
+        if (error) goto QUIT;
+    }
+
+    error = GRBupdatemodel(sk->model);
+    if (error) goto QUIT;
+
+    return sk;
+
+  QUIT:
+    printf("ERROR: %s\n", GRBgeterrormsg(ctx->env));
+    skel_destroy(sk);
+    return NULL;
+}
+
+
+static struct abr_grb_skel *
+skel_get (struct abr_grb_ctx *ctx, enum abr_grb_model kind, unsigned n_rep,
+                                            unsigned n_seg, bool multistream)
+{
+    struct abr_grb_skel *sk;
+
+    SLIST_FOREACH(sk, &ctx->skels, next)
+        if (sk->kind == kind && sk->n_rep == n_rep && sk->n_seg == n_seg
+                                        && sk->multistream == multistream)
+            return sk;
+
+    sk = skel_new(ctx, kind, n_rep, n_seg, multistream);
+    if (sk)
+        SLIST_INSERT_HEAD(&ctx->skels, sk, next);
+    return sk;
+}
+
+
+static void
+fill_objective (const struct abr_grb_skel *sk, double alpha, double beta,
+                                                                double *obj)
+{
+    const unsigned n_rep = sk->n_rep, n_seg = sk->n_seg;
+    double normal_factor = 0.0;
+    unsigned i, j;
+
+    for (i = 0; i < n_seg; i++)
+        normal_factor += pow((double) n_rep-1, (double) i + 2);
+
+    for (i = 0; i < (unsigned) sk->n_vars; i++)
+        obj[i] = 0.0;
+
+    for (i = 0; i < n_seg; i++)
+        for (j = 0; j < n_rep; j++)
+            switch (sk->kind)
+            {
+            case ABR_GRB_MAX_J:
+            case ABR_GRB_MAX_MIN_J:
+                obj[VAR_A(sk, i, j)] = (double) j;
+                break;
+            case ABR_GRB_MAX_MIN_J_NORM:
+                obj[VAR_A(sk, i, j)] = alpha * j
+                        * pow((double) n_rep-1, (double) i + 1) / normal_factor;
+                break;
+            case ABR_GRB_QI_NORM:
+                obj[VAR_A(sk, i, j)] = alpha * j
+                        * pow((double) n_rep-1, (double) i + 1)
+                                            / (normal_factor + (n_rep - 1));
+                break;
+            }
+
+    switch (sk->kind)
+    {
+    case ABR_GRB_MAX_J:
+        break;
+    case ABR_GRB_MAX_MIN_J:
+        obj[VAR_JSTAR(sk)] = 1.0;
+        break;
+    case ABR_GRB_MAX_MIN_J_NORM:
+        obj[VAR_JSTAR(sk)] = beta / (n_rep-1);
+        break;
+    case ABR_GRB_QI_NORM:
+        obj[VAR_JSTAR(sk)] = alpha / (normal_factor + (n_rep-1));
+        break;
+    }
+}
+
+
+int
+abr_grb_solve (struct abr_grb_ctx *ctx, enum abr_grb_model kind,
+        unsigned n_rep, unsigned n_seg, unsigned n_par, unsigned seg_dur,
+        double bandwidth, const int* bitrates, double* available_times,
+        unsigned* min_q, double* sol, bool isMultiStream, double alpha,
+        double beta)
+{
+    struct abr_grb_skel *sk;
+    unsigned i, j, k, n_chg, idx, t_off, expected_par;
+    double big_m, big_b;
+    int error = 0;
+
+    if (n_seg == 0 || n_rep == 0)
+    {
+        printf("ERROR: Gurobi context called with an empty model\n");
+        return -1;
+    }
+
+    expected_par = n_seg + (kind != ABR_GRB_MAX_J);
+    for (i = 0; i < n_seg; i++)
+    {
+        if (min_q[i] >= n_rep)
+        {
+            printf("ERROR: Gurobi context: min_q[%u] = %u out of range\n",
+                                                                i, min_q[i]);
+            return -1;
+        }
+        expected_par += n_rep - min_q[i];
+    }
+    if (n_par < expected_par)
+    {
+        printf("ERROR: Gurobi context: n_par is %u, need %u\n", n_par,
+                                                                expected_par);
+        return -1;
+    }
+
+    /* Same override as getMaxQINormCoefficients() */
+    if (kind == ABR_GRB_QI_NORM)
+        seg_dur = 4U;
+
+    sk = skel_get(ctx, kind, n_rep, n_seg,
+                                    kind != ABR_GRB_MAX_J && isMultiStream);
+    if (!sk)
+        return -1;
+
+    const unsigned max_chg = n_seg * (n_rep + 5) + n_seg * n_seg;
+    int cind[max_chg], vind[max_chg];
+    double cval[max_chg];
+    double buf[sk->n_vars];
+
+    big_m = 0.0;
+    for (j = 0; j < n_rep; j++)
+        if ((double) seg_dur * bitrates[j] > big_m)
+            big_m = (double) seg_dur * bitrates[j];
+    big_b = bandwidth > 0 ? bandwidth : 0.0;
+
+    /* Coefficients */
+    n_chg = 0;
+#define CHG(row, var, v) do {                                           \
+    cind[n_chg] = (row); vind[n_chg] = (var); cval[n_chg] = (v); ++n_chg; \
+} while (0)
+    for (i = 0; i < n_seg; i++)
+    {
+        if (sk->cur_min_q[i] != min_q[i])
+        {
+            CHG(ROW_LINK(sk, i), VAR_A(sk, i, sk->cur_min_q[i]), 0.0);
+            CHG(ROW_LINK(sk, i), VAR_A(sk, i, min_q[i]), -1.0);
+        }
+        for (j = 0; j < n_rep; j++)
+            CHG(ROW_DEADLINE(sk, i), VAR_A(sk, i, j),
+                                            (double) seg_dur * bitrates[j]);
+        CHG(ROW_DEADLINE(sk, i), VAR_T(sk, i), - available_times[i]);
+        CHG(ROW_DEADLINE(sk, i), VAR_S(sk, i), - big_m);
+    }
+    for (i = 0; i < sk->n_zero; i++)
+        CHG(sk->zero_row0 + (int) i, VAR_S(sk, i), big_b);
+    if (sk->multistream)
+    {
+        k = 0;
+        for (i = 0; i < n_seg - 1; i++)
+            for (j = 0; j < n_seg; j++)
+                if (i != j)
+                    CHG(sk->ms_row0 + (int) k++, VAR_S(sk, i), big_b);
+    }
+#undef CHG
+    error = GRBchgcoeffs(sk->model, n_chg, cind, vind, cval);
+    if (error) goto QUIT;
+    memcpy(sk->cur_min_q, min_q, n_seg * sizeof(min_q[0]));
+
+    /* Right-hand sides */
+    error = GRBsetdblattrelement(sk->model, GRB_DBL_ATTR_RHS, sk->bw_row,
+                                                                bandwidth);
+    if (error) goto QUIT;
+    for (i = 0; i < sk->n_zero; i++)
+    {
+        error = GRBsetdblattrelement(sk->model, GRB_DBL_ATTR_RHS,
+                                            sk->zero_row0 + (int) i, big_b);
+        if (error) goto QUIT;
+    }
+
+    /* Upper bounds: no quality below the one already buffered */
+    for (i = 0; i < n_seg; i++)
+        for (j = 0; j < n_rep; j++)
+            buf[VAR_A(sk, i, j)] = j >= min_q[i] ? 1.0 : 0.0;
+    error = GRBsetdblattrarray(sk->model, GRB_DBL_ATTR_UB, 0, n_seg * n_rep,
+                                                                        buf);
+    if (error) goto QUIT;
+
+    fill_objective(sk, alpha, beta, buf);
+    error = GRBsetdblattrarray(sk->model, GRB_DBL_ATTR_OBJ, 0, sk->n_vars,
+                                                                        buf);
+    if (error) goto QUIT;
+
+    /* Warm start: the window moved by one segment since the last decision */
+    for (i = 0; i < (unsigned) sk->n_vars; i++)
+        buf[i] = GRB_UNDEFINED;
+    if (sk->has_prev)
+        for (i = 0; i < n_seg; i++)
+        {
+            k = i + 1 < n_seg && sk->prev_q[i + 1] > min_q[i]
+                                            ? sk->prev_q[i + 1] : min_q[i];
+            for (j = 0; j < n_rep; j++)
+                buf[VAR_A(sk, i, j)] = j == k ? 1.0 : 0.0;
+        }
+    error = GRBsetdblattrarray(sk->model, GRB_DBL_ATTR_START, 0, sk->n_vars,
+                                                                        buf);
+    if (error) goto QUIT;
+
+    /* Optimize model */
+    error = GRBoptimize(sk->model);
+    if (error) goto QUIT;
+
+    error = GRBgetdblattrarray(sk->model, GRB_DBL_ATTR_X, 0, sk->n_vars, buf);
+    if (error) goto QUIT;
+
+    /* Write out the solution using the getMax*Coefficients() layout */
+    memset(sol, 0, n_par * sizeof(sol[0]));
+    t_off = n_par - n_seg - sk->has_jstar;
+    idx = 0;
+    for (i = 0; i < n_seg; i++)
+    {
+        for (j = min_q[i]; j < n_rep; j++)
+        {
+            sol[idx++] = buf[VAR_A(sk, i, j)];
+            if (buf[VAR_A(sk, i, j)] > 0.5)
+                sk->prev_q[i] = j;
+        }
+        sol[t_off + i] = buf[VAR_T(sk, i)];
+    }
+    if (sk->has_jstar)
+        sol[n_par - 1] = buf[VAR_JSTAR(sk)];
+    sk->has_prev = true;
+
+    return 0;
+
+  QUIT:
+    printf("ERROR: %s\n", GRBgeterrormsg(ctx->env));
+    return -1;
+}
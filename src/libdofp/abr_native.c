@@ -0,0 +1,315 @@
+/* ABR native solver for the DoFP+ optimization models
+ *
+ * The models in abr_max_j.c, abr_max_min_j.c, abr_max_min_j_norm.c and
+ * abr_quality_instability.c pick one representation j for each of the
+ * n_seg segments of the decision window.  With n_seg <= ~6 and n_rep = 11
+ * the search space is small enough to be explored exactly with a depth-first
+ * branch-and-bound, which takes microseconds instead of a Gurobi environment
+ * start-up plus a model build.
+ *
+ * What the MIP models reduce to:
+ *
+ *  - Keeping the buffered quality (j == min_q[i]) needs no throughput: the
+ *    indicator constraints force T_i = 0.
+ *  - Any other choice needs an integer T_i >= seg_dur * bitrates[j] /
+ *    available_times[i].
+ *  - Single stream: sum(T_i) <= bandwidth.
+ *  - Multi-stream: every upgraded segment and the last segment share the same
+ *    T = max(required T_i), so the cost is (n_upgraded + 1) * T.
+ *  - j* is the minimum chosen quality; its objective weight is model specific.
+ *
+ * Among solutions with the same objective value, the one using the least
+ * throughput is returned.
+ */
+
+#include <float.h>
+#include <string.h>
+
+#include "abr_native.h"
+
+/* Gurobi's default feasibility tolerance */
+#define ABR_NATIVE_EPS 1e-6
+
+struct abr_native_model
+{
+    unsigned            n_rep;
+    unsigned            n_seg;
+    const unsigned     *min_q;
+    const double       *cost;       /* [n_seg][n_rep], DBL_MAX if infeasible */
+    const double       *weight;     /* [n_seg][n_rep] */
+    const double       *best_rest;  /* [n_seg + 1] upper bound of the rest */
+    double              jstar_w;    /* Zero if the model has no j* */
+    double              bandwidth;
+    bool                multistream;
+};
+
+struct abr_native_search
+{
+    const struct abr_native_model *model;
+    unsigned           *cur_q;
+    unsigned           *best_q;
+    double              best_obj;
+    double              best_cost;
+    bool                found;
+};
+
+
+static double
+ms_cost (unsigned n_up, double max_t)
+{
+    return (n_up + 1) * max_t;
+}
+
+
+static void
+search (struct abr_native_search *s, unsigned i, double obj, double sum_t,
+                            unsigned n_up, double max_t, unsigned jmin)
+{
+    const struct abr_native_model *const m = s->model;
+    double cost, bound, jstar_val, new_sum_t, new_max_t;
+    unsigned j, new_n_up, new_jmin;
+
+    cost = m->multistream ? ms_cost(n_up, max_t) : sum_t;
+    jstar_val = m->jstar_w > 0 ? m->jstar_w * jmin : 0.0;
+
+    if (i == m->n_seg)
+    {
+        obj += jstar_val;
+        if (!s->found || obj > s->best_obj + ABR_NATIVE_EPS
+                || (obj > s->best_obj - ABR_NATIVE_EPS
+                                    && cost < s->best_cost - ABR_NATIVE_EPS))
+        {
+            s->found = true;
+            s->best_obj = obj;
+            s->best_cost = cost;
+            memcpy(s->best_q, s->cur_q, m->n_seg * sizeof(s->best_q[0]));
+        }
+        return;
+    }
+
+    /* Costs never decrease and j* can only go down from here */
+    bound = obj + m->best_rest[i] + jstar_val;
+    if (s->found && (bound < s->best_obj - ABR_NATIVE_EPS
+                        || (bound < s->best_obj + ABR_NATIVE_EPS
+                                        && cost >= s->best_cost)))
+        return;
+
+    for (j = m->n_rep; j-- > m->min_q[i]; )
+    {
+        const double t = m->cost[i * m->n_rep + j];
+        if (t == DBL_MAX)
+            continue;
+        new_sum_t = sum_t;
+        new_n_up = n_up;
+        new_max_t = max_t;
+        if (m->multistream)
+        {
+            if (j != m->min_q[i] && i + 1 < m->n_seg)
+                ++new_n_up;
+            if (t > new_max_t)
+                new_max_t = t;
+            if (ms_cost(new_n_up, new_max_t) > m->bandwidth + ABR_NATIVE_EPS)
+                continue;
+        }
+        else
+        {
+            new_sum_t += t;
+            if (new_sum_t > m->bandwidth + ABR_NATIVE_EPS)
+                continue;
+        }
+        new_jmin = j < jmin ? j : jmin;
+        s->cur_q[i] = j;
+        search(s, i + 1, obj + m->weight[i * m->n_rep + j], new_sum_t,
+                                            new_n_up, new_max_t, new_jmin);
+    }
+}
+
+
+/* Fills the costs of the model and runs the search.  Weights are expected to
+ * be filled in by the caller.  Returns 0 on success, -1 if the model cannot
+ * be solved.
+ */
+static int
+solve (unsigned n_rep, unsigned n_seg, unsigned n_par, unsigned seg_dur,
+        double bandwidth, const int *bitrates, const double *available_times,
+        const unsigned *min_q, double *weight, double jstar_w, bool has_jstar,
+        bool isMultiStream, double *sol)
+{
+    double cost[n_seg * n_rep];
+    double best_rest[n_seg + 1];
+    unsigned cur_q[n_seg], best_q[n_seg];
+    unsigned i, j, idx, t_off, expected_par;
+    double req, max_w, max_t, jstar;
+    struct abr_native_model model;
+    struct abr_native_search s;
+
+    if (n_seg == 0 || n_rep == 0)
+    {
+        printf("ERROR: native ABR solver called with an empty model\n");
+        return -1;
+    }
+
+    expected_par = n_seg + (has_jstar ? 1 : 0);
+    for (i = 0; i < n_seg; ++i)
+    {
+        if (min_q[i] >= n_rep)
+        {
+            printf("ERROR: native ABR solver: min_q[%u] = %u out of range\n",
+                                                                i, min_q[i]);
+            return -1;
+        }
+        expected_par += n_rep - min_q[i];
+    }
+    if (n_par < expected_par)
+    {
+        printf("ERROR: native ABR solver: n_par is %u, need %u\n", n_par,
+                                                                expected_par);
+        return -1;
+    }
+
+    for (i = 0; i < n_seg; ++i)
+        for (j = 0; j < n_rep; ++j)
+        {
+            if (j == min_q[i])
+                cost[i * n_rep + j] = 0.0;
+            else if (j < min_q[i] || available_times[i] <= 0)
+                cost[i * n_rep + j] = DBL_MAX;
+            else
+            {
+                /* T_i is an integer variable */
+                req = (double) seg_dur * bitrates[j] / available_times[i];
+                cost[i * n_rep + j] = ceil(req - ABR_NATIVE_EPS);
+            }
+        }
+
+    best_rest[n_seg] = 0.0;
+    for (i = n_seg; i-- > 0; )
+    {
+        max_w = -DBL_MAX;
+        for (j = min_q[i]; j < n_rep; ++j)
+            if (weight[i * n_rep + j] > max_w)
+                max_w = weight[i * n_rep + j];
+        best_rest[i] = best_rest[i + 1] + max_w;
+    }
+
+    model = (struct abr_native_model) {
+        .n_rep       = n_rep,
+        .n_seg       = n_seg,
+        .min_q       = min_q,
+        .cost        = cost,
+        .weight      = weight,
+        .best_rest   = best_rest,
+        .jstar_w     = has_jstar ? jstar_w : 0.0,
+        .bandwidth   = bandwidth,
+        .multistream = isMultiStream,
+    };
+    s = (struct abr_native_search) {
+        .model  = &model,
+        .cur_q  = cur_q,
+        .best_q = best_q,
+    };
+    search(&s, 0, 0.0, 0.0, 0, 0.0, n_rep - 1);
+    if (!s.found)
+    {
+        printf("ERROR: native ABR solver: model is infeasible\n");
+        return -1;
+    }
+
+    /* Write out the solution using the Gurobi variable layout */
+    memset(sol, 0, n_par * sizeof(sol[0]));
+    t_off = n_par - n_seg - (has_jstar ? 1 : 0);
+    idx = 0;
+    max_t = 0.0;
+    jstar = n_rep - 1;
+    for (i = 0; i < n_seg; ++i)
+    {
+        sol[idx + best_q[i] - min_q[i]] = 1.0;
+        idx += n_rep - min_q[i];
+        sol[t_off + i] = cost[i * n_rep + best_q[i]];
+        if (sol[t_off + i] > max_t)
+            max_t = sol[t_off + i];
+        if (best_q[i] < jstar)
+            jstar = best_q[i];
+    }
+    if (isMultiStream)
+        for (i = 0; i < n_seg; ++i)
+            if (best_q[i] != min_q[i] || i + 1 == n_seg)
+                sol[t_off + i] = max_t;
+    if (has_jstar)
+        sol[n_par - 1] = jstar_w > 0 ? jstar : 0.0;
+
+    return 0;
+}
+
+
+int
+getMaxJCoefficientsNative(unsigned n_rep, unsigned n_seg, unsigned n_par, unsigned seg_dur, double bandwidth,
+                    const int* bitrates, double* available_times, unsigned* min_q, double* sol) {
+    double weight[n_seg * n_rep];
+
+    for (size_t i = 0; i < n_seg; i++)
+        for (size_t j = 0; j < n_rep; j++)
+            weight[i * n_rep + j] = (double) j;
+
+    return solve(n_rep, n_seg, n_par, seg_dur, bandwidth, bitrates,
+                available_times, min_q, weight, 0.0, false, false, sol);
+}
+
+
+int
+getMaxMinJCoefficientsNative(unsigned n_rep, unsigned n_seg, unsigned n_par, unsigned seg_dur, double throughput,
+                    const int* bitrates, double* available_times, unsigned* min_q, double* sol, bool isMultiStream) {
+    double weight[n_seg * n_rep];
+
+    for (size_t i = 0; i < n_seg; i++)
+        for (size_t j = 0; j < n_rep; j++)
+            weight[i * n_rep + j] = (double) j;
+
+    return solve(n_rep, n_seg, n_par, seg_dur, throughput, bitrates,
+                available_times, min_q, weight, 1.0, true, isMultiStream, sol);
+}
+
+
+int
+getMaxMinJNormCoefficientsNative(unsigned n_rep, unsigned n_seg, unsigned n_par, unsigned seg_dur, double bandwidth,
+                    const int* bitrates, double* available_times, unsigned* min_q, double* sol, bool isMultiStream, double alpha, double beta, double buffer_level, double buffer_size) {
+    double weight[n_seg * n_rep];
+    double normal_factor = 0.0;
+
+    for (size_t i = 0; i < n_seg; i++)
+        normal_factor += pow((double) n_rep-1, (double) i + 2);
+
+    for (size_t i = 0; i < n_seg; i++)
+        for (size_t j = 0; j < n_rep; j++)
+            weight[i * n_rep + j] = alpha * j * pow((double) n_rep-1, (double) i + 1) / normal_factor;
+
+    return solve(n_rep, n_seg, n_par, seg_dur, bandwidth, bitrates,
+                available_times, min_q, weight, beta / (n_rep-1), true,
+                isMultiStream, sol);
+}
+
+
+int
+getMaxQINormCoefficientsNative(unsigned n_rep, unsigned n_seg, unsigned n_par, unsigned seg_dur, double bandwidth,
+                    const int* bitrates, double* available_times, unsigned* min_q, double* sol, bool isMultiStream, double alpha, double beta) {
+    double weight[n_seg * n_rep];
+    double normal_factor = 0.0;
+
+    /* Same override as getMaxQINormCoefficients() */
+    seg_dur = 4U;
+
+    for (size_t i = 0; i < n_seg; i++)
+        normal_factor += pow((double) n_rep-1, (double) i + 2);
+
+    /* The instability variables have no constraints left in the Gurobi
+     * model and a negative objective coefficient: they are always zero.
+     */
+    for (size_t i = 0; i < n_seg; i++)
+        for (size_t j = 0; j < n_rep; j++)
+            weight[i * n_rep + j] = alpha * j * pow((double) n_rep-1, (double) i + 1) / (normal_factor + (n_rep - 1));
+
+    return solve(n_rep, n_seg, n_par, seg_dur, bandwidth, bitrates,
+                available_times, min_q, weight,
+                alpha / (normal_factor + (n_rep - 1)), true, isMultiStream,
+                sol);
+}
@@ -0,0 +1,177 @@
+/* ABR decision worker thread
+ *
+ * One thread is enough: the client has at most one decision outstanding per
+ * connection, and the Gurobi context is not meant to be used concurrently.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "abr_worker.h"
+
+struct abr_worker
+{
+    pthread_t                   aw_thread;
+    pthread_mutex_t             aw_mutex;
+    pthread_cond_t              aw_cond;
+    TAILQ_HEAD(, abr_job)       aw_todo,
+                                aw_done;
+    int                         aw_fds[2];  /* Worker writes a byte to [1]
+                                             * for every completed job.
+                                             */
+    bool                        aw_stop;
+};
+
+
+static void *
+abr_worker_thread (void *arg)
+{
+    struct abr_worker *const aw = arg;
+    struct abr_job *job;
+    ssize_t nw;
+
+    pthread_mutex_lock(&aw->aw_mutex);
+    while (1)
+    {
+        while (!aw->aw_stop && TAILQ_EMPTY(&aw->aw_todo))
+            pthread_cond_wait(&aw->aw_cond, &aw->aw_mutex);
+        if (aw->aw_stop)
+            break;
+        job = TAILQ_FIRST(&aw->aw_todo);
+        TAILQ_REMOVE(&aw->aw_todo, job, aj_next);
+        pthread_mutex_unlock(&aw->aw_mutex);
+
+        job->aj_status = job->aj_solve(job);
+
+        pthread_mutex_lock(&aw->aw_mutex);
+        TAILQ_INSERT_TAIL(&aw->aw_done, job, aj_next);
+        do
+            nw = write(aw->aw_fds[1], "", 1);
+        while (nw < 0 && errno == EINTR);
+    }
+    pthread_mutex_unlock(&aw->aw_mutex);
+    return NULL;
+}
+
+
+struct abr_worker *
+abr_worker_new (void)
+{
+    struct abr_worker *aw;
+    int flags;
+
+    aw = calloc(1, sizeof(*aw));
+    if (!aw)
+        return NULL;
+
+    TAILQ_INIT(&aw->aw_todo);
+    TAILQ_INIT(&aw->aw_done);
+    if (0 != pipe(aw->aw_fds))
+    {
+        fprintf(stderr, "ABR worker: pipe failed: %s\n", strerror(errno));
+        free(aw);
+        return NULL;
+    }
+    flags = fcntl(aw->aw_fds[0], F_GETFL);
+    if (flags < 0 || 0 != fcntl(aw->aw_fds[0], F_SETFL, flags | O_NONBLOCK))
+    {
+        fprintf(stderr, "ABR worker: fcntl failed: %s\n", strerror(errno));
+        goto err;
+    }
+
+    pthread_mutex_init(&aw->aw_mutex, NULL);
+    pthread_cond_init(&aw->aw_cond, NULL);
+    if (0 != pthread_create(&aw->aw_thread, NULL, abr_worker_thread, aw))
+    {
+        fprintf(stderr, "ABR worker: cannot create thread\n");
+        pthread_cond_destroy(&aw->aw_cond);
+        pthread_mutex_destroy(&aw->aw_mutex);
+        goto err;
+    }
+
+    return aw;
+
+  err:
+    close(aw->aw_fds[0]);
+    close(aw->aw_fds[1]);
+    free(aw);
+    return NULL;
+}
+
+
+void
+abr_worker_destroy (struct abr_worker *aw)
+{
+    struct abr_job *job;
+
+    pthread_mutex_lock(&aw->aw_mutex);
+    aw->aw_stop = true;
+    pthread_cond_signal(&aw->aw_cond);
+    pthread_mutex_unlock(&aw->aw_mutex);
+    pthread_join(aw->aw_thread, NULL);
+
+    while ((job = TAILQ_FIRST(&aw->aw_todo)))
+    {
+        TAILQ_REMOVE(&aw->aw_todo, job, aj_next);
+        free(job);
+    }
+    while ((job = TAILQ_FIRST(&aw->aw_done)))
+    {
+        TAILQ_REMOVE(&aw->aw_done, job, aj_next);
+        free(job);
+    }
+
+    pthread_cond_destroy(&aw->aw_cond);
+    pthread_mutex_destroy(&aw->aw_mutex);
+    close(aw->aw_fds[0]);
+    close(aw->aw_fds[1]);
+    free(aw);
+}
+
+
+int
+abr_worker_fd (const struct abr_worker *aw)
+{
+    return aw->aw_fds[0];
+}
+
+
+int
+abr_worker_submit (struct abr_worker *aw, struct abr_job *job)
+{
+    pthread_mutex_lock(&aw->aw_mutex);
+    if (aw->aw_stop)
+    {
+        pthread_mutex_unlock(&aw->aw_mutex);
+        return -1;
+    }
+    TAILQ_INSERT_TAIL(&aw->aw_todo, job, aj_next);
+    pthread_cond_signal(&aw->aw_cond);
+    pthread_mutex_unlock(&aw->aw_mutex);
+    return 0;
+}
+
+
+struct abr_job *
+abr_worker_next_done (struct abr_worker *aw)
+{
+    struct abr_job *job;
+    char buf[64];
+
+    /* Drain the notifications first: a job completed after this point
+     * writes another byte and the descriptor becomes readable again.
+     */
+    while (read(aw->aw_fds[0], buf, sizeof(buf)) > 0)
+        ;
+
+    pthread_mutex_lock(&aw->aw_mutex);
+    job = TAILQ_FIRST(&aw->aw_done);
+    if (job)
+        TAILQ_REMOVE(&aw->aw_done, job, aj_next);
+    pthread_mutex_unlock(&aw->aw_mutex);
+
+    return job;
+}
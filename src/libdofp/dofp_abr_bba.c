@@ -0,0 +1,79 @@
+/* BBA-0 (chosen_abr 7)
+ *
+ * BBA selects the bitrate based on a function f = a*buffer_level + b: the
+ * lowest bitrate below the reservoir rS, the highest one above the cushion
+ * rS + cuS, and in between the quality only moves when f crosses the
+ * bitrate of the neighbouring representations.
+ */
+
+#include "dofp_int.h"
+
+
+static enum dofp_status
+bba_decide (void *abr_ctx, struct dofp_session *sess,
+                            struct dofp_decision *dec, struct abr_job **aj)
+{
+    const struct dofp_ladder *const ladder = sess->ds_ladder;
+    const int *const seg_bitrates = ladder->dl_bitrates;
+    const unsigned n_rep = ladder->dl_n_rep;
+    const double buffer_level = sess->ds_buffer_level;
+    const double buffer_size = sess->ds_settings.dss_buffer_size;
+    const unsigned last_q = dofp_last_q(sess);
+    double rS, cuS, a, b, f_buff_value;
+    unsigned m_selectedQualityIndex = 0;
+    unsigned m_quality_plus = 0;
+    unsigned m_quality_subtract = 0;
+    int i;
+
+    rS = sess->ds_settings.dss_bba_reservoir * buffer_size;
+    cuS = sess->ds_settings.dss_bba_cushion * buffer_size;
+    a = 1.0 * (seg_bitrates[n_rep-1] - seg_bitrates[0])/cuS;
+    b = seg_bitrates[0] - rS * a;
+    f_buff_value = a * buffer_level + b; // (kbps)
+
+    // determine plus quality
+    if (last_q == n_rep-1)   // if the last selected segment's quality == the highest one
+        m_quality_plus = n_rep-1;
+    else
+        m_quality_plus = last_q+1;   // the plus quality is the next higher level
+
+    // determine subtract quality
+    if (last_q == 0)
+        m_quality_subtract = 0;
+    else
+        m_quality_subtract = last_q-1; // the subtract quality is the previous lower level
+
+    // determine the next segment's bitrate
+    if (buffer_level <= rS)
+        m_selectedQualityIndex = 0;
+    else if (buffer_level >= (rS + cuS))
+        m_selectedQualityIndex = n_rep-1;
+    else if (f_buff_value >= seg_bitrates[m_quality_plus]) {
+        for (i = n_rep-1; i >= 0; i--) {
+            if (seg_bitrates[i] < f_buff_value) {
+                m_selectedQualityIndex = i;
+                break;
+            }
+        }
+    }
+    else if (f_buff_value <= seg_bitrates[m_quality_subtract]) {
+        for (i = 0; i < (int) n_rep; i++) {
+            if (seg_bitrates[i] > f_buff_value) {
+                m_selectedQualityIndex = i;
+                break;
+            }
+        }
+    }
+    else
+        m_selectedQualityIndex = last_q;
+
+    dofp_decision_next(sess, dec, m_selectedQualityIndex);
+    return DOFP_DONE;
+}
+
+
+const struct dofp_abr_if dofp_abr_bba =
+{
+    .dai_name       = "bba",
+    .dai_decide     = bba_decide,
+};
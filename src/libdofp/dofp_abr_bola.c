@@ -0,0 +1,94 @@
+/* BOLA (chosen_abr 5)
+ *
+ * Picks the representation that maximizes
+ *   (V (v_m + gamma p) - Q) / S_m
+ * where v_m = ln(S_m / S_1) is the utility of representation m, p the
+ * segment duration and Q the buffer level in segments (equation 9 of the
+ * paper).  V and the utility terms V (v_m + gamma p) only depend on the
+ * ladder and the buffer size: they are computed once per session.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "dofp_int.h"
+
+struct bola_m_stats
+{
+    double        V;             // the control parameter for overflow case
+    double        gma;           // control parameter for rebuffering case
+    unsigned      m_star;        // selected quality
+    double        VVm[];         // V (v_m + gamma p), one per representation
+};
+
+
+static void *
+bola_new (struct dofp_session *sess)
+{
+    const struct dofp_ladder *const ladder = sess->ds_ladder;
+    const unsigned n_rep = ladder->dl_n_rep;
+    const unsigned seg_length = ladder->dl_seg_len;
+    const double buffer_size = sess->ds_settings.dss_buffer_size;
+    struct bola_m_stats *b_m_stats;
+    double Vm;
+    unsigned i;
+
+    b_m_stats = calloc(1, sizeof(*b_m_stats) + n_rep * sizeof(double));
+    if (!b_m_stats)
+        return NULL;
+
+    b_m_stats->gma = 5.0 / seg_length;
+    Vm = log((double) ladder->dl_bitrates[n_rep - 1] / ladder->dl_bitrates[0]);
+    b_m_stats->V = ((buffer_size*1.0/seg_length)-1.0)/(Vm+(b_m_stats->gma*seg_length));
+    for (i = 0; i < n_rep; ++i)
+    {
+        Vm = log((double) ladder->dl_bitrates[i] / ladder->dl_bitrates[0]);
+        b_m_stats->VVm[i] = b_m_stats->V*(Vm + b_m_stats->gma*seg_length);
+    }
+
+    return b_m_stats;
+}
+
+
+static void
+bola_destroy (void *abr_ctx)
+{
+    free(abr_ctx);
+}
+
+
+static enum dofp_status
+bola_decide (void *abr_ctx, struct dofp_session *sess,
+                            struct dofp_decision *dec, struct abr_job **aj)
+{
+    struct bola_m_stats *const b_m_stats = abr_ctx;
+    const struct dofp_ladder *const ladder = sess->ds_ladder;
+    const unsigned n_rep = ladder->dl_n_rep;
+    const double Q = sess->ds_buffer_level / ladder->dl_seg_len;
+    double value, max_value = 0;
+    unsigned i;
+
+    // equation 9; representations whose objective < 0 are skipped
+    for (i = 0; i < n_rep; i++) {
+        if (b_m_stats->VVm[i] <= Q)
+            continue;
+        value = (b_m_stats->VVm[i] - Q) / dofp_seg_size(ladder, i, sess->ds_seg_ind);
+        if (value > max_value)
+        {
+            max_value = value;
+            b_m_stats->m_star = i;
+        }
+    }
+
+    dofp_decision_next(sess, dec, b_m_stats->m_star);
+    return DOFP_DONE;
+}
+
+
+const struct dofp_abr_if dofp_abr_bola =
+{
+    .dai_name       = "bola",
+    .dai_new        = bola_new,
+    .dai_destroy    = bola_destroy,
+    .dai_decide     = bola_decide,
+};
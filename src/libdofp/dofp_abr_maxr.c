@@ -0,0 +1,30 @@
+/* MaxR (chosen_abr 4): highest bitrate below the estimated throughput */
+
+#include "dofp_int.h"
+
+
+static enum dofp_status
+maxr_decide (void *abr_ctx, struct dofp_session *sess,
+                            struct dofp_decision *dec, struct abr_job **aj)
+{
+    const struct dofp_ladder *const ladder = sess->ds_ladder;
+    unsigned chosen_q = 0;
+    int i;
+
+    for (i = ladder->dl_n_rep - 1; i >= 0; i--) {
+        if ((1 - 0.1) * (double) sess->ds_t_stats.tot_throughput > ladder->dl_bitrates[i]) { // 0.1 parameter
+            chosen_q = i;
+            break;
+        }
+    }
+
+    dofp_decision_next(sess, dec, chosen_q);
+    return DOFP_DONE;
+}
+
+
+const struct dofp_abr_if dofp_abr_maxr =
+{
+    .dai_name       = "maxr",
+    .dai_decide     = maxr_decide,
+};
@@ -0,0 +1,256 @@
+/* DoFP+ optimization models (chosen_abr 0-3)
+ *
+ * A decision looks at the window of buffered segments that can still be
+ * re-downloaded plus the next segment, and solves one of the MILP models
+ * for the quality of each of them.  The inputs are copied into a job so that
+ * the model can be solved on the ABR worker while the session keeps playing.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "abr_native.h"
+#if HAVE_GUROBI
+#include "abr_grb_ctx.h"
+#endif
+#include "dofp_int.h"
+
+/* Same numbering as enum abr_grb_model */
+enum milp_model
+{
+    MILP_QI_NORM,
+    MILP_MAX_J,
+    MILP_MAX_MIN_J,
+    MILP_MAX_MIN_J_NORM,
+};
+
+struct milp_job
+{
+    struct dofp_job              base;
+    enum milp_model              model;
+    struct abr_grb_ctx          *grb_ctx;
+    const int                   *bitrates;
+    unsigned                     n_rep;
+    unsigned                     seg_length;
+    unsigned                     group_n;
+    unsigned                     n_par;
+    unsigned                     start_seg_ind;
+    bool                         multistream;
+    double                       throughput;
+    double                       buffer_level;
+    double                       buffer_size;
+    double                       alpha, beta;
+    dofp_time_t                  solve_time;
+    unsigned                    *min_q;
+    double                      *available_times;
+    double                      *sol;
+    double                       buf[];     /* available_times, sol, min_q */
+};
+
+
+static dofp_time_t
+milp_clock (void)
+{
+    struct timespec ts;
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (dofp_time_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+/* Runs on the ABR worker thread */
+static int
+milp_solve (struct abr_job *aj)
+{
+    struct milp_job *const job = (struct milp_job *) aj;
+    const unsigned group_n = job->group_n, n_par = job->n_par;
+    const dofp_time_t init_opt_model = milp_clock();
+    int error;
+
+#if HAVE_GUROBI
+    if (job->grb_ctx)
+        error = abr_grb_solve(job->grb_ctx, (enum abr_grb_model) job->model, job->n_rep, group_n, n_par, job->seg_length, job->throughput, job->bitrates, job->available_times, job->min_q, job->sol, job->multistream, job->alpha, job->beta);
+    else
+#endif
+    switch (job->model)
+    {
+    case MILP_QI_NORM:
+        error = getMaxQINormCoefficientsNative(job->n_rep, group_n, n_par, job->seg_length, job->throughput, job->bitrates, job->available_times, job->min_q, job->sol, job->multistream, job->alpha, job->beta);
+        break;
+    case MILP_MAX_J:
+        error = getMaxJCoefficientsNative(job->n_rep, group_n, n_par, job->seg_length, job->throughput, job->bitrates, job->available_times, job->min_q, job->sol);
+        break;
+    case MILP_MAX_MIN_J:
+        error = getMaxMinJCoefficientsNative(job->n_rep, group_n, n_par, job->seg_length, job->throughput, job->bitrates, job->available_times, job->min_q, job->sol, job->multistream);
+        break;
+    case MILP_MAX_MIN_J_NORM:
+        error = getMaxMinJNormCoefficientsNative(job->n_rep, group_n, n_par, job->seg_length, job->throughput, job->bitrates, job->available_times, job->min_q, job->sol, job->multistream, job->alpha, job->beta, job->buffer_level, job->buffer_size);
+        break;
+    default:
+        error = -1;
+        break;
+    }
+
+    job->solve_time = milp_clock() - init_opt_model;
+    return error;
+}
+
+
+static struct milp_job *
+milp_job_new (struct dofp_session *sess, unsigned group_n, unsigned n_par)
+{
+    struct milp_job *job;
+
+    job = calloc(1, sizeof(*job) + (group_n + n_par) * sizeof(double)
+                                            + group_n * sizeof(unsigned));
+    if (!job)
+        return NULL;
+    job->base.dj_base.aj_solve = milp_solve;
+    job->base.dj_sess = sess;
+    job->group_n = group_n;
+    job->n_par = n_par;
+    job->available_times = job->buf;
+    job->sol = job->buf + group_n;
+    job->min_q = (unsigned *) (job->buf + group_n + n_par);
+    return job;
+}
+
+
+static enum dofp_status
+milp_decide (enum milp_model model, struct dofp_session *sess,
+                                                    struct abr_job **aj)
+{
+    const struct dofp_ladder *const ladder = sess->ds_ladder;
+    const unsigned n_rep = ladder->dl_n_rep;
+    const unsigned seg_length = ladder->dl_seg_len;
+    const unsigned seg_ind = sess->ds_seg_ind, rep_seg_ind = sess->ds_rep_seg_ind;
+    const double buffer_level = sess->ds_buffer_level;
+    const double buffer_size = sess->ds_settings.dss_buffer_size;
+    const double window = sess->ds_settings.dss_milp_window * buffer_size;
+    const double safety = sess->ds_settings.dss_deadline_safety;
+    struct milp_job *job;
+    unsigned start_seg_ind, group_n, n_par;
+    size_t i;
+
+    start_seg_ind = rep_seg_ind;
+    if (buffer_level < window && dofp_ladder_has_seg(ladder, seg_ind + 1))
+        start_seg_ind = seg_ind - 1; // Only download the next segment
+
+    group_n = seg_ind - start_seg_ind;  // Number of segments in the group to be checked for [re-]transmission -> |T|
+    if (!dofp_ladder_has_seg(ladder, seg_ind))
+        group_n--;
+    if (group_n == 0)
+        return DOFP_END;
+
+    unsigned min_q[group_n];
+    for (i = 0; i < group_n; i++)
+        min_q[i] = dofp_seg_q(sess, i + start_seg_ind);
+    if (!dofp_ladder_has_seg(ladder, seg_ind))
+        min_q[group_n - 1] = dofp_seg_q(sess, start_seg_ind + group_n - 1);
+    else
+        min_q[group_n - 1] = 0;
+
+    n_par = group_n; // Throughputs
+    for (i = 0; i < group_n; i++)
+        n_par += n_rep - min_q[i];
+    if (model != MILP_MAX_J)
+        n_par++; // j*
+
+    job = milp_job_new(sess, group_n, n_par);
+    if (!job)
+        return DOFP_ERROR;
+
+    if (buffer_level < window)
+        job->available_times[0] = seg_length * safety;
+    else
+        for (i = 0; i < group_n; i++)
+        {
+            if (i < group_n - 1)
+                job->available_times[i] = (sess->ds_rep_seg_time + (i + start_seg_ind - rep_seg_ind) * seg_length) * safety;
+            else // If last segment (next segment to be downloaded). EPIQ paper: rep_seg_time - buffer_threshold + (i + start_seg_ind - rep_seg_ind) * seg_length
+                job->available_times[i] = seg_length * safety;
+        }
+
+    job->model = model;
+    job->grb_ctx = sess->ds_settings.dss_grb_ctx;
+    job->bitrates = ladder->dl_bitrates;
+    job->n_rep = n_rep;
+    job->seg_length = seg_length;
+    job->start_seg_ind = start_seg_ind;
+    job->multistream = sess->ds_settings.dss_multistream;
+    job->throughput = (double) sess->ds_t_stats.tot_throughput;
+    job->buffer_level = buffer_level;
+    job->buffer_size = buffer_size;
+    job->alpha = sess->ds_settings.dss_alpha;
+    job->beta = sess->ds_settings.dss_beta;
+    memcpy(job->min_q, min_q, group_n * sizeof(min_q[0]));
+
+    *aj = &job->base.dj_base;
+    return DOFP_PENDING;
+}
+
+
+static enum dofp_status
+milp_complete (void *abr_ctx, struct dofp_session *sess, struct abr_job *aj,
+                                                    struct dofp_decision *dec)
+{
+    const struct milp_job *const job = (struct milp_job *) aj;
+    const unsigned group_n = job->group_n;
+    const unsigned start_seg_ind = job->start_seg_ind;
+    const unsigned *const min_q = job->min_q;
+    const double *const sol = job->sol;
+    unsigned temp_ind = 0, i, j;
+
+    dec->dd_solve_time = job->solve_time;
+    if (aj->aj_status == -1 || group_n == 0)
+        return DOFP_ERROR;
+
+    unsigned chosen_q[group_n];
+
+    for (i = 0; i < group_n; i++)
+    {
+        chosen_q[i] = min_q[i];
+        for (j = min_q[i]; j < job->n_rep; j++)
+        {
+            if ((unsigned) (sol[temp_ind]) == 1)
+                chosen_q[i] = j;
+            temp_ind++;
+        }
+    }
+
+    if (dofp_ladder_has_seg(sess->ds_ladder, sess->ds_seg_ind)) // NEW SEGMENTS TO DOWNLOAD
+        dofp_decision_next(sess, dec, chosen_q[group_n - 1]);
+
+    /* Re-download the buffered segments whose chosen quality is higher than
+     * the buffered one.
+     */
+    for (i = 0; i < group_n - 1; ++i)
+        if (chosen_q[i] != min_q[i])
+            (void) dofp_decision_add_ret(dec, i + start_seg_ind + 1,
+                                                                chosen_q[i]);
+
+    return DOFP_DONE;
+}
+
+
+#define MILP_ABR(name_, model_, flags_)                                     \
+static enum dofp_status                                                     \
+name_##_decide (void *abr_ctx, struct dofp_session *sess,                   \
+                        struct dofp_decision *dec, struct abr_job **aj)     \
+{                                                                           \
+    return milp_decide(model_, sess, aj);                                   \
+}                                                                           \
+                                                                            \
+const struct dofp_abr_if dofp_abr_##name_ =                                 \
+{                                                                           \
+    .dai_name       = #name_,                                               \
+    .dai_flags      = DOFP_ABR_ASYNC|DOFP_ABR_RETRANS|(flags_),             \
+    .dai_decide     = name_##_decide,                                       \
+    .dai_complete   = milp_complete,                                        \
+};
+
+MILP_ABR(qi_norm,           MILP_QI_NORM,           DOFP_ABR_CANCEL)
+MILP_ABR(max_j,             MILP_MAX_J,             0)
+MILP_ABR(max_min_j,         MILP_MAX_MIN_J,         DOFP_ABR_CANCEL)
+MILP_ABR(max_min_j_norm,    MILP_MAX_MIN_J_NORM,    DOFP_ABR_CANCEL)
@@ -0,0 +1,166 @@
+/* SARA (chosen_abr 6)
+ *
+ * The throughput is estimated with the weighted harmonic mean H of the
+ * download rates of the last dss_sara_avg_count segments, weighted by their
+ * size.  The sums behind H slide with the window; they are recomputed
+ * once per window to keep the rounding errors from adding up.
+ * The buffer is split by I < B_alpha < B_beta: fast start below I, additive
+ * increase up to B_alpha, aggressive switching up to B_beta and delayed
+ * download above it.
+ */
+
+#include <stdlib.h>
+
+#include "dofp_int.h"
+
+struct sara_stats
+{
+    double        I;
+    double        B_alpha;
+    double        B_beta;
+    double        H;                          // Weighted Harmonic mean of first n segments
+    double        delta;
+    long double   num, den;                   // Sums of the window
+    /* The last dss_sara_avg_count segments, by segment index modulo it */
+    long double  *weights;                    // In KB
+    long double  *down_rate;                  // In KB/s
+    long double   buf[];
+};
+
+
+static void *
+sara_new (struct dofp_session *sess)
+{
+    const unsigned seg_length = sess->ds_ladder->dl_seg_len;
+    const unsigned avg_count = sess->ds_settings.dss_sara_avg_count;
+    struct sara_stats *s_stats;
+
+    s_stats = calloc(1, sizeof(*s_stats) + 2 * avg_count * sizeof(long double));
+    if (!s_stats)
+        return NULL;
+
+    s_stats->I = seg_length;
+    s_stats->B_alpha = 2 * seg_length;
+    s_stats->B_beta = 5 * seg_length;
+    s_stats->weights = s_stats->buf;
+    s_stats->down_rate = s_stats->buf + avg_count;
+    /* Playout starts as soon as the fast start phase is over */
+    sess->ds_settings.dss_min_init_bs = s_stats->I;
+    return s_stats;
+}
+
+
+static void
+sara_destroy (void *abr_ctx)
+{
+    free(abr_ctx);
+}
+
+
+static void
+sara_on_segment (void *abr_ctx, struct dofp_session *sess, unsigned seg_ind,
+                                                                    unsigned q)
+{
+    struct sara_stats *const s_stats = abr_ctx;
+    const unsigned avg_count = sess->ds_settings.dss_sara_avg_count; /* Moving average count */
+    const unsigned slot = (seg_ind - 1) % avg_count;
+    unsigned start_ind = 0;
+    size_t i;
+
+    if (seg_ind > avg_count) {
+        /* Segment seg_ind - avg_count leaves the window */
+        s_stats->num -= s_stats->weights[slot];
+        s_stats->den -= s_stats->weights[slot] / s_stats->down_rate[slot];
+    }
+    s_stats->weights[slot] = dofp_seg_size(sess->ds_ladder, q, seg_ind - 1);
+    s_stats->down_rate[slot] = sess->ds_t_stats.e_temp_throughput;
+    s_stats->num += s_stats->weights[slot];
+    s_stats->den += s_stats->weights[slot] / s_stats->down_rate[slot];
+
+    if (slot == avg_count - 1) {
+        if (seg_ind > avg_count)
+            start_ind = seg_ind - avg_count;
+        s_stats->num = s_stats->den = 0.0;
+        for (i = start_ind; i < seg_ind; i++) {
+            s_stats->num += s_stats->weights[i % avg_count];
+            s_stats->den += s_stats->weights[i % avg_count] / s_stats->down_rate[i % avg_count];
+        }
+    }
+    s_stats->H = (double) (s_stats->num / s_stats->den);
+}
+
+
+static enum dofp_status
+sara_decide (void *abr_ctx, struct dofp_session *sess,
+                            struct dofp_decision *dec, struct abr_job **aj)
+{
+    struct sara_stats *const s_stats = abr_ctx;
+    const struct dofp_ladder *const ladder = sess->ds_ladder;
+    const unsigned n_rep = ladder->dl_n_rep;
+    const unsigned seg_ind = sess->ds_seg_ind;
+    const double buffer_level = sess->ds_buffer_level;
+    const unsigned last_q = dofp_last_q(sess);
+    unsigned l = 0;
+    int i;
+
+#define W(q_) dofp_seg_size(ladder, (q_), seg_ind)
+
+    s_stats->delta = 0.0;
+
+    if (buffer_level > s_stats->I) {
+        if (W(last_q) / s_stats->H > buffer_level - s_stats->I) {
+            for (i = last_q; i >= 0; i--) {
+                if (W(i) / s_stats->H <= buffer_level - s_stats->I) {
+                    l = (unsigned) i;
+                    break;
+                }
+            }
+        } else if (buffer_level <= s_stats->B_alpha) { // Additive increase
+            unsigned qualities_ind_increased = MIN(last_q + 1, n_rep - 1);
+
+            if (W(qualities_ind_increased) / s_stats->H < buffer_level - s_stats->I)
+                l = qualities_ind_increased;
+            else
+                l = last_q;
+        } else if (buffer_level <= s_stats->B_beta) { // Aggressive switching
+            l = last_q;
+            for (i = n_rep - 1; i >= (int) last_q; i--) {
+                if (W(i) / s_stats->H <= buffer_level - s_stats->I) {
+                    l = (unsigned) i;
+                    break;
+                }
+            }
+        } else if (buffer_level > s_stats->B_beta) { // Delayed Download
+            l = last_q;
+            for (i = n_rep - 1; i >= (int) last_q; i--) {
+                if (W(i) / s_stats->H <= buffer_level - s_stats->B_alpha) {
+                    l = (unsigned) i;
+                    break;
+                }
+            }
+            s_stats->delta = buffer_level - s_stats->B_beta;
+        } else
+            l = last_q;
+    }
+    else
+        l = 0;
+
+#undef W
+
+    if (l >= n_rep)
+        l = n_rep - 1;
+
+    dofp_decision_next(sess, dec, l);
+    dec->dd_delay = (dofp_time_t) (s_stats->delta * 1000000);
+    return DOFP_DONE;
+}
+
+
+const struct dofp_abr_if dofp_abr_sara =
+{
+    .dai_name       = "sara",
+    .dai_new        = sara_new,
+    .dai_destroy    = sara_destroy,
+    .dai_on_segment = sara_on_segment,
+    .dai_decide     = sara_decide,
+};
@@ -0,0 +1,303 @@
+/* Segment cache
+ *
+ * Entries are in a hash table keyed by path.  The entries that no stream
+ * holds are also in an LRU list, most recently used first, from which
+ * they are dropped when the cache is over its budget.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/queue.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dofp_int.h"
+
+struct cache_entry
+{
+    struct dofp_cached_seg      ce_seg;     /* First: handed out to streams */
+    struct cache_entry         *ce_next;    /* Hash chain */
+    TAILQ_ENTRY(cache_entry)    ce_lru;
+    unsigned                    ce_hash;
+    unsigned                    ce_refs;
+    bool                        ce_mapped;
+    char                        ce_path[];
+};
+
+struct dofp_cache
+{
+    struct cache_entry        **dc_buckets;
+    unsigned                    dc_n_buckets;   /* Power of two */
+    unsigned                    dc_n_entries;
+    size_t                      dc_size;
+    size_t                      dc_budget;
+    TAILQ_HEAD(cache_lru, cache_entry) dc_lru;
+};
+
+
+/* FNV-1a */
+static unsigned
+path_hash (const char *path)
+{
+    unsigned h = 2166136261u;
+
+    for ( ; *path; ++path)
+        h = (h ^ (unsigned char) *path) * 16777619u;
+    return h;
+}
+
+
+struct dofp_cache *
+dofp_cache_new (size_t budget)
+{
+    struct dofp_cache *cache;
+
+    cache = calloc(1, sizeof(*cache));
+    if (!cache)
+        return NULL;
+    cache->dc_n_buckets = 64;
+    cache->dc_buckets = calloc(cache->dc_n_buckets,
+                                            sizeof(cache->dc_buckets[0]));
+    if (!cache->dc_buckets)
+    {
+        free(cache);
+        return NULL;
+    }
+    cache->dc_budget = budget;
+    TAILQ_INIT(&cache->dc_lru);
+    return cache;
+}
+
+
+static void
+entry_destroy (struct cache_entry *entry)
+{
+    if (entry->ce_mapped)
+        munmap((void *) entry->ce_seg.dcs_buf, entry->ce_seg.dcs_len);
+    else
+        free((void *) entry->ce_seg.dcs_buf);
+    free(entry);
+}
+
+
+void
+dofp_cache_destroy (struct dofp_cache *cache)
+{
+    struct cache_entry *entry;
+    unsigned i;
+
+    for (i = 0; i < cache->dc_n_buckets; ++i)
+        while ((entry = cache->dc_buckets[i]))
+        {
+            cache->dc_buckets[i] = entry->ce_next;
+            entry_destroy(entry);
+        }
+    free(cache->dc_buckets);
+    free(cache);
+}
+
+
+/* Read the file when it cannot be mapped */
+static int
+entry_read (struct cache_entry *entry, int fd, size_t len)
+{
+    unsigned char *buf;
+    size_t off;
+    ssize_t nr;
+
+    buf = malloc(len);
+    if (!buf)
+        return -1;
+    for (off = 0; off < len; off += nr)
+    {
+        nr = pread(fd, buf + off, len - off, off);
+        if (nr <= 0)
+        {
+            if (nr == 0)
+                errno = EIO;
+            free(buf);
+            return -1;
+        }
+    }
+    entry->ce_seg.dcs_buf = buf;
+    return 0;
+}
+
+
+static struct cache_entry *
+entry_load (const char *path, unsigned hash)
+{
+    struct cache_entry *entry;
+    struct stat st;
+    size_t path_len;
+    void *map;
+    int fd, saved_errno;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (0 != fstat(fd, &st))
+        goto err;
+    if (!S_ISREG(st.st_mode))
+    {
+        errno = EISDIR;
+        goto err;
+    }
+    path_len = strlen(path);
+    entry = calloc(1, sizeof(*entry) + path_len + 1);
+    if (!entry)
+        goto err;
+    memcpy(entry->ce_path, path, path_len + 1);
+    entry->ce_hash = hash;
+    entry->ce_seg.dcs_len = st.st_size;
+    if (st.st_size > 0)
+    {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            entry->ce_seg.dcs_buf = map;
+            entry->ce_mapped = true;
+        }
+        else if (0 != entry_read(entry, fd, st.st_size))
+        {
+            free(entry);
+            goto err;
+        }
+    }
+    close(fd);
+    return entry;
+
+  err:
+    saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+    return NULL;
+}
+
+
+static void
+cache_grow (struct dofp_cache *cache)
+{
+    struct cache_entry **buckets, *entry;
+    unsigned n_buckets, i;
+
+    n_buckets = cache->dc_n_buckets * 2;
+    buckets = calloc(n_buckets, sizeof(buckets[0]));
+    if (!buckets)
+        return;     /* Longer chains */
+    for (i = 0; i < cache->dc_n_buckets; ++i)
+        while ((entry = cache->dc_buckets[i]))
+        {
+            cache->dc_buckets[i] = entry->ce_next;
+            entry->ce_next = buckets[entry->ce_hash & (n_buckets - 1)];
+            buckets[entry->ce_hash & (n_buckets - 1)] = entry;
+        }
+    free(cache->dc_buckets);
+    cache->dc_buckets = buckets;
+    cache->dc_n_buckets = n_buckets;
+}
+
+
+static void
+cache_evict (struct dofp_cache *cache)
+{
+    struct cache_entry *entry, **prev;
+
+    while (cache->dc_size > cache->dc_budget
+                            && (entry = TAILQ_LAST(&cache->dc_lru, cache_lru)))
+    {
+        TAILQ_REMOVE(&cache->dc_lru, entry, ce_lru);
+        prev = &cache->dc_buckets[entry->ce_hash & (cache->dc_n_buckets - 1)];
+        while (*prev != entry)
+            prev = &(*prev)->ce_next;
+        *prev = entry->ce_next;
+        cache->dc_size -= entry->ce_seg.dcs_len;
+        --cache->dc_n_entries;
+        entry_destroy(entry);
+    }
+}
+
+
+const struct dofp_cached_seg *
+dofp_cache_get (struct dofp_cache *cache, const char *path)
+{
+    struct cache_entry *entry, **bucket;
+    const unsigned hash = path_hash(path);
+
+    bucket = &cache->dc_buckets[hash & (cache->dc_n_buckets - 1)];
+    for (entry = *bucket; entry; entry = entry->ce_next)
+        if (entry->ce_hash == hash && 0 == strcmp(entry->ce_path, path))
+        {
+            if (entry->ce_refs++ == 0)
+                TAILQ_REMOVE(&cache->dc_lru, entry, ce_lru);
+            return &entry->ce_seg;
+        }
+
+    entry = entry_load(path, hash);
+    if (!entry)
+        return NULL;
+    entry->ce_refs = 1;
+    entry->ce_next = *bucket;
+    *bucket = entry;
+    cache->dc_size += entry->ce_seg.dcs_len;
+    if (++cache->dc_n_entries > cache->dc_n_buckets)
+        cache_grow(cache);
+    /* Make room for the new segment */
+    cache_evict(cache);
+    return &entry->ce_seg;
+}
+
+
+void
+dofp_cache_put (struct dofp_cache *cache, const struct dofp_cached_seg *seg)
+{
+    struct cache_entry *const entry = (struct cache_entry *) seg;
+
+    if (--entry->ce_refs == 0)
+    {
+        TAILQ_INSERT_HEAD(&cache->dc_lru, entry, ce_lru);
+        cache_evict(cache);
+    }
+}
+
+
+size_t
+dofp_cache_size (const struct dofp_cache *cache)
+{
+    return cache->dc_size;
+}
+
+
+int
+dofp_seg_path_next (const char *path, unsigned delta, char *buf,
+                                                                size_t bufsz)
+{
+    const char *name, *end, *begin;
+    unsigned long ind;
+    int len;
+
+    name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+    /* The extension may have digits, as in .m4s */
+    end = strrchr(name, '.');
+    if (!end)
+        end = name + strlen(name);
+    while (end > name && !isdigit((unsigned char) end[-1]))
+        --end;
+    if (end == name)
+        return -1;
+    begin = end;
+    while (begin > name && isdigit((unsigned char) begin[-1]))
+        --begin;
+    ind = strtoul(begin, NULL, 10) + delta;
+    len = snprintf(buf, bufsz, "%.*s%lu%s", (int) (begin - path), path, ind,
+                                                                        end);
+    if (len < 0 || (size_t) len >= bufsz)
+        return -1;
+    return len;
+}
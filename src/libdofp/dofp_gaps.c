@@ -0,0 +1,296 @@
+/* DoFP+ gap planning
+ *
+ * A port of run_dofp() of the former milp.py, which http_client_dofp_python
+ * ran in an embedded interpreter.  The planner works in the quality space of
+ * the script, quality + 1, where 0 stands for the next segment, which has no
+ * quality yet: the objective depends on it.  The results are identical to
+ * the script's for the same inputs.
+ *
+ * The next segment is appended to the window as a gap of its own.  It is
+ * the lowest, so it comes first once the gaps are ordered, and it is not
+ * re-downloaded.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "dofp_int.h"
+
+#define MAX_WINDOW (DOFP_MAX_RET + 2)
+
+/* Weight of the average quality against the instability */
+#define ALPHA 0.8
+
+/* Above this share of the buffer size, the next segment may take all the
+ * time down to half the buffer size.
+ */
+#define HIGH_BUFFER 0.75
+
+
+/* Level of segment `i' of the window, the next segment being at `n' */
+static unsigned
+level (const unsigned *q, unsigned n, unsigned i)
+{
+    return i < n ? q[i] + 1 : 0;
+}
+
+
+/* get_gaps(): levels in `gaps', the gap of the next segment included */
+static unsigned
+find_gaps (const unsigned *q, unsigned n, unsigned n_rep,
+                                                        struct dofp_gap *gaps)
+{
+    const unsigned len = n + 1;
+    unsigned i, cur, prev, target, n_gaps;
+    bool started, ended;
+
+    n_gaps = 0;
+    started = ended = false;
+    target = 0;
+    for (i = 1; i < len; ++i)
+    {
+        cur = level(q, n, i);
+        prev = level(q, n, i - 1);
+        if (cur < prev)
+        {
+            /* A gap lower than the open one replaces it */
+            if (started && !ended)
+                --n_gaps;
+            else
+            {
+                started = true;
+                ended = false;
+            }
+            gaps[n_gaps].dg_first = i;
+            gaps[n_gaps].dg_n = 1;
+            gaps[n_gaps].dg_q = cur;
+            gaps[n_gaps].dg_target = prev;
+            ++n_gaps;
+            target = prev;
+            if (i == len - 2)
+                /* Last buffered segment: no next quality to stay below */
+                ended = true;
+            else if (i == len - 1)
+            {
+                gaps[n_gaps - 1].dg_target = n_rep;
+                ended = false;
+            }
+        }
+        else if (cur == prev)
+        {
+            if (started)
+                ++gaps[n_gaps - 1].dg_n;
+        }
+        else
+        {
+            ended = true;
+            if (started)
+            {
+                target = MIN(target, cur);
+                gaps[n_gaps - 1].dg_target = target;
+                started = false;
+            }
+        }
+    }
+    return n_gaps;
+}
+
+
+unsigned
+dofp_gaps_find (const unsigned *q, unsigned n, unsigned n_rep,
+                                                        struct dofp_gap *gaps)
+{
+    struct dofp_gap *gap;
+    unsigned n_gaps;
+
+    if (n == 0)
+        return 0;
+    n_gaps = find_gaps(q, n, n_rep, gaps);
+    /* The last gap is the next segment */
+    --n_gaps;
+    for (gap = gaps; gap < gaps + n_gaps; ++gap)
+    {
+        --gap->dg_q;
+        --gap->dg_target;
+    }
+    return n_gaps;
+}
+
+
+void
+dofp_gaps_order (struct dofp_gap *gaps, unsigned n_gaps)
+{
+    struct dofp_gap gap;
+    unsigned i, j;
+
+    for (i = 1; i < n_gaps; ++i)
+    {
+        gap = gaps[i];
+        for (j = i; j > 0 && gaps[j - 1].dg_q > gap.dg_q; --j)
+            gaps[j] = gaps[j - 1];
+        gaps[j] = gap;
+    }
+}
+
+
+/* get_objective_function(): `lv' are levels */
+static double
+objective (const unsigned *lv, unsigned len, unsigned n_levels)
+{
+    unsigned i, sum;
+    double instability;
+
+    sum = 0;
+    for (i = 0; i < len; ++i)
+        sum += lv[i];
+    instability = 0;
+    for (i = 0; i + 1 < len; ++i)
+        instability += fabs((double) ((int) lv[i] - (int) lv[i + 1])
+                                                        / (len * lv[i + 1]));
+    return ALPHA * ((double) sum / (len * n_levels))
+                                                - (1 - ALPHA) * instability;
+}
+
+
+/* Download time of a segment at level `lv' */
+static double
+seg_time (const struct dofp_gap_params *params, unsigned lv)
+{
+    return (double) (params->dgp_bitrates[lv - 1] * params->dgp_seg_len)
+                                                    / params->dgp_throughput;
+}
+
+
+/* get_min_objective_value_quality_array(): only the next segment */
+static void
+pick_next (const struct dofp_gap_params *params, unsigned *lv, unsigned len,
+                                                                double avail)
+{
+    double obj, max_obj;
+    unsigned q_n, best;
+
+    max_obj = -1000000;
+    best = 1;
+    for (q_n = 1; q_n <= params->dgp_n_rep; ++q_n)
+    {
+        lv[len - 1] = q_n;
+        obj = objective(lv, len, params->dgp_n_rep + 1);
+        if (max_obj < obj && seg_time(params, q_n) < avail)
+        {
+            max_obj = obj;
+            best = q_n;
+        }
+    }
+    lv[len - 1] = best;
+}
+
+
+int
+dofp_gaps_plan (const struct dofp_gap_params *params, const unsigned *q,
+            unsigned n, unsigned *new_q, unsigned *ret, unsigned *n_ret)
+{
+    const unsigned len = n + 1, n_levels = params->dgp_n_rep + 1;
+    const double seg_len = params->dgp_seg_len;
+    const double save = params->dgp_buffer_size / 2;
+    struct dofp_gap gaps[MAX_WINDOW];
+    unsigned orig[MAX_WINDOW], cur[MAX_WINDOW], tmp[MAX_WINDOW],
+                                                            best[MAX_WINDOW];
+    unsigned n_gaps, g, k, i, seg, q_n, lv;
+    double max_obj, obj, t, t_prev, avail;
+
+    if (n == 0 || n > DOFP_MAX_RET + 1)
+        return -1;
+    for (i = 0; i < len; ++i)
+        orig[i] = level(q, n, i);
+    *n_ret = 0;
+
+    n_gaps = find_gaps(q, n, params->dgp_n_rep, gaps);
+    dofp_gaps_order(gaps, n_gaps);
+    memcpy(best, orig, len * sizeof(orig[0]));
+
+    if (params->dgp_buffer < save)
+    {
+        pick_next(params, best, len, seg_len);
+        goto end;
+    }
+    if (n_gaps == 1)
+    {
+        if (params->dgp_buffer > params->dgp_buffer_size * HIGH_BUFFER)
+            avail = params->dgp_buffer - save;
+        else
+            avail = seg_len;
+        pick_next(params, best, len, avail);
+        goto end;
+    }
+
+    /* Try every quality of the next segment while it takes less than a
+     * segment duration, then upgrade the gaps from their last segment on
+     * while the downloads, one after the other, meet the playout.  The
+     * best window seen so far is kept.
+     */
+    max_obj = -10000;
+    memcpy(cur, orig, len * sizeof(orig[0]));
+    /* The lowest quality if even that takes longer than a segment */
+    cur[len - 1] = best[len - 1] = 1;
+    for (q_n = 1; q_n < n_levels; ++q_n)
+    {
+        t = seg_time(params, q_n);
+        if (t > seg_len)
+            break;
+        memcpy(tmp, orig, len * sizeof(orig[0]));
+        tmp[len - 1] = q_n;
+        obj = objective(tmp, len, n_levels);
+        if (max_obj < obj)
+        {
+            max_obj = obj;
+            memcpy(best, tmp, len * sizeof(tmp[0]));
+        }
+        cur[len - 1] = q_n;
+
+        for (g = 1; g < n_gaps; ++g)
+        {
+            if (params->dgp_one_gap)
+                memcpy(cur, orig, n * sizeof(orig[0]));
+            for (k = gaps[g].dg_n; k > 0; --k)
+            {
+                seg = gaps[g].dg_first + k - 1;
+                t_prev = t;
+                t = 0;
+                for (lv = orig[seg] + 1; lv <= gaps[g].dg_target; ++lv)
+                {
+                    t = t_prev + seg_time(params, lv);
+                    avail = params->dgp_play_left + (seg - 1.0) * seg_len;
+                    if (t > avail)
+                        goto next_gap;
+                    memcpy(tmp, cur, len * sizeof(cur[0]));
+                    tmp[seg] = lv;
+                    obj = objective(tmp, len, n_levels);
+                    if (max_obj < obj)
+                    {
+                        max_obj = obj;
+                        memcpy(cur, tmp, len * sizeof(tmp[0]));
+                        memcpy(best, tmp, len * sizeof(tmp[0]));
+                    }
+                }
+            }
+  next_gap:
+            ;
+        }
+    }
+    if (!params->dgp_one_gap)
+        memcpy(best, cur, len * sizeof(cur[0]));
+
+    /* Gaps in order, skipping the next segment */
+    for (g = 1; g < n_gaps; ++g)
+        for (k = gaps[g].dg_n; k > 0; --k)
+        {
+            seg = gaps[g].dg_first + k - 1;
+            if (best[seg] != orig[seg])
+                ret[(*n_ret)++] = seg;
+        }
+
+  end:
+    for (i = 0; i < len; ++i)
+        new_q[i] = best[i] - 1;
+    return 0;
+}
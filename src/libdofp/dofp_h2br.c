@@ -0,0 +1,132 @@
+/* H2BR: re-download a group of buffered segments at a higher quality when
+ * the throughput allows it.
+ *
+ * A group is a run of buffered segments whose quality is lower than that of
+ * both of its neighbours.  Its segments are re-downloaded at a quality
+ * between the two neighbours' as long as every re-download makes its
+ * deadline and the buffer does not fall below min_init_bs.
+ */
+
+#include "dofp_int.h"
+
+
+void
+dofp_h2br (const struct dofp_session *sess, struct dofp_decision *dec)
+{
+    const struct dofp_ladder *const ladder = sess->ds_ladder;
+    const int *const seg_bitrates = ladder->dl_bitrates;
+    const unsigned seg_length = ladder->dl_seg_len;
+    const unsigned seg_ind = sess->ds_seg_ind;
+    const unsigned rep_seg_ind = sess->ds_rep_seg_ind;
+    const double buffer_level = sess->ds_buffer_level;
+    const double min_init_bs = sess->ds_settings.dss_min_init_bs;
+    const unsigned next_quality = dec->dd_next ? dec->dd_next_seg.dsr_q : 0;
+    const long double T_e = sess->ds_t_stats.tot_throughput;    /* T^e in the paper */
+
+    if (!(T_e > seg_bitrates[next_quality]))
+        return;
+    if (rep_seg_ind < 1 || seg_ind < rep_seg_ind + 2)
+        return;     /* Nothing buffered after the segment being played */
+
+    const unsigned n_buffered = seg_ind - rep_seg_ind - 1;
+    if (n_buffered == 0)
+        return;
+    double buffer_estim = 0.0;
+    int start_group = -1;
+    int end_group = -1;
+    bool retransmit = true;
+    unsigned first_quality = 0U;
+    unsigned second_quality = 0U;
+    unsigned ret_segments = 0U;
+    unsigned group_quality = 0U;
+    unsigned quality_levels[n_buffered];
+    unsigned i, k, s;
+
+    for (i = 0; i < n_buffered; i++)
+        quality_levels[i] = dofp_seg_q(sess, rep_seg_ind + i);
+    // Check beginning quality value
+    first_quality = dofp_seg_q(sess, rep_seg_ind - 1);
+    if (quality_levels[0] < first_quality)
+        start_group = 0;
+
+    unsigned start_search = 0U;
+  find_groups:
+    // Check groups and conditions
+    for (i = start_search; i + 1 < n_buffered; i++) {
+        if (start_group != -1 && end_group != -1)
+            break;
+        if (quality_levels[i] > quality_levels[i + 1]) {
+            start_group = i + 1;
+            first_quality = quality_levels[i];
+        } else if (quality_levels[i] < quality_levels[i + 1]) {
+            if (start_group != -1) {
+                end_group = i;
+                second_quality = quality_levels[i + 1];
+            }
+        }
+    }
+    // Check the group indexes
+    if (start_group == -1) {
+        retransmit = false;
+    } else if (end_group == -1) {
+        if (quality_levels[n_buffered - 1] < next_quality) {
+            end_group = n_buffered - 1;
+            second_quality = next_quality;
+        } else
+            retransmit = false;
+    }
+
+    if (!retransmit)
+        return;
+
+    // If the right extreme quality value is lower than the group quality we set it to the group quality + 1
+    if (second_quality <= quality_levels[start_group])
+        second_quality = quality_levels[start_group] + 1;
+    if (second_quality >= ladder->dl_n_rep)
+        second_quality = ladder->dl_n_rep - 1;
+    if (first_quality >= ladder->dl_n_rep)
+        first_quality = ladder->dl_n_rep - 1;
+
+    const unsigned n_segments = end_group - start_group + 1;
+    // Try first with minimum of adjacent quality values
+    group_quality = MIN(first_quality, second_quality);
+    double available_times[n_segments];
+    for (i = 0; i < n_segments; i++)
+        available_times[i] = (sess->ds_rep_seg_time + (i + start_group) * seg_length);
+    long double T_r[n_segments];
+    bool break_loop = false;
+    for (k = MIN(first_quality, second_quality); k <= MAX(first_quality, second_quality); k++) {
+        for (i = 0; i < n_segments; i++) {
+            long double split_throughput = T_e/(i + 1 + 1); // i + 1 ret. segments + 1 next segment
+            buffer_estim = buffer_level + seg_length - (seg_length * seg_bitrates[next_quality] + (i + 1) * seg_length * seg_bitrates[k])/T_e;
+            if (buffer_estim < min_init_bs)
+                break_loop = true;
+            for (unsigned j = 0; j < i + 1; j++) {
+                T_r[j] = seg_bitrates[k] * seg_length / available_times[j];
+                if (T_r[j] > split_throughput) // Not enough throughput for retransmission
+                    break_loop = true;
+            }
+            if (break_loop) {
+                break_loop = false;
+                break;
+            }
+            else if (ret_segments <= i + 1) { // If actual ret_segments is lower or equal than the new number of segments to be pushed at quality k, go for it
+                ret_segments = i + 1;
+                group_quality = k;
+            }
+        }
+    }
+
+    // Check next group if ret_segments is 0 and other groups are available
+    if (ret_segments == 0 && end_group < (int) n_buffered - 1) {
+        first_quality = quality_levels[end_group];
+        start_search = end_group + 1;
+        start_group = -1;
+        end_group = -1;
+        goto find_groups;
+    }
+
+    for (s = 0; s < ret_segments; s++)
+        (void) dofp_decision_add_ret(dec, rep_seg_ind + start_group + s + 1,
+                                                                group_quality);
+}
@@ -0,0 +1,166 @@
+/* Session internals shared by the libdofp sources.  Built-in algorithms
+ * read the session directly; external ones go through dofp.h.
+ */
+
+#ifndef DOFP_INT_H
+#define DOFP_INT_H
+
+#include "abr_worker.h"
+#include "dofp.h"
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+struct throughput_stats
+{
+    long double         throughput;
+    long double         tot_throughput;
+    long double         s_throughput;
+    long double         e_temp_throughput;
+};
+
+/* Ring of entries that only grows at its end.  Entry i is in slot
+ * i & (lr_cap - 1) for lr_first <= i < lr_end.  The columns are separate
+ * arrays that grow together.
+ */
+struct log_ring
+{
+    unsigned            lr_first;
+    unsigned            lr_end;
+    unsigned            lr_cap;     /* Power of two or 0 */
+};
+
+#define LOG_SLOT(ring_, i_) ((i_) & ((ring_)->lr_cap - 1))
+
+/* Per-segment log, indexed by the 0-based segment index */
+struct seg_log
+{
+    struct log_ring     sl_ring;
+    int                *sl_q;       /* Chosen quality */
+    long double        *sl_e_tput;  /* Estimated throughput on arrival */
+    double             *sl_b_level; /* Buffer level after arrival */
+};
+
+/* Stall log.  The first stall is the initial buffering; the last one may
+ * still be in progress.
+ */
+struct stall_log
+{
+    struct log_ring     stl_ring;
+    double             *stl_t;      /* Media time */
+    double             *stl_d;      /* Duration */
+};
+
+struct wlb_stats
+{
+    unsigned            re_count;
+    unsigned            re_unused_count;
+    long double         re_data; // [kB]
+    long double         re_unused_data; // [kB]
+};
+
+/* Running sums behind dofp_session_qoe(), updated as segments arrive */
+struct qoe_stats
+{
+    double              sum_bitrate;
+    double              sum_bitrate2;
+    unsigned            sum_quality;    /* Qualities starting from 1 */
+    unsigned            switches;
+    double              instability;
+    double              startup;        /* Initial buffering [s] */
+    unsigned            n_stalls;       /* Finished stalls, not start-up */
+    double              stall_dur;
+};
+
+struct dofp_session
+{
+    struct dofp_settings        ds_settings;
+    const struct dofp_ladder   *ds_ladder;
+    const struct dofp_abr_if   *ds_abr;
+    void                       *ds_abr_ctx;
+    void                       *ds_ctx;
+
+    /* Buffer model */
+    double                      ds_buffer_level; /* Updated buffer level of the downloaded segment */
+    unsigned                    ds_playout; /* States whether the playout is running [1] or is paused (stall or buffering) [0] */
+    dofp_time_t                 ds_playout_t; /* Start playout time */
+    unsigned                    ds_seg_ind; /* Next segment to download */
+    unsigned                    ds_rep_seg_ind;
+    double                      ds_rep_seg_time; /* Left time for the segment to be fully reproduced (4s -> ... -> 0s) */
+
+    /* Stalls; the first one is the initial buffering */
+    struct stall_log            ds_stalls;
+    unsigned                    ds_stall_ind; /* Current or next stall */
+    dofp_time_t                 ds_stall_t; /* Start stall time */
+
+    struct seg_log              ds_segs;
+    int                         ds_qualities_ind; /* Index of the last received segment */
+
+    struct throughput_stats     ds_t_stats;
+    struct wlb_stats            ds_w_stats;
+    struct qoe_stats            ds_q_stats;
+
+    /* Streaming P.1203 writer and the next segment it gets */
+    struct dofp_p1203          *ds_p1203;
+    unsigned                    ds_p1203_seg;
+};
+
+/* Solver jobs of DOFP_ABR_ASYNC algorithms start with this */
+struct dofp_job
+{
+    struct abr_job              dj_base;
+    struct dofp_session        *dj_sess;
+};
+
+/* Segment size [kbit], `i' is 0-based */
+static inline long double
+dofp_seg_size (const struct dofp_ladder *ladder, unsigned q, unsigned i)
+{
+    if (!ladder->dl_sizes)
+        return (long double) ladder->dl_bitrates[q] * ladder->dl_seg_len;
+    if (i >= ladder->dl_n_seg)
+        i = ladder->dl_n_seg - 1;
+    return (long double) ladder->dl_sizes[q * ladder->dl_n_seg + i] * 8
+                                                                    / 1000.0;
+}
+
+/* Quality of segment `i' (0-based), -1 if it is not in the log */
+static inline int
+dofp_seg_q (const struct dofp_session *sess, unsigned i)
+{
+    const struct log_ring *const ring = &sess->ds_segs.sl_ring;
+
+    if (i >= ring->lr_first && i < ring->lr_end)
+        return sess->ds_segs.sl_q[LOG_SLOT(ring, i)];
+    else
+        return -1;
+}
+
+/* Quality of the last received segment */
+static inline unsigned
+dofp_last_q (const struct dofp_session *sess)
+{
+    if (sess->ds_qualities_ind < 0)
+        return 0;
+    return dofp_seg_q(sess, sess->ds_qualities_ind);
+}
+
+void
+dofp_decision_next (const struct dofp_session *, struct dofp_decision *,
+                                                                unsigned q);
+
+int
+dofp_decision_add_ret (struct dofp_decision *, unsigned seg_ind, unsigned q);
+
+void
+dofp_h2br (const struct dofp_session *, struct dofp_decision *);
+
+/* The playout moved: write the segments that can no longer change */
+void
+dofp_p1203_on_played (struct dofp_session *);
+
+/* Stall ds_stall_ind has ended */
+void
+dofp_p1203_on_stall (struct dofp_session *);
+
+#endif
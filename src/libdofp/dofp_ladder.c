@@ -0,0 +1,465 @@
+/* Representation ladder: representations, media paths and segment sizes */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dofp_int.h"
+
+/* Stands for the segment number in media paths: "$Number$", or
+ * "$Number%05d$" for zero-padded numbers.
+ */
+#define NUMBER_VAR "$Number"
+
+/* Segment-size index header, see dofp_ladder_write_sizes() */
+struct sizes_header
+{
+    char            sh_magic[8];
+    uint32_t        sh_bom;
+    uint32_t        sh_n_rep;
+    uint32_t        sh_n_seg;
+    uint32_t        sh_zero;
+};
+
+#define SIZES_BOM 0x01020304
+
+
+static void
+free_sizes (struct dofp_ladder *ladder)
+{
+    if (ladder->dl_sizes_map_len)
+        (void) munmap((struct sizes_header *) ladder->dl_sizes - 1,
+                                                    ladder->dl_sizes_map_len);
+    else
+        free((void *) ladder->dl_sizes);
+    ladder->dl_sizes = NULL;
+    ladder->dl_sizes_map_len = 0;
+}
+
+
+struct dofp_ladder *
+dofp_ladder_new (unsigned n_rep, unsigned n_seg, unsigned seg_len)
+{
+    struct dofp_ladder *ladder;
+
+    if (n_rep == 0 || seg_len == 0)
+    {
+        fprintf(stderr, "%s: no representations or no segment duration\n",
+                                                                __func__);
+        return NULL;
+    }
+
+    ladder = calloc(1, sizeof(*ladder));
+    if (!ladder)
+        return NULL;
+    ladder->dl_n_rep = n_rep;
+    ladder->dl_n_seg = n_seg;
+    ladder->dl_seg_len = seg_len;
+    ladder->dl_start_number = 1;
+    ladder->dl_bitrates = calloc(n_rep, sizeof(ladder->dl_bitrates[0]));
+    ladder->dl_res = calloc(n_rep, sizeof(ladder->dl_res[0]));
+    ladder->dl_media = calloc(n_rep, sizeof(ladder->dl_media[0]));
+    ladder->dl_base = strdup("");
+    if (!(ladder->dl_bitrates && ladder->dl_res && ladder->dl_media
+                                                        && ladder->dl_base))
+    {
+        dofp_ladder_destroy(ladder);
+        return NULL;
+    }
+
+    return ladder;
+}
+
+
+void
+dofp_ladder_destroy (struct dofp_ladder *ladder)
+{
+    unsigned i;
+
+    for (i = 0; i < ladder->dl_n_rep; ++i)
+    {
+        if (ladder->dl_res)
+            free(ladder->dl_res[i]);
+        if (ladder->dl_media)
+            free(ladder->dl_media[i]);
+    }
+    free(ladder->dl_bitrates);
+    free(ladder->dl_res);
+    free(ladder->dl_media);
+    free(ladder->dl_base);
+    free_sizes(ladder);
+    free(ladder);
+}
+
+
+/* Replace `*dst' by a copy of `src', which may be NULL */
+static int
+set_str (char **dst, const char *src)
+{
+    char *copy = NULL;
+
+    if (src && !(copy = strdup(src)))
+        return -1;
+    free(*dst);
+    *dst = copy;
+    return 0;
+}
+
+
+int
+dofp_ladder_set_rep (struct dofp_ladder *ladder, unsigned q, int bitrate,
+                                        const char *res, const char *media)
+{
+    if (q >= ladder->dl_n_rep || bitrate <= 0)
+        return -1;
+    if (0 != set_str(&ladder->dl_res[q], res)
+                            || 0 != set_str(&ladder->dl_media[q], media))
+        return -1;
+    ladder->dl_bitrates[q] = bitrate;
+    return 0;
+}
+
+
+int
+dofp_ladder_set_base (struct dofp_ladder *ladder, const char *base)
+{
+    return set_str(&ladder->dl_base, base ? base : "");
+}
+
+
+/* Ladder file being read: the representations are collected first because
+ * their number is only known at the end.
+ */
+struct ladder_rep
+{
+    int         bitrate;
+    char        res[32];
+    char        media[256];
+};
+
+
+struct dofp_ladder *
+dofp_ladder_load (const char *filename)
+{
+    struct dofp_ladder *ladder = NULL;
+    struct ladder_rep *reps = NULL, *new_reps, *rep;
+    unsigned n_reps = 0, n_alloc = 0, n_seg = 0, seg_len = 0, lineno = 0, i;
+    unsigned start_number = 1;
+    char *line = NULL, *p, base[256] = "";
+    size_t len = 0;
+    int n;
+    FILE *fp;
+
+    fp = fopen(filename, "r");
+    if (!fp)
+    {
+        fprintf(stderr, "cannot open ladder %s: %s\n", filename,
+                                                            strerror(errno));
+        return NULL;
+    }
+
+    while (getline(&line, &len, fp) != -1)
+    {
+        ++lineno;
+        if ((p = strchr(line, '#')))
+            *p = '\0';
+        for (p = line; *p == ' ' || *p == '\t'; ++p)
+            ;
+        if (*p == '\0' || *p == '\n' || *p == '\r')
+            continue;
+
+        if (0 == strncmp(p, "rep ", 4))
+        {
+            if (n_reps >= n_alloc)
+            {
+                n_alloc = n_alloc ? n_alloc * 2 : 16;
+                new_reps = realloc(reps, n_alloc * sizeof(reps[0]));
+                if (!new_reps)
+                    goto end;
+                reps = new_reps;
+            }
+            rep = &reps[n_reps];
+            rep->res[0] = rep->media[0] = '\0';
+            n = sscanf(p + 4, "%d %31s %255s", &rep->bitrate, rep->res,
+                                                                rep->media);
+            if (n < 1 || rep->bitrate <= 0
+                        || (n_reps && rep->bitrate <= reps[n_reps - 1].bitrate))
+            {
+                fprintf(stderr, "%s:%u: invalid representation, bitrates "
+                                    "must ascend\n", filename, lineno);
+                goto end;
+            }
+            ++n_reps;
+        }
+        else if (1 == sscanf(p, "segment_duration %u", &seg_len)
+                    || 1 == sscanf(p, "segments %u", &n_seg)
+                    || 1 == sscanf(p, "start_number %u", &start_number)
+                    || 1 == sscanf(p, "base %255s", base))
+            ;
+        else
+        {
+            fprintf(stderr, "%s:%u: cannot parse line\n", filename, lineno);
+            goto end;
+        }
+    }
+
+    ladder = dofp_ladder_new(n_reps, n_seg, seg_len);
+    if (!ladder)
+    {
+        fprintf(stderr, "%s: invalid ladder\n", filename);
+        goto end;
+    }
+    ladder->dl_start_number = start_number;
+    for (i = 0; i < n_reps; ++i)
+        if (0 != dofp_ladder_set_rep(ladder, i, reps[i].bitrate,
+                reps[i].res[0] ? reps[i].res : NULL,
+                reps[i].media[0] ? reps[i].media : NULL))
+            break;
+    if (i < n_reps || 0 != dofp_ladder_set_base(ladder, base))
+    {
+        dofp_ladder_destroy(ladder);
+        ladder = NULL;
+    }
+
+  end:
+    fclose(fp);
+    free(line);
+    free(reps);
+    return ladder;
+}
+
+
+/* Map a segment-size index.  The mapping outlives the descriptor. */
+static int
+map_sizes (struct dofp_ladder *ladder, const char *filename, int fd)
+{
+    const struct sizes_header *hdr;
+    struct stat st;
+    size_t len;
+    void *map;
+
+    if (0 != fstat(fd, &st))
+    {
+        fprintf(stderr, "cannot stat %s: %s\n", filename, strerror(errno));
+        return -1;
+    }
+    len = sizeof(*hdr) + (size_t) ladder->dl_n_rep * ladder->dl_n_seg
+                                                * sizeof(ladder->dl_sizes[0]);
+    if ((size_t) st.st_size != len)
+    {
+        fprintf(stderr, "%s: %jd bytes instead of %zu for %u representations "
+            "of %u segments\n", filename, (intmax_t) st.st_size, len,
+            ladder->dl_n_rep, ladder->dl_n_seg);
+        return -1;
+    }
+
+    map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "cannot map %s: %s\n", filename, strerror(errno));
+        return -1;
+    }
+    hdr = map;
+    if (hdr->sh_bom != SIZES_BOM)
+    {
+        fprintf(stderr, "%s: written on a host of another byte order\n",
+                                                                    filename);
+        goto err;
+    }
+    if (hdr->sh_n_rep != ladder->dl_n_rep || hdr->sh_n_seg != ladder->dl_n_seg)
+    {
+        fprintf(stderr, "%s: %"PRIu32" representations of %"PRIu32" segments "
+            "instead of %u of %u\n", filename, hdr->sh_n_rep, hdr->sh_n_seg,
+            ladder->dl_n_rep, ladder->dl_n_seg);
+        goto err;
+    }
+
+    free_sizes(ladder);
+    ladder->dl_sizes = (const uint32_t *) (hdr + 1);
+    ladder->dl_sizes_map_len = len;
+    return 0;
+
+  err:
+    (void) munmap(map, len);
+    return -1;
+}
+
+
+static int
+parse_sizes (struct dofp_ladder *ladder, const char *filename, FILE *fp)
+{
+    char *line = NULL, *p, *end;
+    size_t len = 0;
+    unsigned r_ind = 0, n;
+    long double size;
+    uint32_t *sizes;
+    int rv = -1;
+
+    sizes = malloc(ladder->dl_n_rep * ladder->dl_n_seg * sizeof(sizes[0]));
+    if (!sizes)
+        return -1;
+
+    while (getline(&line, &len, fp) != -1)
+    {
+        if (r_ind >= ladder->dl_n_rep)
+        {
+            fprintf(stderr, "%s: more than %u representations\n", filename,
+                                                            ladder->dl_n_rep);
+            goto end;
+        }
+        for (n = 0, p = line; ; p = end, ++n)
+        {
+            size = strtold(p, &end);
+            if (end == p)
+                break;
+            if (size < 0 || size > UINT32_MAX)
+            {
+                fprintf(stderr, "%s: invalid segment size %.*s\n", filename,
+                                                        (int) (end - p), p);
+                goto end;
+            }
+            if (n < ladder->dl_n_seg)
+                sizes[r_ind * ladder->dl_n_seg + n] = (uint32_t) (size + .5);
+        }
+        if (n != ladder->dl_n_seg)
+        {
+            fprintf(stderr, "%s: quality idx %u has %u segment sizes instead "
+                            "of %u\n", filename, r_ind, n, ladder->dl_n_seg);
+            goto end;
+        }
+        ++r_ind;
+    }
+
+    if (r_ind == ladder->dl_n_rep)
+    {
+        free_sizes(ladder);
+        ladder->dl_sizes = sizes;
+        sizes = NULL;
+        rv = 0;
+    }
+    else
+        fprintf(stderr, "%s: %u representations instead of %u\n", filename,
+                                                    r_ind, ladder->dl_n_rep);
+
+  end:
+    free(line);
+    free(sizes);
+    return rv;
+}
+
+
+int
+dofp_ladder_load_sizes (struct dofp_ladder *ladder, const char *filename)
+{
+    char magic[sizeof(DOFP_SIZES_MAGIC) - 1];
+    FILE *fp;
+    int rv;
+
+    if (ladder->dl_n_seg == 0)
+    {
+        fprintf(stderr, "%s: live content has no segment sizes\n", filename);
+        return -1;
+    }
+
+    fp = fopen(filename, "r");
+    if (!fp)
+    {
+        fprintf(stderr, "cannot open segment sizes file %s: %s\n", filename,
+                                                            strerror(errno));
+        return -1;
+    }
+
+    if (sizeof(magic) == fread(magic, 1, sizeof(magic), fp)
+                        && 0 == memcmp(magic, DOFP_SIZES_MAGIC, sizeof(magic)))
+        rv = map_sizes(ladder, filename, fileno(fp));
+    else
+    {
+        rewind(fp);
+        rv = parse_sizes(ladder, filename, fp);
+    }
+
+    fclose(fp);
+    return rv;
+}
+
+
+int
+dofp_ladder_write_sizes (const struct dofp_ladder *ladder,
+                                                        const char *filename)
+{
+    struct sizes_header hdr;
+    FILE *fp;
+    size_t n;
+    int rv;
+
+    if (!ladder->dl_sizes)
+    {
+        fprintf(stderr, "%s: the ladder has no segment sizes\n", __func__);
+        return -1;
+    }
+
+    fp = fopen(filename, "wb");
+    if (!fp)
+    {
+        fprintf(stderr, "cannot open %s for writing: %s\n", filename,
+                                                            strerror(errno));
+        return -1;
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.sh_magic, DOFP_SIZES_MAGIC, sizeof(hdr.sh_magic));
+    hdr.sh_bom = SIZES_BOM;
+    hdr.sh_n_rep = ladder->dl_n_rep;
+    hdr.sh_n_seg = ladder->dl_n_seg;
+    n = (size_t) ladder->dl_n_rep * ladder->dl_n_seg;
+    rv = 1 == fwrite(&hdr, sizeof(hdr), 1, fp)
+        && n == fwrite(ladder->dl_sizes, sizeof(ladder->dl_sizes[0]), n, fp)
+        ? 0 : -1;
+    if (0 != fclose(fp))
+        rv = -1;
+    if (rv != 0)
+        fprintf(stderr, "cannot write %s: %s\n", filename, strerror(errno));
+    return rv;
+}
+
+
+int
+dofp_ladder_seg_path (const struct dofp_ladder *ladder, unsigned q,
+                                unsigned seg_ind, char *buf, size_t bufsz)
+{
+    const char *media, *var, *rest;
+    char *end;
+    unsigned long width = 0;
+    int len;
+
+    if (q >= ladder->dl_n_rep)
+        return -1;
+    media = ladder->dl_media[q];
+    if (!media)
+        return -1;
+    var = strstr(media, NUMBER_VAR);
+    if (var)
+    {
+        rest = var + sizeof(NUMBER_VAR) - 1;
+        if (*rest == '%')
+        {
+            width = strtoul(rest + 1, &end, 10);
+            if (end[0] != 'd' || end[1] != '$' || width > 16)
+                return -1;
+            rest = end + 2;
+        }
+        else if (*rest++ != '$')
+            return -1;
+        len = snprintf(buf, bufsz, "%s%.*s%0*u%s", ladder->dl_base,
+                        (int) (var - media), media, (int) width,
+                        ladder->dl_start_number + seg_ind - 1, rest);
+    }
+    else
+        len = snprintf(buf, bufsz, "%s%s", ladder->dl_base, media);
+    if (len < 0 || (size_t) len >= bufsz)
+        return -1;
+    return len;
+}
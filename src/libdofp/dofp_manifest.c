@@ -0,0 +1,1427 @@
+/* Manifest parser: DASH MPDs and HLS playlists to a ladder
+ *
+ * Documents are parsed as they arrive, one XML tag or playlist line at a
+ * time: only the tag or line being read is buffered, never the document.
+ *
+ * DASH: the video representations of the first period, with a
+ * SegmentTemplate (with or without a SegmentTimeline) at any level.
+ * SegmentList and SegmentBase are not supported.
+ *
+ * HLS: the variants of the master playlist, then one media playlist per
+ * variant.  Segment URIs must be numbered: the $Number$ template is
+ * recovered from the first URI and checked against the others.  Segment
+ * sizes are known when the playlists carry EXT-X-BITRATE.
+ */
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dofp_int.h"
+
+/* Longest tag or line */
+#define MF_MAX_TOK 0x10000
+
+/* Digit runs of the first segment URI of a media playlist that may hold
+ * the segment number.
+ */
+#define MF_MAX_CAND 32
+
+enum mf_kind { MF_UNKNOWN, MF_MPD, MF_HLS, };
+
+/* DASH element levels that may carry a BaseURL or a SegmentTemplate */
+enum mpd_level { L_MPD, L_PERIOD, L_AS, L_REP, N_LEVELS, };
+
+struct mpd_tmpl
+{
+    char               *mt_media;
+    uint64_t            mt_start;
+    uint64_t            mt_duration;
+    uint64_t            mt_timescale;
+    enum {
+        MT_START        = 1 << 0,
+        MT_DURATION     = 1 << 1,
+        MT_TIMESCALE    = 1 << 2,
+        MT_TIMELINE     = 1 << 3,
+    }                   mt_flags;
+    /* SegmentTimeline */
+    uint64_t            mt_n_seg;
+    uint64_t            mt_first_d;
+    uint64_t            mt_total;       /* Sum of the durations */
+    uint64_t            mt_open_d;      /* Duration repeated to the end */
+};
+
+struct mf_rep
+{
+    int                 mr_bitrate;     /* [kbps] */
+    char               *mr_res;
+    char               *mr_media;       /* Resolved media template */
+    char               *mr_uri;         /* HLS: media playlist */
+    unsigned            mr_start;
+    unsigned            mr_n_seg;       /* Segments listed */
+    bool                mr_live;
+    double              mr_seg_dur;     /* [s] */
+    long double        *mr_sizes;       /* [kbit], HLS only */
+    unsigned            mr_n_sizes;
+};
+
+/* Digit run of the first segment URI */
+struct hls_cand
+{
+    unsigned            hc_off;
+    unsigned            hc_len;
+    unsigned            hc_width;       /* Zero-padded to this width */
+    unsigned long       hc_value;
+};
+
+struct mf_buf
+{
+    char               *mb_buf;
+    size_t              mb_len;
+    size_t              mb_cap;
+};
+
+struct dofp_manifest
+{
+    enum mf_kind        mf_kind;
+    bool                mf_error;
+    bool                mf_live;
+    char               *mf_path;        /* Path of the manifest */
+    const char         *mf_doc;         /* Path of the current document */
+
+    struct mf_buf       mf_tok;         /* Tag or line being read */
+    struct mf_buf       mf_text;        /* DASH: text of a BaseURL */
+
+    struct mf_rep      *mf_reps;
+    unsigned            mf_n_reps;
+    unsigned            mf_n_alloc;
+
+    /* DASH */
+    enum { MS_TEXT, MS_TAG, }   mf_state;
+    char                mf_quote;       /* Quote of the attribute being read */
+    enum mpd_level      mf_level;
+    bool                mf_in_base;     /* Text is a BaseURL */
+    bool                mf_in_s_tl;     /* Inside a SegmentTimeline */
+    enum mpd_level      mf_tmpl_level;  /* Level of the open SegmentTemplate */
+    unsigned            mf_n_periods;
+    const char         *mf_skip;        /* Element being skipped, if any */
+    double              mf_duration;    /* Presentation duration [s] */
+    char               *mf_base[N_LEVELS];
+    struct mpd_tmpl     mf_tmpl[N_LEVELS];
+    struct mf_rep       mf_rep;         /* Representation being read */
+    char               *mf_rep_id;
+
+    /* HLS */
+    unsigned            mf_n_docs;      /* Playlists read */
+    bool                mf_variant;     /* Next URI is a variant */
+    bool                mf_endlist;
+    double              mf_extinf;      /* Duration of the next segment [s] */
+    double              mf_seg_bitrate; /* EXT-X-BITRATE [kbps], 0 if none */
+    char               *mf_first_uri;
+    struct hls_cand     mf_cands[MF_MAX_CAND];
+    unsigned            mf_n_cands;
+    uint32_t            mf_live_cands;  /* Candidates still matching */
+
+    struct dofp_ladder *mf_ladder;
+};
+
+
+static void
+mf_error (struct dofp_manifest *mf, const char *msg, const char *arg)
+{
+    fprintf(stderr, "%s: %s%s%s\n", mf->mf_doc, msg, arg ? ": " : "",
+                                                                arg ? arg : "");
+    mf->mf_error = true;
+}
+
+
+/* Reference `ref' from document `doc', as a path on the same server */
+static char *
+resolve (const char *doc, const char *ref)
+{
+    const char *scheme, *slash;
+    size_t dir_len;
+    char *path;
+
+    scheme = strstr(ref, "://");
+    if (scheme && (size_t) (scheme - ref) == strcspn(ref, "/?"))
+    {
+        slash = strchr(scheme + 3, '/');
+        return strdup(slash ? slash : "/");
+    }
+    if (ref[0] == '/')
+        return strdup(ref);
+
+    dir_len = strcspn(doc, "?");
+    while (dir_len > 0 && doc[dir_len - 1] != '/')
+        --dir_len;
+    path = malloc(dir_len + strlen(ref) + 1);
+    if (path)
+    {
+        memcpy(path, doc, dir_len);
+        strcpy(path + dir_len, ref);
+    }
+    return path;
+}
+
+
+static void
+free_rep (struct mf_rep *rep)
+{
+    free(rep->mr_res);
+    free(rep->mr_media);
+    free(rep->mr_uri);
+    free(rep->mr_sizes);
+    memset(rep, 0, sizeof(*rep));
+}
+
+
+static struct mf_rep *
+add_rep (struct dofp_manifest *mf)
+{
+    struct mf_rep *reps;
+
+    if (mf->mf_n_reps >= mf->mf_n_alloc)
+    {
+        mf->mf_n_alloc = mf->mf_n_alloc ? mf->mf_n_alloc * 2 : 8;
+        reps = realloc(mf->mf_reps, mf->mf_n_alloc * sizeof(reps[0]));
+        if (!reps)
+        {
+            mf->mf_error = true;
+            return NULL;
+        }
+        mf->mf_reps = reps;
+    }
+    reps = &mf->mf_reps[mf->mf_n_reps++];
+    memset(reps, 0, sizeof(*reps));
+    return reps;
+}
+
+
+static bool
+add_size (struct mf_rep *rep, long double kbit)
+{
+    long double *sizes;
+    unsigned n = rep->mr_n_sizes;
+
+    /* The array doubles from 64 entries */
+    if (n == 0 || (n >= 64 && (n & (n - 1)) == 0))
+    {
+        sizes = realloc(rep->mr_sizes, MAX(64, n * 2) * sizeof(sizes[0]));
+        if (!sizes)
+            return false;
+        rep->mr_sizes = sizes;
+    }
+    rep->mr_sizes[rep->mr_n_sizes++] = kbit;
+    return true;
+}
+
+
+struct dofp_manifest *
+dofp_manifest_new (const char *path)
+{
+    struct dofp_manifest *mf;
+
+    mf = calloc(1, sizeof(*mf));
+    if (!mf)
+        return NULL;
+    mf->mf_path = strdup(path);
+    if (!mf->mf_path)
+    {
+        free(mf);
+        return NULL;
+    }
+    mf->mf_doc = mf->mf_path;
+    return mf;
+}
+
+
+static void
+clear_tmpl (struct mpd_tmpl *tmpl)
+{
+    free(tmpl->mt_media);
+    memset(tmpl, 0, sizeof(*tmpl));
+}
+
+
+void
+dofp_manifest_destroy (struct dofp_manifest *mf)
+{
+    unsigned i;
+
+    for (i = 0; i < mf->mf_n_reps; ++i)
+        free_rep(&mf->mf_reps[i]);
+    free(mf->mf_reps);
+    for (i = 0; i < N_LEVELS; ++i)
+    {
+        free(mf->mf_base[i]);
+        clear_tmpl(&mf->mf_tmpl[i]);
+    }
+    free_rep(&mf->mf_rep);
+    free(mf->mf_rep_id);
+    free(mf->mf_first_uri);
+    free(mf->mf_tok.mb_buf);
+    free(mf->mf_text.mb_buf);
+    free(mf->mf_path);
+    if (mf->mf_ladder)
+        dofp_ladder_destroy(mf->mf_ladder);
+    free(mf);
+}
+
+
+/* Append to `mb', which is kept NUL-terminated */
+static bool
+buf_append (struct dofp_manifest *mf, struct mf_buf *mb, const char *buf,
+                                                                size_t len)
+{
+    size_t cap;
+    char *p;
+
+    if (mb->mb_len + len + 1 > mb->mb_cap)
+    {
+        if (mb->mb_len + len + 1 > MF_MAX_TOK)
+        {
+            mf_error(mf, "tag or line too long", NULL);
+            return false;
+        }
+        cap = mb->mb_cap ? mb->mb_cap : 256;
+        while (cap < mb->mb_len + len + 1)
+            cap *= 2;
+        p = realloc(mb->mb_buf, cap);
+        if (!p)
+        {
+            mf->mf_error = true;
+            return false;
+        }
+        mb->mb_buf = p;
+        mb->mb_cap = cap;
+    }
+    memcpy(mb->mb_buf + mb->mb_len, buf, len);
+    mb->mb_len += len;
+    mb->mb_buf[mb->mb_len] = '\0';
+    return true;
+}
+
+
+/*
+ * DASH
+ */
+
+#define MAX_ATTRS 32
+
+struct xml_tag
+{
+    const char         *xt_name;        /* Without the namespace prefix */
+    bool                xt_close;       /* </name> */
+    bool                xt_empty;       /* <name/> */
+    unsigned            xt_n_attrs;
+    const char         *xt_attrs[MAX_ATTRS][2];
+};
+
+
+/* Replace the predefined entities in place */
+static void
+xml_unescape (char *s)
+{
+    static const struct { const char *ent; char c; } ents[] =
+    {
+        { "&amp;", '&', }, { "&lt;", '<', }, { "&gt;", '>', },
+        { "&quot;", '"', }, { "&apos;", '\'', },
+    };
+    char *out = s;
+    unsigned i;
+
+    while (*s)
+    {
+        if (*s == '&')
+            for (i = 0; i < sizeof(ents) / sizeof(ents[0]); ++i)
+                if (0 == strncmp(s, ents[i].ent, strlen(ents[i].ent)))
+                {
+                    *out++ = ents[i].c;
+                    s += strlen(ents[i].ent);
+                    goto next;
+                }
+        *out++ = *s++;
+  next:
+        ;
+    }
+    *out = '\0';
+}
+
+
+/* Split the tag in `s' (without the angle brackets) in place */
+static bool
+xml_parse_tag (char *s, struct xml_tag *tag)
+{
+    char *p, *name, quote;
+
+    memset(tag, 0, sizeof(*tag));
+    p = s;
+    if (*p == '/')
+    {
+        tag->xt_close = true;
+        ++p;
+    }
+    name = p;
+    while (*p && !isspace((unsigned char) *p) && *p != '/')
+        ++p;
+    if (*p == '/')
+        tag->xt_empty = true;
+    if (*p)
+        *p++ = '\0';
+    tag->xt_name = strrchr(name, ':') ? strrchr(name, ':') + 1 : name;
+
+    for (;;)
+    {
+        while (isspace((unsigned char) *p))
+            ++p;
+        if (*p == '/')
+        {
+            tag->xt_empty = true;
+            ++p;
+            continue;
+        }
+        if (!*p)
+            return true;
+        name = p;
+        while (*p && *p != '=' && !isspace((unsigned char) *p))
+            ++p;
+        if (*p != '=')
+            return false;
+        *p++ = '\0';
+        quote = *p++;
+        if (quote != '"' && quote != '\'')
+            return false;
+        if (tag->xt_n_attrs < MAX_ATTRS)
+        {
+            tag->xt_attrs[tag->xt_n_attrs][0] = name;
+            tag->xt_attrs[tag->xt_n_attrs][1] = p;
+            ++tag->xt_n_attrs;
+        }
+        p = strchr(p, quote);
+        if (!p)
+            return false;
+        *p++ = '\0';
+        xml_unescape((char *) tag->xt_attrs[tag->xt_n_attrs - 1][1]);
+    }
+}
+
+
+static const char *
+xml_attr (const struct xml_tag *tag, const char *name)
+{
+    unsigned i;
+
+    for (i = 0; i < tag->xt_n_attrs; ++i)
+        if (0 == strcmp(tag->xt_attrs[i][0], name))
+            return tag->xt_attrs[i][1];
+    return NULL;
+}
+
+
+static bool
+xml_attr_u64 (const struct xml_tag *tag, const char *name, uint64_t *val)
+{
+    const char *s;
+    char *end;
+
+    s = xml_attr(tag, name);
+    if (!s)
+        return false;
+    *val = strtoull(s, &end, 10);
+    return end != s;
+}
+
+
+/* ISO 8601 duration, e.g. PT1H2M3.5S [s].  Returns -1 on error. */
+static double
+parse_duration (const char *s)
+{
+    double secs = 0, val;
+    bool time = false;
+    char *end;
+
+    if (*s++ != 'P')
+        return -1;
+    while (*s)
+    {
+        if (*s == 'T')
+        {
+            time = true;
+            ++s;
+            continue;
+        }
+        val = strtod(s, &end);
+        if (end == s)
+            return -1;
+        switch (*end)
+        {
+        case 'Y': secs += val * 365 * 86400; break;
+        case 'D': secs += val * 86400; break;
+        case 'H': secs += val * 3600; break;
+        case 'M': secs += time ? val * 60 : val * 30 * 86400; break;
+        case 'S': secs += val; break;
+        default:  return -1;
+        }
+        s = end + 1;
+    }
+    return secs;
+}
+
+
+static bool
+is_video (const char *content_type, const char *mime_type)
+{
+    if (content_type)
+        return 0 == strcmp(content_type, "video");
+    if (mime_type)
+        return 0 == strncmp(mime_type, "video/", 6);
+    return true;
+}
+
+
+/* Expand $RepresentationID$ and $Bandwidth$; $Number$ is left for
+ * dofp_ladder_seg_path().
+ */
+static char *
+expand_media (struct dofp_manifest *mf, const char *media, const char *id,
+                                                        uint64_t bandwidth)
+{
+    char *out, *p;
+    const char *end;
+    size_t len, n_vars = 0;
+
+    /* Every variable may take the longer of the ID and the bandwidth */
+    for (p = strchr(media, '$'); p; p = strchr(p + 1, '$'))
+        ++n_vars;
+    len = strlen(media) + 1 + n_vars * ((id ? strlen(id) : 0) + 20);
+    out = malloc(len);
+    if (!out)
+        return NULL;
+
+    for (p = out; *media; )
+    {
+        if (*media != '$')
+        {
+            *p++ = *media++;
+            continue;
+        }
+        end = strchr(media + 1, '$');
+        if (!end)
+            goto bad;
+        if (end == media + 1)
+            *p++ = '$';
+        else if (0 == strncmp(media, "$RepresentationID$", end + 1 - media))
+        {
+            if (!id)
+                goto bad;
+            p += sprintf(p, "%s", id);
+        }
+        else if (0 == strncmp(media, "$Bandwidth$", end + 1 - media))
+            p += sprintf(p, "%"PRIu64, bandwidth);
+        else if (0 == strncmp(media, "$Number", 7))
+        {
+            memcpy(p, media, end + 1 - media);
+            p += end + 1 - media;
+        }
+        else
+            goto bad;
+        media = end + 1;
+    }
+    *p = '\0';
+    return out;
+
+  bad:
+    mf_error(mf, "unsupported media template", media);
+    free(out);
+    return NULL;
+}
+
+
+/* Template of the representation: SegmentTemplate attributes are inherited
+ * from the upper levels.
+ */
+static void
+merge_tmpl (const struct dofp_manifest *mf, struct mpd_tmpl *out)
+{
+    const struct mpd_tmpl *tmpl;
+    int level;
+
+    memset(out, 0, sizeof(*out));
+    out->mt_start = 1;
+    out->mt_timescale = 1;
+    for (level = L_PERIOD; level <= L_REP; ++level)
+    {
+        tmpl = &mf->mf_tmpl[level];
+        if (tmpl->mt_media)
+            out->mt_media = tmpl->mt_media;
+        if (tmpl->mt_flags & MT_START)
+            out->mt_start = tmpl->mt_start;
+        if (tmpl->mt_flags & MT_DURATION)
+            out->mt_duration = tmpl->mt_duration;
+        if (tmpl->mt_flags & MT_TIMESCALE)
+            out->mt_timescale = tmpl->mt_timescale;
+        if (tmpl->mt_flags & MT_TIMELINE)
+        {
+            out->mt_n_seg = tmpl->mt_n_seg;
+            out->mt_first_d = tmpl->mt_first_d;
+            out->mt_total = tmpl->mt_total;
+            out->mt_open_d = tmpl->mt_open_d;
+        }
+        out->mt_flags |= tmpl->mt_flags;
+    }
+}
+
+
+static void
+mpd_end_rep (struct dofp_manifest *mf)
+{
+    struct mf_rep *const cur = &mf->mf_rep;
+    struct mpd_tmpl tmpl;
+    struct mf_rep *rep;
+    char *media, *base, *path;
+    double n_seg;
+    int level;
+
+    merge_tmpl(mf, &tmpl);
+    if (!tmpl.mt_media)
+    {
+        mf_error(mf, "representation without SegmentTemplate@media",
+                                                            mf->mf_rep_id);
+        return;
+    }
+    if (tmpl.mt_timescale == 0)
+    {
+        mf_error(mf, "invalid timescale", mf->mf_rep_id);
+        return;
+    }
+
+    if (tmpl.mt_flags & MT_TIMELINE)
+    {
+        cur->mr_seg_dur = (double) tmpl.mt_first_d / tmpl.mt_timescale;
+        n_seg = tmpl.mt_n_seg;
+        if (tmpl.mt_open_d && mf->mf_duration > 0)
+            n_seg += ceil((mf->mf_duration * tmpl.mt_timescale
+                                    - tmpl.mt_total) / tmpl.mt_open_d - 1e-6);
+    }
+    else
+    {
+        cur->mr_seg_dur = (double) tmpl.mt_duration / tmpl.mt_timescale;
+        n_seg = cur->mr_seg_dur > 0 && mf->mf_duration > 0
+              ? ceil(mf->mf_duration / cur->mr_seg_dur - 1e-6) : 0;
+    }
+    if (cur->mr_seg_dur <= 0)
+    {
+        mf_error(mf, "no segment duration", mf->mf_rep_id);
+        return;
+    }
+    if (!mf->mf_live && n_seg < 1)
+    {
+        mf_error(mf, "unknown number of segments", mf->mf_rep_id);
+        return;
+    }
+    cur->mr_n_seg = mf->mf_live ? 0 : (unsigned) n_seg;
+    cur->mr_live = mf->mf_live;
+    cur->mr_start = (unsigned) tmpl.mt_start;
+
+    media = expand_media(mf, tmpl.mt_media, mf->mf_rep_id,
+                                    (uint64_t) cur->mr_bitrate * 1000);
+    if (!media)
+        return;
+    base = strdup(mf->mf_path);
+    for (level = L_MPD; base && level < N_LEVELS; ++level)
+        if (mf->mf_base[level])
+        {
+            path = resolve(base, mf->mf_base[level]);
+            free(base);
+            base = path;
+        }
+    cur->mr_media = base ? resolve(base, media) : NULL;
+    free(base);
+    free(media);
+    if (!cur->mr_media || !(rep = add_rep(mf)))
+    {
+        mf->mf_error = true;
+        return;
+    }
+    *rep = *cur;
+    memset(cur, 0, sizeof(*cur));
+}
+
+
+static void
+mpd_open (struct dofp_manifest *mf, const struct xml_tag *tag)
+{
+    const char *name = tag->xt_name, *val;
+    struct mpd_tmpl *tmpl;
+    uint64_t u, d, r, width, height;
+    long long rr;
+    char *end;
+    double dur;
+
+    if (0 == strcmp(name, "MPD"))
+    {
+        mf->mf_level = L_MPD;
+        val = xml_attr(tag, "type");
+        mf->mf_live = val && 0 == strcmp(val, "dynamic");
+        val = xml_attr(tag, "mediaPresentationDuration");
+        if (val && (dur = parse_duration(val)) > 0)
+            mf->mf_duration = dur;
+    }
+    else if (0 == strcmp(name, "Period"))
+    {
+        /* Only the first period is played */
+        if (++mf->mf_n_periods > 1)
+        {
+            if (!tag->xt_empty)
+                mf->mf_skip = "Period";
+            return;
+        }
+        mf->mf_level = L_PERIOD;
+        val = xml_attr(tag, "duration");
+        if (val && (dur = parse_duration(val)) > 0)
+            mf->mf_duration = dur;
+    }
+    else if (0 == strcmp(name, "AdaptationSet"))
+    {
+        if (!is_video(xml_attr(tag, "contentType"),
+                                            xml_attr(tag, "mimeType")))
+        {
+            if (!tag->xt_empty)
+                mf->mf_skip = "AdaptationSet";
+            return;
+        }
+        mf->mf_level = L_AS;
+    }
+    else if (0 == strcmp(name, "Representation"))
+    {
+        if (!is_video(NULL, xml_attr(tag, "mimeType")))
+        {
+            if (!tag->xt_empty)
+                mf->mf_skip = "Representation";
+            return;
+        }
+        mf->mf_level = L_REP;
+        free_rep(&mf->mf_rep);
+        free(mf->mf_rep_id);
+        mf->mf_rep_id = NULL;
+        if ((val = xml_attr(tag, "id")) && !(mf->mf_rep_id = strdup(val)))
+        {
+            mf->mf_error = true;
+            return;
+        }
+        if (!xml_attr_u64(tag, "bandwidth", &u) || u < 1000)
+        {
+            mf_error(mf, "representation without bandwidth", mf->mf_rep_id);
+            return;
+        }
+        mf->mf_rep.mr_bitrate = (int) (u / 1000);
+        if (xml_attr_u64(tag, "width", &width)
+                                && xml_attr_u64(tag, "height", &height))
+        {
+            mf->mf_rep.mr_res = malloc(48);
+            if (!mf->mf_rep.mr_res)
+            {
+                mf->mf_error = true;
+                return;
+            }
+            snprintf(mf->mf_rep.mr_res, 48, "%"PRIu64"x%"PRIu64, width, height);
+        }
+        if (tag->xt_empty)
+            mpd_end_rep(mf);
+    }
+    else if (0 == strcmp(name, "BaseURL"))
+    {
+        if (!tag->xt_empty)
+        {
+            mf->mf_in_base = true;
+            mf->mf_text.mb_len = 0;
+        }
+    }
+    else if (0 == strcmp(name, "SegmentTemplate"))
+    {
+        if (mf->mf_level == L_MPD)
+            return;
+        mf->mf_tmpl_level = mf->mf_level;
+        tmpl = &mf->mf_tmpl[mf->mf_level];
+        clear_tmpl(tmpl);
+        if ((val = xml_attr(tag, "media")) && !(tmpl->mt_media = strdup(val)))
+        {
+            mf->mf_error = true;
+            return;
+        }
+        if (xml_attr_u64(tag, "startNumber", &tmpl->mt_start))
+            tmpl->mt_flags |= MT_START;
+        if (xml_attr_u64(tag, "duration", &tmpl->mt_duration))
+            tmpl->mt_flags |= MT_DURATION;
+        if (xml_attr_u64(tag, "timescale", &tmpl->mt_timescale))
+            tmpl->mt_flags |= MT_TIMESCALE;
+    }
+    else if (0 == strcmp(name, "SegmentTimeline"))
+    {
+        tmpl = &mf->mf_tmpl[mf->mf_tmpl_level];
+        tmpl->mt_flags |= MT_TIMELINE;
+        mf->mf_in_s_tl = !tag->xt_empty;
+    }
+    else if (0 == strcmp(name, "S") && mf->mf_in_s_tl)
+    {
+        tmpl = &mf->mf_tmpl[mf->mf_tmpl_level];
+        if (!xml_attr_u64(tag, "d", &d) || d == 0)
+        {
+            mf_error(mf, "S without a duration", NULL);
+            return;
+        }
+        rr = (val = xml_attr(tag, "r")) ? strtoll(val, &end, 10) : 0;
+        if (tmpl->mt_n_seg == 0)
+            tmpl->mt_first_d = d;
+        if (rr < 0)
+        {
+            tmpl->mt_open_d = d;
+            return;
+        }
+        r = (uint64_t) rr;
+        tmpl->mt_n_seg += 1 + r;
+        tmpl->mt_total += d * (1 + r);
+    }
+    else if (0 == strcmp(name, "SegmentList") || 0 == strcmp(name, "SegmentBase"))
+    {
+        if (mf->mf_level >= L_AS)
+            mf_error(mf, "only SegmentTemplate is supported", name);
+    }
+}
+
+
+static void
+mpd_close (struct dofp_manifest *mf, const struct xml_tag *tag)
+{
+    const char *name = tag->xt_name;
+    char *base;
+
+    if (0 == strcmp(name, "Representation"))
+    {
+        mpd_end_rep(mf);
+        clear_tmpl(&mf->mf_tmpl[L_REP]);
+        free(mf->mf_base[L_REP]);
+        mf->mf_base[L_REP] = NULL;
+        mf->mf_level = L_AS;
+    }
+    else if (0 == strcmp(name, "AdaptationSet"))
+    {
+        clear_tmpl(&mf->mf_tmpl[L_AS]);
+        free(mf->mf_base[L_AS]);
+        mf->mf_base[L_AS] = NULL;
+        mf->mf_level = L_PERIOD;
+    }
+    else if (0 == strcmp(name, "Period"))
+        mf->mf_level = L_MPD;
+    else if (0 == strcmp(name, "SegmentTimeline"))
+        mf->mf_in_s_tl = false;
+    else if (0 == strcmp(name, "BaseURL") && mf->mf_in_base)
+    {
+        mf->mf_in_base = false;
+        base = strdup(mf->mf_text.mb_len ? mf->mf_text.mb_buf : "");
+        if (!base)
+        {
+            mf->mf_error = true;
+            return;
+        }
+        xml_unescape(base);
+        free(mf->mf_base[mf->mf_level]);
+        mf->mf_base[mf->mf_level] = base;
+    }
+}
+
+
+static void
+mpd_tag (struct dofp_manifest *mf, char *s)
+{
+    struct xml_tag tag;
+
+    /* Declarations, processing instructions and comments */
+    if (s[0] == '?' || s[0] == '!')
+        return;
+    if (!xml_parse_tag(s, &tag))
+    {
+        mf_error(mf, "malformed tag", s);
+        return;
+    }
+    if (mf->mf_skip)
+    {
+        if (tag.xt_close && 0 == strcmp(tag.xt_name, mf->mf_skip))
+            mf->mf_skip = NULL;
+        return;
+    }
+    if (tag.xt_close)
+        mpd_close(mf, &tag);
+    else
+        mpd_open(mf, &tag);
+}
+
+
+static void
+mpd_feed (struct dofp_manifest *mf, const char *buf, size_t len)
+{
+    struct mf_buf *const tok = &mf->mf_tok;
+    const char *end = buf + len, *p;
+    char first;
+
+    while (buf < end && !mf->mf_error)
+    {
+        if (mf->mf_state == MS_TEXT)
+        {
+            p = memchr(buf, '<', end - buf);
+            /* Only the text of BaseURL elements is kept */
+            if (mf->mf_in_base && !buf_append(mf, &mf->mf_text, buf,
+                                                        (p ? p : end) - buf))
+                return;
+            if (!p)
+                return;
+            buf = p + 1;
+            tok->mb_len = 0;
+            mf->mf_quote = '\0';
+            mf->mf_state = MS_TAG;
+        }
+        else
+        {
+            /* Outside quotes, a tag ends at '>'.  Comments and
+             * declarations have no attributes: quotes are not special.
+             */
+            first = tok->mb_len ? tok->mb_buf[0] : *buf;
+            for (p = buf; p < end; ++p)
+            {
+                if (mf->mf_quote)
+                {
+                    if (*p == mf->mf_quote)
+                        mf->mf_quote = '\0';
+                }
+                else if (*p == '>')
+                    break;
+                else if ((*p == '"' || *p == '\'') && first != '!')
+                    mf->mf_quote = *p;
+            }
+            if (!buf_append(mf, tok, buf, p - buf))
+                return;
+            if (p == end)
+                return;
+            buf = p + 1;
+            /* A comment only ends at "-->" */
+            if (tok->mb_len >= 3 && 0 == strncmp(tok->mb_buf, "!--", 3)
+                && (tok->mb_len < 5 || 0 != strcmp(tok->mb_buf
+                                                    + tok->mb_len - 2, "--")))
+            {
+                if (!buf_append(mf, tok, ">", 1))
+                    return;
+                continue;
+            }
+            mf->mf_state = MS_TEXT;
+            mpd_tag(mf, tok->mb_buf);
+        }
+    }
+}
+
+
+/*
+ * HLS
+ */
+
+/* Value of attribute `name' of an attribute list, e.g. BANDWIDTH=1280000,
+ * RESOLUTION=640x360.  Quotes are removed.
+ */
+static bool
+hls_attr (const char *list, const char *name, char *val, size_t valsz)
+{
+    const size_t name_len = strlen(name);
+    const char *p = list, *end;
+    size_t len;
+
+    while (*p)
+    {
+        end = p;
+        while (*end && *end != '=' && *end != ',')
+            ++end;
+        if (*end != '=')
+            return false;
+        if ((size_t) (end - p) == name_len && 0 == strncmp(p, name, name_len))
+        {
+            p = end + 1;
+            if (*p == '"')
+            {
+                end = strchr(++p, '"');
+                if (!end)
+                    return false;
+            }
+            else
+                end = p + strcspn(p, ",");
+            len = MIN((size_t) (end - p), valsz - 1);
+            memcpy(val, p, len);
+            val[len] = '\0';
+            return true;
+        }
+        p = end + 1;
+        if (*p == '"')
+        {
+            p = strchr(p + 1, '"');
+            if (!p)
+                return false;
+            ++p;
+        }
+        p += strcspn(p, ",");
+        if (*p == ',')
+            ++p;
+    }
+    return false;
+}
+
+
+static void
+hls_master_line (struct dofp_manifest *mf, const char *line)
+{
+    struct mf_rep *rep;
+    char val[64];
+    unsigned long bandwidth;
+
+    if (0 == strncmp(line, "#EXT-X-STREAM-INF:", 18))
+    {
+        line += 18;
+        /* The average bitrate is closer to what the ABR downloads */
+        if (!hls_attr(line, "AVERAGE-BANDWIDTH", val, sizeof(val))
+                            && !hls_attr(line, "BANDWIDTH", val, sizeof(val)))
+        {
+            mf_error(mf, "variant without BANDWIDTH", NULL);
+            return;
+        }
+        bandwidth = strtoul(val, NULL, 10);
+        if (bandwidth < 1000)
+        {
+            mf_error(mf, "invalid BANDWIDTH", val);
+            return;
+        }
+        rep = add_rep(mf);
+        if (!rep)
+            return;
+        rep->mr_bitrate = (int) (bandwidth / 1000);
+        if (hls_attr(line, "RESOLUTION", val, sizeof(val))
+                                        && !(rep->mr_res = strdup(val)))
+            mf->mf_error = true;
+        mf->mf_variant = true;
+    }
+    else if (0 == strncmp(line, "#EXTINF:", 8)
+                        || 0 == strncmp(line, "#EXT-X-TARGETDURATION:", 22))
+        mf_error(mf, "media playlist without a master playlist", NULL);
+    else if (line[0] != '#' && mf->mf_variant)
+    {
+        rep = &mf->mf_reps[mf->mf_n_reps - 1];
+        rep->mr_uri = resolve(mf->mf_doc, line);
+        if (!rep->mr_uri)
+            mf->mf_error = true;
+        mf->mf_variant = false;
+    }
+}
+
+
+/* Record the digit runs of the first segment URI */
+static void
+hls_find_cands (struct dofp_manifest *mf, const char *uri)
+{
+    struct hls_cand *cand;
+    const char *p;
+
+    mf->mf_n_cands = 0;
+    for (p = uri; *p && mf->mf_n_cands < MF_MAX_CAND; )
+    {
+        if (!isdigit((unsigned char) *p))
+        {
+            ++p;
+            continue;
+        }
+        cand = &mf->mf_cands[mf->mf_n_cands++];
+        cand->hc_off = (unsigned) (p - uri);
+        cand->hc_value = strtoul(p, NULL, 10);
+        while (isdigit((unsigned char) *p))
+            ++p;
+        cand->hc_len = (unsigned) (p - uri) - cand->hc_off;
+        cand->hc_width = cand->hc_len > 1 && uri[cand->hc_off] == '0'
+                       ? cand->hc_len : 0;
+    }
+    mf->mf_live_cands = mf->mf_n_cands == 32 ? UINT32_MAX
+                      : (1u << mf->mf_n_cands) - 1;
+}
+
+
+/* True if `uri' is the first URI with the digit run of `cand' replaced by
+ * its value plus `k'.
+ */
+static bool
+hls_cand_matches (const struct dofp_manifest *mf, const struct hls_cand *cand,
+                                                const char *uri, unsigned k)
+{
+    const char *const first = mf->mf_first_uri;
+    char num[32];
+    int len;
+
+    len = snprintf(num, sizeof(num), "%0*lu", (int) cand->hc_width,
+                                                        cand->hc_value + k);
+    return 0 == strncmp(uri, first, cand->hc_off)
+        && 0 == strncmp(uri + cand->hc_off, num, len)
+        && 0 == strcmp(uri + cand->hc_off + len,
+                                        first + cand->hc_off + cand->hc_len);
+}
+
+
+static void
+hls_segment (struct dofp_manifest *mf, struct mf_rep *rep, const char *uri)
+{
+    const unsigned k = rep->mr_n_seg;
+    unsigned i;
+
+    if (k == 0)
+    {
+        mf->mf_first_uri = strdup(uri);
+        if (!mf->mf_first_uri)
+        {
+            mf->mf_error = true;
+            return;
+        }
+        hls_find_cands(mf, uri);
+        if (mf->mf_extinf > 0)
+            rep->mr_seg_dur = mf->mf_extinf;
+    }
+    else
+        for (i = 0; i < mf->mf_n_cands; ++i)
+            if ((mf->mf_live_cands & (1u << i))
+                        && !hls_cand_matches(mf, &mf->mf_cands[i], uri, k))
+                mf->mf_live_cands &= ~(1u << i);
+
+    /* Sizes are only kept if every segment has one */
+    if (rep->mr_n_sizes == k && mf->mf_seg_bitrate > 0 && mf->mf_extinf > 0
+            && !add_size(rep, (long double) mf->mf_seg_bitrate * mf->mf_extinf))
+        mf->mf_error = true;
+    mf->mf_extinf = 0;
+    ++rep->mr_n_seg;
+}
+
+
+static void
+hls_media_line (struct dofp_manifest *mf, const char *line)
+{
+    struct mf_rep *const rep = &mf->mf_reps[mf->mf_n_docs - 1];
+
+    if (0 == strncmp(line, "#EXTINF:", 8))
+        mf->mf_extinf = strtod(line + 8, NULL);
+    else if (0 == strncmp(line, "#EXT-X-TARGETDURATION:", 22))
+    {
+        if (rep->mr_seg_dur <= 0)
+            rep->mr_seg_dur = strtod(line + 22, NULL);
+    }
+    else if (0 == strncmp(line, "#EXT-X-BITRATE:", 15))
+        mf->mf_seg_bitrate = strtod(line + 15, NULL);
+    else if (0 == strncmp(line, "#EXT-X-BYTERANGE:", 17))
+        mf_error(mf, "byte-range segments are not supported", NULL);
+    else if (0 == strcmp(line, "#EXT-X-ENDLIST"))
+        mf->mf_endlist = true;
+    else if (line[0] != '#')
+        hls_segment(mf, rep, line);
+}
+
+
+static void
+hls_line (struct dofp_manifest *mf, char *line)
+{
+    size_t len = strlen(line);
+
+    while (len > 0 && isspace((unsigned char) line[len - 1]))
+        line[--len] = '\0';
+    if (len == 0)
+        return;
+    if (mf->mf_n_docs == 0)
+        hls_master_line(mf, line);
+    else
+        hls_media_line(mf, line);
+}
+
+
+static void
+hls_feed (struct dofp_manifest *mf, const char *buf, size_t len)
+{
+    const char *end = buf + len, *nl;
+
+    while (buf < end && !mf->mf_error)
+    {
+        nl = memchr(buf, '\n', end - buf);
+        if (!buf_append(mf, &mf->mf_tok, buf, (nl ? nl : end) - buf))
+            return;
+        if (!nl)
+            return;
+        hls_line(mf, mf->mf_tok.mb_buf);
+        mf->mf_tok.mb_len = 0;
+        buf = nl + 1;
+    }
+}
+
+
+/* The media playlist of `rep' is complete: build its media template from
+ * the number in the segment URIs.
+ */
+static void
+hls_end_media (struct dofp_manifest *mf, struct mf_rep *rep)
+{
+    const struct hls_cand *cand = NULL;
+    char *tmpl, *first = mf->mf_first_uri;
+    int i;
+
+    if (rep->mr_n_seg == 0)
+    {
+        mf_error(mf, "no segments", NULL);
+        return;
+    }
+    /* The number closest to the end is the one of the file name */
+    for (i = (int) mf->mf_n_cands - 1; i >= 0; --i)
+        if (mf->mf_live_cands & (1u << i))
+        {
+            cand = &mf->mf_cands[i];
+            break;
+        }
+    if (!cand && rep->mr_n_seg > 1)
+    {
+        mf_error(mf, "segment URIs are not numbered", NULL);
+        return;
+    }
+
+    if (cand)
+    {
+        tmpl = malloc(strlen(first) + 32);
+        if (!tmpl)
+        {
+            mf->mf_error = true;
+            return;
+        }
+        if (cand->hc_width)
+            sprintf(tmpl, "%.*s$Number%%0%ud$%s", (int) cand->hc_off, first,
+                        cand->hc_width, first + cand->hc_off + cand->hc_len);
+        else
+            sprintf(tmpl, "%.*s$Number$%s", (int) cand->hc_off, first,
+                                        first + cand->hc_off + cand->hc_len);
+        rep->mr_start = (unsigned) cand->hc_value;
+        rep->mr_media = resolve(mf->mf_doc, tmpl);
+        free(tmpl);
+    }
+    else
+    {
+        rep->mr_start = 1;
+        rep->mr_media = resolve(mf->mf_doc, first);
+    }
+    if (!rep->mr_media)
+        mf->mf_error = true;
+    rep->mr_live = !mf->mf_endlist;
+
+    free(mf->mf_first_uri);
+    mf->mf_first_uri = NULL;
+    mf->mf_endlist = false;
+    mf->mf_extinf = 0;
+    mf->mf_seg_bitrate = 0;
+}
+
+
+/*
+ * Ladder
+ */
+
+static void
+sort_reps (struct dofp_manifest *mf)
+{
+    struct mf_rep rep;
+    unsigned i, j;
+
+    for (i = 1; i < mf->mf_n_reps; ++i)
+    {
+        rep = mf->mf_reps[i];
+        for (j = i; j > 0 && mf->mf_reps[j - 1].mr_bitrate > rep.mr_bitrate;
+                                                                        --j)
+            mf->mf_reps[j] = mf->mf_reps[j - 1];
+        mf->mf_reps[j] = rep;
+    }
+}
+
+
+static int
+build_ladder (struct dofp_manifest *mf)
+{
+    struct dofp_ladder *ladder;
+    const struct mf_rep *rep;
+    uint32_t *seg_sizes;
+    unsigned n_seg = 0, q, i;
+    bool live, sizes = true;
+    long seg_len;
+
+    sort_reps(mf);
+    live = mf->mf_reps[0].mr_live;
+    seg_len = lround(mf->mf_reps[0].mr_seg_dur);
+    for (q = 0; q < mf->mf_n_reps; ++q)
+    {
+        rep = &mf->mf_reps[q];
+        if (q > 0 && rep->mr_bitrate == mf->mf_reps[q - 1].mr_bitrate)
+        {
+            mf_error(mf, "representations with the same bitrate", NULL);
+            return -1;
+        }
+        if (rep->mr_live != live)
+        {
+            mf_error(mf, "live and on-demand representations", NULL);
+            return -1;
+        }
+        if (rep->mr_start != mf->mf_reps[0].mr_start)
+        {
+            mf_error(mf, "representations start at different numbers", NULL);
+            return -1;
+        }
+        if (q == 0 || rep->mr_n_seg < n_seg)
+            n_seg = rep->mr_n_seg;
+        sizes = sizes && rep->mr_n_sizes >= rep->mr_n_seg;
+    }
+    if (seg_len < 1)
+    {
+        mf_error(mf, "segments shorter than a second", NULL);
+        return -1;
+    }
+
+    ladder = dofp_ladder_new(mf->mf_n_reps, live ? 0 : n_seg,
+                                                        (unsigned) seg_len);
+    if (!ladder)
+        return -1;
+    ladder->dl_start_number = mf->mf_reps[0].mr_start;
+    for (q = 0; q < mf->mf_n_reps; ++q)
+    {
+        rep = &mf->mf_reps[q];
+        if (0 != dofp_ladder_set_rep(ladder, q, rep->mr_bitrate, rep->mr_res,
+                                                            rep->mr_media))
+            goto err;
+    }
+    if (!live && sizes)
+    {
+        seg_sizes = malloc(mf->mf_n_reps * n_seg * sizeof(seg_sizes[0]));
+        if (!seg_sizes)
+            goto err;
+        for (q = 0; q < mf->mf_n_reps; ++q)
+            for (i = 0; i < n_seg; ++i)
+                seg_sizes[q * n_seg + i] = (uint32_t)
+                                    (mf->mf_reps[q].mr_sizes[i] * 125 + .5);
+        ladder->dl_sizes = seg_sizes;
+    }
+    mf->mf_ladder = ladder;
+    return 0;
+
+  err:
+    dofp_ladder_destroy(ladder);
+    mf->mf_error = true;
+    return -1;
+}
+
+
+int
+dofp_manifest_feed (struct dofp_manifest *mf, const void *buf, size_t len)
+{
+    const char *p = buf, *const end = p + len;
+
+    if (mf->mf_kind == MF_UNKNOWN)
+    {
+        /* Byte order mark and blank lines */
+        while (p < end && (isspace((unsigned char) *p)
+                                            || (unsigned char) *p >= 0x80))
+            ++p;
+        if (p == end)
+            return mf->mf_error ? -1 : 0;
+        if (*p == '#')
+            mf->mf_kind = MF_HLS;
+        else if (*p == '<')
+            mf->mf_kind = MF_MPD;
+        else
+        {
+            mf_error(mf, "neither a DASH MPD nor an HLS playlist", NULL);
+            return -1;
+        }
+    }
+    if (mf->mf_kind == MF_HLS)
+        hls_feed(mf, p, end - p);
+    else
+        mpd_feed(mf, p, end - p);
+    return mf->mf_error ? -1 : 0;
+}
+
+
+int
+dofp_manifest_end (struct dofp_manifest *mf, const char **next_path)
+{
+    unsigned q;
+
+    if (mf->mf_error)
+        return -1;
+    switch (mf->mf_kind)
+    {
+    case MF_UNKNOWN:
+        mf_error(mf, "empty manifest", NULL);
+        return -1;
+    case MF_MPD:
+        if (mf->mf_state != MS_TEXT || mf->mf_n_reps == 0)
+        {
+            mf_error(mf, mf->mf_n_reps ? "truncated MPD"
+                                    : "no video representation", NULL);
+            return -1;
+        }
+        return build_ladder(mf);
+    case MF_HLS:
+        break;
+    }
+
+    /* Last line without a newline */
+    if (mf->mf_tok.mb_len)
+    {
+        hls_line(mf, mf->mf_tok.mb_buf);
+        mf->mf_tok.mb_len = 0;
+        if (mf->mf_error)
+            return -1;
+    }
+    if (mf->mf_n_docs == 0)
+    {
+        if (mf->mf_n_reps == 0)
+        {
+            mf_error(mf, "no variants", NULL);
+            return -1;
+        }
+        for (q = 0; q < mf->mf_n_reps; ++q)
+            if (!mf->mf_reps[q].mr_uri)
+            {
+                mf_error(mf, "variant without a URI", NULL);
+                return -1;
+            }
+        /* The media playlists are read in ladder order */
+        sort_reps(mf);
+    }
+    else
+    {
+        hls_end_media(mf, &mf->mf_reps[mf->mf_n_docs - 1]);
+        if (mf->mf_error)
+            return -1;
+        if (mf->mf_n_docs == mf->mf_n_reps)
+        {
+            mf->mf_doc = mf->mf_path;
+            return build_ladder(mf);
+        }
+    }
+
+    mf->mf_doc = mf->mf_reps[mf->mf_n_docs++].mr_uri;
+    *next_path = mf->mf_doc;
+    return 1;
+}
+
+
+struct dofp_ladder *
+dofp_manifest_ladder (struct dofp_manifest *mf)
+{
+    struct dofp_ladder *ladder = mf->mf_ladder;
+
+    mf->mf_ladder = NULL;
+    return ladder;
+}
@@ -0,0 +1,237 @@
+/* ITU-T P.1203 input
+ *
+ * The segments (I13) and the stalls (I23) are two arrays of one JSON
+ * document, but they are known in an interleaved order.  The streaming
+ * writer appends the segments to the document and the stalls to a side
+ * file, which is copied into the document when it is closed.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dofp_int.h"
+
+/* P.1203 input parameters */
+static const float      FPS = 24.0;
+static const char       DEVICE[] = "pc";
+static const char       DISPLAYSIZE[] = "3840x2160";
+static const unsigned   VIEWINGDISTANCE = 150U;
+
+struct dofp_p1203
+{
+    FILE               *dp_fp;
+    FILE               *dp_stalls_fp;
+    char               *dp_stalls_path;
+    unsigned            dp_n_segs;
+    unsigned            dp_n_stalls;
+    unsigned            dp_flush_every;
+    unsigned            dp_n_unflushed;
+};
+
+
+static void
+p1203_head (FILE *jfp)
+{
+    fprintf(jfp, "{\n\t\"I11\":{\n\t\t\"segments\":[],\n\t\t\"streamId\":42},\n\t\"I13\":{\n\t\t\"segments\":[");
+}
+
+
+/* Segment `i' (0-based) of the session log */
+static void
+p1203_segment (FILE *jfp, const struct dofp_session *sess, unsigned i,
+                                                                    bool first)
+{
+    const struct dofp_ladder *const ladder = sess->ds_ladder;
+    const int q = dofp_seg_q(sess, i);
+
+    fprintf(jfp, "%s\n\t\t{\n\t\t\t\"bitrate\":%i,\n\t\t\t\"codec\":\"hevc\",\n\t\t\t\"duration\":%u,\n\t\t\t\"fps\":%.1f,\n\t\t\t\"resolution\":\"%s\",\n\t\t\t\"start\":%u\n\t\t\t}",
+        first ? "" : ",", ladder->dl_bitrates[q], ladder->dl_seg_len, FPS,
+        ladder->dl_res[q] ? ladder->dl_res[q] : "", i * ladder->dl_seg_len);
+}
+
+
+static void
+p1203_middle (FILE *jfp)
+{
+    fprintf(jfp, "],\n\t\t\"streamId\":42\n},\n\t\"I23\":{\n\t\"stalling\":[");
+}
+
+
+/* Stall `i' of the session log */
+static void
+p1203_stall (FILE *jfp, const struct dofp_session *sess, unsigned i,
+                                                                    bool first)
+{
+    const struct log_ring *const stalls = &sess->ds_stalls.stl_ring;
+
+    fprintf(jfp, "%s[%.3f,%.3f]", first ? "" : ",",
+        sess->ds_stalls.stl_t[LOG_SLOT(stalls, i)],
+        sess->ds_stalls.stl_d[LOG_SLOT(stalls, i)]);
+}
+
+
+static void
+p1203_tail (FILE *jfp)
+{
+    fprintf(jfp, "],\n\t\t\"streamId\": 42},\n\t\"IGen\":{\n\t\t\"device\":\"%s\",\n\t\t\"displaySize\":\"%s\",\n\t\t\"viewingDistance\":\"%u%s\"}}\n", DEVICE, DISPLAYSIZE, VIEWINGDISTANCE, "cm");
+}
+
+
+int
+dofp_session_write_p1203 (const struct dofp_session *sess, FILE *jfp)
+{
+    const struct log_ring *const segs = &sess->ds_segs.sl_ring;
+    const struct log_ring *const stalls = &sess->ds_stalls.stl_ring;
+    unsigned i;
+
+    p1203_head(jfp);
+    for (i = segs->lr_first; i < segs->lr_end; i++)
+        p1203_segment(jfp, sess, i, i == segs->lr_first);
+    p1203_middle(jfp);
+    /* The first stall is listed even if it is still going on */
+    p1203_stall(jfp, sess, stalls->lr_first, true);
+    for (i = stalls->lr_first + 1; i < sess->ds_stall_ind; i++)
+        p1203_stall(jfp, sess, i, false);
+    p1203_tail(jfp);
+
+    return ferror(jfp) ? -1 : 0;
+}
+
+
+struct dofp_p1203 *
+dofp_p1203_open (const char *path, unsigned flush_every)
+{
+    struct dofp_p1203 *w;
+    size_t len;
+
+    w = calloc(1, sizeof(*w));
+    if (!w)
+        return NULL;
+    len = strlen(path) + sizeof(".stalls");
+    w->dp_stalls_path = malloc(len);
+    if (!w->dp_stalls_path)
+        goto err;
+    snprintf(w->dp_stalls_path, len, "%s.stalls", path);
+    w->dp_fp = fopen(path, "w");
+    if (!w->dp_fp)
+    {
+        fprintf(stderr, "%s: cannot open %s\n", __func__, path);
+        goto err;
+    }
+    w->dp_stalls_fp = fopen(w->dp_stalls_path, "w+");
+    if (!w->dp_stalls_fp)
+    {
+        fprintf(stderr, "%s: cannot open %s\n", __func__, w->dp_stalls_path);
+        goto err;
+    }
+    w->dp_flush_every = flush_every;
+    p1203_head(w->dp_fp);
+    return w;
+
+  err:
+    if (w->dp_fp)
+        fclose(w->dp_fp);
+    free(w->dp_stalls_path);
+    free(w);
+    return NULL;
+}
+
+
+static void
+p1203_written (struct dofp_p1203 *w)
+{
+    if (w->dp_flush_every && ++w->dp_n_unflushed >= w->dp_flush_every)
+    {
+        fflush(w->dp_fp);
+        fflush(w->dp_stalls_fp);
+        w->dp_n_unflushed = 0;
+    }
+}
+
+
+void
+dofp_p1203_on_played (struct dofp_session *sess)
+{
+    struct dofp_p1203 *const w = sess->ds_p1203;
+    const struct log_ring *const segs = &sess->ds_segs.sl_ring;
+
+    /* Segments that cannot be upgraded any more */
+    sess->ds_p1203_seg = MAX(sess->ds_p1203_seg, segs->lr_first);
+    for ( ; sess->ds_p1203_seg < MIN(segs->lr_end, sess->ds_rep_seg_ind);
+                                                        ++sess->ds_p1203_seg)
+    {
+        p1203_segment(w->dp_fp, sess, sess->ds_p1203_seg, w->dp_n_segs == 0);
+        ++w->dp_n_segs;
+        p1203_written(w);
+    }
+}
+
+
+static void
+p1203_stall_ended (struct dofp_p1203 *w, const struct dofp_session *sess)
+{
+    const struct log_ring *const stalls = &sess->ds_stalls.stl_ring;
+
+    if (sess->ds_stall_ind >= stalls->lr_first
+                                    && sess->ds_stall_ind < stalls->lr_end)
+    {
+        p1203_stall(w->dp_stalls_fp, sess, sess->ds_stall_ind,
+                                                        w->dp_n_stalls == 0);
+        ++w->dp_n_stalls;
+        p1203_written(w);
+    }
+}
+
+
+void
+dofp_p1203_on_stall (struct dofp_session *sess)
+{
+    p1203_stall_ended(sess->ds_p1203, sess);
+}
+
+
+void
+dofp_session_set_p1203 (struct dofp_session *sess, struct dofp_p1203 *w)
+{
+    sess->ds_p1203 = w;
+    if (w)
+        dofp_p1203_on_played(sess);
+}
+
+
+int
+dofp_p1203_close (struct dofp_p1203 *w, struct dofp_session *sess)
+{
+    const struct log_ring *const segs = &sess->ds_segs.sl_ring;
+    char buf[0x1000];
+    size_t n;
+    int s;
+
+    /* The segments still in the buffer are played as they are */
+    sess->ds_p1203_seg = MAX(sess->ds_p1203_seg, segs->lr_first);
+    for ( ; sess->ds_p1203_seg < segs->lr_end; ++sess->ds_p1203_seg)
+    {
+        p1203_segment(w->dp_fp, sess, sess->ds_p1203_seg, w->dp_n_segs == 0);
+        ++w->dp_n_segs;
+    }
+    p1203_middle(w->dp_fp);
+
+    /* The initial buffering is listed even if it is still going on */
+    if (w->dp_n_stalls == 0 && sess->ds_stall_ind == 0)
+        p1203_stall_ended(w, sess);
+    rewind(w->dp_stalls_fp);
+    while ((n = fread(buf, 1, sizeof(buf), w->dp_stalls_fp)) > 0)
+        fwrite(buf, 1, n, w->dp_fp);
+    p1203_tail(w->dp_fp);
+    sess->ds_p1203 = NULL;
+
+    s = ferror(w->dp_fp) || ferror(w->dp_stalls_fp) ? -1 : 0;
+    if (0 != fclose(w->dp_fp))
+        s = -1;
+    fclose(w->dp_stalls_fp);
+    if (s == 0)
+        (void) remove(w->dp_stalls_path);
+    free(w->dp_stalls_path);
+    free(w);
+    return s;
+}
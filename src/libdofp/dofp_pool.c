@@ -0,0 +1,280 @@
+/* Segment buffer pool
+ *
+ * Free slabs are kept in one list per representation, so that a slab is
+ * reused for segments of about the same size.  The buffered slabs are in a
+ * ring indexed by segment: slot seg_ind & (dp_cap - 1) for dp_first <=
+ * seg_ind < dp_end.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dofp_int.h"
+
+/* Segments are larger than their nominal bitrate suggests when the content
+ * is VBR: leave room for this share more.
+ */
+#define NOMINAL_SLACK 1.25
+
+struct dofp_pool
+{
+    const struct dofp_ladder   *dp_ladder;
+    struct dofp_slab          **dp_free;    /* dl_n_rep lists */
+    size_t                     *dp_slab_size;
+    struct dofp_slab          **dp_segs;
+    unsigned                    dp_cap;     /* Power of two or 0 */
+    unsigned                    dp_first;
+    unsigned                    dp_end;
+    size_t                      dp_buffered;
+};
+
+
+/* Largest segment of representation `q' [bytes] */
+static size_t
+slab_size (const struct dofp_ladder *ladder, unsigned q)
+{
+    long double kbit, max;
+    unsigned i;
+
+    if (!ladder->dl_sizes)
+        return (size_t) (dofp_seg_size(ladder, q, 0) * 125 * NOMINAL_SLACK);
+    max = 0;
+    for (i = 0; i < ladder->dl_n_seg; ++i)
+    {
+        kbit = dofp_seg_size(ladder, q, i);
+        max = MAX(max, kbit);
+    }
+    return (size_t) (max * 125) + 1;
+}
+
+
+static struct dofp_slab *
+slab_new (size_t size)
+{
+    struct dofp_slab *slab;
+
+    slab = malloc(sizeof(*slab));
+    if (!slab)
+        return NULL;
+    slab->dsl_buf = malloc(size);
+    if (!slab->dsl_buf)
+    {
+        free(slab);
+        return NULL;
+    }
+    slab->dsl_size = size;
+    slab->dsl_len = 0;
+    return slab;
+}
+
+
+static void
+slab_destroy (struct dofp_slab *slab)
+{
+    free(slab->dsl_buf);
+    free(slab);
+}
+
+
+struct dofp_pool *
+dofp_pool_new (const struct dofp_ladder *ladder, unsigned n_slabs)
+{
+    struct dofp_pool *pool;
+    struct dofp_slab *slab;
+    unsigned q, i;
+
+    pool = calloc(1, sizeof(*pool));
+    if (!pool)
+        return NULL;
+    pool->dp_ladder = ladder;
+    pool->dp_free = calloc(ladder->dl_n_rep, sizeof(pool->dp_free[0]));
+    pool->dp_slab_size = malloc(ladder->dl_n_rep
+                                        * sizeof(pool->dp_slab_size[0]));
+    if (!pool->dp_free || !pool->dp_slab_size)
+        goto err;
+    pool->dp_first = pool->dp_end = 1;
+
+    for (q = 0; q < ladder->dl_n_rep; ++q)
+    {
+        pool->dp_slab_size[q] = slab_size(ladder, q);
+        for (i = 0; i < n_slabs; ++i)
+        {
+            slab = slab_new(pool->dp_slab_size[q]);
+            if (!slab)
+                goto err;
+            slab->dsl_next = pool->dp_free[q];
+            pool->dp_free[q] = slab;
+        }
+    }
+    return pool;
+
+  err:
+    fprintf(stderr, "%s: cannot allocate %u slabs per representation\n",
+                                                        __func__, n_slabs);
+    dofp_pool_destroy(pool);
+    return NULL;
+}
+
+
+void
+dofp_pool_destroy (struct dofp_pool *pool)
+{
+    struct dofp_slab *slab;
+    unsigned q;
+
+    dofp_pool_release(pool, pool->dp_end);
+    if (pool->dp_free)
+        for (q = 0; q < pool->dp_ladder->dl_n_rep; ++q)
+            while ((slab = pool->dp_free[q]))
+            {
+                pool->dp_free[q] = slab->dsl_next;
+                slab_destroy(slab);
+            }
+    free(pool->dp_free);
+    free(pool->dp_slab_size);
+    free(pool->dp_segs);
+    free(pool);
+}
+
+
+struct dofp_slab *
+dofp_pool_get (struct dofp_pool *pool, unsigned q, unsigned seg_ind)
+{
+    struct dofp_slab *slab;
+
+    if (q >= pool->dp_ladder->dl_n_rep)
+        return NULL;
+    slab = pool->dp_free[q];
+    if (slab)
+        pool->dp_free[q] = slab->dsl_next;
+    else
+    {
+        slab = slab_new(pool->dp_slab_size[q]);
+        if (!slab)
+            return NULL;
+    }
+    slab->dsl_q = q;
+    slab->dsl_seg_ind = seg_ind;
+    slab->dsl_len = 0;
+    slab->dsl_next = NULL;
+    return slab;
+}
+
+
+int
+dofp_slab_append (struct dofp_slab *slab, const void *buf, size_t len)
+{
+    unsigned char *new_buf;
+    size_t size;
+
+    if (len > slab->dsl_size - slab->dsl_len)
+    {
+        size = MAX(slab->dsl_size * 2, slab->dsl_len + len);
+        new_buf = realloc(slab->dsl_buf, size);
+        if (!new_buf)
+            return -1;
+        slab->dsl_buf = new_buf;
+        slab->dsl_size = size;
+    }
+    memcpy(slab->dsl_buf + slab->dsl_len, buf, len);
+    slab->dsl_len += len;
+    return 0;
+}
+
+
+void
+dofp_pool_put (struct dofp_pool *pool, struct dofp_slab *slab)
+{
+    slab->dsl_next = pool->dp_free[slab->dsl_q];
+    pool->dp_free[slab->dsl_q] = slab;
+}
+
+
+/* Make room in the ring for segments up to `seg_ind' */
+static int
+pool_reserve (struct dofp_pool *pool, unsigned seg_ind)
+{
+    struct dofp_slab **segs;
+    unsigned cap, i;
+
+    if (seg_ind - pool->dp_first < pool->dp_cap)
+        return 0;
+    cap = pool->dp_cap ? pool->dp_cap : 8;
+    while (seg_ind - pool->dp_first >= cap)
+        cap *= 2;
+    segs = calloc(cap, sizeof(segs[0]));
+    if (!segs)
+        return -1;
+    for (i = pool->dp_first; i < pool->dp_end; ++i)
+        segs[i & (cap - 1)] = pool->dp_segs[i & (pool->dp_cap - 1)];
+    free(pool->dp_segs);
+    pool->dp_segs = segs;
+    pool->dp_cap = cap;
+    return 0;
+}
+
+
+int
+dofp_pool_commit (struct dofp_pool *pool, struct dofp_slab *slab)
+{
+    struct dofp_slab **slot;
+    unsigned i;
+
+    if (slab->dsl_seg_ind < pool->dp_first)
+    {
+        /* Played before it arrived */
+        dofp_pool_put(pool, slab);
+        return 0;
+    }
+    if (0 != pool_reserve(pool, slab->dsl_seg_ind))
+        return -1;
+    for (i = pool->dp_end; i <= slab->dsl_seg_ind; ++i)
+        pool->dp_segs[i & (pool->dp_cap - 1)] = NULL;
+    pool->dp_end = MAX(pool->dp_end, slab->dsl_seg_ind + 1);
+
+    slot = &pool->dp_segs[slab->dsl_seg_ind & (pool->dp_cap - 1)];
+    if (*slot)
+    {
+        pool->dp_buffered -= (*slot)->dsl_len;
+        dofp_pool_put(pool, *slot);
+    }
+    *slot = slab;
+    pool->dp_buffered += slab->dsl_len;
+    return 0;
+}
+
+
+const struct dofp_slab *
+dofp_pool_segment (const struct dofp_pool *pool, unsigned seg_ind)
+{
+    if (seg_ind < pool->dp_first || seg_ind >= pool->dp_end)
+        return NULL;
+    return pool->dp_segs[seg_ind & (pool->dp_cap - 1)];
+}
+
+
+void
+dofp_pool_release (struct dofp_pool *pool, unsigned seg_ind)
+{
+    struct dofp_slab *slab;
+
+    for ( ; pool->dp_first < seg_ind && pool->dp_first < pool->dp_end;
+                                                            ++pool->dp_first)
+    {
+        slab = pool->dp_segs[pool->dp_first & (pool->dp_cap - 1)];
+        if (slab)
+        {
+            pool->dp_buffered -= slab->dsl_len;
+            dofp_pool_put(pool, slab);
+        }
+    }
+    if (pool->dp_first == pool->dp_end)
+        pool->dp_first = pool->dp_end = MAX(pool->dp_end, seg_ind);
+}
+
+
+size_t
+dofp_pool_buffered (const struct dofp_pool *pool)
+{
+    return pool->dp_buffered;
+}
@@ -0,0 +1,859 @@
+/* DoFP+ player session: buffer model, stall log and throughput estimates
+ *
+ * This used to be the global state of http_client_dofp.c.  The playout is
+ * advanced lazily: every call that takes `now' first plays out the time
+ * elapsed since the previous call.
+ */
+
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dofp_int.h"
+
+/* Default dss_log_window of live content */
+#define LIVE_LOG_WINDOW 256
+
+
+void
+dofp_settings_init (struct dofp_settings *settings)
+{
+    memset(settings, 0, sizeof(*settings));
+    settings->dss_abr           = &dofp_abr_max_j;
+    settings->dss_buffer_size   = 20.0;
+    settings->dss_min_init_bs   = 4.0;
+    settings->dss_alpha         = .5;
+    settings->dss_beta          = .5;
+    settings->dss_tput_safety   = .9;
+    settings->dss_deadline_safety = .9;
+    settings->dss_milp_window   = .5;
+    settings->dss_bba_reservoir = .2;
+    settings->dss_bba_cushion   = .7;
+    settings->dss_sara_avg_count = 5;
+}
+
+
+/* Settings that can be set by name */
+static const struct settings_param
+{
+    const char     *name;
+    size_t          off;
+    bool            is_unsigned;
+} settings_params[] =
+{
+#define P(name_) { #name_, offsetof(struct dofp_settings, dss_##name_), false, }
+    P(buffer_size),
+    P(min_init_bs),
+    P(alpha),
+    P(beta),
+    P(tput_safety),
+    P(deadline_safety),
+    P(milp_window),
+    P(bba_reservoir),
+    P(bba_cushion),
+#undef P
+    { "sara_avg_count", offsetof(struct dofp_settings, dss_sara_avg_count),
+                                                                    true, },
+    { "log_window", offsetof(struct dofp_settings, dss_log_window), true, },
+};
+
+
+int
+dofp_settings_set (struct dofp_settings *settings, const char *name,
+                                                                double value)
+{
+    const struct settings_param *param;
+
+    for (param = settings_params; param < settings_params
+                + sizeof(settings_params) / sizeof(settings_params[0]); ++param)
+        if (0 == strcmp(param->name, name))
+        {
+            if (param->is_unsigned)
+            {
+                if (value < 0 || value != (unsigned) value)
+                    return -1;
+                *(unsigned *) ((char *) settings + param->off) = value;
+            }
+            else
+                *(double *) ((char *) settings + param->off) = value;
+            return 0;
+        }
+
+    return -1;
+}
+
+
+int
+dofp_settings_parse (struct dofp_settings *settings, const char *name_value)
+{
+    const char *eq;
+    char name[64], *end;
+    double value;
+
+    eq = strchr(name_value, '=');
+    if (!eq || eq == name_value || (size_t) (eq - name_value) >= sizeof(name))
+        return -1;
+    memcpy(name, name_value, eq - name_value);
+    name[eq - name_value] = '\0';
+    value = strtod(eq + 1, &end);
+    if (end == eq + 1 || *end != '\0')
+        return -1;
+    return dofp_settings_set(settings, name, value);
+}
+
+
+void
+dofp_settings_print (const struct dofp_settings *settings, FILE *out)
+{
+    const struct settings_param *param;
+
+    for (param = settings_params; param < settings_params
+                + sizeof(settings_params) / sizeof(settings_params[0]); ++param)
+        if (param->is_unsigned)
+            fprintf(out, "%s=%u\n", param->name,
+                    *(const unsigned *) ((const char *) settings + param->off));
+        else
+            fprintf(out, "%s=%g\n", param->name,
+                    *(const double *) ((const char *) settings + param->off));
+}
+
+
+static bool
+settings_valid (const struct dofp_settings *settings)
+{
+    const struct dofp_ladder *const ladder = settings->dss_ladder;
+
+    return settings->dss_abr && ladder && ladder->dl_n_rep > 0
+        && ladder->dl_seg_len > 0
+        && settings->dss_buffer_size > 0 && settings->dss_min_init_bs >= 0
+        && settings->dss_tput_safety > 0 && settings->dss_tput_safety <= 1
+        && settings->dss_deadline_safety > 0
+        && settings->dss_deadline_safety <= 1
+        && settings->dss_milp_window >= 0 && settings->dss_milp_window <= 1
+        && settings->dss_bba_reservoir >= 0 && settings->dss_bba_cushion > 0
+        && settings->dss_sara_avg_count > 0;
+}
+
+
+/* Column of a log: its array and the size of its elements */
+struct log_col
+{
+    void           *lc_base;
+    size_t          lc_size;
+};
+
+
+/* Make room for entry `i' of the log and zero the new entries up to it.
+ * If `window' is not 0, the entries before `keep' are dropped as long as
+ * more than `window' entries are kept.  When the ring grows, the columns
+ * are moved to new arrays and `cols' is updated.
+ */
+static int
+log_reserve (struct log_ring *ring, struct log_col *cols, unsigned n_cols,
+                                unsigned i, unsigned keep, unsigned window)
+{
+    char *bases[n_cols];
+    unsigned cap, c, j;
+    size_t size;
+
+    if (i < ring->lr_end)
+        return 0;
+
+    if (window && i + 1 - ring->lr_first > window)
+        ring->lr_first = MAX(ring->lr_first, MIN(keep, i + 1 - window));
+    if (ring->lr_end < ring->lr_first)
+        ring->lr_end = ring->lr_first;
+
+    if (i + 1 - ring->lr_first > ring->lr_cap)
+    {
+        for (cap = ring->lr_cap ? ring->lr_cap * 2 : 16;
+                                    cap < i + 1 - ring->lr_first; cap *= 2)
+            ;
+        for (c = 0; c < n_cols; ++c)
+            if (!(bases[c] = malloc(cap * cols[c].lc_size)))
+            {
+                while (c > 0)
+                    free(bases[--c]);
+                return -1;
+            }
+        for (c = 0; c < n_cols; ++c)
+        {
+            size = cols[c].lc_size;
+            for (j = ring->lr_first; j < ring->lr_end; ++j)
+                memcpy(bases[c] + (j & (cap - 1)) * size,
+                    (char *) cols[c].lc_base + LOG_SLOT(ring, j) * size, size);
+            free(cols[c].lc_base);
+            cols[c].lc_base = bases[c];
+        }
+        ring->lr_cap = cap;
+    }
+
+    for (j = ring->lr_end; j <= i; ++j)
+        for (c = 0; c < n_cols; ++c)
+            memset((char *) cols[c].lc_base + LOG_SLOT(ring, j)
+                                * cols[c].lc_size, 0, cols[c].lc_size);
+    ring->lr_end = i + 1;
+    return 0;
+}
+
+
+/* Make room for the segment received next */
+static int
+seg_log_reserve (struct dofp_session *sess)
+{
+    struct seg_log *const log = &sess->ds_segs;
+    struct log_col cols[] =
+    {
+        { log->sl_q,        sizeof(log->sl_q[0]), },
+        { log->sl_e_tput,   sizeof(log->sl_e_tput[0]), },
+        { log->sl_b_level,  sizeof(log->sl_b_level[0]), },
+    };
+
+    /* The segment being played is the neighbour of the first one that can
+     * still be re-downloaded.
+     */
+    if (0 != log_reserve(&log->sl_ring, cols, 3, sess->ds_qualities_ind + 1,
+                sess->ds_rep_seg_ind ? sess->ds_rep_seg_ind - 1 : 0,
+                sess->ds_settings.dss_log_window))
+        return -1;
+    log->sl_q = cols[0].lc_base;
+    log->sl_e_tput = cols[1].lc_base;
+    log->sl_b_level = cols[2].lc_base;
+    return 0;
+}
+
+
+/* Make room for stall ds_stall_ind */
+static int
+stall_log_reserve (struct dofp_session *sess)
+{
+    struct stall_log *const log = &sess->ds_stalls;
+    struct log_col cols[] =
+    {
+        { log->stl_t,   sizeof(log->stl_t[0]), },
+        { log->stl_d,   sizeof(log->stl_d[0]), },
+    };
+
+    if (0 != log_reserve(&log->stl_ring, cols, 2, sess->ds_stall_ind,
+                    sess->ds_stall_ind, sess->ds_settings.dss_log_window))
+        return -1;
+    log->stl_t = cols[0].lc_base;
+    log->stl_d = cols[1].lc_base;
+    return 0;
+}
+
+
+struct dofp_session *
+dofp_session_new (const struct dofp_settings *settings, void *ctx,
+                                                            dofp_time_t now)
+{
+    const struct dofp_ladder *const ladder = settings->dss_ladder;
+    struct dofp_session *sess;
+
+    if (!settings_valid(settings))
+    {
+        fprintf(stderr, "%s: invalid settings\n", __func__);
+        return NULL;
+    }
+
+    sess = calloc(1, sizeof(*sess));
+    if (!sess)
+        return NULL;
+
+    sess->ds_settings = *settings;
+    if (ladder->dl_n_seg == 0 && settings->dss_log_window == 0)
+        sess->ds_settings.dss_log_window = LIVE_LOG_WINDOW;
+    sess->ds_ladder = ladder;
+    sess->ds_abr = settings->dss_abr;
+    sess->ds_ctx = ctx;
+    sess->ds_seg_ind = 1;
+    sess->ds_rep_seg_ind = 1;
+    sess->ds_rep_seg_time = ladder->dl_seg_len;
+    sess->ds_stall_t = now;
+    sess->ds_qualities_ind = -1;
+    /* The initial buffering */
+    if (0 != stall_log_reserve(sess))
+    {
+        free(sess);
+        return NULL;
+    }
+
+    if (sess->ds_abr->dai_new)
+    {
+        sess->ds_abr_ctx = sess->ds_abr->dai_new(sess);
+        if (!sess->ds_abr_ctx)
+        {
+            free(sess->ds_stalls.stl_t);
+            free(sess->ds_stalls.stl_d);
+            free(sess);
+            return NULL;
+        }
+    }
+
+    return sess;
+}
+
+
+void
+dofp_session_destroy (struct dofp_session *sess)
+{
+    if (sess->ds_abr->dai_destroy)
+        sess->ds_abr->dai_destroy(sess->ds_abr_ctx);
+    free(sess->ds_segs.sl_q);
+    free(sess->ds_segs.sl_e_tput);
+    free(sess->ds_segs.sl_b_level);
+    free(sess->ds_stalls.stl_t);
+    free(sess->ds_stalls.stl_d);
+    free(sess);
+}
+
+
+void *
+dofp_session_get_ctx (const struct dofp_session *sess)
+{
+    return sess->ds_ctx;
+}
+
+
+const struct dofp_settings *
+dofp_session_settings (const struct dofp_session *sess)
+{
+    return &sess->ds_settings;
+}
+
+
+/* Add (sign 1) or remove (sign -1) segment `i' from the QoE sums.  The
+ * switch from the previous segment counts, and so does the one to the next
+ * segment if it is there.
+ */
+static void
+qoe_account (struct dofp_session *sess, unsigned i, int sign)
+{
+    struct qoe_stats *const q_stats = &sess->ds_q_stats;
+    const int q = dofp_seg_q(sess, i);
+    const int prev_q = i > 0 ? dofp_seg_q(sess, i - 1) : -1;
+    const int next_q = dofp_seg_q(sess, i + 1);
+    const double bitrate = sess->ds_ladder->dl_bitrates[q];
+
+    q_stats->sum_bitrate += sign * bitrate;
+    q_stats->sum_bitrate2 += sign * bitrate * bitrate;
+    q_stats->sum_quality += sign * (q + 1);
+    if (prev_q >= 0)
+    {
+        q_stats->instability += sign * (double) abs(prev_q - q) / (q + 1);
+        q_stats->switches += sign * (prev_q > q);
+    }
+    if (next_q >= 0)
+    {
+        q_stats->instability += sign * (double) abs(q - next_q) / (next_q + 1);
+        q_stats->switches += sign * (q > next_q);
+    }
+}
+
+
+static void
+qoe_changed (struct dofp_session *sess)
+{
+    struct dofp_qoe qoe;
+
+    if (sess->ds_settings.dss_on_qoe)
+    {
+        dofp_session_qoe(sess, &qoe);
+        sess->ds_settings.dss_on_qoe(sess, &qoe);
+    }
+}
+
+
+/* Update the buffer size when required */
+static void
+update_buff (struct dofp_session *sess, bool sr, dofp_time_t now)
+{
+    const unsigned seg_length = sess->ds_ladder->dl_seg_len;
+
+    if (sess->ds_playout) { /* If player is not paused */
+        double elapsed_time = (double) (now - sess->ds_playout_t) / 1000000;
+        sess->ds_playout_t = now;
+        if (elapsed_time > sess->ds_buffer_level) {
+            sess->ds_rep_seg_ind = sess->ds_seg_ind - 1;
+            sess->ds_rep_seg_time = 0.0;
+            sess->ds_playout = 0;
+            if (0 == stall_log_reserve(sess))
+                sess->ds_stalls.stl_t[LOG_SLOT(&sess->ds_stalls.stl_ring,
+                    sess->ds_stall_ind)] = (sess->ds_rep_seg_ind + 1) * seg_length;
+            sess->ds_stall_t = now - (dofp_time_t) ((elapsed_time - sess->ds_buffer_level) * 1000000);
+            sess->ds_buffer_level = 0.0;
+        } else {
+            sess->ds_buffer_level -= elapsed_time;
+            if (elapsed_time > sess->ds_rep_seg_time) {
+                sess->ds_rep_seg_ind += floor(1 + (elapsed_time - sess->ds_rep_seg_time) / seg_length);
+                sess->ds_rep_seg_time = seg_length - (elapsed_time - sess->ds_rep_seg_time - floor((elapsed_time - sess->ds_rep_seg_time) / seg_length) * seg_length);
+            } else
+                sess->ds_rep_seg_time -= elapsed_time;
+        }
+    }
+    if (sr) { /* Segment received */
+        sess->ds_buffer_level += seg_length;
+        if (!sess->ds_playout) { /* If player is paused */
+            if (sess->ds_buffer_level > sess->ds_settings.dss_min_init_bs) {
+                sess->ds_playout = 1;
+                sess->ds_playout_t = now;
+                const double stall_d = (double) (now - sess->ds_stall_t) / 1000000;
+                if (sess->ds_stall_ind < sess->ds_stalls.stl_ring.lr_end)
+                    sess->ds_stalls.stl_d[LOG_SLOT(&sess->ds_stalls.stl_ring,
+                                            sess->ds_stall_ind)] = stall_d;
+                if (sess->ds_p1203)
+                    dofp_p1203_on_stall(sess);
+                if (sess->ds_stall_ind > 0) { /* Not the initial buffering */
+                    ++sess->ds_q_stats.n_stalls;
+                    sess->ds_q_stats.stall_dur += stall_d;
+                } else
+                    sess->ds_q_stats.startup = stall_d;
+                ++sess->ds_stall_ind;
+                if (sess->ds_rep_seg_time <= 0) {
+                    if (sess->ds_rep_seg_ind < sess->ds_seg_ind) {
+                        ++sess->ds_rep_seg_ind;
+                        sess->ds_rep_seg_time = seg_length;
+                    }
+                }
+            }
+        }
+    }
+    if (sess->ds_p1203)
+        dofp_p1203_on_played(sess);
+}
+
+
+void
+dofp_session_update (struct dofp_session *sess, dofp_time_t now)
+{
+    update_buff(sess, false, now);
+}
+
+
+dofp_time_t
+dofp_session_next_event (const struct dofp_session *sess)
+{
+    double left;
+
+    if (!sess->ds_playout)
+        return 0;
+    left = MAX(MIN(sess->ds_rep_seg_time, sess->ds_buffer_level), 0);
+    /* The update moves past a boundary once the time is beyond it */
+    return sess->ds_playout_t + (dofp_time_t) floor(left * 1000000) + 1;
+}
+
+
+/* New throughput sample [kbps] */
+static void
+throughput_sample (struct dofp_session *sess, long double new_throughput)
+{
+    struct throughput_stats *const t_stats = &sess->ds_t_stats;
+
+    /* Smoothed throughput computation */
+    if (t_stats->s_throughput == 0)
+        t_stats->s_throughput = new_throughput;
+    else
+        t_stats->s_throughput = .875 * t_stats->s_throughput + .125 * new_throughput; // (1-1/8) and 1/8 as described in the WISH paper
+
+    /* Nothing was read: fall back to the smoothed throughput */
+    t_stats->throughput = (new_throughput == 0) ? t_stats->s_throughput : new_throughput;
+    t_stats->e_temp_throughput = sess->ds_settings.dss_tput_safety * t_stats->throughput;
+}
+
+
+void
+dofp_session_on_download (struct dofp_session *sess, size_t nbytes,
+                                                    dofp_time_t download_time)
+{
+    struct throughput_stats *const t_stats = &sess->ds_t_stats;
+
+    throughput_sample(sess, (long double) nbytes * 8 / ((long double) 1000 * download_time / 1000000)); // [kbps]
+    t_stats->tot_throughput += t_stats->e_temp_throughput; // Useful for computing the total throughput in multistreams scenarios
+}
+
+
+void
+dofp_session_on_rate (struct dofp_session *sess, long double rate)
+{
+    struct throughput_stats *const t_stats = &sess->ds_t_stats;
+
+    throughput_sample(sess, rate);
+    /* The rate is shared by every stream of the connection: concurrent
+     * downloads do not add up.
+     */
+    t_stats->tot_throughput = MAX(t_stats->tot_throughput,
+                                                t_stats->e_temp_throughput);
+}
+
+
+long double
+dofp_session_throughput (const struct dofp_session *sess)
+{
+    return sess->ds_t_stats.tot_throughput;
+}
+
+
+void
+dofp_session_share_throughput (struct dofp_session *sess, unsigned n)
+{
+    if (n)
+        sess->ds_t_stats.tot_throughput /= n;
+}
+
+
+bool
+dofp_session_segment_received (struct dofp_session *sess, unsigned q,
+                                                            dofp_time_t now)
+{
+    struct seg_log *const log = &sess->ds_segs;
+    unsigned slot;
+    int qi;
+
+    if (!dofp_ladder_has_seg(sess->ds_ladder, sess->ds_seg_ind))
+        return false;
+    if (0 != seg_log_reserve(sess))
+    {
+        fprintf(stderr, "%s: cannot grow the session log\n", __func__);
+        return false;
+    }
+
+    qi = ++sess->ds_qualities_ind;
+    slot = LOG_SLOT(&log->sl_ring, qi);
+    log->sl_q[slot] = q;
+    qoe_account(sess, qi, 1);
+    log->sl_e_tput[slot] = sess->ds_t_stats.e_temp_throughput;
+    if (sess->ds_abr->dai_on_segment)
+        sess->ds_abr->dai_on_segment(sess->ds_abr_ctx, sess, sess->ds_seg_ind,
+                                                                            q);
+    update_buff(sess, true, now);
+    log->sl_b_level[slot] = sess->ds_buffer_level;
+
+    ++sess->ds_seg_ind;
+    if (dofp_ladder_has_seg(sess->ds_ladder, sess->ds_seg_ind))
+    {
+        qoe_changed(sess);
+        return true;
+    }
+
+    update_buff(sess, false, now);
+    qoe_changed(sess);
+    return false;
+}
+
+
+bool
+dofp_session_retrans_acceptable (const struct dofp_session *sess,
+                                                            unsigned seg_ind)
+{
+    return seg_ind > sess->ds_rep_seg_ind;
+}
+
+
+bool
+dofp_session_retrans_received (struct dofp_session *sess, unsigned seg_ind,
+            unsigned q, size_t nbytes, bool cancelled, dofp_time_t now)
+{
+    struct wlb_stats *const w_stats = &sess->ds_w_stats;
+
+    /* A re-download does not add playout time to the buffer */
+    update_buff(sess, false, now);
+    w_stats->re_count++;
+    w_stats->re_data += nbytes / 1000;
+    if (!cancelled && dofp_session_retrans_acceptable(sess, seg_ind)
+                                && dofp_seg_q(sess, seg_ind - 1) >= 0)
+    {
+        qoe_account(sess, seg_ind - 1, -1);
+        sess->ds_segs.sl_q[LOG_SLOT(&sess->ds_segs.sl_ring, seg_ind - 1)]
+                                                                    = (int) q;
+        qoe_account(sess, seg_ind - 1, 1);
+        qoe_changed(sess);
+        return true;
+    }
+    else
+    {
+        w_stats->re_unused_count++;
+        w_stats->re_unused_data += nbytes / 1000;
+        qoe_changed(sess);
+        return false;
+    }
+}
+
+
+double
+dofp_session_available_time (const struct dofp_session *sess, unsigned seg_ind)
+{
+    if (seg_ind > sess->ds_rep_seg_ind)
+        return sess->ds_rep_seg_time
+            + (seg_ind - sess->ds_rep_seg_ind - 1) * sess->ds_ladder->dl_seg_len;
+    else
+        return 0.0;
+}
+
+
+dofp_time_t
+dofp_session_request_delay (const struct dofp_session *sess, dofp_time_t delay)
+{
+    const double over = sess->ds_buffer_level
+                                    - sess->ds_settings.dss_buffer_size;
+    dofp_time_t wait;
+
+    /* A paused player does not drain the buffer */
+    if (over <= 0 || !sess->ds_playout)
+        return delay;
+    wait = (dofp_time_t) ceil(over * 1000000);
+    return MAX(wait, delay);
+}
+
+
+void
+dofp_decision_next (const struct dofp_session *sess,
+                                    struct dofp_decision *dec, unsigned q)
+{
+    if (!dofp_ladder_has_seg(sess->ds_ladder, sess->ds_seg_ind))
+        return;
+    dec->dd_next = true;
+    dec->dd_next_seg.dsr_seg_ind = sess->ds_seg_ind;
+    dec->dd_next_seg.dsr_q = q;
+}
+
+
+int
+dofp_decision_add_ret (struct dofp_decision *dec, unsigned seg_ind, unsigned q)
+{
+    if (dec->dd_n_ret >= DOFP_MAX_RET)
+        return -1;
+    dec->dd_ret[dec->dd_n_ret].dsr_seg_ind = seg_ind;
+    dec->dd_ret[dec->dd_n_ret].dsr_q = q;
+    ++dec->dd_n_ret;
+    return 0;
+}
+
+
+enum dofp_status
+dofp_session_decide (struct dofp_session *sess, struct dofp_decision *dec,
+                                                        struct abr_job **job)
+{
+    enum dofp_status status;
+
+    dec->dd_next = false;
+    dec->dd_delay = 0;
+    dec->dd_solve_time = 0;
+    dec->dd_n_ret = 0;
+    *job = NULL;
+
+    /* The first segment is always requested at the lowest quality */
+    if (sess->ds_seg_ind > 1 && sess->ds_rep_seg_ind >= sess->ds_seg_ind)
+        return DOFP_END;    /* No place for improvement */
+    if (!dofp_ladder_has_seg(sess->ds_ladder, sess->ds_seg_ind)
+            && !(sess->ds_playout && ((sess->ds_abr->dai_flags & DOFP_ABR_RETRANS)
+                                            || sess->ds_settings.dss_h2br)))
+        return DOFP_END;    /* Nothing left to download or to improve */
+
+    if (sess->ds_buffer_level >= sess->ds_settings.dss_min_init_bs
+                                                        && sess->ds_playout)
+    {
+        status = sess->ds_abr->dai_decide(sess->ds_abr_ctx, sess, dec, job);
+        if (status != DOFP_DONE)
+            return status;
+        if (sess->ds_settings.dss_h2br)
+            dofp_h2br(sess, dec);
+    }
+    else    /* Transmit only new segment with lowest resolution */
+        dofp_decision_next(sess, dec, 0);
+
+    sess->ds_t_stats.tot_throughput = 0.0;
+    return DOFP_DONE;
+}
+
+
+enum dofp_status
+dofp_session_complete (struct dofp_session *sess, struct abr_job *job,
+                                                    struct dofp_decision *dec)
+{
+    enum dofp_status status;
+
+    status = sess->ds_abr->dai_complete(sess->ds_abr_ctx, sess, job, dec);
+    dofp_job_destroy(job);
+    if (status != DOFP_DONE)
+        return status;
+
+    if (sess->ds_settings.dss_h2br)
+        dofp_h2br(sess, dec);
+    sess->ds_t_stats.tot_throughput = 0.0;
+    return DOFP_DONE;
+}
+
+
+struct dofp_session *
+dofp_job_session (const struct abr_job *job)
+{
+    return ((const struct dofp_job *) job)->dj_sess;
+}
+
+
+void
+dofp_job_destroy (struct abr_job *job)
+{
+    free(job);
+}
+
+
+double
+dofp_session_buffer_level (const struct dofp_session *sess)
+{
+    return sess->ds_buffer_level;
+}
+
+
+unsigned
+dofp_session_seg_ind (const struct dofp_session *sess)
+{
+    return sess->ds_seg_ind;
+}
+
+
+unsigned
+dofp_session_rep_seg_ind (const struct dofp_session *sess)
+{
+    return sess->ds_rep_seg_ind;
+}
+
+
+int
+dofp_session_seg_quality (const struct dofp_session *sess, unsigned seg_ind)
+{
+    if (seg_ind >= 1)
+        return dofp_seg_q(sess, seg_ind - 1);
+    else
+        return -1;
+}
+
+
+void
+dofp_session_qoe (const struct dofp_session *sess, struct dofp_qoe *qoe)
+{
+    const struct qoe_stats *const q_stats = &sess->ds_q_stats;
+    unsigned n;
+
+    memset(qoe, 0, sizeof(*qoe));
+    n = sess->ds_qualities_ind + 1;
+    qoe->dq_n_seg = n;
+    if (n)
+    {
+        qoe->dq_avg_bitrate = q_stats->sum_bitrate / n;
+        qoe->dq_std_bitrate = sqrt(MAX(q_stats->sum_bitrate2 / n
+                    - qoe->dq_avg_bitrate * qoe->dq_avg_bitrate, 0.0));
+        qoe->dq_avg_quality = (double) q_stats->sum_quality / n;
+    }
+    qoe->dq_switches = q_stats->switches;
+    qoe->dq_instability = MAX(q_stats->instability, 0.0);
+
+    /* A stall still in progress has no duration yet and is not counted */
+    qoe->dq_startup = q_stats->startup;
+    qoe->dq_n_stalls = q_stats->n_stalls;
+    qoe->dq_stall_dur = q_stats->stall_dur;
+
+    qoe->dq_re_count = sess->ds_w_stats.re_count;
+    qoe->dq_re_unused_count = sess->ds_w_stats.re_unused_count;
+    qoe->dq_re_data = sess->ds_w_stats.re_data;
+    qoe->dq_re_unused_data = sess->ds_w_stats.re_unused_data;
+}
+
+
+int
+dofp_session_write_qoe (const struct dofp_session *sess, FILE *fp)
+{
+    const struct stall_log *const stalls = &sess->ds_stalls;
+    struct dofp_qoe qoe;
+    unsigned i;
+
+    dofp_session_qoe(sess, &qoe);
+    fprintf(fp, "Average bitrate (kbps),Average bitrate Std (kbps),Average quality level,Switches,Instability,Start-up (s),Stalls,Stall duration (s)\n");
+    fprintf(fp, "%.3f,%.3f,%.3f,%.1f,%.3f,%.3f,%.1f,", qoe.dq_avg_bitrate,
+        qoe.dq_std_bitrate, qoe.dq_avg_quality, (double) qoe.dq_switches,
+        qoe.dq_instability, qoe.dq_startup, (double) qoe.dq_n_stalls);
+    /* Stall durations are listed as a sum, like compute-metrics.py does,
+     * if they are all still in the log.
+     */
+    if (qoe.dq_n_stalls > 1 && stalls->stl_ring.lr_first <= 1)
+    {
+        fprintf(fp, "=%.3f", stalls->stl_d[LOG_SLOT(&stalls->stl_ring, 1)]);
+        for (i = 2; i <= qoe.dq_n_stalls; ++i)
+            fprintf(fp, "+%.3f", stalls->stl_d[LOG_SLOT(&stalls->stl_ring, i)]);
+    }
+    else
+        fprintf(fp, "%.3f", qoe.dq_stall_dur);
+    fprintf(fp, "\n");
+
+    return ferror(fp) ? -1 : 0;
+}
+
+
+int
+dofp_session_write_csv (const struct dofp_session *sess, FILE *fp)
+{
+    const struct dofp_ladder *const ladder = sess->ds_ladder;
+    const struct log_ring *const segs = &sess->ds_segs.sl_ring;
+    const struct log_ring *const stalls = &sess->ds_stalls.stl_ring;
+    const struct wlb_stats *const w_stats = &sess->ds_w_stats;
+    const bool retrans = (sess->ds_abr->dai_flags & DOFP_ABR_RETRANS)
+                                                || sess->ds_settings.dss_h2br;
+    unsigned i, first, end;
+    int q;
+
+    fprintf(fp, "THROUGHPUT,BITRATE,BUFFER,QUALITY,STALLT,STALLD");
+    if (retrans)
+        fprintf(fp, ",REDATA,RECOUNT,REUNUSED,REUNUSEDCOUNT");
+    fprintf(fp, "\n");
+    /* Stalls are listed alongside the segments, one per row */
+    first = MIN(segs->lr_first, stalls->lr_first);
+    end = MAX(MAX(segs->lr_end, stalls->lr_end), ladder->dl_n_seg);
+    for (i = first; i < end; i++) {
+        q = dofp_seg_q(sess, i);
+        if (q >= 0)
+            fprintf(fp, "%.2Lf,%i,%.3f,%i",
+                sess->ds_segs.sl_e_tput[LOG_SLOT(segs, i)],
+                ladder->dl_bitrates[q],
+                sess->ds_segs.sl_b_level[LOG_SLOT(segs, i)], q);
+        else
+            fprintf(fp, "%.2f,%i,%.3f,%i", 0.0, 0, 0.0, q);
+        if (i >= stalls->lr_first && i < stalls->lr_end)
+            fprintf(fp, ",%.3f,%.3f",
+                sess->ds_stalls.stl_t[LOG_SLOT(stalls, i)],
+                sess->ds_stalls.stl_d[LOG_SLOT(stalls, i)]);
+        else
+            fprintf(fp, ",%.3f,%.3f", 0.0, 0.0);
+        if (i == first && retrans)
+            fprintf(fp, ",%.3Lf,%u,%.3Lf,%u", w_stats->re_data,
+                w_stats->re_count, w_stats->re_unused_data,
+                w_stats->re_unused_count);
+        fprintf(fp, "\n");
+    }
+
+    return ferror(fp) ? -1 : 0;
+}
+
+
+/* Indexed by the -J option of http_client_dofp */
+static const struct dofp_abr_if *const abr_by_id[] =
+{
+    &dofp_abr_qi_norm,
+    &dofp_abr_max_j,
+    &dofp_abr_max_min_j,
+    &dofp_abr_max_min_j_norm,
+    &dofp_abr_maxr,
+    &dofp_abr_bola,
+    &dofp_abr_sara,
+    &dofp_abr_bba,
+};
+
+
+const struct dofp_abr_if *
+dofp_abr_by_id (unsigned id)
+{
+    if (id < sizeof(abr_by_id) / sizeof(abr_by_id[0]))
+        return abr_by_id[id];
+    else
+        return NULL;
+}
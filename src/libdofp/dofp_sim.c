@@ -0,0 +1,147 @@
+/* Trace-driven playback of one session
+ *
+ * Time is simulated: it only advances by the download times given by the
+ * trace, the delays asked for by the ABR and the full-buffer waits.  The
+ * request loop is the one of dofp_loadgen.
+ */
+
+#include <stdlib.h>
+
+#include "dofp_int.h"
+
+/* Re-downloads are cancelled this long before their playout, as in
+ * http_client_dofp [us].
+ */
+#define CANCEL_MARGIN 100000
+
+
+/* Download one segment and pass it to the session.  `*more' is cleared when
+ * the last new segment is received.
+ */
+static int
+sim_download (struct dofp_session *sess, const struct dofp_trace *trace,
+        const struct dofp_sim_params *params,
+        const struct dofp_segment_req *seg, bool ret, dofp_time_t *now,
+        bool *more)
+{
+    const struct dofp_ladder *const ladder = sess->ds_ladder;
+    dofp_time_t transfer, deadline, cut;
+    double kbit, avail;
+
+    kbit = (double) dofp_seg_size(ladder, seg->dsr_q, seg->dsr_seg_ind - 1);
+    transfer = dofp_trace_transfer_time(trace, *now + params->dsp_rtt, kbit);
+    if (transfer == (dofp_time_t) -1)
+        return -1;
+    transfer += params->dsp_rtt;
+
+    if (ret && seg->dsr_q > 0 && (sess->ds_abr->dai_flags & DOFP_ABR_CANCEL))
+    {
+        avail = dofp_session_available_time(sess, seg->dsr_seg_ind);
+        deadline = avail * 1000000 > CANCEL_MARGIN
+                 ? (dofp_time_t) (avail * 1000000) - CANCEL_MARGIN : 0;
+        if (deadline < transfer)
+        {
+            cut = deadline > params->dsp_rtt ? deadline - params->dsp_rtt : 0;
+            kbit = dofp_trace_volume(trace, *now + params->dsp_rtt, cut);
+            *now += deadline;
+            dofp_session_on_download(sess, (size_t) (kbit * 125),
+                                                            MAX(deadline, 1));
+            (void) dofp_session_retrans_received(sess, seg->dsr_seg_ind,
+                            seg->dsr_q, (size_t) (kbit * 125), true, *now);
+            return 0;
+        }
+    }
+
+    *now += transfer;
+    dofp_session_on_download(sess, (size_t) (kbit * 125), transfer);
+    if (ret)
+        (void) dofp_session_retrans_received(sess, seg->dsr_seg_ind,
+                            seg->dsr_q, (size_t) (kbit * 125), false, *now);
+    else
+        *more = dofp_session_segment_received(sess, seg->dsr_q, *now);
+    return 0;
+}
+
+
+int
+dofp_sim_run (struct dofp_session *sess, const struct dofp_trace *trace,
+                                        const struct dofp_sim_params *params)
+{
+    const struct dofp_ladder *const ladder = sess->ds_ladder;
+    const dofp_time_t seg_us = (dofp_time_t) ladder->dl_seg_len * 1000000;
+    const struct dofp_segment_req *seg;
+    struct dofp_decision dec;
+    struct abr_job *job;
+    dofp_time_t now = 0, delay;
+    unsigned n_dec, n_reqs, i;
+    long double throughput;
+    bool more = true;
+
+    if (ladder->dl_n_seg == 0)
+    {
+        fprintf(stderr, "%s: live content cannot be played to the end\n",
+                                                                __func__);
+        return -1;
+    }
+
+    /* Every decision downloads something or lets a segment play out */
+    for (n_dec = 0; n_dec < 100 * ladder->dl_n_seg; ++n_dec)
+    {
+        dofp_session_update(sess, now);
+        switch (dofp_session_decide(sess, &dec, &job))
+        {
+        case DOFP_DONE:
+            break;
+        case DOFP_PENDING:
+            job->aj_status = job->aj_solve(job);
+            if (DOFP_DONE != dofp_session_complete(sess, job, &dec))
+                return -1;
+            break;
+        case DOFP_END:
+            return 0;
+        default:
+            return -1;
+        }
+
+        n_reqs = 0;
+        if (dec.dd_next)
+        {
+            /* Wait if the ABR asked for it (SARA) or the buffer is full */
+            delay = dofp_session_request_delay(sess, dec.dd_delay);
+            if (delay)
+            {
+                now += delay;
+                dofp_session_update(sess, now);
+            }
+            if (0 != sim_download(sess, trace, params, &dec.dd_next_seg,
+                                                        false, &now, &more))
+                return -1;
+            if (!more)
+                return 0;
+            ++n_reqs;
+        }
+
+        /* Skip the re-downloads that cannot make it before their playout */
+        for (i = 0; i < dec.dd_n_ret; ++i)
+        {
+            seg = &dec.dd_ret[i];
+            throughput = dofp_session_throughput(sess);
+            if (dofp_session_retrans_acceptable(sess, seg->dsr_seg_ind)
+                && throughput > 0 && dofp_session_available_time(sess,
+                    seg->dsr_seg_ind) >= ladder->dl_bitrates[seg->dsr_q]
+                                        * ladder->dl_seg_len / throughput)
+            {
+                if (0 != sim_download(sess, trace, params, seg, true, &now,
+                                                                    &more))
+                    return -1;
+                ++n_reqs;
+            }
+        }
+
+        /* Nothing to do now: let one segment play out */
+        if (!n_reqs)
+            now += seg_us;
+    }
+
+    return -1;
+}
@@ -0,0 +1,269 @@
+/* Bandwidth traces for the simulator
+ *
+ * The traces are the shell scripts that shape the link of a live run with
+ * `tc qdisc'.  Only the rates and the sleeps between them are kept.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "dofp_int.h"
+
+
+/* Rate in the units of tc(8) [kbps].  Returns a negative value on error. */
+static double
+parse_rate (const char *s)
+{
+    static const struct { const char *unit; double mult; } units[] =
+    {
+        { "gbit", 1000000.0, },
+        { "mbit", 1000.0, },
+        { "kbit", 1.0, },
+        { "bit", .001, },
+        { "gbps", 8000000.0, },
+        { "mbps", 8000.0, },
+        { "kbps", 8.0, },
+        { "bps", .008, },
+    };
+    char *end;
+    double rate;
+    unsigned i;
+
+    rate = strtod(s, &end);
+    if (end == s || rate < 0)
+        return -1.0;
+    if (*end == '\0' || *end == ' ' || *end == '\t' || *end == '\n')
+        return rate * .008;     /* No unit: bytes per second */
+    for (i = 0; i < sizeof(units) / sizeof(units[0]); ++i)
+        if (0 == strncasecmp(end, units[i].unit, strlen(units[i].unit)))
+            return rate * units[i].mult;
+    return -1.0;
+}
+
+
+/* Argument of sleep(1) [us].  Returns a negative value on error. */
+static double
+parse_sleep (const char *s)
+{
+    char *end;
+    double secs;
+
+    secs = strtod(s, &end);
+    if (end == s || secs < 0)
+        return -1.0;
+    switch (*end)
+    {
+    case 'd':
+        secs *= 24;
+        /* fall through */
+    case 'h':
+        secs *= 60;
+        /* fall through */
+    case 'm':
+        secs *= 60;
+        break;
+    }
+    return secs * 1000000;
+}
+
+
+struct dofp_trace *
+dofp_trace_load (const char *filename)
+{
+    struct dofp_trace *trace;
+    struct dofp_trace_step *steps = NULL, *new_steps;
+    unsigned n_steps = 0, n_alloc = 0, lineno = 0, i, j;
+    FILE *fp;
+    char *line = NULL, *p, *rate;
+    const char *name;
+    size_t len = 0;
+    double val;
+
+    fp = fopen(filename, "r");
+    if (!fp)
+    {
+        fprintf(stderr, "cannot open trace %s: %s\n", filename,
+                                                            strerror(errno));
+        return NULL;
+    }
+
+    while (getline(&line, &len, fp) != -1)
+    {
+        ++lineno;
+        for (p = line; *p == ' ' || *p == '\t'; ++p)
+            ;
+        if (0 == strncmp(p, "tc ", 3) && (rate = strstr(p, " rate ")))
+        {
+            val = parse_rate(rate + 6);
+            if (val < 0)
+            {
+                fprintf(stderr, "%s:%u: invalid rate\n", filename, lineno);
+                goto err;
+            }
+            if (n_steps >= n_alloc)
+            {
+                n_alloc = n_alloc ? n_alloc * 2 : 256;
+                new_steps = realloc(steps, n_alloc * sizeof(steps[0]));
+                if (!new_steps)
+                    goto err;
+                steps = new_steps;
+            }
+            steps[n_steps].dts_start = 0;
+            steps[n_steps].dts_dur = 0;
+            steps[n_steps].dts_rate = val;
+            ++n_steps;
+        }
+        else if (0 == strncmp(p, "sleep ", 6))
+        {
+            val = parse_sleep(p + 6);
+            if (val < 0)
+            {
+                fprintf(stderr, "%s:%u: invalid sleep\n", filename, lineno);
+                goto err;
+            }
+            /* The link is not shaped before the first rate: skip */
+            if (n_steps)
+                steps[n_steps - 1].dts_dur += (dofp_time_t) llround(val);
+        }
+    }
+
+    /* Drop the rates that were replaced right away */
+    for (i = j = 0; i < n_steps; ++i)
+        if (steps[i].dts_dur)
+        {
+            steps[j].dts_start = j ? steps[j - 1].dts_start
+                                            + steps[j - 1].dts_dur : 0;
+            steps[j].dts_dur = steps[i].dts_dur;
+            steps[j].dts_rate = steps[i].dts_rate;
+            ++j;
+        }
+    n_steps = j;
+    if (n_steps == 0)
+    {
+        fprintf(stderr, "%s: no rates with a duration\n", filename);
+        goto err;
+    }
+
+    trace = calloc(1, sizeof(*trace));
+    if (!trace)
+        goto err;
+    name = strrchr(filename, '/');
+    trace->dt_name = strdup(name ? name + 1 : filename);
+    if (!trace->dt_name)
+    {
+        free(trace);
+        goto err;
+    }
+    trace->dt_n_steps = n_steps;
+    trace->dt_steps = steps;
+    trace->dt_len = steps[n_steps - 1].dts_start + steps[n_steps - 1].dts_dur;
+    fclose(fp);
+    free(line);
+    return trace;
+
+  err:
+    fclose(fp);
+    free(line);
+    free(steps);
+    return NULL;
+}
+
+
+void
+dofp_trace_destroy (struct dofp_trace *trace)
+{
+    free(trace->dt_steps);
+    free(trace->dt_name);
+    free(trace);
+}
+
+
+/* Index of the step that covers offset `off' of the trace */
+static unsigned
+trace_step (const struct dofp_trace *trace, dofp_time_t off)
+{
+    unsigned lo = 0, hi = trace->dt_n_steps - 1, mid;
+
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo + 1) / 2;
+        if (trace->dt_steps[mid].dts_start <= off)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+
+dofp_time_t
+dofp_trace_transfer_time (const struct dofp_trace *trace, dofp_time_t start,
+                                                                double kbit)
+{
+    const struct dofp_trace_step *step;
+    dofp_time_t off, left, elapsed = 0;
+    unsigned idx, n_idle = 0;
+    double capacity;
+
+    off = start % trace->dt_len;
+    idx = trace_step(trace, off);
+    while (kbit > 0)
+    {
+        step = &trace->dt_steps[idx];
+        left = step->dts_start + step->dts_dur - off;
+        capacity = step->dts_rate * left / 1000000;
+        if (capacity >= kbit)
+            return elapsed + (dofp_time_t) ceil(kbit / step->dts_rate
+                                                                * 1000000);
+        if (capacity > 0)
+            n_idle = 0;
+        else if (++n_idle > trace->dt_n_steps)
+            return (dofp_time_t) -1;
+        kbit -= capacity;
+        elapsed += left;
+        if (++idx == trace->dt_n_steps)
+            idx = 0;
+        off = trace->dt_steps[idx].dts_start;
+    }
+
+    return elapsed;
+}
+
+
+double
+dofp_trace_volume (const struct dofp_trace *trace, dofp_time_t start,
+                                                            dofp_time_t dur)
+{
+    const struct dofp_trace_step *step;
+    dofp_time_t off, left;
+    unsigned idx;
+    double kbit = 0;
+
+    /* Whole loops of the trace */
+    if (dur >= trace->dt_len)
+    {
+        for (idx = 0; idx < trace->dt_n_steps; ++idx)
+            kbit += trace->dt_steps[idx].dts_rate
+                                    * trace->dt_steps[idx].dts_dur / 1000000;
+        kbit *= dur / trace->dt_len;
+        dur %= trace->dt_len;
+    }
+
+    off = start % trace->dt_len;
+    idx = trace_step(trace, off);
+    while (dur > 0)
+    {
+        step = &trace->dt_steps[idx];
+        left = MIN(step->dts_start + step->dts_dur - off, dur);
+        kbit += step->dts_rate * left / 1000000;
+        dur -= left;
+        if (++idx == trace->dt_n_steps)
+            idx = 0;
+        off = trace->dt_steps[idx].dts_start;
+    }
+
+    return kbit;
+}
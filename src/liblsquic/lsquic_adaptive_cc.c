@@ -184,6 +184,18 @@ adaptive_cc_pacing_rate (void *cong_ctl, int in_recovery)
 }
 
 
+static uint64_t
+adaptive_cc_get_bw (void *cong_ctl)
+{
+    struct adaptive_cc *const acc = cong_ctl;
+
+    if (acc->acc_flags & ACC_CUBIC)
+        return 0;   /* Cubic has no estimate of its own */
+    else
+        return lsquic_cong_bbr_if.cci_get_bw(&acc->acc_bbr);
+}
+
+
 static void
 adaptive_cc_cleanup (void *cong_ctl)
 {
@@ -200,6 +212,7 @@ const struct cong_ctl_if lsquic_cong_adaptive_if =
     .cci_begin_ack     = adaptive_cc_begin_ack,
     .cci_end_ack       = adaptive_cc_end_ack,
     .cci_cleanup       = adaptive_cc_cleanup,
+    .cci_get_bw        = adaptive_cc_get_bw,
     .cci_get_cwnd      = adaptive_cc_get_cwnd,
     .cci_init          = adaptive_cc_init,
     .cci_pacing_rate   = adaptive_cc_pacing_rate,
@@ -51,6 +51,7 @@ const char *const lsquic_alid2str[] =
     [AL_BLOCKED_KA] = "BLOCKED_KA",
     [AL_MTU_PROBE]  = "MTU_PROBE",
     [AL_PACK_TOL]   = "PACK_TOL",
+    [AL_DEADLINE]   = "DEADLINE",
 };
 
 
@@ -264,6 +264,17 @@ lsquic_bbr_pacing_rate (void *cong_ctl, int in_recovery)
 }
 
 
+static uint64_t
+lsquic_bbr_get_bw (void *cong_ctl)
+{
+    struct lsquic_bbr *const bbr = cong_ctl;
+    struct bandwidth bw;
+
+    bw = BW(minmax_get(&bbr->bbr_max_bandwidth));
+    return BW_TO_BYTES_PER_SEC(&bw);
+}
+
+
 /* BbrSender::GetTargetCongestionWindow */
 static uint64_t
 get_target_cwnd (const struct lsquic_bbr *bbr, float gain)
@@ -1074,6 +1085,7 @@ const struct cong_ctl_if lsquic_cong_bbr_if =
     .cci_begin_ack     = lsquic_bbr_begin_ack,
     .cci_end_ack       = lsquic_bbr_end_ack,
     .cci_cleanup       = lsquic_bbr_cleanup,
+    .cci_get_bw        = lsquic_bbr_get_bw,
     .cci_get_cwnd      = lsquic_bbr_get_cwnd,
     .cci_init          = lsquic_bbr_init,
     .cci_pacing_rate   = lsquic_bbr_pacing_rate,
@@ -64,6 +64,10 @@ struct cong_ctl_if
     uint64_t
     (*cci_pacing_rate) (void *cong_ctl, int in_recovery);
 
+    /* Optional method.  Bandwidth estimate in bytes per second. */
+    uint64_t
+    (*cci_get_bw) (void *cong_ctl);
+
     void
     (*cci_cleanup) (void *cong_ctl);
 };
@@ -310,6 +310,16 @@ lsquic_conn_get_min_datagram_size (struct lsquic_conn *lconn)
 }
 
 
+int
+lsquic_conn_get_info (struct lsquic_conn *lconn, struct lsquic_conn_info *info)
+{
+    if (lconn->cn_if && lconn->cn_if->ci_get_info)
+        return lconn->cn_if->ci_get_info(lconn, info);
+    else
+        return -1;
+}
+
+
 #if LSQUIC_CONN_STATS
 void
 lsquic_conn_stats_diff (const struct conn_stats *cumulative_stats,
@@ -30,6 +30,7 @@ struct lsquic_packet_in;
 struct sockaddr;
 struct parse_funcs;
 struct attq_elem;
+struct lsquic_conn_info;
 #if LSQUIC_CONN_STATS
 struct conn_stats;
 #endif
@@ -293,6 +294,14 @@ struct conn_iface
     /* Optional method */
     void
     (*ci_early_data_failed) (struct lsquic_conn *);
+
+    /* Optional method */
+    int
+    (*ci_get_info) (struct lsquic_conn *, struct lsquic_conn_info *);
+
+    /* Optional method.  Check stream deadlines no later than `expiry'. */
+    void
+    (*ci_set_deadline_alarm) (struct lsquic_conn *, lsquic_time_t expiry);
 };
 
 #define LSCONN_CCE_BITS 3
@@ -0,0 +1,57 @@
+/* Copyright (c) 2017 - 2021 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_deadline_sched.c -- Write scheduling of streams with a deadline
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <sys/queue.h>
+
+#include "lsquic.h"
+#include "lsquic_int_types.h"
+#include "lsquic_sfcw.h"
+#include "lsquic_varint.h"
+#include "lsquic_hq.h"
+#include "lsquic_hash.h"
+#include "lsquic_stream.h"
+#include "lsquic_min_heap.h"
+#include "lsquic_deadline_sched.h"
+
+
+void
+lsquic_deadline_sched_init (struct deadline_sched *ds, uint64_t bw)
+{
+    ds->ds_heap.mh_elems = ds->ds_els;
+    ds->ds_heap.mh_nalloc = sizeof(ds->ds_els) / sizeof(ds->ds_els[0]);
+    ds->ds_heap.mh_nelem = 0;
+    ds->ds_bw = bw;
+}
+
+
+int
+lsquic_deadline_sched_filter (void *ctx, struct lsquic_stream *stream)
+{
+    struct deadline_sched *const ds = ctx;
+    lsquic_time_t deadline, need;
+    uint64_t left;
+
+    deadline = lsquic_stream_send_deadline(stream, &left);
+    if (deadline == 0 || lsquic_stream_is_critical(stream)
+            || lsquic_mh_count(&ds->ds_heap) >= lsquic_mh_nalloc(&ds->ds_heap))
+        return 1;
+
+    need = ds->ds_bw ? left * 1000000 / ds->ds_bw : 0;
+    lsquic_mh_insert(&ds->ds_heap, stream, deadline > need ? deadline - need : 0);
+    return 0;
+}
+
+
+struct lsquic_stream *
+lsquic_deadline_sched_next (struct deadline_sched *ds)
+{
+    if (lsquic_mh_count(&ds->ds_heap) > 0)
+        return lsquic_mh_pop(&ds->ds_heap);
+    else
+        return NULL;
+}
@@ -0,0 +1,35 @@
+/* Copyright (c) 2017 - 2021 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_deadline_sched.h -- Write scheduling of streams with a deadline
+ *
+ * When es_deadline_sched is set, streams with a send deadline are taken
+ * out of the priority iterator by the filter and kept in a min-heap
+ * ordered by the latest time they can start sending and still make their
+ * deadline.  They are written right after the critical streams.  Those
+ * that do not fit into the heap are left to the iterator.
+ */
+
+#ifndef LSQUIC_DEADLINE_SCHED_H
+#define LSQUIC_DEADLINE_SCHED_H 1
+
+struct lsquic_stream;
+
+struct deadline_sched
+{
+    struct min_heap         ds_heap;
+    uint64_t                ds_bw;      /* Bytes per second, 0 if unknown */
+    struct min_heap_elem    ds_els[32];
+};
+
+void
+lsquic_deadline_sched_init (struct deadline_sched *, uint64_t bw);
+
+/* Priority iterator filter: returns false if the stream is taken */
+int
+lsquic_deadline_sched_filter (void *ds, struct lsquic_stream *);
+
+/* Returns NULL when there are no more streams */
+struct lsquic_stream *
+lsquic_deadline_sched_next (struct deadline_sched *);
+
+#endif
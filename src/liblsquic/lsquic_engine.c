@@ -226,6 +226,7 @@ struct lsquic_engine
                                          */
         ENG_CONNS_BY_ADDR
                         = (1 <<  9),    /* Connections are hashed by address */
+        ENG_PACKETS_IN  = (1 << 10),    /* In lsquic_engine_packets_in() */
 #ifndef NDEBUG
         ENG_COALESCE    = (1 << 24),    /* Packet coalescing is enabled */
 #endif
@@ -249,6 +250,11 @@ struct lsquic_engine
     unsigned                           batch_size;
     unsigned                           min_batch_size, max_batch_size;
     struct lsquic_conn                *curr_conn;
+    /* While ENG_PACKETS_IN is set, the element found last by CID and the
+     * CID.  It is reset when the element is erased from the hash.
+     */
+    struct lsquic_hash_elem           *last_cid_el;
+    lsquic_cid_t                       last_cid;
     struct pr_queue                   *pr_queue;
     struct attq                       *attq;
     /* Track time last time a packet was sent to give new connections
@@ -393,6 +399,7 @@ lsquic_engine_init_settings (struct lsquic_engine_settings *settings,
     settings->es_ptpc_err_divisor= LSQUIC_DF_PTPC_ERR_DIVISOR;
     settings->es_delay_onclose   = LSQUIC_DF_DELAY_ONCLOSE;
     settings->es_check_tp_sanity = LSQUIC_DF_CHECK_TP_SANITY;
+    settings->es_deadline_sched  = LSQUIC_DF_DEADLINE_SCHED;
 }
 
 
@@ -999,8 +1006,22 @@ maybe_grow_conn_heaps (struct lsquic_engine *engine)
 }
 
 
+/* All erasures from the connections hash go through here, so that the
+ * element found last by CID never outlives its entry.
+ */
+static void
+erase_cce_from_hash (struct lsquic_engine *engine, struct conn_cid_elem *cce)
+{
+    if (engine->last_cid_el == &cce->cce_hash_el)
+        engine->last_cid_el = NULL;
+    lsquic_hash_erase(engine->conns_hash, &cce->cce_hash_el);
+    assert(!engine->last_cid_el
+                        || (engine->last_cid_el->qhe_flags & QHE_HASHED));
+}
+
+
 static void
-remove_cces_from_hash (struct lsquic_hash *hash, struct lsquic_conn *conn,
+remove_cces_from_hash (struct lsquic_engine *engine, struct lsquic_conn *conn,
                                                                 unsigned todo)
 {
     unsigned n;
@@ -1008,14 +1029,15 @@ remove_cces_from_hash (struct lsquic_hash *hash, struct lsquic_conn *conn,
     for (n = 0; todo; todo &= ~(1 << n++))
         if ((todo & (1 << n)) &&
                         (conn->cn_cces[n].cce_hash_el.qhe_flags & QHE_HASHED))
-            lsquic_hash_erase(hash, &conn->cn_cces[n].cce_hash_el);
+            erase_cce_from_hash(engine, &conn->cn_cces[n]);
 }
 
 
 static void
-remove_all_cces_from_hash (struct lsquic_hash *hash, struct lsquic_conn *conn)
+remove_all_cces_from_hash (struct lsquic_engine *engine,
+                                                    struct lsquic_conn *conn)
 {
-    remove_cces_from_hash(hash, conn, conn->cn_cces_mask);
+    remove_cces_from_hash(engine, conn, conn->cn_cces_mask);
 }
 
 
@@ -1050,7 +1072,7 @@ insert_conn_into_hash (struct lsquic_engine *engine, struct lsquic_conn *conn,
     return 0;
 
   err:
-    remove_cces_from_hash(engine->conns_hash, conn, done);
+    remove_cces_from_hash(engine, conn, done);
     return -1;
 }
 
@@ -1211,6 +1233,30 @@ dcid_checks_out (const struct lsquic_conn *conn, const lsquic_cid_t *dcid)
 }
 
 
+/* Within lsquic_engine_packets_in(), packets in a row are likely to be for
+ * the same connection: the hash is not searched again for the same CID.
+ */
+static struct lsquic_hash_elem *
+find_conn_by_cid (struct lsquic_engine *engine, const lsquic_cid_t *cid)
+{
+    struct lsquic_hash_elem *el;
+
+    if (engine->last_cid_el && LSQUIC_CIDS_EQ(&engine->last_cid, cid))
+    {
+        assert(engine->flags & ENG_PACKETS_IN);
+        assert(engine->last_cid_el->qhe_flags & QHE_HASHED);
+        return engine->last_cid_el;
+    }
+    el = lsquic_hash_find(engine->conns_hash, cid->idbuf, cid->len);
+    if (el && (engine->flags & ENG_PACKETS_IN))
+    {
+        engine->last_cid_el = el;
+        engine->last_cid = *cid;
+    }
+    return el;
+}
+
+
 static lsquic_conn_t *
 find_conn (lsquic_engine_t *engine, lsquic_packet_in_t *packet_in,
          struct packin_parse_state *ppstate, const struct sockaddr *sa_local)
@@ -1231,8 +1277,7 @@ find_conn (lsquic_engine_t *engine, lsquic_packet_in_t *packet_in,
         }
     }
     else if (packet_in->pi_flags & PI_CONN_ID)
-        el = lsquic_hash_find(engine->conns_hash,
-                    packet_in->pi_conn_id.idbuf, packet_in->pi_conn_id.len);
+        el = find_conn_by_cid(engine, &packet_in->pi_conn_id);
     else
     {
         LSQ_DEBUG("packet header does not have connection ID: discarding");
@@ -1278,8 +1323,7 @@ find_or_create_conn (lsquic_engine_t *engine, lsquic_packet_in_t *packet_in,
         LSQ_DEBUG("packet header does not have connection ID: discarding");
         return NULL;
     }
-    el = lsquic_hash_find(engine->conns_hash,
-                    packet_in->pi_conn_id.idbuf, packet_in->pi_conn_id.len);
+    el = find_conn_by_cid(engine, &packet_in->pi_conn_id);
 
     if (el)
     {
@@ -1829,7 +1873,7 @@ lsquic_engine_connect (lsquic_engine_t *engine, enum lsquic_version version,
 static void
 remove_conn_from_hash (lsquic_engine_t *engine, lsquic_conn_t *conn)
 {
-    remove_all_cces_from_hash(engine->conns_hash, conn);
+    remove_all_cces_from_hash(engine, conn);
     (void) engine_decref_conn(engine, conn, LSCONN_HASHED);
 }
 
@@ -3080,6 +3124,25 @@ lsquic_engine_packet_in (lsquic_engine_t *engine,
 }
 
 
+unsigned
+lsquic_engine_packets_in (lsquic_engine_t *engine,
+        const struct lsquic_in_spec *specs, unsigned count, void *peer_ctx)
+{
+    unsigned n;
+
+    engine->flags |= ENG_PACKETS_IN;
+    for (n = 0; n < count; ++n)
+        if (0 > lsquic_engine_packet_in(engine, specs[n].data, specs[n].sz,
+                    specs[n].local_sa, specs[n].peer_sa, peer_ctx,
+                    specs[n].ecn))
+            break;
+    engine->flags &= ~ENG_PACKETS_IN;
+    engine->last_cid_el = NULL;
+
+    return n;
+}
+
+
 #if __GNUC__ && !defined(NDEBUG)
 __attribute__((weak))
 #endif
@@ -3344,7 +3407,7 @@ lsquic_engine_retire_cid (struct lsquic_engine_public *enpub,
     assert(cce_idx < conn->cn_n_cces);
 
     if (cce->cce_hash_el.qhe_flags & QHE_HASHED)
-        lsquic_hash_erase(engine->conns_hash, &cce->cce_hash_el);
+        erase_cce_from_hash(engine, cce);
 
     if (engine->purga)
     {
@@ -267,6 +267,9 @@ handshake_alarm_expired (enum alarm_id, void *ctx, lsquic_time_t expiry, lsquic_
 static void
 ack_alarm_expired (enum alarm_id, void *ctx, lsquic_time_t expiry, lsquic_time_t now);
 
+static void
+deadline_alarm_expired (enum alarm_id, void *ctx, lsquic_time_t expiry, lsquic_time_t now);
+
 static lsquic_stream_t *
 new_stream (struct full_conn *conn, lsquic_stream_id_t stream_id,
             enum stream_ctor_flags);
@@ -661,6 +664,7 @@ new_conn_common (lsquic_cid_t cid, struct lsquic_engine_public *enpub,
     lsquic_alarmset_init_alarm(&conn->fc_alset, AL_ACK_APP, ack_alarm_expired, conn);
     lsquic_alarmset_init_alarm(&conn->fc_alset, AL_PING, ping_alarm_expired, conn);
     lsquic_alarmset_init_alarm(&conn->fc_alset, AL_HANDSHAKE, handshake_alarm_expired, conn);
+    lsquic_alarmset_init_alarm(&conn->fc_alset, AL_DEADLINE, deadline_alarm_expired, conn);
     lsquic_set64_init(&conn->fc_closed_stream_ids[0]);
     lsquic_set64_init(&conn->fc_closed_stream_ids[1]);
     lsquic_cfcw_init(&conn->fc_pub.cfcw, &conn->fc_pub, conn->fc_settings->es_cfcw);
@@ -2555,6 +2559,28 @@ ping_alarm_expired (enum alarm_id al_id, void *ctx, lsquic_time_t expiry,
 }
 
 
+static void
+deadline_alarm_expired (enum alarm_id al_id, void *ctx, lsquic_time_t expiry,
+                                                            lsquic_time_t now)
+{
+    struct full_conn *conn = ctx;
+    struct lsquic_hash_elem *el;
+    lsquic_time_t next, min_next;
+
+    min_next = 0;
+    for (el = lsquic_hash_first(conn->fc_pub.all_streams); el;
+                                 el = lsquic_hash_next(conn->fc_pub.all_streams))
+    {
+        next = lsquic_stream_check_deadline(lsquic_hashelem_getdata(el), now);
+        if (next && (min_next == 0 || next < min_next))
+            min_next = next;
+    }
+
+    if (min_next)
+        lsquic_alarmset_set(&conn->fc_alset, AL_DEADLINE, min_next);
+}
+
+
 static lsquic_packet_out_t *
 get_writeable_packet (struct full_conn *conn, unsigned need_at_least)
 {
@@ -4348,6 +4374,25 @@ full_conn_ci_is_tickable (lsquic_conn_t *lconn)
 }
 
 
+static void
+full_conn_ci_set_deadline_alarm (struct lsquic_conn *lconn,
+                                                        lsquic_time_t expiry)
+{
+    struct full_conn *conn = (struct full_conn *) lconn;
+
+    if (lsquic_alarmset_is_set(&conn->fc_alset, AL_DEADLINE)
+                    && conn->fc_alset.as_expiry[AL_DEADLINE] <= expiry)
+        return;
+
+    lsquic_alarmset_set(&conn->fc_alset, AL_DEADLINE, expiry);
+    /* See ietf_full_conn_ci_set_deadline_alarm() */
+    if ((lconn->cn_flags & LSCONN_ATTQ) ? lsquic_conn_adv_time(lconn) > expiry
+                        : !(conn->fc_enpub->enp_flags & ENPUB_PROC))
+        lsquic_engine_add_conn_to_attq(conn->fc_enpub, lconn, expiry,
+                                                    N_AEWS + AL_DEADLINE);
+}
+
+
 static lsquic_time_t
 full_conn_ci_next_tick_time (lsquic_conn_t *lconn, unsigned *why)
 {
@@ -4561,6 +4606,7 @@ static const struct conn_iface full_conn_iface = {
     .ci_packet_not_sent      =  full_conn_ci_packet_not_sent,
     .ci_packet_sent          =  full_conn_ci_packet_sent,
     .ci_record_addrs         =  full_conn_ci_record_addrs,
+    .ci_set_deadline_alarm   =  full_conn_ci_set_deadline_alarm,
     /* gQUIC connection does not need this functionality because it only
      * uses one CID and it's liveness is updated automatically by the
      * caller when packets come in.
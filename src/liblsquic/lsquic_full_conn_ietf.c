@@ -43,6 +43,7 @@
 #include "lsquic_conn_public.h"
 #include "lsquic_bw_sampler.h"
 #include "lsquic_minmax.h"
+#include "lsquic_rx_rate.h"
 #include "lsquic_bbr.h"
 #include "lsquic_adaptive_cc.h"
 #include "lsquic_send_ctl.h"
@@ -72,6 +73,7 @@
 #include "lsquic_full_conn.h"
 #include "lsquic_spi.h"
 #include "lsquic_min_heap.h"
+#include "lsquic_deadline_sched.h"
 #include "lsquic_hpi.h"
 #include "lsquic_ietf.h"
 #include "lsquic_push_promise.h"
@@ -448,6 +450,7 @@ struct ietf_full_conn
     unsigned                    ifc_max_retx_since_last_ack;
     lsquic_time_t               ifc_max_ack_delay;
     uint64_t                    ifc_ecn_counts_in[N_PNS][4];
+    struct rx_rate              ifc_rx_rate;
     lsquic_stream_id_t          ifc_max_req_id;
     struct hcso_writer          ifc_hcso;
     struct http_ctl_stream_in   ifc_hcsi;
@@ -852,6 +855,28 @@ ping_alarm_expired (enum alarm_id al_id, void *ctx, lsquic_time_t expiry,
 }
 
 
+static void
+deadline_alarm_expired (enum alarm_id al_id, void *ctx, lsquic_time_t expiry,
+                                                            lsquic_time_t now)
+{
+    struct ietf_full_conn *const conn = (struct ietf_full_conn *) ctx;
+    struct lsquic_hash_elem *el;
+    lsquic_time_t next, min_next;
+
+    min_next = 0;
+    for (el = lsquic_hash_first(conn->ifc_pub.all_streams); el;
+                             el = lsquic_hash_next(conn->ifc_pub.all_streams))
+    {
+        next = lsquic_stream_check_deadline(lsquic_hashelem_getdata(el), now);
+        if (next && (min_next == 0 || next < min_next))
+            min_next = next;
+    }
+
+    if (min_next)
+        lsquic_alarmset_set(&conn->ifc_alset, AL_DEADLINE, min_next);
+}
+
+
 static void
 retire_cid (struct ietf_full_conn *, struct conn_cid_elem *, lsquic_time_t);
 
@@ -1277,6 +1302,7 @@ ietf_full_conn_init (struct ietf_full_conn *conn,
     lsquic_alarmset_init_alarm(&conn->ifc_alset, AL_PATH_CHAL_3, path_chal_alarm_expired, conn);
     lsquic_alarmset_init_alarm(&conn->ifc_alset, AL_BLOCKED_KA, blocked_ka_alarm_expired, conn);
     lsquic_alarmset_init_alarm(&conn->ifc_alset, AL_MTU_PROBE, mtu_probe_alarm_expired, conn);
+    lsquic_alarmset_init_alarm(&conn->ifc_alset, AL_DEADLINE, deadline_alarm_expired, conn);
     /* For Init and Handshake, we don't expect many ranges at all.  For
      * the regular receive history, set limit to a value that would never
      * be reached under normal circumstances, yet small enough that would
@@ -1291,6 +1317,7 @@ ietf_full_conn_init (struct ietf_full_conn *conn,
         &conn->ifc_pub, SC_IETF|SC_NSTP|(ecn ? SC_ECN : 0));
     lsquic_cfcw_init(&conn->ifc_pub.cfcw, &conn->ifc_pub,
                                         conn->ifc_settings->es_init_max_data);
+    lsquic_rx_rate_init(&conn->ifc_rx_rate);
     conn->ifc_pub.all_streams = lsquic_hash_create();
     if (!conn->ifc_pub.all_streams)
         return -1;
@@ -4344,22 +4371,44 @@ write_is_possible (struct ietf_full_conn *conn)
 static void
 process_streams_write_events (struct ietf_full_conn *conn, int high_prio)
 {
-    struct lsquic_stream *stream;
+    struct lsquic_stream *stream, *dl_stream;
+    struct deadline_sched ds;
     union prio_iter pi;
+    int sched;
+
+    sched = conn->ifc_settings->es_deadline_sched;
+    if (sched)
+        lsquic_deadline_sched_init(&ds,
+                                lsquic_send_ctl_get_bw(&conn->ifc_send_ctl));
 
     conn->ifc_pii->pii_init(&pi, TAILQ_FIRST(&conn->ifc_pub.write_streams),
         TAILQ_LAST(&conn->ifc_pub.write_streams, lsquic_streams_tailq),
         (uintptr_t) &TAILQ_NEXT((lsquic_stream_t *) NULL, next_write_stream),
         &conn->ifc_pub,
-        high_prio ? "write-high" : "write-low", NULL, NULL);
+        high_prio ? "write-high" : "write-low",
+        sched ? lsquic_deadline_sched_filter : NULL, sched ? &ds : NULL);
 
     if (high_prio)
         conn->ifc_pii->pii_drop_non_high(&pi);
     else
         conn->ifc_pii->pii_drop_high(&pi);
 
-    for (stream = conn->ifc_pii->pii_first(&pi);
-                        stream && write_is_possible(conn);
+    stream = conn->ifc_pii->pii_first(&pi);
+
+    /* Streams with a deadline go right after the critical streams.  If the
+     * high-priority pass has no critical streams, it returns the streams of
+     * the best urgency, which go after the ones with a deadline.
+     */
+    if (sched && !(high_prio && stream && lsquic_stream_is_critical(stream)))
+        while (write_is_possible(conn)
+                            && (dl_stream = lsquic_deadline_sched_next(&ds)))
+        {
+            LSQ_DEBUG("deadline scheduling: stream %"PRIu64, dl_stream->id);
+            if (dl_stream->sm_qflags & SMQF_WRITE_Q_FLAGS)
+                lsquic_stream_dispatch_write_events(dl_stream);
+        }
+
+    for ( ; stream && write_is_possible(conn);
                                     stream = conn->ifc_pii->pii_next(&pi))
         if (stream->sm_qflags & SMQF_WRITE_Q_FLAGS)
             lsquic_stream_dispatch_write_events(stream);
@@ -7502,6 +7551,9 @@ process_regular_packet (struct ietf_full_conn *conn,
                 cpath->cop_spin_bit = !lsquic_packet_in_spin_bit(packet_in);
         }
         conn->ifc_pub.bytes_in += packet_in->pi_data_sz;
+        lsquic_rx_rate_packet_in(&conn->ifc_rx_rate, packet_in->pi_received,
+                packet_in->pi_data_sz,
+                lsquic_rtt_stats_get_srtt(&conn->ifc_pub.rtt_stats));
         if ((conn->ifc_mflags & MF_VALIDATE_PATH) &&
                 (packet_in->pi_header_type == HETY_NOT_SET
               || packet_in->pi_header_type == HETY_HANDSHAKE))
@@ -8074,6 +8126,42 @@ ietf_full_conn_ci_early_data_failed (struct lsquic_conn *lconn)
 }
 
 
+static int
+ietf_full_conn_ci_get_info (struct lsquic_conn *lconn,
+                                            struct lsquic_conn_info *info)
+{
+    struct ietf_full_conn *conn = (struct ietf_full_conn *) lconn;
+
+    lsquic_send_ctl_get_info(&conn->ifc_send_ctl, info);
+    info->lci_bytes_in = lsquic_rx_rate_total(&conn->ifc_rx_rate);
+    info->lci_recv_rate = lsquic_rx_rate_get(&conn->ifc_rx_rate);
+    info->lci_recv_rate_max = lsquic_rx_rate_get_max(&conn->ifc_rx_rate);
+    return 0;
+}
+
+
+static void
+ietf_full_conn_ci_set_deadline_alarm (struct lsquic_conn *lconn,
+                                                        lsquic_time_t expiry)
+{
+    struct ietf_full_conn *conn = (struct ietf_full_conn *) lconn;
+
+    if (lsquic_alarmset_is_set(&conn->ifc_alset, AL_DEADLINE)
+                    && conn->ifc_alset.as_expiry[AL_DEADLINE] <= expiry)
+        return;
+
+    lsquic_alarmset_set(&conn->ifc_alset, AL_DEADLINE, expiry);
+    /* While connections are processed, the tick time of this connection is
+     * queried after its tick.  Otherwise, the alarm may be earlier than the
+     * time at which the engine is going to tick it.
+     */
+    if ((lconn->cn_flags & LSCONN_ATTQ) ? lsquic_conn_adv_time(lconn) > expiry
+                        : !(conn->ifc_enpub->enp_flags & ENPUB_PROC))
+        lsquic_engine_add_conn_to_attq(conn->ifc_enpub, lconn, expiry,
+                                                    N_AEWS + AL_DEADLINE);
+}
+
+
 static size_t
 ietf_full_conn_ci_get_min_datagram_size (struct lsquic_conn *lconn)
 {
@@ -8836,6 +8924,7 @@ ietf_full_conn_ci_log_stats (struct lsquic_conn *lconn)
     .ci_drop_crypto_streams  =  ietf_full_conn_ci_drop_crypto_streams, \
     .ci_early_data_failed    =  ietf_full_conn_ci_early_data_failed, \
     .ci_get_engine           =  ietf_full_conn_ci_get_engine, \
+    .ci_get_info             =  ietf_full_conn_ci_get_info, \
     .ci_get_log_cid          =  ietf_full_conn_ci_get_log_cid, \
     .ci_get_min_datagram_size=  ietf_full_conn_ci_get_min_datagram_size, \
     .ci_get_path             =  ietf_full_conn_ci_get_path, \
@@ -8854,6 +8943,7 @@ ietf_full_conn_ci_log_stats (struct lsquic_conn *lconn)
     .ci_record_addrs         =  ietf_full_conn_ci_record_addrs, \
     .ci_report_live          =  ietf_full_conn_ci_report_live, \
     .ci_retx_timeout         =  ietf_full_conn_ci_retx_timeout, \
+    .ci_set_deadline_alarm   =  ietf_full_conn_ci_set_deadline_alarm, \
     .ci_set_min_datagram_size=  ietf_full_conn_ci_set_min_datagram_size, \
     .ci_status               =  ietf_full_conn_ci_status, \
     .ci_stateless_reset      =  ietf_full_conn_ci_stateless_reset, \
@@ -193,6 +193,8 @@ lsquic_packet_out_add_stream (struct lsquic_packet_out *packet_out,
                             (uintptr_t) new_stream, frame_type, off, len))
     {
         ++new_stream->n_unacked;
+        if (frame_type == QUIC_FRAME_STREAM)
+            new_stream->sm_frame_bytes_out += len;
         return 0;
     }
     else
@@ -342,6 +344,7 @@ lsquic_packet_out_elide_reset_stream_frames (lsquic_packet_out_t *packet_out,
                         packet_out->po_data_sz - frec->fe_off - frec->fe_len);
                 packet_out->po_data_sz -= frec->fe_len;
 
+                frec->fe_stream->sm_frame_bytes_out -= frec->fe_len;
                 lsquic_stream_acked(frec->fe_stream, frec->fe_frame_type);
                 frec->fe_frame_type = 0;
             }
@@ -401,7 +404,11 @@ lsquic_packet_out_ack_streams (lsquic_packet_out_t *packet_out)
                                                 frec = lsquic_pofi_next(&pofi))
         if ((1 << frec->fe_frame_type)
                 & (QUIC_FTBIT_STREAM|QUIC_FTBIT_CRYPTO|QUIC_FTBIT_RST_STREAM))
+        {
+            if (frec->fe_frame_type == QUIC_FRAME_STREAM)
+                frec->fe_stream->sm_frame_bytes_acked += frec->fe_len;
             lsquic_stream_acked(frec->fe_stream, frec->fe_frame_type);
+        }
 }
 
 
@@ -193,6 +193,9 @@ lsquic_packet_resize_next (struct packet_resize_ctx *prctx)
             LSQ_DEBUG("finished using %s frame record",
                                         frame_type_2_str[frec->fe_frame_type]);
             --frec->fe_stream->n_unacked;
+            /* Replaced by the frames of the new packets */
+            if (frec->fe_frame_type == QUIC_FRAME_STREAM)
+                frec->fe_stream->sm_frame_bytes_out -= frec->fe_len;
             frec = prctx->prc_cur_frec = NULL;
             if (lsquic_packet_out_avail(new) > 0)
                 if (frec = packet_resize_get_frec(prctx), frec != NULL)
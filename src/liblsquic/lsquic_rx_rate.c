@@ -0,0 +1,69 @@
+/* Copyright (c) 2017 - 2021 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_rx_rate.c -- Receive-side delivery rate
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "lsquic_int_types.h"
+#include "lsquic_minmax.h"
+#include "lsquic_rx_rate.h"
+
+/* Intervals are never shorter than this, so that a burst of packets that
+ * arrive together on a short path does not produce an absurd rate.
+ */
+#define RXR_MIN_INTERVAL 10000
+
+/* Used before the first RTT sample */
+#define RXR_DEFAULT_INTERVAL 50000
+
+/* The maximum rate is taken over this many intervals */
+#define RXR_MAX_INTERVALS 10
+
+
+void
+lsquic_rx_rate_init (struct rx_rate *rxr)
+{
+    memset(rxr, 0, sizeof(*rxr));
+    minmax_init(&rxr->rxr_max, RXR_MAX_INTERVALS * RXR_DEFAULT_INTERVAL);
+}
+
+
+void
+lsquic_rx_rate_packet_in (struct rx_rate *rxr, lsquic_time_t now,
+                                            unsigned sz, lsquic_time_t srtt)
+{
+    lsquic_time_t interval;
+
+    rxr->rxr_total += sz;
+
+    if (srtt == 0)
+        interval = RXR_DEFAULT_INTERVAL;
+    else if (srtt < RXR_MIN_INTERVAL)
+        interval = RXR_MIN_INTERVAL;
+    else
+        interval = srtt;
+
+    /* The interval starts with the arrival of its first packet: the bytes
+     * of that packet were on their way before it.
+     */
+    if (rxr->rxr_start == 0 || now - rxr->rxr_last > interval)
+    {
+        rxr->rxr_start = now;
+        rxr->rxr_last = now;
+        rxr->rxr_bytes = 0;
+        return;
+    }
+
+    rxr->rxr_bytes += sz;
+    rxr->rxr_last = now;
+    if (now - rxr->rxr_start >= interval)
+    {
+        rxr->rxr_rate = rxr->rxr_bytes * 1000000 / (now - rxr->rxr_start);
+        rxr->rxr_max.window = RXR_MAX_INTERVALS * interval;
+        minmax_upmax(&rxr->rxr_max, now, rxr->rxr_rate);
+        rxr->rxr_start = now;
+        rxr->rxr_bytes = 0;
+    }
+}
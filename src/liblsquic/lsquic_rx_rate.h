@@ -0,0 +1,41 @@
+/* Copyright (c) 2017 - 2021 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_rx_rate.h -- Receive-side delivery rate
+ *
+ * The congestion controller estimates the bandwidth of the sending
+ * direction.  A client that downloads needs the other one: this module
+ * measures the rate at which packets arrive, over intervals of one
+ * smoothed RTT during which the peer keeps sending.  An idle gap starts a
+ * new interval, so that the time spent waiting for a request to be
+ * answered does not count.
+ */
+
+#ifndef LSQUIC_RX_RATE_H
+#define LSQUIC_RX_RATE_H 1
+
+struct rx_rate
+{
+    struct minmax       rxr_max;        /* Bytes per second, over the last
+                                         * RXR_MAX_INTERVALS intervals
+                                         */
+    lsquic_time_t       rxr_start;      /* Start of the current interval */
+    lsquic_time_t       rxr_last;       /* Arrival of the last packet */
+    uint64_t            rxr_bytes;      /* Received since rxr_start */
+    uint64_t            rxr_total;      /* Received since init */
+    uint64_t            rxr_rate;       /* Last completed interval */
+};
+
+void
+lsquic_rx_rate_init (struct rx_rate *);
+
+void
+lsquic_rx_rate_packet_in (struct rx_rate *, lsquic_time_t now, unsigned sz,
+                                                        lsquic_time_t srtt);
+
+#define lsquic_rx_rate_get(rxr_) (+(rxr_)->rxr_rate)
+
+#define lsquic_rx_rate_get_max(rxr_) minmax_get(&(rxr_)->rxr_max)
+
+#define lsquic_rx_rate_total(rxr_) (+(rxr_)->rxr_total)
+
+#endif
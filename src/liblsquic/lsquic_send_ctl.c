@@ -1617,6 +1617,45 @@ send_ctl_all_bytes_out (const struct lsquic_send_ctl *ctl)
 }
 
 
+/* Fills in the RTT and congestion control part of `info' */
+void
+lsquic_send_ctl_get_info (struct lsquic_send_ctl *ctl,
+                                            struct lsquic_conn_info *info)
+{
+    const struct lsquic_rtt_stats *const rtt_stats
+                                            = &ctl->sc_conn_pub->rtt_stats;
+
+    info->lci_srtt = lsquic_rtt_stats_get_srtt(rtt_stats);
+    info->lci_rttvar = lsquic_rtt_stats_get_rttvar(rtt_stats);
+    info->lci_min_rtt = lsquic_rtt_stats_get_min_rtt(rtt_stats);
+    info->lci_cwnd = ctl->sc_ci->cci_get_cwnd(CGP(ctl));
+    info->lci_bytes_in_flight = send_ctl_all_bytes_out(ctl);
+    info->lci_pacing_rate = ctl->sc_ci->cci_pacing_rate(CGP(ctl),
+                                                send_ctl_in_recovery(ctl));
+    info->lci_send_bw = lsquic_send_ctl_get_bw(ctl);
+}
+
+
+uint64_t
+lsquic_send_ctl_get_bw (struct lsquic_send_ctl *ctl)
+{
+    lsquic_time_t srtt;
+    uint64_t bw;
+
+    if (ctl->sc_ci->cci_get_bw)
+        bw = ctl->sc_ci->cci_get_bw(CGP(ctl));
+    else
+        bw = 0;
+    if (bw == 0)
+    {
+        srtt = lsquic_rtt_stats_get_srtt(&ctl->sc_conn_pub->rtt_stats);
+        if (srtt)
+            bw = ctl->sc_ci->cci_get_cwnd(CGP(ctl)) * 1000000 / srtt;
+    }
+    return bw;
+}
+
+
 int
 lsquic_send_ctl_pacer_blocked (struct lsquic_send_ctl *ctl)
 {
@@ -21,6 +21,7 @@ struct network_path;
 struct ver_neg;
 enum pns;
 struct to_coal;
+struct lsquic_conn_info;
 
 enum buf_packet_type { BPT_HIGHEST_PRIO, BPT_OTHER_PRIO, };
 
@@ -358,6 +359,13 @@ lsquic_send_ctl_turn_on_fin (struct lsquic_send_ctl *,
 int
 lsquic_send_ctl_pacer_blocked (struct lsquic_send_ctl *);
 
+void
+lsquic_send_ctl_get_info (struct lsquic_send_ctl *, struct lsquic_conn_info *);
+
+/* Send bandwidth estimate [bytes per second], zero if not known yet */
+uint64_t
+lsquic_send_ctl_get_bw (struct lsquic_send_ctl *);
+
 #define lsquic_send_ctl_incr_pack_sz(ctl, packet, delta) do {   \
     (packet)->po_data_sz += (delta);                            \
     if ((packet)->po_flags & PO_SCHED)                          \
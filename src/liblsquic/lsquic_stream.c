@@ -46,6 +46,7 @@
 #include "lsquic_cubic.h"
 #include "lsquic_bw_sampler.h"
 #include "lsquic_minmax.h"
+#include "lsquic_rx_rate.h"
 #include "lsquic_bbr.h"
 #include "lsquic_adaptive_cc.h"
 #include "lsquic_send_ctl.h"
@@ -694,6 +695,7 @@ lsquic_stream_destroy (lsquic_stream_t *stream)
     }
     free(stream->sm_buf);
     free(stream->sm_header_block);
+    free(stream->sm_progress);
     LSQ_DEBUG("destroyed stream");
     SM_HISTORY_DUMP_REMAINING(stream);
     free(stream);
@@ -1081,6 +1083,168 @@ lsquic_stream_update_sfcw (lsquic_stream_t *stream, uint64_t max_off)
 }
 
 
+/* Delivery rate and deadlines.  The read path clears the receive deadline
+ * once it is met or missed; the send deadline is only used by the write
+ * scheduler.
+ */
+struct stream_progress
+{
+    struct rx_rate      sp_rx_rate;
+    lsquic_time_t       sp_deadline;    /* Zero if there is none */
+    uint64_t            sp_size;        /* Expected size; zero if unknown */
+    lsquic_time_t       sp_send_deadline;   /* Zero if there is none */
+    uint64_t            sp_send_size;
+};
+
+
+static int
+stream_track_progress (struct lsquic_stream *stream)
+{
+    if (stream->sm_progress)
+        return 0;
+
+    stream->sm_progress = calloc(1, sizeof(*stream->sm_progress));
+    if (!stream->sm_progress)
+        return -1;
+    lsquic_rx_rate_init(&stream->sm_progress->sp_rx_rate);
+    return 0;
+}
+
+
+/* Time until all the expected data has arrived, zero if unknown */
+static lsquic_time_t
+stream_eta (const struct lsquic_stream *stream)
+{
+    const struct stream_progress *const prog = stream->sm_progress;
+    uint64_t size, received, rate;
+
+    if (stream->stream_flags & STREAM_FIN_RECVD)
+        size = stream->sm_fin_off;
+    else
+        size = prog->sp_size;
+    received = lsquic_sfcw_get_max_recv_off(&stream->fc);
+    rate = lsquic_rx_rate_get(&prog->sp_rx_rate);
+    if (size <= received || rate == 0)
+        return 0;
+    return (size - received) * 1000000 / rate;
+}
+
+
+lsquic_time_t
+lsquic_stream_check_deadline (struct lsquic_stream *stream, lsquic_time_t now)
+{
+    struct stream_progress *const prog = stream->sm_progress;
+    lsquic_time_t eta;
+
+    if (!prog || prog->sp_deadline == 0
+                        || (stream->stream_flags & STREAM_DEADLINE_MISSED))
+        return 0;
+    if ((stream->stream_flags & STREAM_FIN_RECVD)
+            && lsquic_sfcw_get_max_recv_off(&stream->fc) >= stream->sm_fin_off)
+    {
+        LSQ_DEBUG("all data received before the deadline");
+        prog->sp_deadline = 0;
+        return 0;
+    }
+
+    eta = stream_eta(stream);
+    if (now >= prog->sp_deadline || (eta && now + eta > prog->sp_deadline))
+    {
+        LSQ_DEBUG("deadline missed: %"PRIu64" usec left, eta %"PRIu64" usec",
+            now < prog->sp_deadline ? prog->sp_deadline - now : 0, eta);
+        stream->stream_flags |= STREAM_DEADLINE_MISSED;
+        return 0;
+    }
+
+    /* If no more data arrives, the ETA stays the same: the deadline is
+     * projected to be missed right after `deadline - eta'.
+     */
+    if (eta)
+        return prog->sp_deadline - eta + 1;
+    else
+        return prog->sp_deadline;
+}
+
+
+static void
+stream_arm_deadline (struct lsquic_stream *stream, lsquic_time_t now)
+{
+    struct lsquic_conn *const lconn = stream->conn_pub->lconn;
+    lsquic_time_t expiry;
+
+    expiry = lsquic_stream_check_deadline(stream, now);
+    if (expiry && lconn->cn_if->ci_set_deadline_alarm)
+        lconn->cn_if->ci_set_deadline_alarm(lconn, expiry);
+}
+
+
+static void
+stream_progress_frame_in (struct lsquic_stream *stream, lsquic_time_t now,
+                                                                unsigned sz)
+{
+    lsquic_rx_rate_packet_in(&stream->sm_progress->sp_rx_rate, now, sz,
+                        lsquic_rtt_stats_get_srtt(&stream->conn_pub->rtt_stats));
+    stream_arm_deadline(stream, now);
+}
+
+
+int
+lsquic_stream_get_progress (struct lsquic_stream *stream,
+                                    struct lsquic_stream_progress *progress)
+{
+    if (0 != stream_track_progress(stream))
+        return -1;
+
+    progress->lsp_bytes_received = lsquic_sfcw_get_max_recv_off(&stream->fc);
+    progress->lsp_bytes_read = stream->read_offset;
+    progress->lsp_bytes_sent = stream->tosend_off;
+    progress->lsp_bytes_acked = stream->sm_frame_bytes_acked;
+    progress->lsp_bytes_in_flight = stream->sm_frame_bytes_out
+                                            - stream->sm_frame_bytes_acked;
+    progress->lsp_rate = lsquic_rx_rate_get(&stream->sm_progress->sp_rx_rate);
+    progress->lsp_eta = stream_eta(stream);
+    return 0;
+}
+
+
+int
+lsquic_stream_set_deadline (struct lsquic_stream *stream, uint64_t usec,
+                                                                uint64_t size)
+{
+    lsquic_time_t now;
+
+    if (0 != stream_track_progress(stream))
+        return -1;
+
+    now = lsquic_time_now();
+    stream->stream_flags &= ~STREAM_DEADLINE_MISSED;
+    stream->sm_progress->sp_deadline = usec ? now + usec : 0;
+    stream->sm_progress->sp_size = size;
+    stream->sm_progress->sp_send_deadline = stream->sm_progress->sp_deadline;
+    stream->sm_progress->sp_send_size = size;
+    LSQ_DEBUG("deadline in %"PRIu64" usec for %"PRIu64" bytes", usec, size);
+    stream_arm_deadline(stream, now);
+    return 0;
+}
+
+
+lsquic_time_t
+lsquic_stream_send_deadline (const struct lsquic_stream *stream,
+                                                            uint64_t *left)
+{
+    const struct stream_progress *const prog = stream->sm_progress;
+
+    if (!prog || prog->sp_send_deadline == 0)
+        return 0;
+
+    if (prog->sp_send_size > stream->tosend_off)
+        *left = prog->sp_send_size - stream->tosend_off;
+    else
+        *left = 0;
+    return prog->sp_send_deadline;
+}
+
+
 int
 lsquic_stream_frame_in (lsquic_stream_t *stream, stream_frame_t *frame)
 {
@@ -1138,6 +1302,9 @@ lsquic_stream_frame_in (lsquic_stream_t *stream, stream_frame_t *frame)
         }
         if (0 != maybe_switch_data_in(stream))
             goto end_ok;
+        if (stream->sm_progress)
+            stream_progress_frame_in(stream, frame->packet_in->pi_received,
+                                                frame->data_frame.df_size);
         if (got_next_offset)
             /* Checking the offset saves di_get_frame() call */
             maybe_conn_to_tickable_if_readable(stream);
@@ -2373,6 +2540,15 @@ maybe_mark_as_blocked (lsquic_stream_t *stream)
 void
 lsquic_stream_dispatch_read_events (lsquic_stream_t *stream)
 {
+    if ((stream->stream_flags & STREAM_DEADLINE_MISSED)
+                                    && (stream->sm_qflags & SMQF_WANT_READ))
+    {
+        stream->stream_flags &= ~STREAM_DEADLINE_MISSED;
+        stream->sm_progress->sp_deadline = 0;   /* Call it once */
+        if (stream->stream_if->on_deadline)
+            stream->stream_if->on_deadline(stream, stream->st_ctx);
+    }
+
     if (stream->sm_qflags & SMQF_WANT_READ)
     {
         if (stream->sm_bflags & SMBF_RW_ONCE)
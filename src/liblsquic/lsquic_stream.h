@@ -16,6 +16,7 @@ struct frame_gen_ctx;
 struct data_frame;
 enum quic_frame_type;
 struct push_promise;
+struct stream_progress;
 union hblock_ctx;
 struct lsquic_packet_out;
 struct lsquic_send_ctl;
@@ -232,7 +233,7 @@ enum stream_flags {
     STREAM_BLOCKED_SENT = 1 << 23,  /* Stays set once a STREAM_BLOCKED frame is sent */
     STREAM_RST_READ     = 1 << 24,  /* User code collected the error */
     STREAM_DATA_RECVD   = 1 << 25,  /* Cache stream state calculation */
-    STREAM_UNUSED26     = 1 << 26,  /* Unused */
+    STREAM_DEADLINE_MISSED = 1 << 26,   /* Call on_deadline */
     STREAM_HDRS_FLUSHED = 1 << 27,  /* Only used in buffered packets mode */
     STREAM_SS_RECVD     = 1 << 28,  /* Received STOP_SENDING frame */
     STREAM_DELAYED_SW   = 1 << 29,  /* Delayed shutdown_write call */
@@ -355,6 +356,13 @@ struct lsquic_stream
     /* Sum of bytes in all incoming DATA frames.  Used for verification. */
     unsigned long long              sm_data_in;
 
+    /* Delivery rate and deadline, allocated when the user asks for them */
+    struct stream_progress         *sm_progress;
+
+    /* Bytes of STREAM frames, headers included, in packets and acked */
+    uint64_t                        sm_frame_bytes_out,
+                                    sm_frame_bytes_acked;
+
     /* How much data there is in sm_header_block and how much of it has been
      * sent:
      */
@@ -568,6 +576,20 @@ lsquic_stream_set_stream_if (struct lsquic_stream *,
 uint64_t
 lsquic_stream_combined_send_off (const struct lsquic_stream *);
 
+/* Deadline set by lsquic_stream_set_deadline(), zero if there is none.
+ * `*left' is set to the number of expected bytes not written yet.  Unlike
+ * the receive deadline, it is not cleared by the read path.
+ */
+lsquic_time_t
+lsquic_stream_send_deadline (const struct lsquic_stream *, uint64_t *left);
+
+/* Mark the deadline missed if it has passed or the rest of the data cannot
+ * arrive in time at the current rate.  Returns the time at which to check
+ * again, or zero if there is nothing to check.
+ */
+lsquic_time_t
+lsquic_stream_check_deadline (struct lsquic_stream *, lsquic_time_t now);
+
 /* [draft-ietf-quic-transport-16] Section 3.1 */
 enum stream_state_sending
 {
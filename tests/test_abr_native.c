@@ -0,0 +1,282 @@
+/* Test the native ABR solver against exhaustive enumeration */
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "abr_native.h"
+
+#define N_REP 11
+#define SEG_DUR 4
+#define MAX_SEG 5
+
+static const int bitrates[N_REP] = {145, 300, 600, 900, 1600, 2400, 3400,
+                                    4500, 5800, 8100, 11600, };
+
+enum model { MAX_J, MAX_MIN_J, MAX_MIN_J_NORM, MAX_QI_NORM, };
+
+#define ALPHA 0.5
+#define BETA 0.5
+
+
+static double
+weight (enum model model, unsigned n_seg, unsigned i, unsigned j)
+{
+    double nf = 0.0;
+    unsigned k;
+
+    if (model == MAX_J || model == MAX_MIN_J)
+        return j;
+    for (k = 0; k < n_seg; ++k)
+        nf += pow(N_REP - 1, k + 2);
+    if (model == MAX_QI_NORM)
+        nf += N_REP - 1;
+    return ALPHA * j * pow(N_REP - 1, i + 1) / nf;
+}
+
+
+static double
+jstar_weight (enum model model, unsigned n_seg)
+{
+    double nf = 0.0;
+    unsigned k;
+
+    switch (model)
+    {
+    case MAX_J:
+        return 0.0;
+    case MAX_MIN_J:
+        return 1.0;
+    case MAX_MIN_J_NORM:
+        return BETA / (N_REP - 1);
+    default:
+        for (k = 0; k < n_seg; ++k)
+            nf += pow(N_REP - 1, k + 2);
+        return ALPHA / (nf + N_REP - 1);
+    }
+}
+
+
+/* Cost of a full assignment straight from the MIP constraints */
+static double
+assignment_cost (unsigned n_seg, const unsigned *q, const unsigned *min_q,
+                        const double *avail, bool multistream, bool *ok)
+{
+    double req[MAX_SEG], sum = 0.0, max = 0.0;
+    unsigned i, n_up = 0;
+
+    *ok = true;
+    for (i = 0; i < n_seg; ++i)
+    {
+        if (q[i] == min_q[i])
+            req[i] = 0.0;
+        else if (avail[i] <= 0)
+        {
+            *ok = false;
+            return 0.0;
+        }
+        else
+            req[i] = ceil((double) SEG_DUR * bitrates[q[i]] / avail[i] - 1e-6);
+        sum += req[i];
+        if (req[i] > max)
+            max = req[i];
+        if (q[i] != min_q[i] && i + 1 < n_seg)
+            ++n_up;
+    }
+    return multistream ? (n_up + 1) * max : sum;
+}
+
+
+static double
+brute_force (enum model model, unsigned n_seg, const unsigned *min_q,
+                const double *avail, double bandwidth, bool multistream)
+{
+    unsigned q[MAX_SEG], i, jmin;
+    double best = -1.0, obj, cost;
+    bool ok;
+
+    for (i = 0; i < n_seg; ++i)
+        q[i] = min_q[i];
+    while (1)
+    {
+        cost = assignment_cost(n_seg, q, min_q, avail, multistream, &ok);
+        if (ok && cost <= bandwidth + 1e-6)
+        {
+            obj = 0.0;
+            jmin = N_REP - 1;
+            for (i = 0; i < n_seg; ++i)
+            {
+                obj += weight(model, n_seg, i, q[i]);
+                if (q[i] < jmin)
+                    jmin = q[i];
+            }
+            obj += jstar_weight(model, n_seg) * jmin;
+            if (obj > best)
+                best = obj;
+        }
+        for (i = 0; i < n_seg; ++i)
+        {
+            if (++q[i] < N_REP)
+                break;
+            q[i] = min_q[i];
+        }
+        if (i == n_seg)
+            break;
+    }
+    return best;
+}
+
+
+static int
+run_native (enum model model, unsigned n_seg, unsigned n_par, double bandwidth,
+            double *avail, unsigned *min_q, double *sol, bool multistream)
+{
+    switch (model)
+    {
+    case MAX_J:
+        return getMaxJCoefficientsNative(N_REP, n_seg, n_par, SEG_DUR,
+                            bandwidth, bitrates, avail, min_q, sol);
+    case MAX_MIN_J:
+        return getMaxMinJCoefficientsNative(N_REP, n_seg, n_par, SEG_DUR,
+                            bandwidth, bitrates, avail, min_q, sol,
+                            multistream);
+    case MAX_MIN_J_NORM:
+        return getMaxMinJNormCoefficientsNative(N_REP, n_seg, n_par, SEG_DUR,
+                            bandwidth, bitrates, avail, min_q, sol,
+                            multistream, ALPHA, BETA, 10.0, 20.0);
+    default:
+        return getMaxQINormCoefficientsNative(N_REP, n_seg, n_par, SEG_DUR,
+                            bandwidth, bitrates, avail, min_q, sol,
+                            multistream, ALPHA, BETA);
+    }
+}
+
+
+static void
+check_instance (enum model model, unsigned n_seg, unsigned *min_q,
+                        double *avail, double bandwidth, bool multistream)
+{
+    const bool has_jstar = model != MAX_J;
+    unsigned n_par, i, j, idx, q[MAX_SEG], n_ones, jmin;
+    double sol[MAX_SEG * (N_REP + 1) + 1], expected, obj, cost, t_sum;
+    int s;
+    bool ok;
+
+    n_par = n_seg + has_jstar;
+    for (i = 0; i < n_seg; ++i)
+        n_par += N_REP - min_q[i];
+
+    s = run_native(model, n_seg, n_par, bandwidth, avail, min_q, sol,
+                                                                multistream);
+    assert(0 == s);
+
+    /* Exactly one binary per segment */
+    idx = 0;
+    for (i = 0; i < n_seg; ++i)
+    {
+        n_ones = 0;
+        for (j = min_q[i]; j < N_REP; ++j, ++idx)
+        {
+            assert(sol[idx] == 0.0 || sol[idx] == 1.0);
+            if (sol[idx] == 1.0)
+            {
+                q[i] = j;
+                ++n_ones;
+            }
+        }
+        assert(1 == n_ones);
+    }
+
+    /* Throughputs respect the bandwidth and the deadlines */
+    t_sum = 0.0;
+    for (i = 0; i < n_seg; ++i)
+    {
+        const double t = sol[n_par - n_seg - has_jstar + i];
+        assert(t == floor(t));
+        if (q[i] != min_q[i])
+            assert(t * avail[i] >= (double) SEG_DUR * bitrates[q[i]] - 1e-6);
+        t_sum += t;
+    }
+    assert(t_sum <= bandwidth + 1e-6);
+
+    cost = assignment_cost(n_seg, q, min_q, avail, multistream, &ok);
+    assert(ok);
+    assert(cost <= bandwidth + 1e-6);
+
+    obj = 0.0;
+    jmin = N_REP - 1;
+    for (i = 0; i < n_seg; ++i)
+    {
+        obj += weight(model, n_seg, i, q[i]);
+        if (q[i] < jmin)
+            jmin = q[i];
+    }
+    obj += jstar_weight(model, n_seg) * jmin;
+    if (has_jstar)
+        assert(sol[n_par - 1] == (double) jmin);
+
+    expected = brute_force(model, n_seg, min_q, avail, bandwidth, multistream);
+    assert(fabs(obj - expected) < 1e-9);
+}
+
+
+static void
+test_simple (void)
+{
+    unsigned min_q[2] = { 3, 0, };
+    double avail[2] = { 3.6, 3.6, };
+    double sol[2 + N_REP - 3 + N_REP];
+    unsigned n_par = 2 + (N_REP - 3) + N_REP;
+    int s;
+
+    /* 1000 kbps is enough for 900 kbps in 3.6 seconds, nothing else */
+    s = getMaxJCoefficientsNative(N_REP, 2, n_par, SEG_DUR, 1000.0, bitrates,
+                                                    avail, min_q, sol);
+    assert(0 == s);
+    assert(sol[0] == 1.0);                          /* Keep q = 3 */
+    assert(sol[N_REP - 3 + 3] == 1.0);              /* Next at q = 3 */
+    assert(sol[n_par - 2] == 0.0);
+    assert(sol[n_par - 1] == 1000.0);
+
+    /* Not enough for anything: stay */
+    s = getMaxJCoefficientsNative(N_REP, 2, n_par, SEG_DUR, 100.0, bitrates,
+                                                    avail, min_q, sol);
+    assert(0 == s);
+    assert(sol[0] == 1.0);
+    assert(sol[N_REP - 3] == 1.0);
+    assert(sol[n_par - 1] == 0.0);
+}
+
+
+int
+main (void)
+{
+    unsigned min_q[MAX_SEG], n_seg, i, iter;
+    double avail[MAX_SEG], bandwidth;
+    enum model model;
+    bool multistream;
+
+    test_simple();
+
+    srand(0x0DF9);
+    for (iter = 0; iter < 400; ++iter)
+    {
+        n_seg = 1 + rand() % 4;
+        for (i = 0; i + 1 < n_seg; ++i)
+        {
+            min_q[i] = rand() % N_REP;
+            avail[i] = (rand() % 200) / 10.0;
+        }
+        min_q[n_seg - 1] = 0;
+        avail[n_seg - 1] = SEG_DUR * 0.9;
+        bandwidth = rand() % 30000;
+        multistream = rand() & 1;
+        for (model = MAX_J; model <= MAX_QI_NORM; ++model)
+            check_instance(model, n_seg, min_q, avail, bandwidth,
+                                        model != MAX_J && multistream);
+    }
+
+    return 0;
+}
@@ -0,0 +1,241 @@
+/* Copyright (c) 2017 - 2021 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * Test the order in which streams are written when es_deadline_sched is
+ * set: critical streams first, then the streams with a deadline, the one
+ * with the least time to spare first, then the rest by priority.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include "lsquic.h"
+
+#include "lsquic_int_types.h"
+#include "lsquic_packet_common.h"
+#include "lsquic_packet_in.h"
+#include "lsquic_conn_flow.h"
+#include "lsquic_sfcw.h"
+#include "lsquic_varint.h"
+#include "lsquic_hq.h"
+#include "lsquic_hash.h"
+#include "lsquic_conn.h"
+#include "lsquic_stream.h"
+#include "lsquic_types.h"
+#include "lsquic_rtt.h"
+#include "lsquic_conn_flow.h"
+#include "lsquic_conn_public.h"
+#include "lsquic_mm.h"
+#include "lsquic_min_heap.h"
+#include "lsquic_hpi.h"
+#include "lsquic_deadline_sched.h"
+#include "lsquic_logger.h"
+
+
+#define MAX_STREAMS 10
+
+struct stream_spec
+{
+    lsquic_stream_id_t  id;
+    int                 priority;       /* Negative means critical */
+    unsigned            deadline_ms;    /* Zero means no deadline */
+    uint64_t            size;           /* Bytes left to write */
+};
+
+static const struct test_spec {
+    int                 lineno;
+    uint64_t            bw;
+    struct stream_spec  streams[MAX_STREAMS];
+    lsquic_stream_id_t  order[MAX_STREAMS];
+} test_specs[] = {
+
+    {   __LINE__,
+        0,
+        {   { 4, 3, 0, 0, }, { 8, 3, 0, 0, }, { 12, 3, 300, 0, },
+            { 16, 3, 200, 0, }, { 1, -1, 0, 0, }, },
+        { 1, 16, 12, 4, 8, },
+    },
+
+    {   __LINE__,
+        /* No critical streams: the high-priority pass returns all streams
+         * of the same urgency, which must not go before the deadlines.
+         */
+        0,
+        {   { 4, 3, 0, 0, }, { 8, 3, 0, 0, }, { 12, 3, 300, 0, },
+            { 16, 3, 200, 0, }, },
+        { 16, 12, 4, 8, },
+    },
+
+    {   __LINE__,
+        /* Different urgencies */
+        0,
+        {   { 4, 0, 0, 0, }, { 8, 5, 0, 0, }, { 12, 6, 100, 0, }, },
+        { 12, 4, 8, },
+    },
+
+    {   __LINE__,
+        /* At one megabyte per second, stream 12 must start sending 50 ms
+         * before its deadline, ahead of stream 16.
+         */
+        1000000,
+        {   { 12, 3, 500, 450000, }, { 16, 3, 100, 1000, }, { 4, 3, 0, 0, }, },
+        { 12, 16, 4, },
+    },
+
+    {   __LINE__,
+        /* Critical streams with a deadline stay in the iterator */
+        0,
+        {   { 1, -1, 500, 0, }, { 12, 3, 100, 0, }, { 4, 3, 0, 0, }, },
+        { 1, 12, 4, },
+    },
+};
+
+
+static const struct conn_iface conn_iface;
+
+static struct lsquic_conn lconn = LSCONN_INITIALIZER_CIDLEN(lconn, 0);
+
+static struct lsquic_conn_public conn_pub = { .lconn = &lconn, };
+
+static lsquic_stream_id_t written[MAX_STREAMS];
+static unsigned n_written;
+
+
+static struct lsquic_stream *
+new_stream (const struct stream_spec *spec)
+{
+    struct lsquic_stream *stream = calloc(1, sizeof(*stream));
+    int s;
+
+    stream->id = spec->id;
+    stream->conn_pub = &conn_pub;
+    stream->sm_qflags = SMQF_WANT_WRITE;
+    if (spec->priority >= 0)
+        stream->sm_priority = spec->priority;
+    else
+        stream->sm_bflags |= SMBF_CRITICAL;
+    if (spec->deadline_ms)
+    {
+        s = lsquic_stream_set_deadline(stream, spec->deadline_ms * 1000,
+                                                                spec->size);
+        assert(0 == s);
+    }
+    return stream;
+}
+
+
+/* Writing a stream is taken to write all of its data */
+static void
+write_stream (struct lsquic_streams_tailq *streams,
+                                                struct lsquic_stream *stream)
+{
+    if (stream->sm_qflags & SMQF_WANT_WRITE)
+    {
+        assert(n_written < MAX_STREAMS);
+        written[n_written++] = stream->id;
+        stream->sm_qflags &= ~SMQF_WANT_WRITE;
+        TAILQ_REMOVE(streams, stream, next_write_stream);
+    }
+}
+
+
+/* The same as process_streams_write_events() */
+static void
+write_pass (struct lsquic_streams_tailq *streams, uint64_t bw, int high_prio)
+{
+    struct lsquic_stream *stream, *dl_stream;
+    struct deadline_sched ds;
+    struct http_prio_iter hpi;
+
+    if (TAILQ_EMPTY(streams))
+        return;
+
+    lsquic_deadline_sched_init(&ds, bw);
+    lsquic_hpi_init(&hpi, TAILQ_FIRST(streams),
+        TAILQ_LAST(streams, lsquic_streams_tailq),
+        (uintptr_t) &TAILQ_NEXT((lsquic_stream_t *) NULL, next_write_stream),
+        &conn_pub, high_prio ? "write-high" : "write-low",
+        lsquic_deadline_sched_filter, &ds);
+
+    if (high_prio)
+        lsquic_hpi_drop_non_high(&hpi);
+    else
+        lsquic_hpi_drop_high(&hpi);
+
+    stream = lsquic_hpi_first(&hpi);
+    if (!(high_prio && stream && lsquic_stream_is_critical(stream)))
+        while ((dl_stream = lsquic_deadline_sched_next(&ds)))
+            write_stream(streams, dl_stream);
+
+    for ( ; stream; stream = lsquic_hpi_next(&hpi))
+        write_stream(streams, stream);
+    lsquic_hpi_cleanup(&hpi);
+}
+
+
+static void
+run_test (const struct test_spec *spec)
+{
+    struct lsquic_streams_tailq streams;
+    struct lsquic_stream *all[MAX_STREAMS];
+    unsigned n_streams, n;
+    struct lsquic_mm mm;
+
+    lsquic_mm_init(&mm);
+    conn_pub.mm = &mm;
+    lconn.cn_if = &conn_iface;
+    TAILQ_INIT(&streams);
+    n_written = 0;
+
+    for (n_streams = 0; n_streams < MAX_STREAMS
+                        && spec->streams[n_streams].id; ++n_streams)
+    {
+        all[n_streams] = new_stream(&spec->streams[n_streams]);
+        TAILQ_INSERT_TAIL(&streams, all[n_streams], next_write_stream);
+    }
+
+    write_pass(&streams, spec->bw, 1);
+    write_pass(&streams, spec->bw, 0);
+
+    if (n_written != n_streams)
+    {
+        fprintf(stderr, "line %d: %u streams written instead of %u\n",
+                                        spec->lineno, n_written, n_streams);
+        assert(0);
+    }
+    for (n = 0; n < n_streams; ++n)
+        if (written[n] != spec->order[n])
+        {
+            fprintf(stderr, "line %d: stream %"PRIu64" written in position "
+                "%u instead of stream %"PRIu64"\n", spec->lineno, written[n],
+                n, spec->order[n]);
+            assert(0);
+        }
+
+    for (n = 0; n < n_streams; ++n)
+    {
+        free(all[n]->sm_progress);
+        free(all[n]);
+    }
+    lsquic_mm_cleanup(&mm);
+}
+
+
+int
+main (int argc, char **argv)
+{
+    unsigned n;
+
+    lsquic_log_to_fstream(stderr, LLTS_NONE);
+
+    for (n = 0; n < sizeof(test_specs) / sizeof(test_specs[0]); ++n)
+        run_test(&test_specs[n]);
+
+    return 0;
+}
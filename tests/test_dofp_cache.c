@@ -0,0 +1,125 @@
+/* Share, evict and reload segments of the segment cache; paths of the
+ * segments a server pushes
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dofp.h"
+
+#define SEG_LEN 60
+
+
+static void
+write_segment (char *path, int c, size_t len)
+{
+    unsigned char buf[SEG_LEN];
+    FILE *file;
+    int fd;
+
+    fd = mkstemp(path);
+    assert(fd >= 0);
+    file = fdopen(fd, "wb");
+    assert(file);
+    memset(buf, c, sizeof(buf));
+    assert(len == fwrite(buf, 1, len, file));
+    fclose(file);
+}
+
+
+static void
+check_segment (const struct dofp_cached_seg *seg, int c, size_t len)
+{
+    assert(seg);
+    assert(seg->dcs_len == len);
+    if (len)
+    {
+        assert(seg->dcs_buf[0] == c);
+        assert(seg->dcs_buf[len - 1] == c);
+    }
+}
+
+
+static void
+test_path_next (void)
+{
+    char buf[64];
+
+    assert(30 == dofp_seg_path_next("/tos1_h264/2426/segment_12.m4s", 1,
+                                                        buf, sizeof(buf)));
+    assert(0 == strcmp(buf, "/tos1_h264/2426/segment_13.m4s"));
+    assert(0 < dofp_seg_path_next("145/seg-99.ts", 3, buf, sizeof(buf)));
+    assert(0 == strcmp(buf, "145/seg-102.ts"));
+    /* Only the file name has the index */
+    assert(-1 == dofp_seg_path_next("v2/init.mp4", 1, buf, sizeof(buf)));
+    assert(-1 == dofp_seg_path_next("/720p/segment.m4s", 1, buf,
+                                                                sizeof(buf)));
+    assert(-1 == dofp_seg_path_next("/a/segment_9.m4s", 1, buf, 16));
+}
+
+
+int
+main (void)
+{
+    char a[] = "/tmp/test_dofp_cache.XXXXXX";
+    char b[] = "/tmp/test_dofp_cache.XXXXXX";
+    char empty[] = "/tmp/test_dofp_cache.XXXXXX";
+    const struct dofp_cached_seg *seg_a, *seg_a2, *seg_b, *seg_e;
+    struct dofp_cache *cache;
+
+    write_segment(a, 'a', SEG_LEN);
+    write_segment(b, 'b', SEG_LEN);
+    write_segment(empty, 'e', 0);
+    cache = dofp_cache_new(SEG_LEN * 3 / 2);
+    assert(cache);
+
+    /* Streams of the same segment share it */
+    seg_a = dofp_cache_get(cache, a);
+    check_segment(seg_a, 'a', SEG_LEN);
+    seg_a2 = dofp_cache_get(cache, a);
+    assert(seg_a2 == seg_a);
+    assert(dofp_cache_size(cache) == SEG_LEN);
+
+    /* Over the budget, but both segments are held */
+    seg_b = dofp_cache_get(cache, b);
+    check_segment(seg_b, 'b', SEG_LEN);
+    assert(dofp_cache_size(cache) == 2 * SEG_LEN);
+    dofp_cache_put(cache, seg_a);
+    assert(dofp_cache_size(cache) == 2 * SEG_LEN);
+
+    /* The last reference to `a' goes: it is dropped */
+    dofp_cache_put(cache, seg_a2);
+    assert(dofp_cache_size(cache) == SEG_LEN);
+
+    /* `b' is no longer held but fits; it goes when `a' comes back */
+    dofp_cache_put(cache, seg_b);
+    assert(dofp_cache_size(cache) == SEG_LEN);
+    seg_a = dofp_cache_get(cache, a);
+    check_segment(seg_a, 'a', SEG_LEN);
+    assert(dofp_cache_size(cache) == SEG_LEN);
+
+    seg_e = dofp_cache_get(cache, empty);
+    check_segment(seg_e, 'e', 0);
+    dofp_cache_put(cache, seg_e);
+    dofp_cache_put(cache, seg_a);
+
+    errno = 0;
+    assert(!dofp_cache_get(cache, "/tmp/test_dofp_cache.none"));
+    assert(errno == ENOENT);
+    errno = 0;
+    assert(!dofp_cache_get(cache, "/tmp"));
+    assert(errno == EISDIR);
+
+    dofp_cache_destroy(cache);
+    unlink(a);
+    unlink(b);
+    unlink(empty);
+
+    test_path_next();
+
+    return 0;
+}
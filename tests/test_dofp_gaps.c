@@ -0,0 +1,137 @@
+/* Gap planning: the expected results are those of the former milp.py */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "dofp.h"
+
+#define N_REP 7
+
+static const int bitrates[N_REP] = { 107, 240, 346, 715, 1347, 2426, 4121, };
+
+
+struct find_case
+{
+    unsigned            n;
+    unsigned            q[8];
+    unsigned            n_gaps;
+    struct dofp_gap     gaps[4];
+};
+
+static const struct find_case find_cases[] =
+{
+    { 5, { 5, 4, 4, 5, 5, }, 1, { { 1, 2, 4, 5, }, }, },
+    { 7, { 6, 2, 5, 1, 1, 4, 3, }, 3,
+        { { 1, 1, 2, 5, }, { 3, 2, 1, 4, }, { 6, 1, 3, 4, }, }, },
+    /* Not a gap while the buffer only goes down */
+    { 4, { 5, 2, 2, 2, }, 0, { { 0, }, }, },
+    { 4, { 5, 3, 4, 4, }, 1, { { 1, 1, 3, 4, }, }, },
+    { 3, { 5, 4, 3, }, 1, { { 2, 1, 3, 4, }, }, },
+    { 6, { 3, 1, 3, 0, 2, 0, }, 3,
+        { { 1, 1, 1, 3, }, { 3, 1, 0, 2, }, { 5, 1, 0, 2, }, }, },
+    { 3, { 2, 2, 2, }, 0, { { 0, }, }, },
+};
+
+
+struct plan_case
+{
+    unsigned            n;
+    unsigned            q[8];
+    double              throughput;
+    double              buffer;
+    double              play_left;
+    bool                one_gap;
+    unsigned            new_q[9];
+    unsigned            n_ret;
+    unsigned            ret[4];
+};
+
+static const struct plan_case plan_cases[] =
+{
+    /* The defaults of the script */
+    { 5, { 5, 4, 4, 5, 5, }, 3634, 16.743, 1, true,
+        { 5, 4, 4, 5, 5, 5, }, 0, { 0, }, },
+    { 5, { 5, 4, 4, 5, 5, }, 3634, 16.743, 1, false,
+        { 5, 4, 5, 5, 5, 5, }, 1, { 2, }, },
+    { 7, { 6, 2, 5, 1, 1, 4, 3, }, 5000, 14, 2.5, true,
+        { 6, 2, 5, 4, 4, 4, 3, 3, }, 2, { 4, 3, }, },
+    { 7, { 6, 2, 5, 1, 1, 4, 3, }, 5000, 14, 2.5, false,
+        { 6, 2, 5, 4, 4, 4, 4, 6, }, 3, { 4, 3, 6, }, },
+    /* No gap: the next segment may take the buffer down to half */
+    { 3, { 3, 3, 3, }, 3000, 16, 1, true, { 3, 3, 3, 6, }, 0, { 0, }, },
+    /* Low buffer: only the next segment */
+    { 3, { 3, 3, 3, }, 3000, 8, 1, true, { 3, 3, 3, 5, }, 0, { 0, }, },
+    { 4, { 5, 2, 2, 2, }, 3634, 16.743, 1, true,
+        { 5, 2, 2, 2, 6, }, 0, { 0, }, },
+};
+
+
+static void
+test_find (const struct find_case *fc)
+{
+    struct dofp_gap gaps[8];
+    unsigned n_gaps, i;
+
+    n_gaps = dofp_gaps_find(fc->q, fc->n, N_REP, gaps);
+    assert(n_gaps == fc->n_gaps);
+    for (i = 0; i < n_gaps; ++i)
+    {
+        assert(gaps[i].dg_first == fc->gaps[i].dg_first);
+        assert(gaps[i].dg_n == fc->gaps[i].dg_n);
+        assert(gaps[i].dg_q == fc->gaps[i].dg_q);
+        assert(gaps[i].dg_target == fc->gaps[i].dg_target);
+    }
+}
+
+
+static void
+test_order (void)
+{
+    struct dofp_gap gaps[8];
+    unsigned n_gaps;
+
+    n_gaps = dofp_gaps_find(find_cases[5].q, find_cases[5].n, N_REP, gaps);
+    assert(n_gaps == 3);
+    dofp_gaps_order(gaps, n_gaps);
+    assert(gaps[0].dg_first == 3);
+    assert(gaps[1].dg_first == 5);
+    assert(gaps[2].dg_first == 1);
+}
+
+
+static void
+test_plan (const struct plan_case *pc)
+{
+    struct dofp_gap_params params = {
+        .dgp_bitrates       = bitrates,
+        .dgp_n_rep          = N_REP,
+        .dgp_seg_len        = 4,
+        .dgp_throughput     = pc->throughput,
+        .dgp_buffer         = pc->buffer,
+        .dgp_buffer_size    = 20,
+        .dgp_play_left      = pc->play_left,
+        .dgp_one_gap        = pc->one_gap,
+    };
+    unsigned new_q[9], ret[DOFP_MAX_RET], n_ret;
+
+    assert(0 == dofp_gaps_plan(&params, pc->q, pc->n, new_q, ret, &n_ret));
+    assert(0 == memcmp(new_q, pc->new_q, (pc->n + 1) * sizeof(new_q[0])));
+    assert(n_ret == pc->n_ret);
+    assert(0 == memcmp(ret, pc->ret, n_ret * sizeof(ret[0])));
+}
+
+
+int
+main (void)
+{
+    unsigned i;
+
+    for (i = 0; i < sizeof(find_cases) / sizeof(find_cases[0]); ++i)
+        test_find(&find_cases[i]);
+    test_order();
+    for (i = 0; i < sizeof(plan_cases) / sizeof(plan_cases[0]); ++i)
+        test_plan(&plan_cases[i]);
+
+    return 0;
+}
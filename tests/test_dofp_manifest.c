@@ -0,0 +1,240 @@
+/* Parse DASH MPDs and HLS playlists into ladders, in chunks of any size */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dofp.h"
+
+static const char mpd_template[] =
+    "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+    "<!-- Generated > by \"a packager -->\n"
+    "<MPD xmlns=\"urn:mpeg:dash:schema:mpd:2011\" type=\"static\"\n"
+    "     mediaPresentationDuration=\"PT0H1M0.00S\" minBufferTime=\"PT2S\">\n"
+    "  <BaseURL>video/</BaseURL>\n"
+    "  <Period id=\"0\">\n"
+    "    <AdaptationSet contentType=\"audio\" mimeType=\"audio/mp4\">\n"
+    "      <SegmentTemplate media=\"audio_$Number$.m4s\" duration=\"4\"/>\n"
+    "      <Representation id=\"a0\" bandwidth=\"128000\"/>\n"
+    "    </AdaptationSet>\n"
+    "    <AdaptationSet mimeType=\"video/mp4\" segmentAlignment=\"true\">\n"
+    "      <SegmentTemplate timescale=\"1000\" duration=\"4000\" startNumber=\"0\"\n"
+    "        media=\"$RepresentationID$/seg_$Number%05d$.m4s?a=1&amp;b=2\"/>\n"
+    "      <Representation id=\"hi\" bandwidth=\"2000000\" width=\"1920\" height=\"1080\"/>\n"
+    "      <Representation id=\"lo\" bandwidth=\"500000\" width=\"640\" height=\"360\">\n"
+    "        <BaseURL>low/</BaseURL>\n"
+    "      </Representation>\n"
+    "    </AdaptationSet>\n"
+    "  </Period>\n"
+    "  <Period id=\"1\"><AdaptationSet mimeType=\"video/mp4\">"
+    "<Representation id=\"x\" bandwidth=\"1\"/></AdaptationSet></Period>\n"
+    "</MPD>\n";
+
+static const char mpd_timeline[] =
+    "<MPD type=\"static\" mediaPresentationDuration=\"PT20S\"><Period>"
+    "<AdaptationSet contentType=\"video\">"
+    "<SegmentTemplate timescale=\"90000\" media=\"v$Bandwidth$_$Number$.mp4\">"
+    "<SegmentTimeline><S t=\"0\" d=\"180000\" r=\"3\"/><S d=\"180000\" r=\"-1\"/>"
+    "</SegmentTimeline></SegmentTemplate>"
+    "<Representation id=\"1\" bandwidth=\"800000\"/>"
+    "<Representation id=\"2\" bandwidth=\"300000\"/>"
+    "</AdaptationSet></Period></MPD>";
+
+static const char mpd_live[] =
+    "<MPD type=\"dynamic\"><Period><AdaptationSet contentType=\"video\">"
+    "<SegmentTemplate duration=\"2\" startNumber=\"100\" media=\"live_$Number$.m4s\"/>"
+    "<Representation id=\"1\" bandwidth=\"1000000\"/>"
+    "</AdaptationSet></Period></MPD>";
+
+static const char hls_master[] =
+    "#EXTM3U\n"
+    "#EXT-X-STREAM-INF:BANDWIDTH=2200000,AVERAGE-BANDWIDTH=2000000,"
+            "CODECS=\"avc1.4d401f,mp4a.40.2\",RESOLUTION=1280x720\n"
+    "720p/index.m3u8\n"
+    "#EXT-X-STREAM-INF:BANDWIDTH=800000,RESOLUTION=640x360\r\n"
+    "360p/index.m3u8";
+
+static const char hls_360p[] =
+    "#EXTM3U\n"
+    "#EXT-X-TARGETDURATION:6\n"
+    "#EXT-X-MEDIA-SEQUENCE:0\n"
+    "#EXT-X-BITRATE:700\n"
+    "#EXTINF:6.000,\n"
+    "seg-360p-001.ts\n"
+    "#EXTINF:6.000,\n"
+    "seg-360p-002.ts\n"
+    "#EXTINF:6.000,\n"
+    "seg-360p-003.ts\n"
+    "#EXT-X-ENDLIST\n";
+
+static const char hls_720p[] =
+    "#EXTM3U\n"
+    "#EXT-X-TARGETDURATION:6\n"
+    "#EXT-X-BITRATE:1900\n"
+    "#EXTINF:6.000,\n"
+    "/cdn/seg-720p-001.ts\n"
+    "#EXTINF:6.000,\n"
+    "/cdn/seg-720p-002.ts\n"
+    "#EXTINF:6.000,\n"
+    "/cdn/seg-720p-003.ts\n"
+    "#EXT-X-ENDLIST\n";
+
+
+/* Feed `text' in chunks of `chunk' bytes */
+static int
+feed (struct dofp_manifest *mf, const char *text, size_t chunk)
+{
+    size_t off, n, len = strlen(text);
+
+    for (off = 0; off < len; off += n)
+    {
+        n = chunk < len - off ? chunk : len - off;
+        if (0 != dofp_manifest_feed(mf, text + off, n))
+            return -1;
+    }
+    return 0;
+}
+
+
+static struct dofp_ladder *
+parse (const char *path, const char *text, size_t chunk)
+{
+    struct dofp_manifest *mf;
+    struct dofp_ladder *ladder = NULL;
+    const char *next;
+
+    mf = dofp_manifest_new(path);
+    assert(mf);
+    if (0 == feed(mf, text, chunk) && 0 == dofp_manifest_end(mf, &next))
+        ladder = dofp_manifest_ladder(mf);
+    dofp_manifest_destroy(mf);
+    return ladder;
+}
+
+
+static void
+check_path (const struct dofp_ladder *ladder, unsigned q, unsigned seg_ind,
+                                                        const char *expected)
+{
+    char buf[0x100];
+
+    assert(dofp_ladder_seg_path(ladder, q, seg_ind, buf, sizeof(buf))
+                                                    == (int) strlen(expected));
+    assert(0 == strcmp(buf, expected));
+}
+
+
+static void
+test_mpd (size_t chunk)
+{
+    struct dofp_ladder *ladder;
+
+    ladder = parse("/content/manifest.mpd", mpd_template, chunk);
+    assert(ladder);
+    assert(ladder->dl_n_rep == 2);
+    assert(ladder->dl_n_seg == 15);
+    assert(ladder->dl_seg_len == 4);
+    assert(ladder->dl_bitrates[0] == 500);
+    assert(ladder->dl_bitrates[1] == 2000);
+    assert(0 == strcmp(ladder->dl_res[0], "640x360"));
+    assert(!ladder->dl_sizes);
+    check_path(ladder, 0, 1, "/content/video/low/lo/seg_00000.m4s?a=1&b=2");
+    check_path(ladder, 1, 4, "/content/video/hi/seg_00003.m4s?a=1&b=2");
+    dofp_ladder_destroy(ladder);
+
+    ladder = parse("manifest.mpd", mpd_timeline, chunk);
+    assert(ladder);
+    assert(ladder->dl_n_seg == 10);
+    assert(ladder->dl_seg_len == 2);
+    check_path(ladder, 0, 1, "v300000_1.mp4");
+    check_path(ladder, 1, 10, "v800000_10.mp4");
+    dofp_ladder_destroy(ladder);
+
+    ladder = parse("/live/stream.mpd", mpd_live, chunk);
+    assert(ladder);
+    assert(ladder->dl_n_seg == 0);
+    check_path(ladder, 0, 1, "/live/live_100.m4s");
+    dofp_ladder_destroy(ladder);
+}
+
+
+static void
+test_hls (size_t chunk)
+{
+    struct dofp_manifest *mf;
+    struct dofp_ladder *ladder;
+    const char *next;
+
+    mf = dofp_manifest_new("/hls/master.m3u8");
+    assert(mf);
+    assert(0 == feed(mf, hls_master, chunk));
+    /* The media playlists are fetched by ascending bitrate */
+    assert(1 == dofp_manifest_end(mf, &next));
+    assert(0 == strcmp(next, "/hls/360p/index.m3u8"));
+    assert(0 == feed(mf, hls_360p, chunk));
+    assert(1 == dofp_manifest_end(mf, &next));
+    assert(0 == strcmp(next, "/hls/720p/index.m3u8"));
+    assert(0 == feed(mf, hls_720p, chunk));
+    assert(0 == dofp_manifest_end(mf, &next));
+    ladder = dofp_manifest_ladder(mf);
+    dofp_manifest_destroy(mf);
+
+    assert(ladder);
+    assert(ladder->dl_n_rep == 2);
+    assert(ladder->dl_n_seg == 3);
+    assert(ladder->dl_seg_len == 6);
+    assert(ladder->dl_bitrates[0] == 800);
+    assert(ladder->dl_bitrates[1] == 2000);
+    assert(0 == strcmp(ladder->dl_res[1], "1280x720"));
+    check_path(ladder, 0, 1, "/hls/360p/seg-360p-001.ts");
+    check_path(ladder, 1, 2, "/cdn/seg-720p-002.ts");
+    assert(ladder->dl_sizes);
+    assert(ladder->dl_sizes[2] == 700 * 6 * 125);
+    assert(ladder->dl_sizes[3] == 1900 * 6 * 125);
+    dofp_ladder_destroy(ladder);
+}
+
+
+static void
+test_errors (void)
+{
+    struct dofp_manifest *mf;
+    const char *next;
+
+    assert(!parse("a.mpd", "", 1));
+    assert(!parse("a.mpd", "{\"json\": true}", 1));
+    assert(!parse("a.mpd", "<MPD><Period><AdaptationSet><SegmentBase/>", 4));
+    assert(!parse("a.mpd", "<MPD mediaPresentationDuration=\"PT8S\"><Period>"
+        "<AdaptationSet><SegmentTemplate media=\"$Time$.m4s\" duration=\"2\"/>"
+        "<Representation id=\"1\" bandwidth=\"100000\"/>"
+        "</AdaptationSet></Period></MPD>", 3));
+    /* Media playlist given as the manifest */
+    assert(!parse("a.m3u8", hls_360p, 5));
+
+    mf = dofp_manifest_new("a.m3u8");
+    assert(mf);
+    assert(0 == feed(mf, "#EXTM3U\n#EXT-X-STREAM-INF:BANDWIDTH=800000\n"
+                                                        "v.m3u8\n", 64));
+    assert(1 == dofp_manifest_end(mf, &next));
+    assert(0 == feed(mf, "#EXTINF:4,\na.ts\n#EXTINF:4,\nb.ts\n", 64));
+    assert(-1 == dofp_manifest_end(mf, &next));
+    dofp_manifest_destroy(mf);
+}
+
+
+int
+main (void)
+{
+    static const size_t chunks[] = { 1, 7, 64, 0x10000, };
+    unsigned i;
+
+    for (i = 0; i < sizeof(chunks) / sizeof(chunks[0]); ++i)
+    {
+        test_mpd(chunks[i]);
+        test_hls(chunks[i]);
+    }
+    test_errors();
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+/* Fill, upgrade and play out segments of the buffer pool */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dofp.h"
+
+#define N_REP 2
+#define N_SEG 40
+#define SEG_DUR 1
+
+static const int bitrates[N_REP] = { 8, 16, };
+
+
+static struct dofp_slab *
+receive (struct dofp_pool *pool, unsigned q, unsigned seg_ind, size_t len)
+{
+    struct dofp_slab *slab;
+    unsigned char buf[100];
+    size_t off, n;
+
+    slab = dofp_pool_get(pool, q, seg_ind);
+    assert(slab);
+    assert(slab->dsl_len == 0);
+    memset(buf, (int) (seg_ind * N_REP + q), sizeof(buf));
+    for (off = 0; off < len; off += n)
+    {
+        n = len - off < sizeof(buf) ? len - off : sizeof(buf);
+        assert(0 == dofp_slab_append(slab, buf, n));
+    }
+    return slab;
+}
+
+
+static void
+check_segment (const struct dofp_pool *pool, unsigned seg_ind, unsigned q,
+                                                                size_t len)
+{
+    const struct dofp_slab *slab;
+
+    slab = dofp_pool_segment(pool, seg_ind);
+    assert(slab);
+    assert(slab->dsl_q == q);
+    assert(slab->dsl_seg_ind == seg_ind);
+    assert(slab->dsl_len == len);
+    assert(slab->dsl_buf[0] == seg_ind * N_REP + q);
+    assert(slab->dsl_buf[len - 1] == seg_ind * N_REP + q);
+}
+
+
+int
+main (void)
+{
+    struct dofp_ladder *ladder;
+    struct dofp_pool *pool;
+    struct dofp_slab *slab, *up;
+    unsigned i, q;
+
+    ladder = dofp_ladder_new(N_REP, N_SEG, SEG_DUR);
+    assert(ladder);
+    for (q = 0; q < N_REP; ++q)
+        assert(0 == dofp_ladder_set_rep(ladder, q, bitrates[q], NULL, NULL));
+    pool = dofp_pool_new(ladder, 2);
+    assert(pool);
+
+    /* Nominal size, then larger than the slab */
+    assert(0 == dofp_pool_commit(pool, receive(pool, 0, 1, 1000)));
+    assert(0 == dofp_pool_commit(pool, receive(pool, 0, 2, 3000)));
+    check_segment(pool, 1, 0, 1000);
+    check_segment(pool, 2, 0, 3000);
+    assert(!dofp_pool_segment(pool, 3));
+    assert(dofp_pool_buffered(pool) == 4000);
+
+    /* The upgrade replaces segment 1; the old slab is reused */
+    up = receive(pool, 1, 1, 2000);
+    slab = (struct dofp_slab *) dofp_pool_segment(pool, 1);
+    assert(0 == dofp_pool_commit(pool, up));
+    check_segment(pool, 1, 1, 2000);
+    assert(dofp_pool_buffered(pool) == 5000);
+    assert(dofp_pool_get(pool, 0, 3) == slab);
+    dofp_pool_put(pool, slab);
+
+    /* A cancelled download is not buffered */
+    dofp_pool_put(pool, receive(pool, 1, 2, 500));
+    check_segment(pool, 2, 0, 3000);
+
+    /* Gaps, then more segments than the ring holds at first */
+    assert(0 == dofp_pool_commit(pool, receive(pool, 0, 5, 10)));
+    assert(!dofp_pool_segment(pool, 4));
+    for (i = 6; i <= N_SEG; ++i)
+        assert(0 == dofp_pool_commit(pool, receive(pool, i & 1, i, i)));
+    check_segment(pool, 2, 0, 3000);
+    check_segment(pool, 5, 0, 10);
+    for (i = 6; i <= N_SEG; ++i)
+        check_segment(pool, i, i & 1, i);
+
+    /* Play out */
+    dofp_pool_release(pool, 3);
+    assert(!dofp_pool_segment(pool, 1));
+    assert(!dofp_pool_segment(pool, 2));
+    check_segment(pool, 5, 0, 10);
+    dofp_pool_release(pool, N_SEG + 1);
+    assert(!dofp_pool_segment(pool, N_SEG));
+    assert(dofp_pool_buffered(pool) == 0);
+
+    /* Arrived after its playout */
+    assert(0 == dofp_pool_commit(pool, receive(pool, 1, 7, 100)));
+    assert(!dofp_pool_segment(pool, 7));
+    assert(dofp_pool_buffered(pool) == 0);
+
+    dofp_pool_destroy(pool);
+    dofp_ladder_destroy(ladder);
+    return 0;
+}
@@ -0,0 +1,467 @@
+/* Play a short content with every built-in ABR algorithm */
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "abr_worker.h"
+#include "dofp.h"
+
+#define N_REP 3
+#define N_SEG 10
+#define SEG_DUR 4
+
+static const int bitrates[N_REP] = { 500, 1000, 2000, };
+
+
+static struct dofp_ladder *
+new_ladder (unsigned n_seg)
+{
+    struct dofp_ladder *ladder;
+    unsigned i;
+
+    ladder = dofp_ladder_new(N_REP, n_seg, SEG_DUR);
+    assert(ladder);
+    for (i = 0; i < N_REP; ++i)
+        assert(0 == dofp_ladder_set_rep(ladder, i, bitrates[i], "1280x720",
+                                                        "seg_$Number$.m4s"));
+    return ladder;
+}
+
+
+static struct dofp_ladder *
+load_ladder (const char *text)
+{
+    struct dofp_ladder *ladder;
+    char path[] = "/tmp/test_dofp_session.XXXXXX";
+    FILE *fp;
+    int fd;
+
+    fd = mkstemp(path);
+    assert(fd >= 0);
+    fp = fdopen(fd, "w");
+    assert(fp);
+    fputs(text, fp);
+    fclose(fp);
+    ladder = dofp_ladder_load(path);
+    unlink(path);
+    return ladder;
+}
+
+
+/* Segment sizes from text, then from the index written from them */
+static void
+test_sizes (void)
+{
+    struct dofp_ladder *ladder, *mapped;
+    char text[] = "/tmp/test_dofp_session.XXXXXX";
+    char index[] = "/tmp/test_dofp_session.XXXXXX";
+    FILE *fp;
+    int fd;
+
+    ladder = load_ladder("segment_duration 2\nsegments 3\nrep 300\nrep 600\n");
+    mapped = load_ladder("segment_duration 2\nsegments 3\nrep 300\nrep 600\n");
+    assert(ladder && mapped);
+    assert(-1 == dofp_ladder_write_sizes(ladder, "/tmp"));
+
+    fd = mkstemp(text);
+    assert(fd >= 0);
+    fp = fdopen(fd, "w");
+    assert(fp);
+    fputs("75000 80000.4 70000\n150000 160000 4000000000\n", fp);
+    fclose(fp);
+    assert(0 == dofp_ladder_load_sizes(ladder, text));
+    assert(!ladder->dl_sizes_map_len);
+    assert(ladder->dl_sizes[1] == 80000);
+    assert(ladder->dl_sizes[5] == 4000000000u);
+
+    fd = mkstemp(index);
+    assert(fd >= 0);
+    close(fd);
+    assert(0 == dofp_ladder_write_sizes(ladder, index));
+    assert(0 == dofp_ladder_load_sizes(mapped, index));
+    assert(mapped->dl_sizes_map_len);
+    assert(0 == memcmp(ladder->dl_sizes, mapped->dl_sizes,
+                                        6 * sizeof(ladder->dl_sizes[0])));
+    /* Loaded again over the mapping */
+    assert(0 == dofp_ladder_load_sizes(mapped, text));
+    assert(!mapped->dl_sizes_map_len);
+    assert(0 == dofp_ladder_load_sizes(mapped, index));
+    dofp_ladder_destroy(mapped);
+
+    /* The index is for another ladder */
+    mapped = load_ladder("segment_duration 2\nsegments 4\nrep 300\nrep 600\n");
+    assert(mapped);
+    assert(-1 == dofp_ladder_load_sizes(mapped, index));
+    assert(!mapped->dl_sizes);
+    dofp_ladder_destroy(mapped);
+
+    fp = fopen(text, "w");
+    assert(fp);
+    fputs("75000 80000 -1\n150000 160000 170000\n", fp);
+    fclose(fp);
+    assert(-1 == dofp_ladder_load_sizes(ladder, text));
+    assert(ladder->dl_sizes[1] == 80000);
+
+    unlink(text);
+    unlink(index);
+    dofp_ladder_destroy(ladder);
+}
+
+
+static void
+test_ladder (void)
+{
+    struct dofp_ladder *ladder;
+    char buf[64];
+
+    ladder = load_ladder(
+        "# Two representations\n"
+        "segment_duration 2\n"
+        "segments 30\n"
+        "base video/\n"
+        "rep 300 640x360 300/segment_$Number$.m4s\n"
+        "  rep 1200 1280x720 1200/segment_$Number$.m4s  # HD\n"
+        "\n"
+    );
+    assert(ladder);
+    assert(ladder->dl_n_rep == 2);
+    assert(ladder->dl_n_seg == 30);
+    assert(ladder->dl_seg_len == 2);
+    assert(ladder->dl_bitrates[1] == 1200);
+    assert(0 == strcmp(ladder->dl_res[0], "640x360"));
+    assert(!ladder->dl_sizes);
+    assert(23 == dofp_ladder_seg_path(ladder, 0, 7, buf, sizeof(buf)));
+    assert(0 == strcmp(buf, "video/300/segment_7.m4s"));
+    assert(-1 == dofp_ladder_seg_path(ladder, 1, 7, buf, 10));
+    assert(-1 == dofp_ladder_seg_path(ladder, 2, 7, buf, sizeof(buf)));
+    dofp_ladder_destroy(ladder);
+
+    /* Live */
+    ladder = load_ladder("segment_duration 4\nrep 300\n");
+    assert(ladder);
+    assert(ladder->dl_n_seg == 0);
+    assert(dofp_ladder_has_seg(ladder, 1000000));
+    assert(-1 == dofp_ladder_seg_path(ladder, 0, 1, buf, sizeof(buf)));
+    dofp_ladder_destroy(ladder);
+
+    test_sizes();
+
+    assert(!load_ladder("segment_duration 4\n"));
+    assert(!load_ladder("rep 300\n"));
+    assert(!load_ladder("segment_duration 4\nrep 300\nrep 200\n"));
+    assert(!load_ladder("segment_duration 4\nrepresentation 300\n"));
+}
+
+
+static unsigned s_n_qoe_calls;
+
+
+static void
+on_qoe (struct dofp_session *sess, const struct dofp_qoe *qoe)
+{
+    assert(qoe->dq_n_seg + 1 >= dofp_session_seg_ind(sess));
+    ++s_n_qoe_calls;
+}
+
+
+/* The running metrics match the ones computed from the final qualities */
+static void
+check_qoe (const struct dofp_session *sess)
+{
+    struct dofp_qoe qoe;
+    double sum = 0, instability = 0;
+    unsigned i, switches = 0, sum_q = 0;
+    int q, next_q;
+
+    dofp_session_qoe(sess, &qoe);
+    assert(qoe.dq_n_seg == N_SEG);
+    for (i = 1; i <= N_SEG; ++i)
+    {
+        q = dofp_session_seg_quality(sess, i);
+        sum += bitrates[q];
+        sum_q += q + 1;
+        if (i < N_SEG)
+        {
+            next_q = dofp_session_seg_quality(sess, i + 1);
+            instability += (double) abs(q - next_q) / (next_q + 1);
+            switches += q > next_q;
+        }
+    }
+    assert(fabs(qoe.dq_avg_bitrate - sum / N_SEG) < 1e-9);
+    assert(fabs(qoe.dq_avg_quality - (double) sum_q / N_SEG) < 1e-9);
+    assert(fabs(qoe.dq_instability - instability) < 1e-9);
+    assert(qoe.dq_switches == switches);
+}
+
+
+/* Downloads take 1.5 s for new segments and 0.5 s for re-downloads */
+static void
+play (const struct dofp_ladder *ladder, unsigned id, bool h2br)
+{
+    struct dofp_settings settings;
+    struct dofp_session *sess;
+    struct dofp_decision dec;
+    struct abr_job *job;
+    enum dofp_status status;
+    dofp_time_t now = 0;
+    unsigned n_dec, i, seg_ind;
+    bool more = true;
+
+    dofp_settings_init(&settings);
+    settings.dss_abr = dofp_abr_by_id(id);
+    settings.dss_ladder = ladder;
+    settings.dss_h2br = h2br;
+    settings.dss_on_qoe = on_qoe;
+    assert(settings.dss_abr);
+    sess = dofp_session_new(&settings, NULL, now);
+    assert(sess);
+
+    s_n_qoe_calls = 0;
+    for (n_dec = 0; n_dec < 100; ++n_dec)
+    {
+        status = dofp_session_decide(sess, &dec, &job);
+        if (status == DOFP_PENDING)
+        {
+            assert(settings.dss_abr->dai_flags & DOFP_ABR_ASYNC);
+            job->aj_status = job->aj_solve(job);
+            assert(dofp_job_session(job) == sess);
+            status = dofp_session_complete(sess, job, &dec);
+        }
+        if (status == DOFP_END)
+            break;
+        assert(status == DOFP_DONE);
+
+        now += dec.dd_delay;
+        dofp_session_update(sess, now);
+        for (i = 0; i < dec.dd_n_ret; ++i)
+        {
+            assert(dec.dd_ret[i].dsr_seg_ind < dofp_session_seg_ind(sess));
+            assert(dec.dd_ret[i].dsr_q < N_REP);
+            now += 500000;
+            dofp_session_on_download(sess, 100000, 500000);
+            (void) dofp_session_retrans_received(sess,
+                dec.dd_ret[i].dsr_seg_ind, dec.dd_ret[i].dsr_q, 100000, false,
+                now);
+        }
+        if (dec.dd_next)
+        {
+            assert(more);
+            seg_ind = dofp_session_seg_ind(sess);
+            assert(dec.dd_next_seg.dsr_seg_ind == seg_ind);
+            assert(dec.dd_next_seg.dsr_q < N_REP);
+            now += 1500000;
+            dofp_session_on_download(sess, 500000, 1500000);
+            more = dofp_session_segment_received(sess, dec.dd_next_seg.dsr_q,
+                                                                        now);
+            assert(dofp_session_seg_quality(sess, seg_ind)
+                                            == (int) dec.dd_next_seg.dsr_q);
+        }
+        else if (dec.dd_n_ret == 0)
+        {
+            now += 1000000;
+            dofp_session_update(sess, now);
+        }
+    }
+
+    assert(n_dec < 100);
+    assert(s_n_qoe_calls >= N_SEG);
+    assert(!more);
+    assert(dofp_session_seg_ind(sess) == N_SEG + 1);
+    for (i = 1; i <= N_SEG; ++i)
+        assert(dofp_session_seg_quality(sess, i) >= 0);
+    check_qoe(sess);
+    dofp_session_destroy(sess);
+}
+
+
+static void
+test_settings (const struct dofp_ladder *ladder)
+{
+    struct dofp_settings settings;
+    struct dofp_session *sess;
+
+    dofp_settings_init(&settings);
+    settings.dss_ladder = ladder;
+    assert(0 == dofp_settings_set(&settings, "buffer_size", 30));
+    assert(settings.dss_buffer_size == 30);
+    assert(0 == dofp_settings_parse(&settings, "milp_window=0.25"));
+    assert(settings.dss_milp_window == .25);
+    assert(0 == dofp_settings_parse(&settings, "sara_avg_count=3"));
+    assert(settings.dss_sara_avg_count == 3);
+    assert(-1 == dofp_settings_parse(&settings, "sara_avg_count=2.5"));
+    assert(-1 == dofp_settings_parse(&settings, "no_such_setting=1"));
+    assert(-1 == dofp_settings_parse(&settings, "alpha"));
+    assert(-1 == dofp_settings_parse(&settings, "alpha=x"));
+
+    sess = dofp_session_new(&settings, NULL, 0);
+    assert(sess);
+    dofp_session_destroy(sess);
+
+    assert(0 == dofp_settings_set(&settings, "tput_safety", 1.5));
+    assert(!dofp_session_new(&settings, NULL, 0));
+}
+
+
+/* Stream throughputs of concurrent downloads add up; the delivery rate of
+ * the connection does not.
+ */
+static void
+test_throughput (const struct dofp_ladder *ladder)
+{
+    struct dofp_settings settings;
+    struct dofp_session *sess;
+
+    dofp_settings_init(&settings);
+    settings.dss_ladder = ladder;
+    assert(0 == dofp_settings_set(&settings, "tput_safety", 1));
+    sess = dofp_session_new(&settings, NULL, 0);
+    assert(sess);
+
+    dofp_session_on_download(sess, 125000, 1000000);
+    dofp_session_on_download(sess, 125000, 1000000);
+    assert(dofp_session_throughput(sess) == 2000);
+
+    dofp_session_on_rate(sess, 3000);
+    assert(dofp_session_throughput(sess) == 3000);
+    dofp_session_on_rate(sess, 2500);
+    assert(dofp_session_throughput(sess) == 3000);
+    dofp_session_destroy(sess);
+}
+
+
+/* The next request waits until the buffer falls to buffer_size */
+static void
+test_request_delay (const struct dofp_ladder *ladder)
+{
+    struct dofp_settings settings;
+    struct dofp_session *sess;
+
+    dofp_settings_init(&settings);
+    settings.dss_ladder = ladder;
+    assert(0 == dofp_settings_set(&settings, "buffer_size", 6));
+    sess = dofp_session_new(&settings, NULL, 0);
+    assert(sess);
+
+    assert(dofp_session_segment_received(sess, 0, 0));
+    assert(dofp_session_request_delay(sess, 0) == 0);
+    assert(dofp_session_request_delay(sess, 1000000) == 1000000);
+    /* Playout starts above min_init_bs */
+    assert(dofp_session_segment_received(sess, 0, 0));
+    assert(dofp_session_request_delay(sess, 0) == 2000000);
+    assert(dofp_session_request_delay(sess, 3000000) == 3000000);
+    dofp_session_update(sess, 500000);
+    assert(dofp_session_request_delay(sess, 0) == 1500000);
+    dofp_session_update(sess, 2000000);
+    assert(dofp_session_request_delay(sess, 0) == 0);
+    dofp_session_destroy(sess);
+}
+
+
+/* The playout moves by itself only at segment ends and at stalls */
+static void
+test_next_event (const struct dofp_ladder *ladder)
+{
+    struct dofp_settings settings;
+    struct dofp_session *sess;
+    dofp_time_t t;
+
+    dofp_settings_init(&settings);
+    settings.dss_ladder = ladder;
+    sess = dofp_session_new(&settings, NULL, 0);
+    assert(sess);
+
+    assert(dofp_session_segment_received(sess, 0, 0));
+    assert(dofp_session_next_event(sess) == 0);
+    assert(dofp_session_segment_received(sess, 0, 0));
+    assert(dofp_session_rep_seg_ind(sess) == 1);
+    t = dofp_session_next_event(sess);
+    assert(t == SEG_DUR * 1000000 + 1);
+    dofp_session_update(sess, t);
+    assert(dofp_session_rep_seg_ind(sess) == 2);
+    t = dofp_session_next_event(sess);
+    assert(t > 2 * SEG_DUR * 1000000 - 10 && t <= 2 * SEG_DUR * 1000000 + 1);
+    dofp_session_update(sess, t);
+    assert(dofp_session_buffer_level(sess) == 0);
+    assert(dofp_session_next_event(sess) == 0);
+    dofp_session_destroy(sess);
+}
+
+
+/* A live session only keeps the last segments */
+static void
+test_live (void)
+{
+    struct dofp_ladder *ladder;
+    struct dofp_settings settings;
+    struct dofp_session *sess;
+    struct dofp_decision dec;
+    struct abr_job *job;
+    struct dofp_qoe qoe;
+    dofp_time_t now = 0;
+    unsigned n_seg = 0;
+
+    ladder = new_ladder(0);
+    dofp_settings_init(&settings);
+    settings.dss_abr = &dofp_abr_bba;
+    settings.dss_ladder = ladder;
+    settings.dss_h2br = true;
+    assert(0 == dofp_settings_parse(&settings, "log_window=8"));
+    sess = dofp_session_new(&settings, NULL, now);
+    assert(sess);
+
+    while (n_seg < 1000)
+    {
+        assert(DOFP_DONE == dofp_session_decide(sess, &dec, &job));
+        now += dec.dd_delay;
+        if (!dec.dd_next)
+        {
+            now += 1000000;
+            dofp_session_update(sess, now);
+            continue;
+        }
+        assert(dec.dd_n_ret < DOFP_MAX_RET);
+        now += 1000000;
+        dofp_session_on_download(sess, 500000, 1000000);
+        assert(dofp_session_segment_received(sess, dec.dd_next_seg.dsr_q,
+                                                                        now));
+        ++n_seg;
+    }
+
+    dofp_session_qoe(sess, &qoe);
+    assert(qoe.dq_n_seg == 1000);
+    assert(dofp_session_seg_quality(sess, 1) == -1);
+    assert(dofp_session_seg_quality(sess, 1000) >= 0);
+    assert(dofp_session_seg_quality(sess, 1001) == -1);
+    dofp_session_destroy(sess);
+    dofp_ladder_destroy(ladder);
+}
+
+
+int
+main (void)
+{
+    struct dofp_ladder *ladder;
+    unsigned id;
+
+    test_ladder();
+    ladder = new_ladder(N_SEG);
+    test_settings(ladder);
+    test_throughput(ladder);
+    test_request_delay(ladder);
+    test_next_event(ladder);
+    for (id = 0; dofp_abr_by_id(id); ++id)
+    {
+        play(ladder, id, false);
+        play(ladder, id, true);
+    }
+    assert(id == 8);
+    dofp_ladder_destroy(ladder);
+    test_live();
+
+    return 0;
+}
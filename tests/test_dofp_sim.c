@@ -0,0 +1,248 @@
+/* Load a tc trace and play a short content over it with every ABR */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dofp.h"
+
+#define N_REP 3
+#define N_SEG 10
+#define SEG_DUR 4
+
+static const int bitrates[N_REP] = { 500, 1000, 2000, };
+
+
+static char *
+write_trace (const char *text)
+{
+    char *path = strdup("/tmp/test_dofp_sim.XXXXXX");
+    FILE *fp;
+    int fd;
+
+    assert(path);
+    fd = mkstemp(path);
+    assert(fd >= 0);
+    fp = fdopen(fd, "w");
+    assert(fp);
+    fputs(text, fp);
+    fclose(fp);
+    return path;
+}
+
+
+static struct dofp_trace *
+load_trace (const char *text)
+{
+    struct dofp_trace *trace;
+    char *path;
+
+    path = write_trace(text);
+    trace = dofp_trace_load(path);
+    unlink(path);
+    free(path);
+    return trace;
+}
+
+
+static void
+test_trace (void)
+{
+    struct dofp_trace *trace;
+
+    trace = load_trace(
+        "#!/usr/bin/env bash\n"
+        "tc qdisc del dev ens33 root\n"
+        "\n"
+        "tc qdisc add dev ens33 root tbf rate 1mbit latency 20ms burst 1540\n"
+        "sleep 0.0s\n"
+        "tc qdisc change dev ens33 root tbf rate 2000kbit latency 20ms burst 1540\n"
+        "sleep 1.0s\n"
+        "sleep 1.0s\n"
+        "tc qdisc change dev ens33 root tbf rate 62500bps latency 20ms burst 1540\n"
+        "sleep 1s\n"
+        "tc qdisc del dev ens33 root\n"
+    );
+    assert(trace);
+    assert(trace->dt_n_steps == 2);
+    assert(trace->dt_len == 3000000);
+    assert(trace->dt_steps[0].dts_rate == 2000);
+    assert(trace->dt_steps[1].dts_start == 2000000);
+    assert(trace->dt_steps[1].dts_rate == 500);
+
+    assert(dofp_trace_transfer_time(trace, 0, 4000) == 2000000);
+    assert(dofp_trace_transfer_time(trace, 0, 4500) == 3000000);
+    assert(dofp_trace_transfer_time(trace, 1000000, 2500) == 2000000);
+    /* Loops back to the first rate */
+    assert(dofp_trace_transfer_time(trace, 0, 6500) == 4000000);
+    assert(dofp_trace_transfer_time(trace, 3000000, 4000) == 2000000);
+
+    assert(dofp_trace_volume(trace, 0, 3000000) == 4500);
+    assert(dofp_trace_volume(trace, 2500000, 1000000) == 1250);
+    assert(dofp_trace_volume(trace, 0, 7000000) == 11000);
+    dofp_trace_destroy(trace);
+
+    assert(!load_trace("sleep 1.0s\n"));
+    assert(!load_trace("tc qdisc add dev ens33 root tbf rate fast\n"));
+}
+
+
+static char *
+read_file (const char *path)
+{
+    char *buf;
+    FILE *fp;
+    long len;
+
+    fp = fopen(path, "r");
+    assert(fp);
+    assert(0 == fseek(fp, 0, SEEK_END));
+    len = ftell(fp);
+    rewind(fp);
+    buf = malloc(len + 1);
+    assert(buf);
+    assert(fread(buf, 1, len, fp) == (size_t) len);
+    buf[len] = '\0';
+    fclose(fp);
+    return buf;
+}
+
+
+static unsigned
+count (const char *haystack, const char *needle)
+{
+    unsigned n = 0;
+
+    while ((haystack = strstr(haystack, needle)))
+    {
+        ++n;
+        ++haystack;
+    }
+    return n;
+}
+
+
+/* The streamed P.1203 input is the one written at the end, and it covers
+ * the segments that left a short log.
+ */
+static void
+test_p1203 (const struct dofp_ladder *ladder, const struct dofp_trace *trace,
+                                                        unsigned log_window)
+{
+    char path[] = "/tmp/test_dofp_p1203.XXXXXX", stalls_path[0x40];
+    struct dofp_settings settings;
+    struct dofp_sim_params params;
+    struct dofp_session *sess;
+    struct dofp_p1203 *w;
+    char *streamed, *written;
+    FILE *fp;
+    int fd;
+
+    dofp_settings_init(&settings);
+    settings.dss_abr = dofp_abr_by_id(5);
+    settings.dss_ladder = ladder;
+    settings.dss_log_window = log_window;
+    params.dsp_rtt = 40000;
+    sess = dofp_session_new(&settings, NULL, 0);
+    assert(sess);
+
+    fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+    w = dofp_p1203_open(path, 1);
+    assert(w);
+    dofp_session_set_p1203(sess, w);
+    assert(0 == dofp_sim_run(sess, trace, &params));
+    assert(0 == dofp_p1203_close(w, sess));
+    snprintf(stalls_path, sizeof(stalls_path), "%s.stalls", path);
+    assert(0 != access(stalls_path, F_OK));
+    streamed = read_file(path);
+    assert(count(streamed, "\"bitrate\"") == N_SEG);
+
+    fp = fopen(path, "w");
+    assert(fp);
+    assert(0 == dofp_session_write_p1203(sess, fp));
+    fclose(fp);
+    written = read_file(path);
+    if (!log_window)
+        assert(0 == strcmp(streamed, written));
+    else
+        assert(count(written, "\"bitrate\"") < N_SEG);
+
+    unlink(path);
+    free(streamed);
+    free(written);
+    dofp_session_destroy(sess);
+}
+
+
+static void
+play (const struct dofp_ladder *ladder, const struct dofp_trace *trace,
+                                            unsigned id, bool h2br, bool fast)
+{
+    struct dofp_settings settings;
+    struct dofp_sim_params params;
+    struct dofp_session *sess;
+    struct dofp_qoe qoe;
+    unsigned i;
+
+    dofp_settings_init(&settings);
+    settings.dss_abr = dofp_abr_by_id(id);
+    settings.dss_ladder = ladder;
+    settings.dss_h2br = h2br;
+    params.dsp_rtt = 40000;
+    sess = dofp_session_new(&settings, NULL, 0);
+    assert(sess);
+
+    assert(0 == dofp_sim_run(sess, trace, &params));
+    assert(dofp_session_seg_ind(sess) == N_SEG + 1);
+    for (i = 1; i <= N_SEG; ++i)
+        assert(dofp_session_seg_quality(sess, i) >= 0);
+    dofp_session_qoe(sess, &qoe);
+    assert(qoe.dq_n_seg == N_SEG);
+    if (fast)
+        assert(qoe.dq_n_stalls == 0);
+    dofp_session_destroy(sess);
+}
+
+
+int
+main (void)
+{
+    struct dofp_ladder *ladder;
+    struct dofp_trace *fast, *slow;
+    unsigned id, i;
+
+    test_trace();
+
+    ladder = dofp_ladder_new(N_REP, N_SEG, SEG_DUR);
+    assert(ladder);
+    for (i = 0; i < N_REP; ++i)
+        assert(0 == dofp_ladder_set_rep(ladder, i, bitrates[i], "1280x720",
+                                                                    NULL));
+
+    fast = load_trace("tc qdisc add dev eth0 root tbf rate 20mbit\n"
+                      "sleep 10s\n");
+    slow = load_trace("tc qdisc add dev eth0 root tbf rate 800kbit\n"
+                      "sleep 3s\n"
+                      "tc qdisc change dev eth0 root tbf rate 200kbit\n"
+                      "sleep 5s\n");
+    assert(fast && slow);
+    for (id = 0; dofp_abr_by_id(id); ++id)
+    {
+        play(ladder, fast, id, false, true);
+        play(ladder, fast, id, true, true);
+        play(ladder, slow, id, false, false);
+    }
+    assert(id == 8);
+    test_p1203(ladder, slow, 0);
+    test_p1203(ladder, slow, 2);
+    dofp_trace_destroy(fast);
+    dofp_trace_destroy(slow);
+    dofp_ladder_destroy(ladder);
+
+    return 0;
+}
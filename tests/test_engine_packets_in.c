@@ -0,0 +1,225 @@
+/* Copyright (c) 2017 - 2021 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * Feed batches of packets to a server engine while connections come and
+ * go between them.  Within a batch, the engine remembers the connection
+ * found last by CID; it must not survive the removal of the connection
+ * or the retirement of the CID.
+ */
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#ifndef WIN32
+#include <netinet/in.h>
+#include <sys/socket.h>
+#else
+#include "vc_compat.h"
+#endif
+
+#include "lsquic.h"
+#include "lsquic_types.h"
+#include "lsquic_int_types.h"
+#include "lsquic_hash.h"
+#include "lsquic_conn.h"
+#include "lsquic_packet_common.h"
+#include "lsquic_packet_in.h"
+#include "lsquic_mm.h"
+#include "lsquic_engine_public.h"
+
+
+#define PACKET_SZ 1350
+
+struct packet_spec
+{
+    unsigned char   cid;            /* Last byte of the CID */
+    int             version;        /* Include version */
+    unsigned char   packno;         /* Zero is invalid: it kills mini conn */
+};
+
+static unsigned char bufs[8][PACKET_SZ];
+static struct lsquic_in_spec specs[8];
+static struct sockaddr_in local_sa, peer_sa;
+
+
+static int
+packets_out (void *ctx, const struct lsquic_out_spec *specs, unsigned count)
+{
+    return (int) count;
+}
+
+
+static void
+gen_gquic_packet (unsigned char *buf, const struct packet_spec *pspec)
+{
+    unsigned char *p = buf;
+
+    /* 8-byte CID, 1-byte packet number */
+    *p++ = 0x08 | (pspec->version ? 0x01 : 0);
+    memset(p, 0xC1, 7);
+    p[7] = pspec->cid;
+    p += 8;
+    if (pspec->version)
+    {
+        memcpy(p, "Q043", 4);
+        p += 4;
+    }
+    *p++ = pspec->packno;
+    memset(p, 0, PACKET_SZ - (p - buf));
+}
+
+
+static unsigned
+feed_batch (struct lsquic_engine *engine, const struct packet_spec *pspecs,
+                                                                unsigned count)
+{
+    unsigned n;
+
+    for (n = 0; n < count; ++n)
+    {
+        gen_gquic_packet(bufs[n], &pspecs[n]);
+        specs[n] = (struct lsquic_in_spec) {
+            .data       = bufs[n],
+            .sz         = PACKET_SZ,
+            .local_sa   = (struct sockaddr *) &local_sa,
+            .peer_sa    = (struct sockaddr *) &peer_sa,
+        };
+    }
+
+    return lsquic_engine_packets_in(engine, specs, count, NULL);
+}
+
+
+/* Only the hash is consulted: the connection structure is laid out
+ * differently in the library, which is not compiled with LSQUIC_TEST.
+ */
+static const struct lsquic_conn *
+find_conn (struct lsquic_engine *engine, unsigned char cid_byte)
+{
+    lsquic_cid_t cid;
+
+    cid.len = 8;
+    memset(cid.idbuf, 0xC1, 7);
+    cid.idbuf[7] = cid_byte;
+    return lsquic_engine_find_conn((struct lsquic_engine_public *) engine,
+                                                                        &cid);
+}
+
+
+/* Wrap the interface of a mini connection so that it retires its CID
+ * upon the first incoming packet -- as a full connection does when it
+ * receives RETIRE_CONNECTION_ID -- and closes on the next tick.
+ */
+static struct lsquic_engine *retiring_engine;
+static const struct conn_iface *orig_conn_if;
+static struct conn_iface retiring_conn_if;
+static unsigned retiring_n_packets;
+
+
+static void
+retiring_packet_in (struct lsquic_conn *lconn,
+                                        struct lsquic_packet_in *packet_in)
+{
+    orig_conn_if->ci_packet_in(lconn, packet_in);
+    if (1 == ++retiring_n_packets)
+        lsquic_engine_retire_cid(
+                    (struct lsquic_engine_public *) retiring_engine, lconn,
+                    0, packet_in->pi_received, 1000000);
+}
+
+
+static enum tick_st
+retiring_tick (struct lsquic_conn *lconn, lsquic_time_t now)
+{
+    return orig_conn_if->ci_tick(lconn, now) | TICK_CLOSE;
+}
+
+
+static void
+make_retiring (struct lsquic_engine *engine, struct lsquic_conn *lconn)
+{
+    retiring_engine = engine;
+    orig_conn_if = lconn->cn_if;
+    retiring_conn_if = *orig_conn_if;
+    retiring_conn_if.ci_packet_in = retiring_packet_in;
+    retiring_conn_if.ci_tick = retiring_tick;
+    lconn->cn_if = &retiring_conn_if;
+}
+
+
+int
+main (void)
+{
+    struct lsquic_engine_settings settings;
+    struct lsquic_engine_api api;
+    struct lsquic_engine *engine;
+    const struct lsquic_conn *b;
+    unsigned n;
+    const unsigned flags = LSENG_SERVER;
+    static const struct lsquic_stream_if stream_if;
+
+    lsquic_global_init(LSQUIC_GLOBAL_SERVER);
+
+    lsquic_engine_init_settings(&settings, flags);
+    settings.es_versions = 1 << LSQVER_043;
+
+    memset(&api, 0, sizeof(api));
+    api.ea_settings = &settings;
+    api.ea_packets_out = packets_out;
+    api.ea_stream_if = &stream_if;
+
+    engine = lsquic_engine_new(flags, &api);
+    assert(engine);
+
+    local_sa.sin_family = AF_INET;
+    local_sa.sin_port = htons(443);
+    local_sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    peer_sa = local_sa;
+    peer_sa.sin_port = htons(12345);
+
+    /* Packets for A and B interleaved; the last packet kills A */
+    n = feed_batch(engine, (struct packet_spec[]) {
+        { 'A', 1, 1, }, { 'A', 0, 2, }, { 'B', 1, 1, }, { 'A', 0, 0, },
+    }, 4);
+    assert(4 == n);
+    assert(find_conn(engine, 'A'));
+    b = find_conn(engine, 'B');
+    assert(b);
+
+    /* A is closed and removed from the hash */
+    lsquic_engine_process_conns(engine);
+    assert(!find_conn(engine, 'A'));
+    assert(b == find_conn(engine, 'B'));
+
+    /* The next batch starts with the removed CID, which is now in the
+     * purgatory, then goes to B, which dies, and on to a new connection C.
+     */
+    n = feed_batch(engine, (struct packet_spec[]) {
+        { 'A', 0, 2, }, { 'B', 0, 2, }, { 'B', 0, 0, }, { 'C', 1, 1, },
+        { 'B', 0, 3, }, { 'A', 0, 3, },
+    }, 6);
+    assert(6 == n);
+    assert(!find_conn(engine, 'A'));
+    assert(b == find_conn(engine, 'B'));
+    assert(find_conn(engine, 'C'));
+
+    lsquic_engine_process_conns(engine);
+    assert(!find_conn(engine, 'B'));
+    assert(find_conn(engine, 'C'));
+
+    /* C retires its CID while processing the first packet of the batch;
+     * the packets that follow must not reach it.
+     */
+    make_retiring(engine, (struct lsquic_conn *) find_conn(engine, 'C'));
+    n = feed_batch(engine, (struct packet_spec[]) {
+        { 'C', 0, 2, }, { 'C', 0, 3, }, { 'C', 0, 4, },
+    }, 3);
+    assert(3 == n);
+    assert(1 == retiring_n_packets);
+    assert(!find_conn(engine, 'C'));
+
+    lsquic_engine_process_conns(engine);
+
+    lsquic_engine_destroy(engine);
+    lsquic_global_cleanup();
+    return 0;
+}
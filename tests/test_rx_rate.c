@@ -0,0 +1,61 @@
+/* Copyright (c) 2017 - 2021 LiteSpeed Technologies Inc.  See LICENSE. */
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lsquic_int_types.h"
+#include "lsquic_minmax.h"
+#include "lsquic_rx_rate.h"
+
+/* Convert milliseconds to lsquic_time_t, which is microseconds */
+#define ms(val) ((val) * 1000)
+
+#define SRTT ms(40)
+
+
+/* Packets of `sz' bytes every `gap' from `*now' until `end' */
+static void
+receive (struct rx_rate *rxr, lsquic_time_t *now, lsquic_time_t end,
+                                                lsquic_time_t gap, unsigned sz)
+{
+    for ( ; *now < end; *now += gap)
+        lsquic_rx_rate_packet_in(rxr, *now, sz, SRTT);
+}
+
+
+int
+main (void)
+{
+    struct rx_rate rxr;
+    lsquic_time_t now;
+
+    lsquic_rx_rate_init(&rxr);
+    assert(0 == lsquic_rx_rate_get(&rxr));
+
+    /* 1000 bytes per millisecond: 1 MB/s */
+    now = ms(1000);
+    receive(&rxr, &now, ms(1100), ms(1), 1000);
+    assert(lsquic_rx_rate_get(&rxr) == 1000000);
+    assert(lsquic_rx_rate_get_max(&rxr) == 1000000);
+    assert(lsquic_rx_rate_total(&rxr) == 100 * 1000);
+
+    /* The peer slows down: the maximum is kept for ten intervals */
+    receive(&rxr, &now, ms(1200), ms(2), 1000);
+    assert(lsquic_rx_rate_get(&rxr) == 500000);
+    assert(lsquic_rx_rate_get_max(&rxr) == 1000000);
+    receive(&rxr, &now, ms(1200) + 10 * SRTT, ms(2), 1000);
+    assert(lsquic_rx_rate_get_max(&rxr) == 500000);
+
+    /* An idle second between two downloads does not lower the rate */
+    now += ms(1000);
+    receive(&rxr, &now, now + ms(100), ms(4), 1000);
+    assert(lsquic_rx_rate_get(&rxr) == 250000);
+
+    /* Packets that arrive together do not complete an interval */
+    lsquic_rx_rate_init(&rxr);
+    now = ms(1);
+    receive(&rxr, &now, ms(2), 1, 1200);
+    assert(0 == lsquic_rx_rate_get(&rxr));
+
+    return 0;
+}
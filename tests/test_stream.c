@@ -51,6 +51,7 @@
 #include "lsquic_varint.h"
 #include "lsquic_hq.h"
 #include "lsquic_data_in_if.h"
+#include "lsquic_util.h"
 
 static const struct parse_funcs *g_pf = select_pf_by_ver(LSQVER_043);
 
@@ -343,11 +344,23 @@ write_ack (struct lsquic_conn *lconn, struct lsquic_packet_out *packet_out)
 }
 
 
+static void
+set_deadline_alarm (struct lsquic_conn *lconn, lsquic_time_t expiry)
+{
+    struct test_objs *const tobjs = (void *) lconn;
+
+    if (!lsquic_alarmset_is_set(&tobjs->alset, AL_DEADLINE)
+                            || tobjs->alset.as_expiry[AL_DEADLINE] > expiry)
+        lsquic_alarmset_set(&tobjs->alset, AL_DEADLINE, expiry);
+}
+
+
 static const struct conn_iface our_conn_if =
 {
     .ci_can_write_ack = can_write_ack,
     .ci_get_path      = get_network_path,
     .ci_write_ack     = write_ack,
+    .ci_set_deadline_alarm = set_deadline_alarm,
 };
 
 #if LSQUIC_CONN_STATS
@@ -3536,6 +3549,233 @@ test_conn_abort (void)
 }
 
 
+static unsigned n_deadlines;
+
+
+static void
+deadline_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *h)
+{
+    char buf[0x100];
+    ssize_t nr;
+
+    do
+        nr = lsquic_stream_read(stream, buf, sizeof(buf));
+    while (nr > 0);
+    if (nr == 0)
+        lsquic_stream_wantread(stream, 0);
+}
+
+
+static void
+deadline_on_deadline (lsquic_stream_t *stream, lsquic_stream_ctx_t *h)
+{
+    ++n_deadlines;
+}
+
+
+static const struct lsquic_stream_if deadline_stream_if =
+{
+    .on_new_stream          = on_new_stream,
+    .on_read                = deadline_on_read,
+    .on_close               = on_close,
+    .on_deadline            = deadline_on_deadline,
+};
+
+
+/* Same as the connections do it */
+static void
+deadline_alarm_expired (enum alarm_id al_id, void *ctx, lsquic_time_t expiry,
+                                                            lsquic_time_t now)
+{
+    struct test_objs *const tobjs = ctx;
+    lsquic_time_t next;
+
+    next = lsquic_stream_check_deadline(test_ctx.stream, now);
+    if (next)
+        lsquic_alarmset_set(&tobjs->alset, AL_DEADLINE, next);
+}
+
+
+static struct lsquic_stream *
+deadline_frame_in (struct test_objs *tobjs, struct lsquic_stream *stream,
+                    size_t off, size_t sz, int fin, lsquic_time_t received)
+{
+    stream_frame_t *frame;
+    int s;
+
+    frame = new_frame_in(tobjs, off, sz, fin);
+    frame->packet_in->pi_received = received;
+    s = lsquic_stream_frame_in(stream, frame);
+    assert(0 == s);
+    return stream;
+}
+
+
+/* The deadline alarm is armed at the deadline and at the point where the
+ * deadline is projected to be missed, so that on_deadline is called even
+ * if no more data arrives.
+ */
+static void
+test_deadline (void)
+{
+    struct test_objs tobjs;
+    struct lsquic_stream *stream;
+    struct lsquic_stream_progress progress;
+    lsquic_time_t before, after, expiry;
+    int s;
+
+    init_test_ctl_settings(&g_ctl_settings);
+    init_test_objs(&tobjs, 0x4000, 0x4000, NULL);
+    tobjs.stream_if = &deadline_stream_if;
+    lsquic_alarmset_init_alarm(&tobjs.alset, AL_DEADLINE,
+                                            deadline_alarm_expired, &tobjs);
+    n_deadlines = 0;
+
+    stream = new_stream(&tobjs, 123);
+    assert(stream == test_ctx.stream);
+    lsquic_stream_wantread(stream, 1);
+
+    s = lsquic_stream_get_progress(stream, &progress);
+    assert(0 == s);
+    assert(0 == progress.lsp_bytes_received);
+    assert(0 == progress.lsp_bytes_read);
+    assert(0 == progress.lsp_rate);
+    assert(0 == progress.lsp_eta);
+
+    /* Nothing is known about the rate: check at the deadline */
+    before = lsquic_time_now();
+    s = lsquic_stream_set_deadline(stream, 10000000, 200000);
+    assert(0 == s);
+    after = lsquic_time_now();
+    assert(lsquic_alarmset_is_set(&tobjs.alset, AL_DEADLINE));
+    expiry = tobjs.alset.as_expiry[AL_DEADLINE];
+    assert(expiry >= before + 10000000 && expiry <= after + 10000000);
+
+    /* 1000 bytes over the 50 ms default interval: 20000 bytes per second.
+     * The remaining 198000 bytes take 9.9 seconds, which is still in time,
+     * but the deadline is missed if nothing arrives for 100 ms.
+     */
+    deadline_frame_in(&tobjs, stream, 0, 1000, 0, before);
+    deadline_frame_in(&tobjs, stream, 1000, 1000, 0, before + 50000);
+    s = lsquic_stream_get_progress(stream, &progress);
+    assert(0 == s);
+    assert(2000 == progress.lsp_bytes_received);
+    assert(20000 == progress.lsp_rate);
+    assert(9900000 == progress.lsp_eta);
+    assert(!(stream->stream_flags & STREAM_DEADLINE_MISSED));
+    expiry = tobjs.alset.as_expiry[AL_DEADLINE];
+    assert(expiry >= before + 100001 && expiry <= after + 100001);
+
+    /* The alarm does not ring before its time */
+    lsquic_alarmset_ring_expired(&tobjs.alset, expiry);
+    assert(lsquic_alarmset_is_set(&tobjs.alset, AL_DEADLINE));
+    assert(!(stream->stream_flags & STREAM_DEADLINE_MISSED));
+
+    /* No data arrives: the alarm marks the deadline missed */
+    lsquic_alarmset_ring_expired(&tobjs.alset, expiry + 1);
+    assert(!lsquic_alarmset_is_set(&tobjs.alset, AL_DEADLINE));
+    assert(stream->stream_flags & STREAM_DEADLINE_MISSED);
+    assert(0 == n_deadlines);
+
+    lsquic_stream_dispatch_read_events(stream);
+    assert(1 == n_deadlines);
+    s = lsquic_stream_get_progress(stream, &progress);
+    assert(0 == s);
+    assert(2000 == progress.lsp_bytes_read);
+    lsquic_stream_dispatch_read_events(stream);
+    assert(1 == n_deadlines);   /* Called once */
+
+    /* The deadline passes with no rate: the alarm at the deadline fires */
+    before = lsquic_time_now();
+    s = lsquic_stream_set_deadline(stream, 1000, 0);
+    assert(0 == s);
+    after = lsquic_time_now();
+    expiry = tobjs.alset.as_expiry[AL_DEADLINE];
+    assert(expiry >= before + 1000 && expiry <= after + 1000);
+    lsquic_alarmset_ring_expired(&tobjs.alset, expiry + 1);
+    assert(!lsquic_alarmset_is_set(&tobjs.alset, AL_DEADLINE));
+    lsquic_stream_dispatch_read_events(stream);
+    assert(2 == n_deadlines);
+
+    /* All data arrives in time: the alarm finds nothing to do */
+    s = lsquic_stream_set_deadline(stream, 1000, 0);
+    assert(0 == s);
+    expiry = tobjs.alset.as_expiry[AL_DEADLINE];
+    deadline_frame_in(&tobjs, stream, 2000, 100, 1, lsquic_time_now());
+    lsquic_alarmset_ring_expired(&tobjs.alset, expiry + 1);
+    assert(!lsquic_alarmset_is_set(&tobjs.alset, AL_DEADLINE));
+    assert(!(stream->stream_flags & STREAM_DEADLINE_MISSED));
+    lsquic_stream_dispatch_read_events(stream);
+    assert(2 == n_deadlines);
+    s = lsquic_stream_get_progress(stream, &progress);
+    assert(0 == s);
+    assert(2100 == progress.lsp_bytes_received);
+    assert(2100 == progress.lsp_bytes_read);
+
+    lsquic_stream_destroy(stream);
+    deinit_test_objs(&tobjs);
+}
+
+
+/* On a server stream, the request arrives after the deadline is set for the
+ * response.  Meeting or missing the receive deadline does not remove the
+ * send deadline used by the write scheduler.
+ */
+static void
+test_send_deadline (void)
+{
+    struct test_objs tobjs;
+    struct lsquic_stream *stream;
+    lsquic_time_t deadline, expiry;
+    uint64_t left;
+    int s;
+
+    init_test_ctl_settings(&g_ctl_settings);
+    init_test_objs(&tobjs, 0x4000, 0x4000, NULL);
+    tobjs.stream_if = &deadline_stream_if;
+    lsquic_alarmset_init_alarm(&tobjs.alset, AL_DEADLINE,
+                                            deadline_alarm_expired, &tobjs);
+    n_deadlines = 0;
+
+    stream = new_stream(&tobjs, 123);
+    lsquic_stream_wantread(stream, 1);
+    assert(0 == lsquic_stream_send_deadline(stream, &left));
+
+    /* Part of the request arrives, then the receive deadline is missed */
+    s = lsquic_stream_set_deadline(stream, 1, 5000);
+    assert(0 == s);
+    deadline = lsquic_stream_send_deadline(stream, &left);
+    assert(deadline);
+    assert(5000 == left);
+    deadline_frame_in(&tobjs, stream, 0, 100, 0, lsquic_time_now());
+    expiry = tobjs.alset.as_expiry[AL_DEADLINE];
+    lsquic_alarmset_ring_expired(&tobjs.alset, expiry + 1);
+    lsquic_stream_dispatch_read_events(stream);
+    assert(1 == n_deadlines);
+    assert(deadline == lsquic_stream_send_deadline(stream, &left));
+    assert(5000 == left);
+
+    /* The rest of the request and FIN arrive in time */
+    s = lsquic_stream_set_deadline(stream, 1000000, 5000);
+    assert(0 == s);
+    deadline = lsquic_stream_send_deadline(stream, &left);
+    assert(deadline);
+    deadline_frame_in(&tobjs, stream, 100, 100, 1, lsquic_time_now());
+    lsquic_stream_dispatch_read_events(stream);
+    assert(1 == n_deadlines);
+    assert(deadline == lsquic_stream_send_deadline(stream, &left));
+    assert(5000 == left);
+
+    /* A zero deadline removes both */
+    s = lsquic_stream_set_deadline(stream, 0, 0);
+    assert(0 == s);
+    assert(0 == lsquic_stream_send_deadline(stream, &left));
+
+    lsquic_stream_destroy(stream);
+    deinit_test_objs(&tobjs);
+}
+
+
 /* Test one: large frame first, followed by small frames to finish off
  * the packet.
  */
@@ -3729,6 +3969,9 @@ main (int argc, char **argv)
 
     test_conn_abort();
 
+    test_deadline();
+    test_send_deadline();
+
     test_bad_packbits_guess_1();
     test_bad_packbits_guess_2();
     test_bad_packbits_guess_3();